@@ -0,0 +1,363 @@
+/* bootldr : USB firmware update bootloader, with A/B slots
+ * Warren W. Gay VE3WWG
+ *
+ * Lives in the first 8K of flash. At reset it boots the slot that
+ * boot_select() chooses (see bootctl.h), unless:
+ *
+ * 1) The application asked for an update (boot_update()),
+ * 2) The BOOT1 jumper (PB2) is set to 1, or
+ * 3) Neither slot holds a good image.
+ *
+ * Then it stays, with the LED (PC13) lit, as a USB vendor class
+ * device (16C0:05DF), taking commands on bulk EP 0x01 and replying
+ * on EP 0x82 (bootctl.h). posix/bootload sends the images.
+ *
+ * Image data is read by the USB ISR into a ring of page buffers,
+ * while the main loop erases and programs the page before, a half-
+ * word at a time. When the ring is full, EP 0x01 NAKs (the host
+ * waits) until a page has been programmed.
+ */
+#include <string.h>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/f1/bkp.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/usb/usbd.h>
+#include <libopencm3/usb/usbstd.h>
+
+#include "bootctl.h"
+
+#define NBUF		4			// Page buffers (4K)
+
+static usbd_device *udev = NULL;	// USB Device
+static uint8_t usbd_control_buffer[128];
+
+static uint8_t ring[NBUF][BOOT_PAGE] __attribute__((aligned(4)));
+static volatile unsigned head, tail;	// Pages received, programmed
+static volatile uint32_t rxbytes;	// Image bytes received
+static volatile bool loading = false;	// Receiving image data
+static volatile bool nak = false;	// EP 0x01 held off: ring full
+static struct s_bootcmd cmd;		// Command received
+static volatile bool cmdready = false;
+static struct s_bootwr wr;		// Image being written
+
+static const struct usb_device_descriptor dev = {
+	.bLength = USB_DT_DEVICE_SIZE,
+	.bDescriptorType = USB_DT_DEVICE,
+	.bcdUSB = 0x0200,
+	.bDeviceClass = USB_CLASS_VENDOR,
+	.bDeviceSubClass = 0,
+	.bDeviceProtocol = 0,
+	.bMaxPacketSize0 = 64,
+	.idVendor = BOOT_USB_VID,
+	.idProduct = BOOT_USB_PID,
+	.bcdDevice = 0x0100,
+	.iManufacturer = 1,
+	.iProduct = 2,
+	.iSerialNumber = 3,
+	.bNumConfigurations = 1,
+};
+
+static const struct usb_endpoint_descriptor data_endp[] = {
+	{
+		.bLength = USB_DT_ENDPOINT_SIZE,
+		.bDescriptorType = USB_DT_ENDPOINT,
+		.bEndpointAddress = 0x01,		/* From Host */
+		.bmAttributes = USB_ENDPOINT_ATTR_BULK,
+		.wMaxPacketSize = 64,
+		.bInterval = 0,				/* Ignored for bulk */
+	}, {
+		.bLength = USB_DT_ENDPOINT_SIZE,
+		.bDescriptorType = USB_DT_ENDPOINT,
+		.bEndpointAddress = 0x82,		/* To Host */
+		.bmAttributes = USB_ENDPOINT_ATTR_BULK,
+		.wMaxPacketSize = 64,
+		.bInterval = 0,				/* Ignored for bulk */
+	}
+};
+
+static const struct usb_interface_descriptor data_iface[] = {
+	{
+		.bLength = USB_DT_INTERFACE_SIZE,
+		.bDescriptorType = USB_DT_INTERFACE,
+		.bInterfaceNumber = 0,
+		.bAlternateSetting = 0,
+		.bNumEndpoints = 2,
+		.bInterfaceClass = 0xFF,
+		.bInterfaceSubClass = 0,
+		.bInterfaceProtocol = 0,
+		.iInterface = 0,
+
+		.endpoint = data_endp,
+	}
+};
+
+static const struct usb_interface ifaces[] = {
+	{
+		.num_altsetting = 1,
+		.altsetting = data_iface,
+	}
+};
+
+static const struct usb_config_descriptor config = {
+	.bLength = USB_DT_CONFIGURATION_SIZE,
+	.bDescriptorType = USB_DT_CONFIGURATION,
+	.wTotalLength = 0,
+	.bNumInterfaces = 1,
+	.bConfigurationValue = 1,
+	.iConfiguration = 0,
+	.bmAttributes = 0x80,
+	.bMaxPower = 0x32,
+	.interface = ifaces,
+};
+
+static const char * usb_strings[] = {
+	"Warren's bootloader",
+	"VE3WWG bootldr",
+	"ve3wwg",
+};
+
+static void
+delay(unsigned loops) {
+	for ( unsigned ux = 0; ux < loops; ++ux )
+		__asm__("nop");
+}
+
+/*
+ * Bulk receive (from the USB ISR): commands, else image data
+ * into the ring. EP 0x01 is set to NAK before the packet is read,
+ * so another can't arrive before we know there is room for it.
+ */
+static void
+bulk_rx_cb(usbd_device *usbd_dev,uint8_t ep) {
+	static uint8_t junk[64];
+	uint32_t off = rxbytes % BOOT_PAGE;
+	unsigned len;
+
+	usbd_ep_nak_set(usbd_dev,ep,1);
+
+	if ( !loading ) {
+		len = usbd_ep_read_packet(usbd_dev,ep,&cmd,sizeof cmd);
+		if ( len == sizeof cmd )
+			cmdready = true;	// NAK until main has it
+		else	usbd_ep_nak_set(usbd_dev,ep,0);
+		return;
+	}
+
+	if ( rxbytes >= wr.length ) {
+		usbd_ep_read_packet(usbd_dev,ep,junk,sizeof junk);
+		usbd_ep_nak_set(usbd_dev,ep,0);
+		return;				// Extra to the image
+	}
+
+	len = usbd_ep_read_packet(usbd_dev,ep,ring[head % NBUF] + off,
+		BOOT_PAGE - off < 64 ? BOOT_PAGE - off : 64);
+	rxbytes += len;
+	if ( rxbytes % BOOT_PAGE == 0 || rxbytes >= wr.length )
+		++head;				// Page ready to program
+
+	if ( head - tail < NBUF )
+		usbd_ep_nak_set(usbd_dev,ep,0);
+	else	nak = true;
+}
+
+static void
+set_config(usbd_device *usbd_dev,uint16_t wValue) {
+	(void)wValue;
+
+	usbd_ep_setup(usbd_dev,0x01,USB_ENDPOINT_ATTR_BULK,64,bulk_rx_cb);
+	usbd_ep_setup(usbd_dev,0x82,USB_ENDPOINT_ATTR_BULK,64,NULL);
+}
+
+void
+usb_lp_can_rx0_isr(void) {
+	usbd_poll(udev);
+}
+
+/*
+ * Main loop side of EP 0x01: let the host send again, and reply
+ */
+static void
+rx_resume(void) {
+
+	nvic_disable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+	nak = false;
+	usbd_ep_nak_set(udev,0x01,0);
+	nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+}
+
+static void
+reply(const void *data,unsigned len) {
+	uint16_t sent;
+
+	do	{
+		nvic_disable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+		sent = usbd_ep_write_packet(udev,0x82,data,len);
+		nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+	} while ( sent == 0 );
+}
+
+static void
+reply_status(int status,uint32_t bytes,uint32_t crc) {
+	struct s_bootreply r;
+
+	r.magic = BOOT_CMD_MAGIC;
+	r.status = status;
+	r.bytes = bytes;
+	r.crc = crc;
+	reply(&r,sizeof r);
+}
+
+/*
+ * Act on a command from the host
+ */
+static void
+command(void) {
+	struct s_bootstate st;
+	struct s_bootinfo info;
+	int rc;
+
+	cmdready = false;
+	if ( cmd.magic != BOOT_CMD_MAGIC ) {
+		rx_resume();
+		return;
+	}
+
+	switch ( cmd.cmd ) {
+	case BOOT_CMD_INFO:
+		boot_state(&st);
+		info.magic = BOOT_CMD_MAGIC;
+		for ( unsigned sx = 0; sx < 2; ++sx ) {
+			info.addr[sx] = boot_slot_addr(sx);
+			info.length[sx] = st.length[sx];
+			info.crc[sx] = st.crc[sx];
+		}
+		info.size = BOOT_SLOT_SIZE;
+		info.slot = st.slot;
+		info.state = st.state;
+		info.valid = boot_valid(0) | boot_valid(1) << 1;
+		info.spare = 0;
+		reply(&info,sizeof info);
+		break;
+	case BOOT_CMD_WRITE:
+		rc = boot_write_begin(&wr,cmd.slot,cmd.length,cmd.crc);
+		if ( rc == 0 ) {
+			head = tail = rxbytes = 0;
+			loading = true;
+		}
+		reply_status(rc,0,0);
+		break;
+	case BOOT_CMD_BOOT:
+	case BOOT_CMD_RESET:
+		rc = cmd.cmd == BOOT_CMD_BOOT ? boot_trial(cmd.slot) : 0;
+		reply_status(rc,0,0);
+		if ( rc == 0 ) {
+			delay(720000);		// Let the reply go
+			scb_reset_system();
+		}
+		break;
+	default:
+		reply_status(BOOT_EINVAL,0,0);
+	}
+	rx_resume();
+}
+
+/*
+ * Program the next page received, ending the upload with its
+ * verified status after the last (or an error)
+ */
+static void
+program(void) {
+	uint32_t off = tail * BOOT_PAGE;
+	unsigned n = wr.length - off < BOOT_PAGE ? wr.length - off : BOOT_PAGE;
+	int rc;
+
+	rc = boot_write(&wr,ring[tail % NBUF],n);
+	++tail;
+	if ( rc == 0 && wr.done < wr.length ) {
+		if ( nak )
+			rx_resume();		// Room for another page
+		return;
+	}
+
+	if ( rc == 0 )
+		rc = boot_write_end(&wr);
+	loading = false;
+	rx_resume();
+	reply_status(rc,wr.done,boot_crc(wr.base,wr.done));
+}
+
+/*
+ * Run the image at base, as if from reset
+ */
+static void
+run(uint32_t base) {
+	const uint32_t *vt = (const uint32_t *)base;
+
+	rcc_periph_clock_disable(RCC_CRC);
+	rcc_periph_clock_disable(RCC_BKP);
+	rcc_periph_clock_disable(RCC_PWR);
+	rcc_periph_clock_disable(RCC_GPIOB);
+
+	SCB_VTOR = base;
+	__asm__ volatile (
+		"msr	msp,%0\n\t"
+		"bx	%1\n"
+		: : "r" (vt[0]), "r" (vt[1]));
+	for (;;);
+}
+
+/*
+ * Main program:
+ */
+int
+main(void) {
+	bool stay;
+	int slot;
+
+	rcc_periph_clock_enable(RCC_GPIOB);
+	rcc_periph_clock_enable(RCC_PWR);
+	rcc_periph_clock_enable(RCC_BKP);
+	gpio_set_mode(GPIOB,GPIO_MODE_INPUT,GPIO_CNF_INPUT_FLOAT,GPIO2);	// BOOT1
+
+	stay = BKP_DR1 == BOOT_DR_UPDATE || gpio_get(GPIOB,GPIO2);
+	if ( BKP_DR1 == BOOT_DR_UPDATE ) {
+		pwr_disable_backup_domain_write_protect();
+		BKP_DR1 = 0;			// Once only
+	}
+	if ( !stay && (slot = boot_select()) >= 0 )
+		run(boot_slot_addr(slot));
+
+	rcc_clock_setup_pll(&rcc_hse_configs[RCC_CLOCK_HSE8_72MHZ]);
+
+	// LED on C13: lit while in the bootloader
+	rcc_periph_clock_enable(RCC_GPIOC);
+	gpio_set_mode(GPIOC,GPIO_MODE_OUTPUT_2_MHZ,GPIO_CNF_OUTPUT_PUSHPULL,GPIO13);
+	gpio_clear(GPIOC,GPIO13);
+
+	// For USB: hold D+ low a while, so the host sees a new device
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_USB);
+	gpio_set_mode(GPIOA,GPIO_MODE_OUTPUT_2_MHZ,GPIO_CNF_OUTPUT_PUSHPULL,GPIO12);
+	gpio_clear(GPIOA,GPIO12);
+	delay(720000);
+
+	udev = usbd_init(&st_usbfs_v1_usb_driver,&dev,&config,
+		usb_strings,3,
+		usbd_control_buffer,sizeof(usbd_control_buffer));
+	usbd_register_set_config_callback(udev,set_config);
+	nvic_enable_irq(NVIC_USB_LP_CAN_RX0_IRQ);
+
+	for (;;) {
+		if ( cmdready )
+			command();
+		if ( loading && tail != head )
+			program();
+	}
+	return 0;
+}
+
+// End main.c
@@ -0,0 +1,302 @@
+//////////////////////////////////////////////////////////////////////
+// bootload.cpp -- Send a firmware image to bootldr over USB
+// Warren W. Gay VE3WWG
+///////////////////////////////////////////////////////////////////////
+//
+// Usage: bootload [-i] [-n] [-f] image.bin
+//
+//	-i	Show the device's slots only
+//	-n	Write the image, but don't boot it
+//	-f	Write it even over the slot booted now
+//
+// The image (objcopy -Obinary) must be linked for slot A or B
+// (ld/slot_a.ld or ld/slot_b.ld): its reset vector tells which.
+// It is padded to a multiple of 4 bytes, and its CRC computed as
+// the MCU's CRC unit will. Then:
+//
+//	1)  BOOT_CMD_INFO: slots and the one booted
+//	2)  BOOT_CMD_WRITE: the device is ready for the image
+//	3)  The image goes as one bulk transfer, while the device
+//	    programs it a page behind, and then replies with the CRC
+//	    it reads back
+//	4)  BOOT_CMD_BOOT: the device resets and runs the image on
+//	    trial. The image must call boot_confirm(), else the next
+//	    reset rolls back to the other slot.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <usb.h>
+
+#include "bootctl.h"
+
+#define EP_OUT		0x01
+#define EP_IN		0x82
+#define TIMEOUT_MS	1000		// Command replies
+#define LOAD_MS		20000		// Image: erase and program
+
+static struct usb_dev_handle *handle = 0;
+static unsigned char image[BOOT_SLOT_SIZE];
+
+//////////////////////////////////////////////////////////////////////
+// Release interface and close USB device upon exit
+//////////////////////////////////////////////////////////////////////
+
+static void
+exit_cleanup() {
+
+	if ( handle ) {
+		usb_release_interface(handle,0);
+		usb_close(handle);
+	}
+}
+
+static double
+now() {
+	struct timeval tv;
+
+	gettimeofday(&tv,0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CRC-32 as the STM32 CRC unit: poly 0x04C11DB7, MSB first, over
+// little endian words, initial 0xFFFFFFFF, no final XOR
+//////////////////////////////////////////////////////////////////////
+
+static uint32_t
+stm32_crc(const unsigned char *data,uint32_t bytes) {
+	uint32_t crc = 0xFFFFFFFF, w;
+
+	for ( uint32_t ux = 0; ux < bytes; ux += 4 ) {
+		w = data[ux] | data[ux+1] << 8 | data[ux+2] << 16 | (uint32_t)data[ux+3] << 24;
+		crc ^= w;
+		for ( unsigned bx = 0; bx < 32; ++bx )
+			crc = crc & 0x80000000 ? crc << 1 ^ 0x04C11DB7 : crc << 1;
+	}
+	return crc;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Open the bootloader device
+//////////////////////////////////////////////////////////////////////
+
+static void
+open_device() {
+	struct usb_device *usb_dev = 0;
+
+	usb_init();
+	usb_find_busses();
+	usb_find_devices();
+
+	for ( struct usb_bus *bus=usb_get_busses(); bus && !usb_dev; bus=bus->next ) {
+		for ( struct usb_device *dev=bus->devices; dev && !usb_dev; dev=dev->next ) {
+			struct usb_device_descriptor& desc = dev->descriptor;
+
+			if ( desc.idVendor == BOOT_USB_VID && desc.idProduct == BOOT_USB_PID )
+				usb_dev = dev;
+		}
+	}
+
+	if ( !usb_dev ) {
+		fprintf(stderr,"bootldr device %04X:%04X not found: reset into it\n"
+			"(boot_update(), or BOOT1 jumper to 1)\n",
+			BOOT_USB_VID,BOOT_USB_PID);
+		exit(1);
+	}
+
+	handle = usb_open(usb_dev);
+	if ( !handle ) {
+		fprintf(stderr,"%s: opening device\n",usb_strerror());
+		exit(1);
+	}
+	atexit(exit_cleanup);
+
+	if ( usb_claim_interface(handle,0) < 0 ) {
+		fprintf(stderr,"%s: claiming interface 0\n",usb_strerror());
+		usb_close(handle);
+		handle = 0;
+		exit(1);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////
+// Send a command, and receive its reply
+//////////////////////////////////////////////////////////////////////
+
+static void
+send_cmd(uint8_t cmd,uint8_t slot,uint32_t length,uint32_t crc) {
+	struct s_bootcmd c;
+	int rc;
+
+	memset(&c,0,sizeof c);
+	c.magic = BOOT_CMD_MAGIC;
+	c.cmd = cmd;
+	c.slot = slot;
+	c.length = length;
+	c.crc = crc;
+
+	rc = usb_bulk_write(handle,EP_OUT,(char *)&c,sizeof c,TIMEOUT_MS);
+	if ( rc != sizeof c ) {
+		fprintf(stderr,"%s: sending command %u\n",usb_strerror(),cmd);
+		exit(1);
+	}
+}
+
+static void
+recv_reply(void *buf,int bytes,int timeout_ms) {
+	char rxbuf[64];
+	int rc;
+
+	rc = usb_bulk_read(handle,EP_IN,rxbuf,sizeof rxbuf,timeout_ms);
+	if ( rc != bytes || *(uint32_t *)rxbuf != BOOT_CMD_MAGIC ) {
+		fprintf(stderr,"Bad reply (%d bytes): %s\n",rc,rc < 0 ? usb_strerror() : "");
+		exit(1);
+	}
+	memcpy(buf,rxbuf,bytes);
+}
+
+static const char *
+status_text(int status) {
+
+	switch ( status ) {
+	case 0:			return "OK";
+	case BOOT_EINVAL:	return "invalid slot, length or command";
+	case BOOT_EIO:		return "flash erase/program failed";
+	case BOOT_ECRC:		return "CRC mismatch";
+	case BOOT_EADDR:	return "image not linked for this slot";
+	}
+	return "?";
+}
+
+static const char *
+state_text(unsigned state) {
+
+	switch ( state ) {
+	case BOOT_TRIAL:	return "trial (next boot)";
+	case BOOT_TRYING:	return "on trial, unconfirmed";
+	case BOOT_GOOD:		return "good";
+	}
+	return "none";
+}
+
+//////////////////////////////////////////////////////////////////////
+// Main program
+//////////////////////////////////////////////////////////////////////
+
+int
+main(int argc,char **argv) {
+	bool opt_info = false, opt_noboot = false, opt_force = false;
+	struct s_bootinfo info;
+	struct s_bootreply reply;
+	uint32_t length, crc, reset;
+	unsigned slot;
+	double t0;
+	FILE *f;
+	int optch, rc;
+
+	while ( (optch = getopt(argc,argv,"inf")) != -1 ) {
+		switch ( optch ) {
+		case 'i':
+			opt_info = true;
+			break;
+		case 'n':
+			opt_noboot = true;
+			break;
+		case 'f':
+			opt_force = true;
+			break;
+		default:
+			fprintf(stderr,"Usage: %s [-i] [-n] [-f] image.bin\n",argv[0]);
+			exit(2);
+		}
+	}
+
+	open_device();
+	send_cmd(BOOT_CMD_INFO,0,0,0);
+	recv_reply(&info,sizeof info,TIMEOUT_MS);
+
+	for ( unsigned sx = 0; sx < 2; ++sx )
+		printf("Slot %c: 0x%08X %6u bytes CRC %08X %s%s\n",
+			'A' + sx,info.addr[sx],info.length[sx],info.crc[sx],
+			info.valid & (1 << sx) ? "valid" : "empty",
+			info.state != BOOT_NONE && info.slot == sx ? "  <- boots" : "");
+	printf("State: %s\n",state_text(info.state));
+
+	if ( opt_info )
+		return 0;
+	if ( optind >= argc ) {
+		fprintf(stderr,"No image file given.\n");
+		exit(2);
+	}
+
+	// Read the image, padded to whole words
+	if ( !(f = fopen(argv[optind],"rb")) ) {
+		fprintf(stderr,"%s: opening %s\n",strerror(errno),argv[optind]);
+		exit(1);
+	}
+	memset(image,0xFF,sizeof image);
+	length = fread(image,1,sizeof image,f);
+	if ( !feof(f) && fgetc(f) != EOF ) {
+		fprintf(stderr,"%s: over the %u byte slot size\n",argv[optind],info.size);
+		exit(1);
+	}
+	fclose(f);
+	length = (length + 3) & ~3u;
+	crc = stm32_crc(image,length);
+
+	reset = image[4] | image[5] << 8 | image[6] << 16 | (uint32_t)image[7] << 24;
+	for ( slot = 0; slot < 2; ++slot )
+		if ( reset >= info.addr[slot] && reset < info.addr[slot] + info.size )
+			break;
+	if ( slot >= 2 || length > info.size ) {
+		fprintf(stderr,"%s: reset vector 0x%08X is in neither slot\n",argv[optind],reset);
+		exit(1);
+	}
+	if ( info.state != BOOT_NONE && info.slot == slot && (info.valid & (1 << slot)) && !opt_force ) {
+		fprintf(stderr,"%s is linked for slot %c, which boots now: relink it for\n"
+			"slot %c (ld/slot_%c.ld) to keep a rollback, or use -f.\n",
+			argv[optind],'A' + slot,'B' - slot,'b' - slot);
+		exit(1);
+	}
+
+	// Write it
+	t0 = now();
+	send_cmd(BOOT_CMD_WRITE,slot,length,crc);
+	recv_reply(&reply,sizeof reply,TIMEOUT_MS);
+	if ( reply.status != 0 ) {
+		fprintf(stderr,"Write refused: %s\n",status_text(reply.status));
+		exit(1);
+	}
+
+	rc = usb_bulk_write(handle,EP_OUT,(char *)image,length,LOAD_MS);
+	if ( rc != (int)length ) {
+		fprintf(stderr,"%s: sending image (%d of %u bytes)\n",usb_strerror(),rc,length);
+		exit(1);
+	}
+	recv_reply(&reply,sizeof reply,LOAD_MS);
+	printf("Slot %c: %u bytes in %.2f s, CRC %08X: %s\n",
+		'A' + slot,reply.bytes,now() - t0,reply.crc,status_text(reply.status));
+	if ( reply.status != 0 )
+		exit(1);
+
+	if ( opt_noboot )
+		return 0;
+
+	send_cmd(BOOT_CMD_BOOT,slot,0,0);
+	recv_reply(&reply,sizeof reply,TIMEOUT_MS);
+	if ( reply.status != 0 ) {
+		fprintf(stderr,"Boot refused: %s\n",status_text(reply.status));
+		exit(1);
+	}
+	printf("Booting slot %c on trial.\n",'A' + slot);
+	return 0;
+}
+
+// End bootload.cpp
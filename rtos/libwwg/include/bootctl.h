@@ -0,0 +1,187 @@
+/* bootctl.h : A/B application slots, boot log and update protocol
+ * Warren W. Gay VE3WWG
+ *
+ * NOTES:
+ *	(1) Flash layout (128K part, as most "C8T6" blue pills are):
+ *
+ *	    0x08000000   8K  bootldr (../../../bootldr)
+ *	    0x08002000  56K  slot A (link with ld/slot_a.ld)
+ *	    0x08010000  56K  slot B (link with ld/slot_b.ld)
+ *	    0x0801E000   6K  spare
+ *	    0x0801F800   2K  boot log (two 1K pages)
+ *
+ *	    A 64K part can't hold two 56K slots: define BOOT_SLOT_B
+ *	    and BOOT_SLOT_SIZE (and BOOT_LOG) for smaller slots.
+ *	(2) An image runs where it was linked, so it is built for
+ *	    slot A or B, and goes to the slot not running now.
+ *	(3) The boot log is append-only 16 byte records, alternating
+ *	    between two pages. A record's magic is programmed last,
+ *	    so one cut short by a reset is skipped. When a page fills,
+ *	    the state is written to the other page with a newer
+ *	    generation, and its header last.
+ *	(4) Images are checked with the CRC unit (CRC-32, poly
+ *	    0x04C11DB7, over words), when written and at every boot.
+ *	(5) An uploaded image boots on trial (BOOT_TRIAL) once. It
+ *	    must call boot_confirm() when it is happy: if it was reset
+ *	    first (crash, watchdog or power), the bootloader rolls
+ *	    back to the other slot.
+ *	(6) boot_write() erases each page as the image reaches it, and
+ *	    programs half-words, so the bootloader can go on receiving
+ *	    the next page into RAM meanwhile.
+ *
+ * EXAMPLE (application):
+ *	boot_confirm();			// Started OK: keep this image
+ *	...
+ *	boot_update();			// Reset into the bootloader
+ */
+#ifndef BOOTCTL_H
+#define BOOTCTL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_PAGE		1024u		// Flash page (medium density)
+#ifndef BOOT_SLOT_A
+#define BOOT_SLOT_A		0x08002000u
+#endif
+#ifndef BOOT_SLOT_B
+#define BOOT_SLOT_B		0x08010000u
+#endif
+#ifndef BOOT_SLOT_SIZE
+#define BOOT_SLOT_SIZE		(56u*1024u)
+#endif
+#ifndef BOOT_LOG
+#define BOOT_LOG		0x0801F800u	// Two pages
+#endif
+#define BOOT_LOG_RECS		(BOOT_PAGE / sizeof(struct s_bootrec))
+
+#define BOOT_RAM		0x20000000u
+#define BOOT_RAM_SIZE		(20u*1024u)
+
+#define BOOT_DR_UPDATE		0xB00Bu		// BKP_DR1: stay in bootldr
+
+#define BOOT_NONE		0xFF		// No state recorded
+#define BOOT_TRIAL		1		// Uploaded: boot once on trial
+#define BOOT_TRYING		2		// On trial, not confirmed yet
+#define BOOT_GOOD		3		// Confirmed (or rolled back to)
+
+#define BOOT_EINVAL		(-2)		// Bad slot, length or command
+#define BOOT_EIO		(-5)		// Flash erase/program failed
+#define BOOT_ECRC		(-6)		// Image CRC mismatch
+#define BOOT_EADDR		(-7)		// Image not linked for the slot
+
+/*********************************************************************
+ * Boot log:
+ *********************************************************************/
+
+#define BOOTREC_MAGIC		0xB007
+#define BOOTREC_PAGE		1		// Page header: length is generation
+#define BOOTREC_IMAGE		2		// Slot image: length, crc (0: none)
+#define BOOTREC_STATE		3		// Slot to boot, and its state
+
+struct s_bootrec {
+	uint16_t	magic;		// BOOTREC_MAGIC (programmed last)
+	uint8_t		kind;		// BOOTREC_*
+	uint8_t		slot;		// 0 (A) or 1 (B)
+	uint8_t		state;		// BOOT_TRIAL etc. (BOOTREC_STATE)
+	uint8_t		check;		// ~sum of the other bytes
+	uint16_t	spare;
+	uint32_t	length;		// Image bytes
+	uint32_t	crc;		// Image CRC
+};
+
+struct s_bootstate {
+	uint32_t	length[2];	// Image bytes [slot], 0 if none
+	uint32_t	crc[2];		// Image CRC [slot]
+	uint8_t		slot;		// Slot to boot
+	uint8_t		state;		// BOOT_NONE, BOOT_TRIAL..
+	int8_t		page;		// Current log page, else -1
+	uint16_t	next;		// Next free record in the page
+	uint32_t	gen;		// Page generation
+};
+
+uint32_t boot_slot_addr(unsigned slot);
+uint32_t boot_crc(uint32_t addr,uint32_t bytes);
+void boot_state(struct s_bootstate *st);
+bool boot_valid(unsigned slot);
+int boot_select(void);
+int boot_trial(unsigned slot);
+int boot_confirm(void);
+void boot_update(void);
+
+/*********************************************************************
+ * Writing an image into a slot:
+ *********************************************************************/
+
+struct s_bootwr {
+	uint8_t		slot;		// Slot being written
+	uint32_t	base;		// Its address
+	uint32_t	length;		// Image bytes expected
+	uint32_t	crc;		// Image CRC expected
+	uint32_t	done;		// Bytes programmed
+	uint32_t	erased;		// Erased up to here
+};
+
+int boot_write_begin(struct s_bootwr *wr,unsigned slot,uint32_t length,uint32_t crc);
+int boot_write(struct s_bootwr *wr,const void *data,unsigned bytes);
+int boot_write_end(struct s_bootwr *wr);
+
+/*********************************************************************
+ * USB protocol (vendor class, bulk EP 0x01 out, 0x82 in):
+ *
+ *	BOOT_CMD_INFO	-> struct s_bootinfo
+ *	BOOT_CMD_WRITE	-> struct s_bootreply (ready), then the image
+ *			   is sent as one bulk transfer of length bytes,
+ *			   -> struct s_bootreply (programmed, verified)
+ *	BOOT_CMD_BOOT	-> struct s_bootreply, then boots slot on trial
+ *	BOOT_CMD_RESET	-> struct s_bootreply, then resets
+ *********************************************************************/
+
+#define BOOT_USB_VID		0x16C0
+#define BOOT_USB_PID		0x05DF
+#define BOOT_CMD_MAGIC		0x42475757	// "WWGB"
+
+#define BOOT_CMD_INFO		1
+#define BOOT_CMD_WRITE		2
+#define BOOT_CMD_BOOT		3
+#define BOOT_CMD_RESET		4
+
+struct s_bootcmd {
+	uint32_t	magic;		// BOOT_CMD_MAGIC
+	uint8_t		cmd;		// BOOT_CMD_*
+	uint8_t		slot;		// 0 (A) or 1 (B)
+	uint16_t	spare;
+	uint32_t	length;		// Image bytes (multiple of 4)
+	uint32_t	crc;		// Image CRC
+};
+
+struct s_bootreply {
+	uint32_t	magic;		// BOOT_CMD_MAGIC
+	int32_t		status;		// 0, else BOOT_E*
+	uint32_t	bytes;		// Image bytes programmed
+	uint32_t	crc;		// Image CRC read back
+};
+
+struct s_bootinfo {
+	uint32_t	magic;		// BOOT_CMD_MAGIC
+	uint32_t	addr[2];	// Slot addresses
+	uint32_t	size;		// Slot size
+	uint32_t	length[2];	// Image bytes [slot], 0 if none
+	uint32_t	crc[2];		// Image CRC [slot]
+	uint8_t		slot;		// Slot booted
+	uint8_t		state;		// Its BOOT_* state
+	uint8_t		valid;		// Bit per slot: image CRC good
+	uint8_t		spare;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOTCTL_H
+
+// End bootctl.h
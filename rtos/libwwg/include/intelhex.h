@@ -1,6 +1,22 @@
 /* Intel Hex Support
  * Warren W. Gay VE3WWG
  * Sat Oct 28 14:26:51 2017
+ *
+ * NOTES:
+ *	(1) ihex_parse() decodes one whole line of text.
+ *	(2) struct s_ihexdec decodes a stream, a character at a time
+ *	    (ihex_dec_putc()), so text need not be gathered into
+ *	    lines. Data from good records is gathered into runs that
+ *	    stop at 256 byte page boundaries, and handed to the write
+ *	    callback a run at a time (one page program each), rather
+ *	    than a record (usually 16 bytes) at a time.
+ *	(3) A record is only used once its checksum is good: a bad
+ *	    record is dropped and counted in errors.
+ *	(4) The write callback returns false if the write failed. The
+ *	    record it was flushed for has IHEX_EWRITE or'd into its
+ *	    type, and write() is not called again: later data is
+ *	    dropped, but records are still decoded, so the EOF record
+ *	    still ends the upload.
  */
 
 #ifndef INTELHEX_H
@@ -31,16 +47,50 @@ struct s_ihex {
 #define IHEX_RT_DATA	0x00	// data record
 #define IHEX_RT_EOF	0x01	// end-of-file record
 #define IHEX_RT_XSEG	0x02	// extended segment address record
+#define IHEX_RT_SSADDR	0x03	// start segment address record
 #define IHEX_RT_XLADDR	0x04	// extended linear address record
 #define IHEX_RT_SLADDR	0x05	// start linear address record (MDK-ARM only)
 
 #define IHEX_FAIL	0x0100	// Parse failed
+#define IHEX_MORE	0x0200	// No record completed yet (ihex_dec_putc())
+#define IHEX_EWRITE	0x0400	// Or'd in: write callback failed (ihex_dec_putc())
 
 typedef struct s_ihex s_ihex;
 
 void ihex_init(s_ihex *ihex);
 unsigned ihex_parse(struct s_ihex *ihex,const char *text);
 
+/*********************************************************************
+ * Streaming decoder:
+ *********************************************************************/
+
+typedef bool (*ihex_write_t)(void *arg,uint32_t addr,const uint8_t *data,unsigned bytes);
+
+struct s_ihexdec {
+	bool		inrec;		// Between ':' and the checksum
+	uint8_t		nibble;		// High nibble, else 0xFF
+	uint8_t		csum;		// Sum of the record's bytes
+	uint16_t	nbytes;		// Bytes in rec[]
+	uint8_t		rec[4+255+1];	// Length, address, type, data, checksum
+	uint32_t	baseaddr;	// From record type 2 or 4
+	uint32_t	startaddr;	// From record type 3 or 5
+	uint32_t	runaddr;	// Address of run[]
+	uint16_t	runlen;		// Bytes in run[]
+	uint8_t		run[256];	// Data for one page program
+	ihex_write_t	write;		// Called for each run
+	void		*arg;		// Passed to write()
+	uint32_t	records;	// Good records
+	uint32_t	errors;		// Bad records dropped
+	uint32_t	writes;		// Calls to write() that succeeded
+	uint32_t	failaddr;	// Address of the run write() failed
+	bool		failed;		// write() failed: no more writes
+};
+
+void ihex_dec_init(struct s_ihexdec *dec,ihex_write_t write,void *arg);
+unsigned ihex_dec_putc(struct s_ihexdec *dec,char ch);
+bool ihex_dec_flush(struct s_ihexdec *dec);
+uint32_t ihex_dec_addr(struct s_ihexdec *dec);
+
 #ifdef __cplusplus
 }
 #endif
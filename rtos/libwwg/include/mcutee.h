@@ -0,0 +1,53 @@
+/* MCU I/O Tee: Fan out std output to several devices
+ * Warren W. Gay VE3WWG
+ *
+ * NOTES:
+ *	(1) Each sink has its own FreeRTOS queue (async buffer) and a
+ *	    drain task, which writes to the real device. A slow 9600
+ *	    baud UART, or a disconnected USB host, only ever stalls its
+ *	    own drain task.
+ *	(2) An output call (putc, puts, printf, write) waits at most
+ *	    the largest sink block ticks, in all: 0 drops output
+ *	    when that sink's buffer is full, else waits up to block
+ *	    ticks for room (backpressure). A sink that times out drops
+ *	    the rest of the call. Each chunk is offered to every sink
+ *	    without waiting first, so a full sink holds up no other.
+ *	(3) Input (getc, peek, gets, getline) comes from the one device
+ *	    chosen with mcu_tee_input().
+ *	(4) Buffers hold chunks of up to 31 bytes, one queue operation
+ *	    each. Every output call takes at least one chunk, so
+ *	    putc() a byte at a time fills a buffer 31 times sooner.
+ *
+ * EXAMPLE:
+ *	mcu_tee_add(mcu_usb,256,0,1);		// USB: drop when full
+ *	mcu_tee_add(mcu_uart1,128,10,1);	// UART1: wait <= 10 ticks
+ *	mcu_tee_input(mcu_usb);
+ *	std_set_device(mcu_tee);
+ */
+#ifndef MCUTEE_H
+#define MCUTEE_H
+
+#include <stdint.h>
+
+#include <mcuio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCU_TEE_MAX_SINKS	3
+
+extern const struct s_mcuio
+	*mcu_tee;		// Tee device for std_set_device()
+
+int mcu_tee_add(const struct s_mcuio *dev,unsigned depth,uint32_t block_ticks,unsigned priority);
+void mcu_tee_input(const struct s_mcuio *dev);
+uint32_t mcu_tee_dropped(int sinkx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCUTEE_H
+
+// End mcutee.h
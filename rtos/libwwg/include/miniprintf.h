@@ -16,6 +16,7 @@ extern "C" {
 
 int mini_vprintf_cooked(void (*putc)(char),const char *format,va_list args);
 int mini_vprintf_uncooked(void (*putc)(char),const char *format,va_list args);
+void mini_vprintf_arg(void (*putc)(char,void *),void *argp,const char *format,va_list args);
 
 int mini_snprintf(char *buf,unsigned maxbuf,const char *format,...)
 	__attribute((format(printf,3,4)));
@@ -73,6 +74,7 @@ DEVICE FORMATTING HOWTO:
 
     int mini_vprintf_cooked(void (*putc)(char),const char *format,va_list args);
     int mini_vprintf_uncooked(void (*putc)(char),const char *format,va_list args);
+    void mini_vprintf_arg(void (*putc)(char,void *),void *argp,const char *format,va_list args);
 
     (0) Decide: cooked or uncooked output?
 
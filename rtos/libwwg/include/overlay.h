@@ -0,0 +1,150 @@
+/* overlay.h : Overlay runtime: RAM regions, LRU, prefetch by DMA
+ * Warren W. Gay VE3WWG
+ *
+ * NOTES:
+ *	(1) Overlay code lives in SPI flash (linked AT >xflash), and is
+ *	    copied into one of several equal RAM regions to be run.
+ *	    When all regions are in use, the least recently used one
+ *	    is replaced.
+ *	(2) Any module may run in any region, so overlay code must not
+ *	    depend on where it runs:
+ *	      - compile with -mlong-calls, so calls out of the module
+ *	        are to absolute addresses (calls within its own section
+ *	        stay PC relative),
+ *	      - keep its data out of the overlay section (.rodata,
+ *	        .data and .bss are fine), and
+ *	      - don't take the address of a function in the module.
+ *	    The modules are linked to run at the first region (linked),
+ *	    the regions follow it, and entry points are moved by the
+ *	    region's offset.
+ *	(3) ovl_lookup() finds a module by its load address in a hash
+ *	    table (O(1)), and pins it until ovl_done(), so a module
+ *	    that calls another is never replaced under itself.
+ *	(4) Each module may list the modules it usually calls next
+ *	    (hints[], from the call graph). After a lookup, the first
+ *	    hint that is not resident is read into a free (else LRU)
+ *	    region by DMA, while the caller runs. One prefetch runs at
+ *	    a time. Call ovl_sync() before using the SPI otherwise.
+ *	(5) Per module statistics (struct s_ovl_stats): hits, demand
+ *	    loads, prefetches used or wasted, and the CPU cycles
+ *	    callers waited for loads (DWT cycle counter).
+ *	(6) One task only: lookups are not locked.
+ *	(7) tools/ovlgen.py generates the module table, call thunks
+ *	    and linker OVERLAY from a list of functions, and chooses
+ *	    which stay resident from saved statistics.
+ *	(8) A module marked packed is stored by tools/ovlpack.py as an
+ *	    OVL_LZ_HDR byte header, then LZ sequences in chunks of
+ *	    OVL_LZ_CHUNK bytes that no sequence crosses. A load reads
+ *	    the chunks by DMA into lzbuf (two chunks), decoding each
+ *	    into the region while the next one is read. A prefetch
+ *	    reads the packed module into the end of its region, and
+ *	    it is decoded in place when waited for (no prefetch if the
+ *	    region is too small for that: see zgap).
+ *
+ * EXAMPLE:
+ *	extern char __load_start_fee, __load_stop_fee, overlay1;
+ *	static struct s_ovl_module mods[] = {
+ *		OVL_MODULE("fee",fee,2),	// Hint: mods[1] (fie) is next
+ *		OVL_MODULE("fie",fie,0),
+ *	};
+ *	static struct s_ovl ovl;
+ *
+ *	ovl_init(&ovl,SPI1,&overlay1,4,512,mods,2);
+ *	...
+ *	int (*f)(int) = ovl_lookup(&ovl,&__load_start_fee);
+ *	r = f(arg);
+ *	ovl_done(&ovl,&__load_start_fee);
+ */
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef OVL_MAX_REGIONS
+#define OVL_MAX_REGIONS		8
+#endif
+#ifndef OVL_MAX_MODULES
+#define OVL_MAX_MODULES		32
+#endif
+#define OVL_HINTS		2		// Call graph hints per module
+#define OVL_HASH		(OVL_MAX_MODULES * 2)	// Power of 2
+#define OVL_LZ_CHUNK		128		// Packed chunk (ovlpack.py -k)
+#define OVL_LZ_HDR		6		// Packed header bytes
+
+// Module table entry: name, symbol, then up to OVL_HINTS hints
+// (index + 1 of a module usually called next, 0 for none)
+#define OVL_MODULE(str,sym,...) \
+	{ .name = str, .start = &__load_start_ ## sym, .stop = &__load_stop_ ## sym, \
+	  .func = (const void *)sym, .hints = { __VA_ARGS__ } }
+
+struct s_ovl_stats {
+	uint32_t	calls;		// Lookups
+	uint32_t	hits;		// Found resident (or prefetched)
+	uint32_t	loads;		// Read on demand: the caller waited
+	uint32_t	prefetches;	// Read ahead by DMA, from hints
+	uint32_t	prefetch_hits;	// ..and called before being replaced
+	uint32_t	waits;		// Called while its prefetch still ran
+	uint32_t	evictions;	// Replaced in its region
+	uint32_t	spi_bytes;	// Read from SPI flash
+	uint32_t	wait_cycles;	// CPU cycles callers waited in all
+	uint32_t	max_cycles;	// Longest wait
+};
+
+struct s_ovl_module {
+	const char	*name;		// For statistics
+	const char	*start;		// Load address (SPI flash)
+	const char	*stop;		// Load end address
+	const void	*func;		// Entry point, as linked
+	uint8_t		hints[OVL_HINTS]; // Module index + 1, else 0
+	bool		packed;		// Stored by ovlpack.py
+	// Set by ovl_init():
+	uint16_t	size;		// Bytes (packed: with header)
+	uint16_t	raw;		// Packed: unpacked bytes (0 until read)
+	uint16_t	zsize;		// ..packed bytes, 0 if stored as is
+	uint16_t	zgap;		// ..least offset to unpack in place
+	uint16_t	entry;		// Offset of func in the module
+	int8_t		region;		// Region loaded into, else -1
+	uint8_t		busy;		// Lookups not yet done
+	bool		prefetched;	// Read ahead, not called since
+	struct s_ovl_stats stats;
+};
+
+struct s_ovl_region {
+	uint8_t		*mem;		// Region base
+	int8_t		module;		// Module in it, else -1
+	uint32_t	stamp;		// Last used (LRU)
+};
+
+struct s_ovl {
+	uint32_t	spi;		// SPI1 or SPI2
+	uint8_t		*linked;	// Region the modules were linked for
+	unsigned	region_size;	// Bytes per region
+	unsigned	nregions;
+	struct s_ovl_region region[OVL_MAX_REGIONS];
+	struct s_ovl_module *mods;
+	unsigned	nmods;
+	uint8_t		hash[OVL_HASH];	// Module index + 1 by load address
+	uint32_t	clock;		// LRU clock
+	int8_t		pending;	// Module being prefetched, else -1
+	bool		noprefetch;	// Don't use hints (to compare)
+	uint8_t		*lzbuf;		// 2 x OVL_LZ_CHUNK, for packed modules
+};
+
+bool ovl_init(struct s_ovl *ov,uint32_t spi,void *linked,unsigned nregions,unsigned region_size,struct s_ovl_module *mods,unsigned nmods);
+void *ovl_lookup(struct s_ovl *ov,const void *start);
+void ovl_done(struct s_ovl *ov,const void *start);
+void ovl_sync(struct s_ovl *ov);
+void ovl_stats_reset(struct s_ovl *ov);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OVERLAY_H
+
+// End overlay.h
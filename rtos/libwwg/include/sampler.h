@@ -0,0 +1,52 @@
+/* sampler.h : Periodic register/memory sampler (TIM3 driven)
+ * Warren W. Gay VE3WWG
+ *
+ * NOTES:
+ *	(1) TIM3 and tim3_isr() are claimed by this module. The ISR runs
+ *	    above configMAX_SYSCALL_INTERRUPT_PRIORITY, so FreeRTOS
+ *	    critical sections do not delay the samples (and the ISR makes
+ *	    no FreeRTOS calls).
+ *	(2) Samples go into two halves of one RAM buffer. When a half
+ *	    fills, the ISR moves on to the other half, and the reader
+ *	    task collects the full one with sampler_get(). If the reader
+ *	    falls behind, samples are dropped and counted as overruns.
+ *	(3) Each channel is read as 1, 2 or 4 bytes, and stored little
+ *	    endian in the frame, in channel order.
+ */
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMP_MAX_CHANS	8		// Max channels per frame
+
+#ifndef SAMP_BUFSIZ
+#define SAMP_BUFSIZ	512		// Bytes per buffer half
+#endif
+
+struct s_samp_chan {
+	uint32_t	addr;		// Address to sample
+	uint8_t		width;		// 1, 2 or 4 bytes
+};
+
+int sampler_start(const struct s_samp_chan *chans,unsigned nchans,uint32_t rate_hz);
+void sampler_stop(void);
+
+int sampler_get(const uint8_t **data,unsigned *nframes,uint32_t *seq);
+void sampler_release(int half);
+
+uint32_t sampler_overruns(void);
+unsigned sampler_framesize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLER_H
+
+// End sampler.h
@@ -0,0 +1,101 @@
+/* w25kv.h : Log structured key/value store on W25Qxx flash
+ * Warren W. Gay VE3WWG
+ *
+ * NOTES:
+ *	(1) The store uses a region of whole 4K sectors, as a ring.
+ *	    Records are only ever appended to the newest (head) sector.
+ *	    The oldest sector is compacted (live records copied to the
+ *	    head) and then erased, so every sector is erased in turn.
+ *	(2) A record is programmed with its commit byte left erased,
+ *	    and the commit byte is programmed last. After a power
+ *	    loss, an uncommitted record is ignored, so a key has
+ *	    either its old value or its new one.
+ *	(3) w25kv_put() never erases. Compaction and erasing are done
+ *	    by w25kv_service(), normally from w25kv_task() at low
+ *	    priority. If no erased sector is ready, the put returns
+ *	    W25KV_EAGAIN. An erase is started and left running without
+ *	    the mutex held; a get, put or delete meanwhile suspends it
+ *	    (or, with nosuspend set after mounting, waits it out).
+ *	(4) RAM index: a hash of key -> record address, W25KV_HASH
+ *	    slots of 8 bytes, holding up to 3/4 of that many keys.
+ *	(5) The SPI must only be used through this module (or under
+ *	    its mutex) while the store is mounted.
+ *
+ * EXAMPLE:
+ *	static struct s_w25kv kv;
+ *
+ *	w25kv_mount(&kv,SPI1,0x100000,16);	// 64K at 1M
+ *	xTaskCreate(w25kv_task,"kv",100,&kv,1,NULL);
+ *	...
+ *	w25kv_put(&kv,KEY_BOOTS,&boots,sizeof boots);
+ */
+#ifndef W25KV_H
+#define W25KV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef W25KV_HASH
+#define W25KV_HASH		64	// Index slots (power of 2)
+#endif
+#ifndef W25KV_MAX_SECTORS
+#define W25KV_MAX_SECTORS	32	// Max sectors in a region
+#endif
+#define W25KV_MAX_KEYS		(W25KV_HASH * 3 / 4)
+#define W25KV_MAX_LEN		256	// Max value length
+#define W25KV_SPARE		2	// Erased sectors kept ahead
+
+#define W25KV_ENOENT		(-1)	// No such key
+#define W25KV_EINVAL		(-2)	// Bad key, length or region
+#define W25KV_EFULL		(-3)	// No room for key or data
+#define W25KV_EAGAIN		(-4)	// Wait for w25kv_service()
+#define W25KV_EIO		(-5)	// Flash write failed
+
+struct s_w25kv_slot {
+	uint16_t	key;		// 0xFFFF if slot free
+	uint16_t	len;		// Value length
+	uint32_t	addr;		// Record address in flash
+};
+
+struct s_w25kv {
+	uint32_t	spi;		// SPI1 or SPI2
+	uint32_t	base;		// Region address (4K aligned)
+	uint16_t	nsectors;	// Sectors in region
+	uint16_t	head;		// Sector appended to, else 0xFFFF
+	uint16_t	wroff;		// Append offset within head
+	uint16_t	ctail;		// Sector being compacted, else 0xFFFF
+	uint16_t	coff;		// Compaction offset within ctail
+	uint16_t	nkeys;		// Keys in index
+	uint32_t	live;		// Flash bytes of live records
+	uint32_t	seq;		// Newest sector sequence no.
+	uint32_t	erases;		// Sectors erased since mount
+	uint32_t	suspends;	// Erases suspended since mount
+	uint16_t	erasing;	// Sector being erased, else 0xFFFF
+	bool		suspended;	// Erase is suspended
+	bool		nosuspend;	// Wait out erases instead
+	uint32_t	sseq[W25KV_MAX_SECTORS];// Sector seq. no., or free/dirty
+	struct s_w25kv_slot index[W25KV_HASH];
+	SemaphoreHandle_t mutex;
+};
+
+int w25kv_mount(struct s_w25kv *kv,uint32_t spi,uint32_t base,unsigned nsectors);
+int w25kv_get(struct s_w25kv *kv,uint16_t key,void *buf,unsigned bufsiz);
+int w25kv_put(struct s_w25kv *kv,uint16_t key,const void *data,unsigned len);
+int w25kv_delete(struct s_w25kv *kv,uint16_t key);
+bool w25kv_service(struct s_w25kv *kv);
+void w25kv_task(void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // W25KV_H
+
+// End w25kv.h
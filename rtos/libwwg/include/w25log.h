@@ -0,0 +1,115 @@
+/* w25log.h : Append-only data log on W25Qxx flash, erased ahead
+ * Warren W. Gay VE3WWG
+ *
+ * NOTES:
+ *	(1) The log uses a region of whole 4K sectors as a ring. When
+ *	    the ring is full, the oldest sector is dropped.
+ *	(2) w25log_service() (normally run by w25log_task() at low
+ *	    priority) keeps W25LOG_AHEAD sectors erased ahead of the
+ *	    one being appended to. w25log_append() never erases.
+ *	(3) Appends are gathered in RAM, and programmed a page (256
+ *	    bytes) at a time. Records are readable, and safe from
+ *	    power loss, once their page is programmed: w25log_flush()
+ *	    programs a part page.
+ *	(4) An erase takes 45 to 400 ms. While one runs, a page program
+ *	    or read suspends it (0x75), does its work and resumes it
+ *	    (0x7A), so an append's latency is at most the suspend time
+ *	    (20us) and a page program per page filled, not the erase
+ *	    time. Set nosuspend after mounting for chips without
+ *	    suspend. Latency is kept in stats, in ticks.
+ *	(5) If the appends outrun the erases and no erased sector is
+ *	    ready, w25log_append() returns W25LOG_EAGAIN (counted in
+ *	    stats.eagain). Sustained logging must stay below the erase
+ *	    rate (about 90K/s typical, 10K/s worst case).
+ *	(6) A record is a 16-bit length and its data, within a sector.
+ *	(7) The SPI must only be used through this module (or under
+ *	    its mutex) while the log is mounted.
+ *
+ * EXAMPLE:
+ *	static struct s_w25log adclog;
+ *
+ *	w25log_mount(&adclog,SPI1,0x200000,64);	// 256K at 2M
+ *	xTaskCreate(w25log_task,"log",100,&adclog,1,NULL);
+ *	...
+ *	w25log_append(&adclog,samples,sizeof samples);
+ */
+#ifndef W25LOG_H
+#define W25LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef W25LOG_MAX_SECTORS
+#define W25LOG_MAX_SECTORS	128	// Max sectors in a region
+#endif
+#ifndef W25LOG_AHEAD
+#define W25LOG_AHEAD		4	// Sectors kept erased ahead
+#endif
+#define W25LOG_MAX_LEN		1024	// Max record length
+#define W25LOG_NBUCKETS		8	// Latency histogram buckets
+
+#define W25LOG_ENOENT		(-1)	// No more records
+#define W25LOG_EINVAL		(-2)	// Bad length or region
+#define W25LOG_EAGAIN		(-4)	// No erased sector ready
+#define W25LOG_EIO		(-5)	// Flash write failed
+#define W25LOG_ELOST		(-6)	// Reader fell behind: records dropped
+
+struct s_w25log_stats {
+	uint32_t	appends;	// Records appended
+	uint32_t	bytes;		// Data bytes appended
+	uint32_t	eagain;		// Appends refused (no erased sector)
+	uint32_t	erases;		// Sectors erased
+	uint32_t	erase_fails;	// Erases that would not start
+	uint32_t	dropped;	// Sectors of data dropped for space
+	uint32_t	suspends;	// Erases suspended
+	uint32_t	max_ticks;	// Worst append latency
+	uint32_t	hist[W25LOG_NBUCKETS];	// Appends taking < 1, 2, 4 .. ticks
+};
+
+struct s_w25log_cursor {
+	uint32_t	seq;		// Sector sequence no.
+	uint16_t	off;		// Next record offset
+};
+
+struct s_w25log {
+	uint32_t	spi;		// SPI1 or SPI2
+	uint32_t	base;		// Region address (4K aligned)
+	uint16_t	nsectors;	// Sectors in region
+	uint16_t	head;		// Sector appended to, else 0xFFFF
+	uint16_t	wroff;		// Append offset within head
+	uint16_t	erasing;	// Sector being erased, else 0xFFFF
+	bool		suspended;	// Erase is suspended
+	bool		nosuspend;	// Wait out erases instead
+	uint16_t	pgbase;		// Offset of page[] within head
+	uint16_t	pgoff;		// Bytes of page[] programmed
+	uint16_t	flushed;	// Head programmed up to here
+	uint32_t	seq;		// Newest sector sequence no.
+	uint32_t	sseq[W25LOG_MAX_SECTORS];// Sector seq. no., or free/dirty
+	struct s_w25log_stats stats;
+	SemaphoreHandle_t mutex;
+	uint8_t		page[256];	// Head page being filled
+};
+
+int w25log_mount(struct s_w25log *log,uint32_t spi,uint32_t base,unsigned nsectors);
+int w25log_append(struct s_w25log *log,const void *data,unsigned len);
+int w25log_flush(struct s_w25log *log);
+void w25log_rewind(struct s_w25log *log,struct s_w25log_cursor *cur);
+int w25log_read(struct s_w25log *log,struct s_w25log_cursor *cur,void *buf,unsigned bufsiz);
+bool w25log_service(struct s_w25log *log);
+void w25log_task(void *arg);
+void w25log_stats(struct s_w25log *log,struct s_w25log_stats *stats,bool reset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // W25LOG_H
+
+// End w25log.h
@@ -0,0 +1,126 @@
+/* w25srv.h : W25Qxx flash server task, with a request queue
+ * Warren W. Gay VE3WWG
+ *
+ * NOTES:
+ *	(1) Clients hand requests to one server task, instead of
+ *	    calling w25_*() and queuing on a mutex themselves. The
+ *	    server only orders what is submitted to it: w25kv, w25log
+ *	    and the overlay loader still call w25_*() directly, so do
+ *	    not run them on the same SPI as a server.
+ *	(2) A request is caller owned, and must stay put until done.
+ *	    Its status is W25SRV_QUEUED until then, and 0 or
+ *	    W25SRV_EIO after. At completion the server calls done()
+ *	    (from the server task, so keep it short), else notifies
+ *	    the task that submitted it (xTaskNotifyGive()).
+ *	(3) Interactive requests are served before bulk ones, but after
+ *	    W25SRV_BULK_EVERY interactive requests a waiting bulk one is
+ *	    served, so bulk work is never starved.
+ *	(4) Within each class, requests are served in address order,
+ *	    sweeping upwards and wrapping (C-SCAN), rather than in
+ *	    arrival order. A request never passes an earlier one that
+ *	    it overlaps, if either writes or erases.
+ *	(5) Queued reads that follow on from each other in flash are
+ *	    merged, up to W25SRV_MAX_MERGE of them, into one read
+ *	    command (w25_readv_start()), each into its own buffer.
+ *	(6) A sector erase (45 to 400 ms) is started as soon as it
+ *	    may be, and the server polls for its end. Reads and
+ *	    programs outside the sector arriving meanwhile suspend
+ *	    the erase (0x75), are served, and then resume it (0x7A).
+ *	    One erase runs at a time. Set nosuspend for chips without
+ *	    suspend (erases are then waited out, in queue order).
+ *	(7) w25srv_read(), w25srv_write() and w25srv_erase() submit a
+ *	    request and block the caller until it is done.
+ *
+ * EXAMPLE:
+ *	static struct s_w25srv flash;
+ *
+ *	w25srv_init(&flash,SPI1);
+ *	xTaskCreate(w25srv_task,"flash",100,&flash,3,NULL);
+ *	...
+ *	rc = w25srv_read(&flash,addr,buf,bytes,false);	// Interactive
+ */
+#ifndef W25SRV_H
+#define W25SRV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef W25SRV_BULK_EVERY
+#define W25SRV_BULK_EVERY	4	// Interactive requests per bulk one
+#endif
+#ifndef W25SRV_MAX_MERGE
+#define W25SRV_MAX_MERGE	8	// Max reads merged into one
+#endif
+
+#define W25SRV_READ		0	// Read bytes into buf
+#define W25SRV_WRITE		1	// Program bytes from buf (erased flash)
+#define W25SRV_ERASE		2	// Erase the 4K sector holding addr
+
+#define W25SRV_QUEUED		1	// Request not done yet
+#define W25SRV_EINVAL		(-2)	// Bad op or length
+#define W25SRV_EIO		(-5)	// Flash failed
+
+struct s_w25req {
+	struct s_w25req	*next;		// Queue link (server's)
+	uint8_t		op;		// W25SRV_READ etc.
+	bool		bulk;		// Bulk, else interactive
+	uint32_t	addr;		// Flash address
+	void		*buf;		// Data (not for W25SRV_ERASE)
+	uint32_t	bytes;		// Length of data
+	void		(*done)(struct s_w25req *req);	// Else notify task
+	void		*arg;		// For done()
+	volatile int	status;		// W25SRV_QUEUED, then 0 or error
+	TaskHandle_t	task;		// Submitter (set by w25srv_submit())
+	uint32_t	seq;		// Arrival order (set by w25srv_submit())
+	TickType_t	ticks;		// Submit time (set by w25srv_submit())
+};
+
+struct s_w25srv_stats {
+	uint32_t	requests;	// Requests done
+	uint32_t	reads;		// Read commands sent (after merging)
+	uint32_t	merged;		// Reads merged into another's command
+	uint32_t	sweeps;		// C-SCAN wraps to the lowest address
+	uint32_t	suspends;	// Erases suspended for other work
+	uint32_t	max_ticks[2];	// Worst queue+service time [bulk]
+};
+
+struct s_w25srv {
+	uint32_t	spi;		// SPI1 or SPI2
+	struct s_w25req	*queue[2];	// [bulk], in address order
+	uint32_t	pos;		// Address after the last request
+	uint32_t	seq;		// Next arrival no.
+	unsigned	burst;		// Interactive served since a bulk one
+	struct s_w25req	*erasing;	// Erase in progress, else 0
+	bool		suspended;	// Erase is suspended
+	bool		nosuspend;	// Wait out erases instead
+	bool		fifo;		// Arrival order, no merging (to compare)
+	TaskHandle_t	task;		// Server task, once running
+	SemaphoreHandle_t mutex;	// Guards the queues
+	struct s_w25srv_stats stats;
+};
+
+void w25srv_init(struct s_w25srv *srv,uint32_t spi);
+void w25srv_submit(struct s_w25srv *srv,struct s_w25req *req);
+bool w25srv_service(struct s_w25srv *srv);
+void w25srv_task(void *arg);
+void w25srv_stats(struct s_w25srv *srv,struct s_w25srv_stats *stats,bool reset);
+
+int w25srv_read(struct s_w25srv *srv,uint32_t addr,void *buf,uint32_t bytes,bool bulk);
+int w25srv_write(struct s_w25srv *srv,uint32_t addr,const void *buf,uint32_t bytes);
+int w25srv_erase(struct s_w25srv *srv,uint32_t addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // W25SRV_H
+
+// End w25srv.h
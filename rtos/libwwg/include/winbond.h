@@ -1,5 +1,24 @@
 /* winbond.hpp -- Winbond Flash Devices w25qxx
  * Warren Gay  Sat Oct 28 19:23:36 2017   (C) datablocks.net
+ *
+ * NOTES:
+ *	(1) w25_dma_init() makes reads and page programs of W25_DMA_MIN
+ *	    bytes or more use DMA (SPI1: DMA1 channels 2 and 3, SPI2:
+ *	    channels 4 and 5), and claims dma1_channel2_isr() or
+ *	    dma1_channel4_isr(). The calling task blocks on a task
+ *	    notification until the transfer is done, so DMA transfers
+ *	    must be made from a task.
+ *	(2) w25_wait() polls BUSY without sleeping for W25_SPIN_US
+ *	    (default 1000, about one page program), then sleeps
+ *	    W25_POLL_TICKS between polls. w25_spi_setup() enables the
+ *	    DWT cycle counter it times this with.
+ *	(3) w25_cache_init() gives w25_read_data() an LRU cache of
+ *	    256 byte pages, in memory supplied by the app. A miss reads
+ *	    only the bytes the line lacks, not the whole page. Async
+ *	    reads (w25_read_start() etc.) use it only for full hits:
+ *
+ *		static uint32_t cache[W25_CACHE_SIZE(8)/4];	// 2144 bytes
+ *		w25_cache_init(SPI1,cache,sizeof cache);
  */
 #ifndef WINBOND_H
 #define WINBOND_H
@@ -23,11 +42,30 @@
 #define W25_CMD_ERA_SECTOR	0x20
 #define W25_CMD_ERA_32K		0x52
 #define W25_CMD_ERA_64K		0xD8
+#define W25_CMD_WRITE_SR	0x01
+#define W25_CMD_SUSPEND		0x75
+#define W25_CMD_RESUME		0x7A
 
 #define DUMMY			0x00
 
 #define W25_SR1_BUSY		0x01
 #define W25_SR1_WEL		0x02
+#define W25_SR2_SUS		0x80
+
+#define W25_PAGE_SIZE		256
+#define W25_CACHE_SIZE(npages)	((npages) * (W25_PAGE_SIZE + 12))
+
+struct s_w25seg {
+	void		*data;		// Buffer
+	uint32_t	bytes;		// Its length
+};
+
+struct s_w25cache_stats {
+	uint32_t	hits;		// Page reads served from the cache
+	uint32_t	misses;		// Page reads (or parts) read into it
+	uint32_t	bypassed;	// Reads sent to the flash uncached
+	uint32_t	invalidated;	// Pages dropped by write or erase
+};
 
 uint8_t w25_read_sr1(uint32_t spi);
 uint8_t w25_read_sr2(uint32_t spi);
@@ -42,10 +80,22 @@ void w25_read_uid(uint32_t spi,void *buf,uint16_t bytes);
 void w25_power(uint32_t spi,bool on);
 
 uint32_t w25_read_data(uint32_t spi,uint32_t addr,void *data,uint32_t bytes);
+void w25_read_start(uint32_t spi,uint32_t addr,void *data,uint32_t bytes);
+uint32_t w25_read_wait(uint32_t spi);
+void w25_readv_start(uint32_t spi,uint32_t addr,const struct s_w25seg *seg,unsigned nseg);
 unsigned w25_write_data(uint32_t spi,uint32_t addr,void *data,uint32_t bytes);
 
 bool w25_chip_erase(uint32_t spi);
 bool w25_erase_block(uint32_t spi,uint32_t addr,uint8_t cmd);
+bool w25_erase_start(uint32_t spi,uint32_t addr,uint8_t cmd);
+bool w25_suspend(uint32_t spi);
+void w25_resume(uint32_t spi);
+
+void w25_dma_init(uint32_t spi);
+
+void w25_cache_init(uint32_t spi,void *mem,unsigned bytes);
+void w25_cache_inval(uint32_t spi,uint32_t addr,uint32_t bytes);
+void w25_cache_stats(uint32_t spi,struct s_w25cache_stats *stats,bool reset);
 
 void w25_spi_setup(
   uint32_t spi,		// SPI1 or SPI2
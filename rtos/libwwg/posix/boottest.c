@@ -0,0 +1,215 @@
+/* boottest.c : A/B slots, rollback and power cuts on the flash model
+ * Warren W. Gay VE3WWG
+ *
+ * Runs ../src/bootctl.c against the internal flash model:
+ *
+ *  1. Uploads 56K images as bootldr does (a 1K page at a time, as
+ *     they arrive from USB), and reports the time in simulated
+ *     flash time, against the USB time for the same bytes.
+ *  2. Boots each upload on trial: confirmed, it stays; reset
+ *     without confirming, the bootloader rolls back.
+ *  3. Rejects an image linked for the other slot, and one with a
+ *     bad CRC, keeping the running image.
+ *  4. Runs enough updates to wrap the boot log many times.
+ *  5. Cuts the power at points through an update, checking that
+ *     every reset boots a whole image: the old one until the new
+ *     one is recorded, and that the update then completes.
+ *
+ * Exits non-zero on failure, misuse of the flash, or if an update
+ * takes over 5 seconds.
+ *
+ * Usage: boottest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include <libopencm3/stm32/flash.h>
+
+#include "bootctl.h"
+#include "stmflash.h"
+
+#define USB_KBS		800		// Bulk OUT, full speed, KB/s
+#define NCUTS		300
+
+static uint8_t image[2][BOOT_SLOT_SIZE];	// Linked for [slot]
+static uint32_t imgcrc[2];
+static jmp_buf power_cut;
+static unsigned failures = 0;
+
+static void
+check(bool ok,const char *what) {
+
+	if ( !ok ) {
+		printf("FAIL: %s\n",what);
+		++failures;
+	}
+}
+
+static void
+cut(void) {
+	longjmp(power_cut,1);
+}
+
+/*********************************************************************
+ * An image linked for slot: stack top, reset vector, then code
+ *********************************************************************/
+
+static void
+make_image(unsigned slot,unsigned seed) {
+	uint32_t base = boot_slot_addr(slot), *vt = (uint32_t *)image[slot];
+
+	srand(seed);
+	for ( unsigned ux = 0; ux < BOOT_SLOT_SIZE; ++ux )
+		image[slot][ux] = rand();
+	vt[0] = BOOT_RAM + BOOT_RAM_SIZE;
+	vt[1] = (base + 0x150) | 1;		// Thumb
+	imgcrc[slot] = stmf_crc(image[slot],BOOT_SLOT_SIZE / 4);
+}
+
+/*********************************************************************
+ * Upload as bootldr does: begin, a page per boot_write(), end
+ *********************************************************************/
+
+static int
+upload(unsigned slot,const uint8_t *img,uint32_t crc) {
+	struct s_bootwr wr;
+	int rc;
+
+	if ( (rc = boot_write_begin(&wr,slot,BOOT_SLOT_SIZE,crc)) != 0 )
+		return rc;
+	for ( uint32_t off = 0; off < BOOT_SLOT_SIZE; off += BOOT_PAGE )
+		if ( (rc = boot_write(&wr,img + off,BOOT_PAGE)) != 0 )
+			return rc;
+	return boot_write_end(&wr);
+}
+
+static bool
+intact(unsigned slot) {
+	return memcmp((void *)boot_slot_addr(slot),image[slot],BOOT_SLOT_SIZE) == 0;
+}
+
+static unsigned
+state(unsigned *slot) {
+	struct s_bootstate st;
+
+	boot_state(&st);
+	*slot = st.slot;
+	return st.state;
+}
+
+/*********************************************************************
+ * An update to slot B, from A running: upload, trial, reboot, confirm
+ *********************************************************************/
+
+static void
+update_b(void) {
+	int rc;
+
+	check((rc = upload(1,image[1],imgcrc[1])) == 0,"upload B");
+	check(boot_trial(1) == 0,"trial B");
+	check(boot_select() == 1,"boot B on trial");
+	check(boot_confirm() == 0,"confirm B");
+}
+
+int
+main(void) {
+	unsigned slot, ncuts = 0, step;
+	unsigned long total;
+	uint64_t t0, ns, usb_ns;
+	struct s_bootstate st;
+
+	stmf_init();
+	make_image(0,1);
+	make_image(1,2);
+
+	// 1. First image
+	check(boot_select() == -1,"empty flash booted");
+	t0 = stmf_now;
+	check(upload(0,image[0],imgcrc[0]) == 0,"upload A");
+	ns = stmf_now - t0;
+	usb_ns = (uint64_t)BOOT_SLOT_SIZE * 1000000000ull / USB_KBS / 1024;
+	check(intact(0),"slot A data");
+	printf("UPLOAD %uK: %lu page erases, %lu half-word programs\n",
+		BOOT_SLOT_SIZE / 1024,stmf_erases,stmf_programs);
+	printf("  flash  %6.0f ms (tERASE %.0f ms, tPROG %.1f us)\n",
+		ns / 1e6,stmf_timing.terase / 1e6,stmf_timing.tprog / 1e3);
+	printf("  USB    %6.0f ms (%u KB/s), overlapped: %.2f s in all\n",
+		usb_ns / 1e6,USB_KBS,(ns + usb_ns / (BOOT_SLOT_SIZE / BOOT_PAGE)) / 1e9);
+	check(ns < 5000000000ull,"update took over 5 s");
+
+	// 2. Trial, confirm; then trial without confirming
+	check(boot_trial(0) == 0,"trial A");
+	check(boot_select() == 0 && state(&slot) == BOOT_TRYING,"A on trial");
+	check(boot_confirm() == 0 && state(&slot) == BOOT_GOOD,"A confirmed");
+	check(boot_select() == 0,"A boots");
+
+	check(upload(1,image[1],imgcrc[1]) == 0 && intact(1),"upload B");
+	check(boot_trial(1) == 0,"trial B");
+	check(boot_select() == 1,"B on trial");
+	check(boot_select() == 0 && state(&slot) == BOOT_GOOD && slot == 0,"rollback to A");
+	check(boot_select() == 0,"A boots after rollback");
+	puts("ROLLBACK: unconfirmed trial of B fell back to A");
+
+	// 3. Wrong slot and bad CRC
+	check(upload(1,image[0],imgcrc[0]) == BOOT_EADDR,"A image into B not refused");
+	check(upload(1,image[1],imgcrc[1] ^ 1) == BOOT_ECRC,"bad CRC not found");
+	check(!boot_valid(1) && boot_trial(1) == BOOT_EINVAL,"bad B may be tried");
+	check(boot_select() == 0 && intact(0),"A lost");
+
+	// 4. Wrap the log
+	for ( unsigned ux = 0; ux < 60; ++ux ) {
+		check(boot_trial(0) == 0 && boot_select() == 0,"trial A");
+		check(boot_confirm() == 0,"confirm A");
+	}
+	boot_state(&st);
+	printf("LOG: 180 records, page generation %u, %u records in page %d\n",
+		(unsigned)st.gen,(unsigned)st.next,st.page);
+	check(st.gen >= 3 && st.slot == 0 && st.state == BOOT_GOOD,"log wrap");
+
+	// 5. Power cuts through an update of B, with A running
+	t0 = stmf_programs + stmf_erases;
+	update_b();
+	total = stmf_programs + stmf_erases - t0;
+	step = total / NCUTS > 0 ? total / NCUTS : 1;
+
+	for ( unsigned long at = 1; at <= total; at += step ) {
+		int sel;
+
+		stmf_init();
+		check(upload(0,image[0],imgcrc[0]) == 0,"upload A");
+		check(boot_trial(0) == 0 && boot_select() == 0 && boot_confirm() == 0,"A");
+		srand(at);
+
+		if ( setjmp(power_cut) == 0 ) {
+			stmf_powerfail(at,cut);
+			update_b();
+			check(false,"power cut did not happen");
+		}
+		stmf_powerfail(0,0);
+		flash_lock();			// Reset
+
+		sel = boot_select();
+		if ( sel < 0 || !intact(sel) ) {
+			printf("FAIL: boot after a cut at op %lu of %lu: slot %d\n",at,total,sel);
+			++failures;
+			break;
+		}
+		if ( sel == 1 )			// Unconfirmed: roll back
+			check(boot_select() == 0 && intact(0),"rollback after cut");
+		update_b();
+		check(boot_select() == 1 && intact(1),"update after cut");
+		++ncuts;
+	}
+	printf("POWER CUTS: %u, 1 in every %u of %lu flash operations\n",ncuts,step,total);
+
+	check(stmf_errs.locked == 0 && stmf_errs.overwrites == 0 && stmf_errs.bounds == 0,
+		"flash misused");
+	if ( failures )
+		return 1;
+	puts("PASS");
+	return 0;
+}
+
+// End boottest.c
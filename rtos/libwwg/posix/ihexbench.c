@@ -0,0 +1,294 @@
+/* ihexbench.c : Intel Hex decoding and flash loading of a 64K image
+ * Warren W. Gay VE3WWG
+ *
+ * A 64K image is written out as Intel Hex (16 byte records, as
+ * objcopy makes them), then:
+ *
+ *  1. Decoded by the old ihex_parse() (strncpy() and strtoul() per
+ *     field, kept here to compare), by the table driven
+ *     ihex_parse(), and by the streaming decoder, timing each in
+ *     host CPU time (relative speeds matter, not the host's ns).
+ *  2. Loaded into the W25Qxx model, a record per w25_write_data()
+ *     as load_ihex() used to, and then a page run at a time from the
+ *     streaming decoder, in simulated time.
+ *
+ * Each load is checked against the image, a record with a bad
+ * checksum must be dropped, and a failed write must be reported
+ * once, with no writes after it. Exits non-zero on failure, or if the
+ * streaming decoder is not at least 1.5 times the old one's speed.
+ *
+ * Usage: ihexbench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "intelhex.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+#define IMAGE_BYTES	65536
+#define IMAGE_BASE	0x00010000
+#define RECLEN		16
+#define NREPS		50
+
+static uint8_t image[IMAGE_BYTES];
+static char hex[IMAGE_BYTES / RECLEN * 48 + 64];
+static unsigned hexlen, nrecords;
+static struct s_ihexdec dec;		// Static: DMA needs a 32-bit address
+static s_ihex ihex;
+static unsigned failures = 0;
+
+static void
+check(bool ok,const char *what) {
+
+	if ( !ok ) {
+		printf("FAIL: %s\n",what);
+		++failures;
+	}
+}
+
+/*********************************************************************
+ * Append one record to hex[]
+ *********************************************************************/
+
+static void
+put_record(uint8_t rtype,uint16_t addr,const uint8_t *data,unsigned len) {
+	unsigned csum = len + (addr >> 8) + (addr & 0xFF) + rtype;
+
+	hexlen += sprintf(hex + hexlen,":%02X%04X%02X",len,addr,rtype);
+	for ( unsigned ux = 0; ux < len; ++ux ) {
+		hexlen += sprintf(hex + hexlen,"%02X",data[ux]);
+		csum += data[ux];
+	}
+	hexlen += sprintf(hex + hexlen,"%02X\r\n",-csum & 0xFF);
+	++nrecords;
+}
+
+static void
+make_hex(void) {
+	uint8_t xl[2] = { IMAGE_BASE >> 24, (IMAGE_BASE >> 16) & 0xFF };
+
+	for ( uint32_t ux = 0; ux < IMAGE_BYTES; ++ux )
+		image[ux] = ux * 13 ^ ux >> 8;
+	put_record(IHEX_RT_XLADDR,0,xl,2);
+	for ( uint32_t ux = 0; ux < IMAGE_BYTES; ux += RECLEN )
+		put_record(IHEX_RT_DATA,(IMAGE_BASE + ux) & 0xFFFF,image + ux,RECLEN);
+	put_record(IHEX_RT_EOF,0,0,0);
+}
+
+/*********************************************************************
+ * The previous ihex_parse(), for comparison
+ *********************************************************************/
+
+static uint32_t
+old_to_hex(const char *text,unsigned n,const char **rp) {
+	char buf[n+1];
+
+	strncpy(buf,text,n)[n] = 0;
+	*rp = text + strlen(buf);
+	return strtoul(buf,0,16);
+}
+
+static unsigned
+old_parse(s_ihex *ihex,const char *text) {
+	const char *cp = strchr(text,':');
+	unsigned csum;
+
+	if ( !cp )
+		return IHEX_FAIL;
+	memset(ihex->data,0,sizeof ihex->data);
+	++cp;
+	ihex->length = old_to_hex(cp,2,&cp);
+	ihex->addr   = old_to_hex(cp,4,&cp);
+	ihex->rtype  = old_to_hex(cp,2,&cp);
+	if ( ihex->length > sizeof ihex->data )
+		return IHEX_FAIL;
+	csum = ihex->length + ((ihex->addr >> 8) & 0xFF) + (ihex->addr & 0xFF) + ihex->rtype;
+	for ( unsigned ux=0; ux<ihex->length; ++ux ) {
+		ihex->data[ux] = old_to_hex(cp,2,&cp);
+		csum += ihex->data[ux];
+	}
+	ihex->checksum = old_to_hex(cp,2,&cp);
+	ihex->compcsum = (-(int)(csum & 0x0FF)) & 0xFF;
+	if ( ihex->compcsum != ihex->checksum )
+		return IHEX_FAIL;
+	if ( ihex->rtype == IHEX_RT_XLADDR )
+		ihex->baseaddr = (uint32_t)ihex->data[0] << 24 | (uint32_t)ihex->data[1] << 16;
+	ihex->compaddr = ihex->baseaddr + ihex->addr;
+	return ihex->rtype;
+}
+
+/*********************************************************************
+ * Decoders over the whole text, returning good records
+ *********************************************************************/
+
+static unsigned
+by_lines(unsigned (*parse)(s_ihex *,const char *)) {
+	unsigned good = 0;
+
+	for ( char *cp = hex, *ep; (ep = strchr(cp,'\n')) != 0; cp = ep + 1 ) {
+		*ep = 0;			// As load_ihex() gathered lines
+		good += parse(&ihex,cp) != IHEX_FAIL;
+		*ep = '\n';
+	}
+	return good;
+}
+
+static unsigned
+streamed(void) {
+
+	for ( unsigned ux = 0; ux < hexlen; ++ux )
+		ihex_dec_putc(&dec,hex[ux]);
+	return dec.records;
+}
+
+static bool
+no_write(void *arg,uint32_t addr,const uint8_t *data,unsigned bytes) {
+	(void)arg; (void)addr; (void)data; (void)bytes;
+	return true;
+}
+
+static bool			// Fails the *(unsigned *)arg'th call, and after
+bad_write(void *arg,uint32_t addr,const uint8_t *data,unsigned bytes) {
+	(void)addr; (void)data; (void)bytes;
+	return --*(unsigned *)arg > 0;
+}
+
+static double
+cpu_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*********************************************************************
+ * Flash loads, in simulated time
+ *********************************************************************/
+
+static bool
+flash_write(void *arg,uint32_t addr,const uint8_t *data,unsigned bytes) {
+	(void)arg;
+	return w25_write_data(SPI1,addr & 0x00FFFFFF,(void *)data,bytes) != 0xFFFFFFFF;
+}
+
+static uint64_t
+load_records(unsigned *programs) {
+	uint64_t t0 = w25m_now;
+
+	*programs = 0;
+	for ( char *cp = hex, *ep; (ep = strchr(cp,'\n')) != 0; cp = ep + 1 ) {
+		*ep = 0;
+		if ( ihex_parse(&ihex,cp) == IHEX_RT_DATA ) {
+			w25_write_data(SPI1,ihex.compaddr & 0x00FFFFFF,ihex.data,ihex.length);
+			++*programs;
+		}
+		*ep = '\n';
+	}
+	w25_wait(SPI1);
+	return w25m_now - t0;
+}
+
+static uint64_t
+load_streamed(unsigned *programs) {
+	uint64_t t0 = w25m_now;
+
+	ihex_dec_init(&dec,flash_write,0);
+	streamed();
+	w25_wait(SPI1);
+	*programs = dec.writes;
+	return w25m_now - t0;
+}
+
+int
+main(void) {
+	double t0, ns_old, ns_parse, ns_stream;
+	unsigned good, programs;
+	unsigned calls = 3, ewrites = 0, rtype, eof = 0;
+	uint64_t ns;
+
+	make_hex();
+	printf("IMAGE  %u bytes, %u records, %u bytes of Intel Hex\n",
+		IMAGE_BYTES,nrecords,hexlen);
+
+	// 1. Decoding only
+	t0 = cpu_ns();
+	for ( unsigned rep = 0; rep < NREPS; ++rep )
+		good = by_lines(old_parse);
+	ns_old = (cpu_ns() - t0) / NREPS / nrecords;
+	check(good == nrecords,"old parse");
+
+	t0 = cpu_ns();
+	for ( unsigned rep = 0; rep < NREPS; ++rep ) {
+		ihex_init(&ihex);
+		good = by_lines(ihex_parse);
+	}
+	ns_parse = (cpu_ns() - t0) / NREPS / nrecords;
+	check(good == nrecords,"ihex_parse");
+
+	t0 = cpu_ns();
+	for ( unsigned rep = 0; rep < NREPS; ++rep ) {
+		ihex_dec_init(&dec,no_write,0);
+		good = streamed();
+	}
+	ns_stream = (cpu_ns() - t0) / NREPS / nrecords;
+	check(good == nrecords && dec.errors == 0,"streaming decoder");
+
+	puts("DECODE (host CPU, per record)");
+	printf("  old ihex_parse()   %7.1f ns\n",ns_old);
+	printf("  ihex_parse()       %7.1f ns (%.1fx)\n",ns_parse,ns_old / ns_parse);
+	printf("  ihex_dec_putc()    %7.1f ns (%.1fx)\n",ns_stream,ns_old / ns_stream);
+	check(ns_stream * 3 < ns_old * 2,"streaming decoder not 1.5x faster");
+
+	// 2. Loading into flash
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_4);
+	w25_dma_init(SPI1);
+
+	puts("LOAD 64K (simulated, SPI1 /4)");
+	w25m_init(W25Q32_ID);
+	ns = load_records(&programs);
+	printf("  record at a time   %5u programs %8.1f ms\n",programs,ns / 1e6);
+	check(memcmp(w25m_memory() + IMAGE_BASE,image,IMAGE_BYTES) == 0,"record load data");
+
+	w25m_init(W25Q32_ID);
+	ns = load_streamed(&programs);
+	printf("  page runs          %5u programs %8.1f ms\n",programs,ns / 1e6);
+	check(memcmp(w25m_memory() + IMAGE_BASE,image,IMAGE_BYTES) == 0,"streamed load data");
+	check(programs == IMAGE_BYTES / 256,"not one program per page");
+	check(w25m_errs.overwrites == 0 && w25m_errs.busy_cmds == 0,"flash misused");
+
+	// A bad checksum drops the record (and ends its run)
+	hex[30] = hex[30] == '0' ? '1' : '0';	// A digit of the first data record
+	ihex_dec_init(&dec,no_write,0);
+	streamed();
+	printf("BAD CHECKSUM: %u errors, %u records\n",(unsigned)dec.errors,(unsigned)dec.records);
+	check(dec.errors == 1 && dec.records == nrecords - 1,"bad record not dropped");
+	hex[30] = hex[30] == '0' ? '1' : '0';
+
+	// A failed write is reported once, and stops the writes
+	ihex_dec_init(&dec,bad_write,&calls);
+	for ( unsigned ux = 0; ux < hexlen; ++ux ) {
+		rtype = ihex_dec_putc(&dec,hex[ux]);
+		if ( rtype != IHEX_MORE && (rtype & IHEX_EWRITE) )
+			++ewrites;
+		if ( rtype != IHEX_MORE && (rtype & ~IHEX_EWRITE) == IHEX_RT_EOF )
+			++eof;
+	}
+	printf("WRITE FAILS: %u reported, %u writes, failed at %08X, %u EOF\n",
+		ewrites,(unsigned)dec.writes,(unsigned)dec.failaddr,eof);
+	check(ewrites == 1 && dec.writes == 2 && calls == 0 && dec.failaddr == IMAGE_BASE + 512
+		&& eof == 1,"write failure not stopped");
+
+	if ( failures )
+		return 1;
+	puts("PASS");
+	return 0;
+}
+
+// End ihexbench.c
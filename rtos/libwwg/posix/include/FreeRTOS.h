@@ -0,0 +1,25 @@
+/* FreeRTOS.h : Host stand-in for the libwwg flash simulation
+ * Only what libwwg's flash routines use is provided.
+ */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE			0
+#define pdTRUE			1
+#define pdPASS			1
+#define portMAX_DELAY		0xFFFFFFFFu
+
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY	191
+#define configCPU_CLOCK_HZ			72000000ul
+
+#define portYIELD_FROM_ISR(w)	((void)(w))
+
+#endif // FREERTOS_H
+
+// End FreeRTOS.h
@@ -0,0 +1,14 @@
+/* dwt.h : Host stand-in, simulated by w25sim.c (72 MHz cycles)
+ */
+#ifndef LIBOPENCM3_DWT_H
+#define LIBOPENCM3_DWT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+bool dwt_enable_cycle_counter(void);
+uint32_t dwt_read_cycle_counter(void);
+
+#endif
+
+// End dwt.h
@@ -0,0 +1,15 @@
+/* nvic.h : Host stand-in (no-ops)
+ */
+#ifndef LIBOPENCM3_NVIC_H
+#define LIBOPENCM3_NVIC_H
+
+#define NVIC_DMA1_CHANNEL2_IRQ	12
+#define NVIC_DMA1_CHANNEL4_IRQ	14
+
+#define nvic_set_priority(irq,prio)	((void)0)
+#define nvic_enable_irq(irq)		((void)0)
+#define nvic_disable_irq(irq)		((void)0)
+
+#endif
+
+// End nvic.h
@@ -0,0 +1,10 @@
+/* scb.h : Host stand-in, simulated by stmflash.c
+ */
+#ifndef LIBOPENCM3_SCB_H
+#define LIBOPENCM3_SCB_H
+
+void scb_reset_system(void);
+
+#endif
+
+// End scb.h
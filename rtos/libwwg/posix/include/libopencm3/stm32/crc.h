@@ -0,0 +1,14 @@
+/* crc.h : Host stand-in, simulated by stmflash.c
+ */
+#ifndef LIBOPENCM3_CRC_H
+#define LIBOPENCM3_CRC_H
+
+#include <stdint.h>
+
+void crc_reset(void);
+uint32_t crc_calculate(uint32_t data);
+uint32_t crc_calculate_block(uint32_t *datap,int size);
+
+#endif
+
+// End crc.h
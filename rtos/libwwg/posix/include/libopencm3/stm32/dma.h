@@ -0,0 +1,52 @@
+/* dma.h : Host stand-in, simulated by w25sim.c
+ */
+#ifndef LIBOPENCM3_DMA_H
+#define LIBOPENCM3_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DMA1			0x40020000u
+
+#define DMA_CHANNEL1		1
+#define DMA_CHANNEL2		2
+#define DMA_CHANNEL3		3
+#define DMA_CHANNEL4		4
+#define DMA_CHANNEL5		5
+#define DMA_CHANNEL6		6
+#define DMA_CHANNEL7		7
+
+#define DMA_GIF			0x1
+#define DMA_TCIF		0x2
+#define DMA_HTIF		0x4
+#define DMA_TEIF		0x8
+
+#define DMA_CCR_PSIZE_8BIT	0
+#define DMA_CCR_MSIZE_8BIT	0
+#define DMA_CCR_PL_LOW		0
+#define DMA_CCR_PL_MEDIUM	1
+#define DMA_CCR_PL_HIGH		2
+#define DMA_CCR_PL_VERY_HIGH	3
+
+void dma_channel_reset(uint32_t dma,uint8_t channel);
+void dma_set_peripheral_address(uint32_t dma,uint8_t channel,uint32_t address);
+void dma_set_memory_address(uint32_t dma,uint8_t channel,uint32_t address);
+void dma_set_number_of_data(uint32_t dma,uint8_t channel,uint16_t number);
+void dma_set_read_from_peripheral(uint32_t dma,uint8_t channel);
+void dma_set_read_from_memory(uint32_t dma,uint8_t channel);
+void dma_enable_memory_increment_mode(uint32_t dma,uint8_t channel);
+void dma_disable_memory_increment_mode(uint32_t dma,uint8_t channel);
+void dma_enable_transfer_complete_interrupt(uint32_t dma,uint8_t channel);
+void dma_enable_transfer_error_interrupt(uint32_t dma,uint8_t channel);
+void dma_enable_channel(uint32_t dma,uint8_t channel);
+void dma_disable_channel(uint32_t dma,uint8_t channel);
+bool dma_get_interrupt_flag(uint32_t dma,uint8_t channel,uint32_t interrupts);
+void dma_clear_interrupt_flags(uint32_t dma,uint8_t channel,uint32_t interrupts);
+
+#define dma_set_peripheral_size(dma,ch,size)	((void)0)
+#define dma_set_memory_size(dma,ch,size)	((void)0)
+#define dma_set_priority(dma,ch,prio)		((void)0)
+
+#endif
+
+// End dma.h
@@ -0,0 +1,14 @@
+/* bkp.h : Host stand-in, simulated by stmflash.c
+ */
+#ifndef LIBOPENCM3_BKP_H
+#define LIBOPENCM3_BKP_H
+
+#include <stdint.h>
+
+extern volatile uint16_t sim_bkp_dr1;
+
+#define BKP_DR1		sim_bkp_dr1
+
+#endif
+
+// End bkp.h
@@ -0,0 +1,22 @@
+/* flash.h : Host stand-in, simulated by stmflash.c
+ */
+#ifndef LIBOPENCM3_FLASH_H
+#define LIBOPENCM3_FLASH_H
+
+#include <stdint.h>
+
+#define FLASH_SR_EOP		(1 << 5)
+#define FLASH_SR_WRPRTERR	(1 << 4)
+#define FLASH_SR_PGERR		(1 << 2)
+#define FLASH_SR_BSY		(1 << 0)
+
+void flash_unlock(void);
+void flash_lock(void);
+void flash_erase_page(uint32_t page_address);
+void flash_program_half_word(uint32_t address,uint16_t data);
+uint32_t flash_get_status_flags(void);
+void flash_clear_status_flags(void);
+
+#endif
+
+// End flash.h
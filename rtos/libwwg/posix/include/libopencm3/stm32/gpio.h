@@ -0,0 +1,27 @@
+/* gpio.h : Host stand-in (no-ops)
+ */
+#ifndef LIBOPENCM3_GPIO_H
+#define LIBOPENCM3_GPIO_H
+
+#define GPIOA			0
+#define GPIOB			1
+#define GPIO4			0x0010
+#define GPIO5			0x0020
+#define GPIO6			0x0040
+#define GPIO7			0x0080
+#define GPIO12			0x1000
+#define GPIO13			0x2000
+#define GPIO14			0x4000
+#define GPIO15			0x8000
+
+#define GPIO_MODE_INPUT			0
+#define GPIO_MODE_OUTPUT_50_MHZ		3
+#define GPIO_CNF_INPUT_FLOAT		1
+#define GPIO_CNF_OUTPUT_ALTFN_PUSHPULL	2
+
+#define gpio_set_mode(port,mode,cnf,pins)	((void)0)
+#define gpio_set(port,pins)			((void)0)
+
+#endif
+
+// End gpio.h
@@ -0,0 +1,10 @@
+/* pwr.h : Host stand-in (no-ops)
+ */
+#ifndef LIBOPENCM3_PWR_H
+#define LIBOPENCM3_PWR_H
+
+#define pwr_disable_backup_domain_write_protect()	((void)0)
+
+#endif
+
+// End pwr.h
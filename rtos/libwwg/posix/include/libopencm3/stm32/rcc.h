@@ -0,0 +1,14 @@
+/* rcc.h : Host stand-in (no-ops)
+ */
+#ifndef LIBOPENCM3_RCC_H
+#define LIBOPENCM3_RCC_H
+
+enum { RCC_SPI1, RCC_SPI2, RCC_DMA1, RCC_CRC, RCC_PWR, RCC_BKP };
+enum { RST_SPI1, RST_SPI2 };
+
+#define rcc_periph_clock_enable(p)	((void)(p))
+#define rcc_periph_reset_pulse(p)	((void)(p))
+
+#endif
+
+// End rcc.h
@@ -0,0 +1,45 @@
+/* spi.h : Host stand-in, wired to the W25Qxx model by w25sim.c
+ */
+#ifndef LIBOPENCM3_SPI_H
+#define LIBOPENCM3_SPI_H
+
+#include <stdint.h>
+
+#define SPI1			0x40013000u
+#define SPI2			0x40003800u
+
+extern volatile uint32_t sim_spi_dr;
+#define SPI_DR(spi)		sim_spi_dr
+
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_2	0x00
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_4	0x08
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_8	0x10
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_16	0x18
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_32	0x20
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_64	0x28
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_128	0x30
+#define SPI_CR1_BAUDRATE_FPCLK_DIV_256	0x38
+#define SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE	0
+#define SPI_CR1_CPOL_CLK_TO_1_WHEN_IDLE	2
+#define SPI_CR1_CPHA_CLK_TRANSITION_1	0
+#define SPI_CR1_CPHA_CLK_TRANSITION_2	1
+#define SPI_CR1_DFF_8BIT		0
+#define SPI_CR1_DFF_16BIT		0x800
+#define SPI_CR1_MSBFIRST		0
+#define SPI_CR1_LSBFIRST		0x80
+
+int spi_init_master(uint32_t spi,uint32_t br,uint32_t cpol,uint32_t cpha,uint32_t dff,uint32_t lsbfirst);
+void spi_enable(uint32_t spi);
+void spi_disable(uint32_t spi);
+uint16_t spi_xfer(uint32_t spi,uint16_t data);
+void spi_enable_rx_dma(uint32_t spi);
+void spi_disable_rx_dma(uint32_t spi);
+void spi_enable_tx_dma(uint32_t spi);
+void spi_disable_tx_dma(uint32_t spi);
+
+#define spi_disable_software_slave_management(spi)	((void)(spi))
+#define spi_enable_ss_output(spi)			((void)(spi))
+
+#endif
+
+// End spi.h
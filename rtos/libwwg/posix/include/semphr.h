@@ -0,0 +1,24 @@
+/* semphr.h : Host stand-in (one task, so mutexes never contend)
+ */
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+typedef void *SemaphoreHandle_t;
+
+#define xSemaphoreCreateMutex()		((SemaphoreHandle_t)1)
+
+static inline BaseType_t
+xSemaphoreTake(SemaphoreHandle_t m,TickType_t ticks) {
+	(void)m; (void)ticks;
+	return pdTRUE;
+}
+
+static inline BaseType_t
+xSemaphoreGive(SemaphoreHandle_t m) {
+	(void)m;
+	return pdTRUE;
+}
+
+#endif // SEMAPHORE_H
+
+// End semphr.h
@@ -0,0 +1,18 @@
+/* task.h : Host stand-in (single task, simulated DMA runs when blocked)
+ */
+#ifndef TASK_H
+#define TASK_H
+
+typedef void *TaskHandle_t;
+
+void taskYIELD(void);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear,TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task,BaseType_t *woken);
+
+#endif // TASK_H
+
+// End task.h
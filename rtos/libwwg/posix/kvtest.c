@@ -0,0 +1,315 @@
+/* kvtest.c : Exercise ../src/w25kv.c against the W25Qxx model,
+ *	      including power failure at many points
+ * Warren W. Gay VE3WWG
+ *
+ * A fixed workload of puts and deletes is run, with w25kv_service()
+ * called as the background task would. A shadow copy records what
+ * each acknowledged put or delete left behind.
+ *
+ * The workload is then rerun with the power cut during the Nth
+ * flash program or erase, for many N. After each cut the store is
+ * mounted again, and every key must hold its last acknowledged
+ * value, except that the key being written at the cut may instead
+ * hold its new value. The workload then continues, and the store is
+ * checked again after another remount.
+ *
+ * Last, a writer puts a value every WRITE_NS of simulated time with
+ * the service running in between, so the puts land on erases in
+ * progress. It is run with erase suspend, and again with nosuspend
+ * (each put waits out any erase), and the put latency of each is
+ * reported. The suspend run fails if its worst put exceeds BOUND_NS.
+ *
+ * Usage: kvtest [cuts]		(default 400 cut points)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "w25kv.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+#define KV_BASE		0x100000
+#define KV_SECTORS	8
+#define NKEYS		12
+#define NOPS		3000
+#define NWRITES		2000
+#define WRITE_NS	5000000ull	// A put every 5 ms
+#define BOUND_NS	3000000ull	// Worst put, with suspend
+
+struct s_shadow {
+	bool		present;
+	uint32_t	ver;		// Version of the value
+};
+
+static struct s_w25kv kv;
+static struct s_shadow shadow[NKEYS+1];
+static struct {
+	uint16_t	key;		// Key being changed, else 0
+	bool		del;
+	uint32_t	ver;
+} inflight;
+
+static uint32_t cache[W25_CACHE_SIZE(8)/4];
+static jmp_buf power_cut;
+static unsigned long puts_waited = 0;
+
+/*********************************************************************
+ * Value for a key and version: ver, then a fill pattern
+ *********************************************************************/
+
+static unsigned
+make_value(uint16_t key,uint32_t ver,uint8_t *buf) {
+	unsigned len = 4 + (key * 7 + ver * 3) % 60;
+
+	memcpy(buf,&ver,4);
+	for ( unsigned ux = 4; ux < len; ++ux )
+		buf[ux] = ver + ux * key;
+	return len;
+}
+
+static void
+cut(void) {
+	longjmp(power_cut,1);
+}
+
+static void
+fail(const char *what,uint16_t key) {
+	printf("FAIL: %s (key %u, ops %lu)\n",what,key,w25m_ops);
+	exit(1);
+}
+
+static void
+mount(void) {
+	int rc;
+
+	w25m_reset();
+	w25_cache_init(SPI1,cache,sizeof cache);	// RAM is lost too
+	if ( (rc = w25kv_mount(&kv,SPI1,KV_BASE,KV_SECTORS)) != 0 ) {
+		printf("FAIL: mount returned %d\n",rc);
+		exit(1);
+	}
+}
+
+/*********************************************************************
+ * Check every key against the shadow (and the change in flight)
+ *********************************************************************/
+
+static void
+verify(void) {
+	uint8_t buf[W25KV_MAX_LEN], want[W25KV_MAX_LEN];
+	unsigned wlen;
+	uint32_t ver;
+	int rc;
+
+	for ( uint16_t key = 1; key <= NKEYS; ++key ) {
+		rc = w25kv_get(&kv,key,buf,sizeof buf);
+		if ( rc == W25KV_ENOENT ) {
+			if ( shadow[key].present && !(inflight.key == key && inflight.del) )
+				fail("key lost",key);
+			shadow[key].present = false;
+			continue;
+		}
+		if ( rc < 4 )
+			fail("bad length",key);
+		memcpy(&ver,buf,4);
+		if ( !(shadow[key].present && ver == shadow[key].ver)
+		  && !(inflight.key == key && !inflight.del && ver == inflight.ver) )
+			fail(shadow[key].present ? "stale or torn value" : "deleted key back",key);
+		wlen = make_value(key,ver,want);
+		if ( (unsigned)rc != wlen || memcmp(buf,want,wlen) != 0 )
+			fail("value corrupt",key);
+
+		// Make the shadow match what survived
+		shadow[key].present = true;
+		shadow[key].ver = ver;
+	}
+	inflight.key = 0;
+}
+
+/*********************************************************************
+ * One pass of w25kv_task(): a tick passes if there was nothing to do
+ *********************************************************************/
+
+static void
+service(void) {
+
+	if ( !w25kv_service(&kv) )
+		vTaskDelay(1);
+}
+
+/*********************************************************************
+ * Workload: ops from a seeded generator, with background service
+ *********************************************************************/
+
+static void
+workload(unsigned seed,unsigned nops) {
+	uint8_t buf[W25KV_MAX_LEN];
+	unsigned long erases;
+	unsigned len;
+	uint16_t key;
+	int rc;
+
+	for ( unsigned op = 0; op < nops; ++op ) {
+		seed = seed * 1103515245 + 12345;
+		key = 1 + (seed >> 16) % NKEYS;
+		inflight.key = key;
+		erases = w25m_cmds[W25_CMD_ERA_SECTOR];
+
+		if ( (seed >> 8) % 10 == 0 ) {
+			inflight.del = true;
+			while ( (rc = w25kv_delete(&kv,key)) == W25KV_EAGAIN ) {
+				service();
+				erases = w25m_cmds[W25_CMD_ERA_SECTOR];
+			}
+			if ( rc != 0 && rc != W25KV_ENOENT )
+				fail("delete",key);
+			shadow[key].present = false;
+		} else	{
+			inflight.del = false;
+			inflight.ver = shadow[key].ver + 1;
+			len = make_value(key,inflight.ver,buf);
+			if ( (rc = w25kv_put(&kv,key,buf,len)) == W25KV_EAGAIN )
+				++puts_waited;
+			while ( rc == W25KV_EAGAIN ) {
+				service();		// As if the task ran
+				erases = w25m_cmds[W25_CMD_ERA_SECTOR];
+				rc = w25kv_put(&kv,key,buf,len);
+			}
+			if ( rc != 0 )
+				fail("put",key);
+			shadow[key].present = true;
+			shadow[key].ver = inflight.ver;
+		}
+		if ( w25m_cmds[W25_CMD_ERA_SECTOR] != erases )
+			fail("put or delete erased",key);
+		inflight.key = 0;
+
+		if ( op & 1 )			// Task runs every other op
+			w25kv_service(&kv);
+	}
+}
+
+/*********************************************************************
+ * Writer: a put every WRITE_NS, while the service erases between
+ *********************************************************************/
+
+static void
+writer(bool nosuspend) {
+	uint8_t buf[W25KV_MAX_LEN];
+	uint64_t due, t0, lat, worst = 0, total = 0;
+	unsigned waited = 0, len;
+	uint16_t key;
+	int rc;
+
+	w25m_init(W25Q32_ID);
+	memset(shadow,0,sizeof shadow);
+	mount();
+	kv.nosuspend = nosuspend;
+
+	due = w25m_now;
+	for ( unsigned n = 0; n < NWRITES; ++n, due += WRITE_NS ) {
+		while ( w25m_now < due )	// Idle: the service runs
+			service();
+
+		key = 1 + n % NKEYS;
+		shadow[key].ver += 1;
+		len = make_value(key,shadow[key].ver,buf);
+		t0 = w25m_now;
+		if ( (rc = w25kv_put(&kv,key,buf,len)) == W25KV_EAGAIN )
+			++waited;
+		while ( rc == W25KV_EAGAIN ) {
+			service();
+			rc = w25kv_put(&kv,key,buf,len);
+		}
+		if ( rc != 0 )
+			fail("put",key);
+		shadow[key].present = true;
+		lat = w25m_now - t0;
+		total += lat;
+		if ( lat > worst )
+			worst = lat;
+	}
+	verify();
+
+	printf("%-10s %u puts, %u erases, %u suspends, %u puts waited\n",
+		nosuspend ? "nosuspend:" : "suspend:",NWRITES,(unsigned)kv.erases,
+		(unsigned)kv.suspends,waited);
+	printf("           put latency: mean %.3f ms, worst %.3f ms\n",
+		total / 1e6 / NWRITES,worst / 1e6);
+
+	if ( w25m_errs.overwrites || w25m_errs.busy_cmds
+	  || w25m_errs.suspended_reads || w25m_errs.bad_suspends ) {
+		printf("FAIL: flash misused\n");
+		exit(1);
+	}
+	if ( kv.erases == 0 || (!nosuspend && (kv.suspends == 0 || worst > BOUND_NS)) ) {
+		printf("FAIL: put latency over bound, or no erases overlapped\n");
+		exit(1);
+	}
+}
+
+int
+main(int argc,char **argv) {
+	unsigned ncuts = argc > 1 ? strtoul(argv[1],0,0) : 400;
+	unsigned long total, step, tested = 0;
+
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_2);
+
+	// Clean run, to count the flash operations
+	w25m_init(W25Q32_ID);
+	memset(shadow,0,sizeof shadow);
+	mount();
+	workload(1,NOPS);
+	verify();
+	mount();
+	verify();
+	total = w25m_ops;
+	printf("clean: %u ops, %lu flash programs/erases, %lu erases, %lu puts waited, %.1f s\n",
+		NOPS,total,w25m_cmds[W25_CMD_ERA_SECTOR],puts_waited,w25m_now / 1e9);
+	if ( w25m_errs.overwrites || w25m_errs.busy_cmds ) {
+		printf("FAIL: %lu programs over unerased bits, %lu commands while busy\n",
+			w25m_errs.overwrites,w25m_errs.busy_cmds);
+		return 1;
+	}
+
+	step = total / ncuts > 0 ? total / ncuts : 1;
+	for ( unsigned long at = 1; at <= total; at += step ) {
+		w25m_init(W25Q32_ID);
+		memset(shadow,0,sizeof shadow);
+		memset(&inflight,0,sizeof inflight);
+		srand(at);
+		mount();
+
+		if ( setjmp(power_cut) == 0 ) {
+			w25m_ops = 0;
+			w25m_powerfail(at,cut);
+			workload(1,NOPS);
+			fail("power cut did not happen",0);
+		}
+
+		mount();			// After the cut
+		verify();
+		workload(at,200);		// Carry on
+		mount();
+		verify();
+		++tested;
+	}
+	w25m_powerfail(0,0);
+	printf("%lu power cuts, 1 in every %lu flash operations: PASS\n",tested,step);
+
+	writer(false);			// Suspend erases
+	writer(true);			// Wait them out
+	puts("PASS");
+	return 0;
+}
+
+// End kvtest.c
@@ -0,0 +1,196 @@
+/* logtest.c : Exercise ../src/w25log.c against the W25Qxx model,
+ *	       and measure append latency while sectors are erased
+ * Warren W. Gay VE3WWG
+ *
+ * A producer appends a 48 byte "ADC frame" every millisecond of
+ * simulated time, into a region that starts out dirty, so every
+ * sector must be erased as the log runs. Between frames the log
+ * task's w25log_service() runs, as it would at low priority. A
+ * reader drains the log every 100 frames, checking the frames
+ * arrive in order.
+ *
+ * This is run with erase suspend, and again with nosuspend (each
+ * append waits out any erase), and the append latency of each is
+ * reported. Exits non-zero if frames are lost, out of order or
+ * corrupt, if an append was refused, if the chip was misused, or
+ * if the suspend run's worst latency exceeds its bound.
+ *
+ * Usage: logtest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "w25log.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+#define LOG_BASE	0x200000
+#define LOG_SECTORS	32
+#define FRAME_BYTES	48
+#define NFRAMES		8000		// Wraps the ring about 4 times
+#define PERIOD_NS	1000000ull	// 1 kHz frames
+#define BOUND_NS	3000000ull	// Worst append, with suspend
+
+static struct s_w25log lg;
+static uint8_t frame[FRAME_BYTES];	// Static: DMA needs a 32-bit address
+static uint8_t rbuf[FRAME_BYTES];
+
+static void
+fail(const char *what,uint32_t n) {
+	printf("FAIL: %s (frame %u)\n",what,(unsigned)n);
+	exit(1);
+}
+
+static void
+make_frame(uint32_t n) {
+
+	memcpy(frame,&n,4);
+	for ( unsigned ux = 4; ux < FRAME_BYTES; ++ux )
+		frame[ux] = n * 3 + ux;
+}
+
+/*********************************************************************
+ * Read all records at the cursor, checking they follow *next
+ *********************************************************************/
+
+static void
+drain(struct s_w25log_cursor *cur,uint32_t *next) {
+	uint32_t n;
+	int rc;
+
+	while ( (rc = w25log_read(&lg,cur,rbuf,sizeof rbuf)) != W25LOG_ENOENT ) {
+		if ( rc == W25LOG_ELOST )
+			fail("reader fell behind",*next);
+		if ( rc != FRAME_BYTES )
+			fail("bad record length",*next);
+		memcpy(&n,rbuf,4);
+		if ( n != *next )
+			fail("frame out of order",n);
+		make_frame(n);
+		if ( memcmp(rbuf,frame,FRAME_BYTES) != 0 )
+			fail("frame corrupt",n);
+		++*next;
+	}
+}
+
+/*********************************************************************
+ * Log NFRAMES at 1 kHz, with the log task running between frames
+ *********************************************************************/
+
+static void
+run(bool nosuspend) {
+	struct s_w25log_cursor cur;
+	struct s_w25log_stats st;
+	uint64_t due, t0, lat, worst = 0, total = 0;
+	uint32_t next = 0;
+	uint8_t *mem;
+
+	w25m_init(W25Q32_ID);
+	mem = w25m_memory();
+	for ( uint32_t ux = 0; ux < LOG_SECTORS * 4096; ++ux )
+		mem[LOG_BASE + ux] = ux * 13;		// Old data: all dirty
+	w25m_now = 0;
+
+	memset(&lg,0,sizeof lg);
+	if ( w25log_mount(&lg,SPI1,LOG_BASE,LOG_SECTORS) != 0 )
+		fail("mount",0);
+	lg.nosuspend = nosuspend;
+	w25log_rewind(&lg,&cur);
+
+	due = w25m_now + 50 * PERIOD_NS;	// Task gets a head start
+	for ( uint32_t n = 0; n < NFRAMES; ++n, due += PERIOD_NS ) {
+		while ( w25m_now < due )		// Idle: the log task runs
+			if ( !w25log_service(&lg) )
+				vTaskDelay(1);
+
+		make_frame(n);
+		t0 = w25m_now;
+		if ( w25log_append(&lg,frame,FRAME_BYTES) != 0 )
+			fail("append",n);
+		lat = w25m_now - t0;
+		total += lat;
+		if ( lat > worst )
+			worst = lat;
+
+		if ( n % 100 == 99 )
+			drain(&cur,&next);
+	}
+	w25log_flush(&lg);
+	drain(&cur,&next);
+	if ( next != NFRAMES )
+		fail("frames missing",next);
+
+	w25log_stats(&lg,&st,false);
+	printf("%-10s %u frames, %u erases, %u suspends, %u sectors dropped\n",
+		nosuspend ? "nosuspend:" : "suspend:",(unsigned)st.appends,(unsigned)st.erases,
+		(unsigned)st.suspends,(unsigned)st.dropped);
+	printf("           append latency: mean %.3f ms, worst %.3f ms (%u ticks)\n",
+		total / 1e6 / NFRAMES,worst / 1e6,(unsigned)st.max_ticks);
+	printf("           ticks:");
+	for ( unsigned b = 0; b < W25LOG_NBUCKETS; ++b )
+		printf(" <%u:%u",1u << b,(unsigned)st.hist[b]);
+	putchar('\n');
+
+	if ( w25m_errs.overwrites || w25m_errs.busy_cmds
+	  || w25m_errs.suspended_reads || w25m_errs.bad_suspends )
+		fail("flash misused",0);
+	if ( st.erase_fails )
+		fail("erases failed to start",0);
+	if ( !nosuspend && worst > BOUND_NS )
+		fail("append latency over bound",0);
+}
+
+/*********************************************************************
+ * Remount: the log must carry on after its last record
+ *********************************************************************/
+
+static void
+remount(void) {
+	struct s_w25log_cursor cur;
+	uint32_t n = 0, last = 0;
+	int rc;
+
+	if ( w25log_mount(&lg,SPI1,LOG_BASE,LOG_SECTORS) != 0 )
+		fail("remount",0);
+	make_frame(NFRAMES);
+	while ( (rc = w25log_append(&lg,frame,FRAME_BYTES)) == W25LOG_EAGAIN )
+		w25log_service(&lg);
+	if ( rc != 0 || w25log_flush(&lg) != 0 )
+		fail("append after remount",NFRAMES);
+
+	w25log_rewind(&lg,&cur);
+	while ( w25log_read(&lg,&cur,rbuf,sizeof rbuf) == FRAME_BYTES ) {
+		memcpy(&last,rbuf,4);
+		++n;
+	}
+	if ( last != NFRAMES )
+		fail("remount lost the end of the log",last);
+	printf("remount:   %u frames readable, newest %u: PASS\n",(unsigned)n,(unsigned)last);
+}
+
+static int
+tests(void) {
+
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_4);
+	w25_dma_init(SPI1);
+
+	run(false);			// Suspend erases
+	run(true);			// Wait them out
+	remount();
+	puts("PASS");
+	return 0;
+}
+
+int
+main(void) {
+	return w25sim_run(tests);	// w25log.c reads into stack buffers by DMA
+}
+
+// End logtest.c
@@ -0,0 +1,256 @@
+/* ovlbench.c : Packed against plain overlay loads, by SPI clock
+ * Warren W. Gay VE3WWG
+ *
+ * Eight modules (300 to 960 bytes) are cut from this program's own
+ * machine code, and stored in the model's flash twice: as they are,
+ * and packed by ../tools/ovlpack.py -b. Each is then loaded on
+ * demand through ../src/overlay.c (one region, so every lookup
+ * reads), at SPI1 /4 up to /256, and the mean time the caller
+ * waited is reported for each form.
+ *
+ * A packed load reads OVL_LZ_CHUNK bytes at a time by DMA, and
+ * decodes each chunk while the next is read. The decode is charged
+ * in Cortex-M3 cycles (OVL_LZ_CPU() in w25sim.h), since host time
+ * says nothing about the MCU's. Then the packed modules are
+ * prefetched down a chain of hints, to be unpacked in place.
+ *
+ * Every region is compared with the module's bytes. Exits non-zero
+ * on bad data, a failed lookup, a bad header being accepted, or if
+ * packing does not cut the load time at /16 and slower.
+ *
+ * Usage: ovlbench		(from libwwg/posix: runs ../tools/ovlpack.py)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "overlay.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+#define NMODS		8
+#define REGION		1536
+#define PACKED		0x100000	// Packed copies, in flash
+#define RAWFILE		".ovlbench.raw"
+#define LZFILE		".ovlbench.lz"
+
+extern char __executable_start, etext;
+
+static const uint16_t sizes[NMODS] = { 300, 420, 512, 600, 700, 800, 880, 960 };
+
+static const struct {
+	uint32_t	br;
+	unsigned	div;
+} speeds[] = {
+	{ SPI_CR1_BAUDRATE_FPCLK_DIV_4,		4 },
+	{ SPI_CR1_BAUDRATE_FPCLK_DIV_8,		8 },
+	{ SPI_CR1_BAUDRATE_FPCLK_DIV_16,	16 },
+	{ SPI_CR1_BAUDRATE_FPCLK_DIV_64,	64 },
+	{ SPI_CR1_BAUDRATE_FPCLK_DIV_256,	256 },
+};
+
+static uint8_t ovlmem[2 * REGION];	// Static: loaded by DMA
+static uint8_t lzbuf[2 * OVL_LZ_CHUNK];
+static const uint8_t *code[NMODS];	// Module bytes, unpacked
+static struct s_ovl_module plain[NMODS], packed[NMODS];
+static struct s_ovl ovl;
+static unsigned zbytes, rawbytes;
+static unsigned failures;
+
+static void
+fail(const char *what,unsigned mx) {
+
+	if ( failures++ < 10 )
+		printf("FAIL: %s (module %u)\n",what,mx);
+}
+
+/*********************************************************************
+ * Cut the modules from .text, and store them plain and packed
+ *********************************************************************/
+
+static void
+make_modules(void) {
+	const uint8_t *text = (const uint8_t *)&__executable_start;
+	unsigned total = 0, len;
+	uint8_t *img;
+	FILE *f;
+
+	for ( unsigned mx = 0; mx < NMODS; ++mx )
+		total += sizes[mx];
+	if ( (const uint8_t *)&etext - text < total + 4096 ) {
+		puts("FAIL: .text too small");
+		exit(1);
+	}
+	text = (const uint8_t *)&etext - total;
+
+	w25m_init(W25Q32_ID);
+	for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+		code[mx] = text;
+		text += sizes[mx];
+
+		img = w25m_memory() + mx * 4096;
+		memcpy(img,code[mx],sizes[mx]);
+		plain[mx].name = "plain";
+		plain[mx].start = (const char *)(uintptr_t)(mx * 4096);
+		plain[mx].stop = plain[mx].start + sizes[mx];
+		plain[mx].func = ovlmem;
+
+		if ( !(f = fopen(RAWFILE,"wb")) || fwrite(code[mx],sizes[mx],1,f) != 1 || fclose(f) ) {
+			perror(RAWFILE);
+			exit(1);
+		}
+		if ( system("python3 ../tools/ovlpack.py -b " RAWFILE " " LZFILE " 2>/dev/null") != 0 ) {
+			puts("FAIL: ../tools/ovlpack.py");
+			exit(1);
+		}
+		img = w25m_memory() + PACKED + mx * 4096;
+		f = fopen(LZFILE,"rb");
+		len = f ? fread(img,1,4096,f) : 0;
+		if ( f )
+			fclose(f);
+		if ( len <= OVL_LZ_HDR ) {
+			puts("FAIL: " LZFILE);
+			exit(1);
+		}
+		packed[mx].name = "packed";
+		packed[mx].start = (const char *)(uintptr_t)(PACKED + mx * 4096);
+		packed[mx].stop = packed[mx].start + len;
+		packed[mx].func = ovlmem;
+		packed[mx].packed = true;
+		packed[mx].hints[0] = (mx + 1) % NMODS + 1;
+		rawbytes += sizes[mx];
+		zbytes += len;
+	}
+	remove(RAWFILE);
+	remove(LZFILE);
+}
+
+static bool
+resident(unsigned mx,const uint8_t *f,const struct s_ovl_module *m) {
+
+	if ( !f ) {
+		fail("lookup",mx);
+		return false;
+	}
+	if ( m->region < 0 || f != ovl.region[m->region].mem
+	  || memcmp(ovl.region[m->region].mem,code[mx],sizes[mx]) != 0 ) {
+		fail("bad data",mx);
+		return false;
+	}
+	return true;
+}
+
+/*********************************************************************
+ * Demand load every module, reps times: mean wait per load (us)
+ *********************************************************************/
+
+static double
+loads(struct s_ovl_module *mods,unsigned reps) {
+	uint32_t cycles = 0, n = 0;
+
+	if ( !ovl_init(&ovl,SPI1,ovlmem,1,REGION,mods,NMODS) ) {
+		puts("FAIL: ovl_init()");
+		exit(1);
+	}
+	ovl.lzbuf = lzbuf;
+	ovl.noprefetch = true;
+
+	for ( unsigned rx = 0; rx < reps; ++rx ) {
+		for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+			resident(mx,ovl_lookup(&ovl,mods[mx].start),&mods[mx]);
+			ovl_done(&ovl,mods[mx].start);
+		}
+	}
+	for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+		cycles += mods[mx].stats.wait_cycles;
+		n += mods[mx].stats.loads;
+	}
+	return n ? cycles / 72.0 / n : 0.0;
+}
+
+/*********************************************************************
+ * Prefetch down the hints (packed into the region's end, unpacked
+ * in place when called), with 1 ms of work per call
+ *********************************************************************/
+
+static void
+prefetches(void) {
+	unsigned used = 0, fetched = 0;
+
+	ovl_init(&ovl,SPI1,ovlmem,2,REGION,packed,NMODS);
+	ovl.lzbuf = lzbuf;
+	for ( unsigned rx = 0; rx < 4; ++rx ) {
+		for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+			resident(mx,ovl_lookup(&ovl,packed[mx].start),&packed[mx]);
+			w25m_now += 1000000ull;
+			ovl_done(&ovl,packed[mx].start);
+		}
+	}
+	ovl_sync(&ovl);
+	for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+		fetched += packed[mx].stats.prefetches;
+		used += packed[mx].stats.prefetch_hits;
+	}
+	printf("prefetch in place: %u calls, %u prefetched, %u used\n",4 * NMODS,fetched,used);
+	if ( used < 3 * NMODS )
+		fail("prefetched modules not used",0);
+}
+
+/*********************************************************************
+ * A header that does not fit the region is refused
+ *********************************************************************/
+
+static void
+bad_header(void) {
+	uint8_t *img = w25m_memory() + PACKED;
+	uint8_t save = img[3];
+
+	img[3] = 0x7F;				// raw > REGION
+	ovl_init(&ovl,SPI1,ovlmem,1,REGION,packed,NMODS);
+	ovl.lzbuf = lzbuf;
+	if ( ovl_lookup(&ovl,packed[0].start) )
+		fail("bad header accepted",0);
+	img[3] = save;
+}
+
+static int
+tests(void) {
+	double tp, tz;
+
+	make_modules();
+	w25_dma_init(SPI1);
+	printf("%u modules, %u bytes, packed %u (%.0f%%), chunks of %u\n",NMODS,rawbytes,
+		zbytes,zbytes * 100.0 / rawbytes,OVL_LZ_CHUNK);
+	puts("  SPI1   plain us  packed us  speedup");
+
+	for ( unsigned sx = 0; sx < sizeof speeds / sizeof speeds[0]; ++sx ) {
+		w25_spi_setup(SPI1,true,true,true,speeds[sx].br);
+		tp = loads(plain,4);
+		tz = loads(packed,4);
+		printf("  /%-4u %9.1f %10.1f %7.2fx\n",speeds[sx].div,tp,tz,tp / tz);
+		if ( speeds[sx].div >= 16 && tz >= tp )
+			fail("packed loads no faster",sx);
+	}
+
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_4);
+	prefetches();
+	bad_header();
+
+	if ( failures || w25m_errs.busy_cmds )
+		return 1;
+	puts("PASS");
+	return 0;
+}
+
+int
+main(void) {
+	return w25sim_run(tests);
+}
+
+// End ovlbench.c
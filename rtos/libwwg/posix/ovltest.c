@@ -0,0 +1,267 @@
+/* ovltest.c : Exercise ../src/overlay.c against the W25Qxx model
+ * Warren W. Gay VE3WWG
+ *
+ * Ten modules (200 to 480 bytes) are placed in the model's flash,
+ * and run by an application loop with this call graph:
+ *
+ *	menu -> parse -> cmd_a | cmd_b | cmd_c -> format	(format
+ *	     -> display				 is nested in cmd_x)
+ *	     -> log (1 in 8), config (1 in 40), selftest (1 in 90)
+ *
+ * Each module "runs" by spending CPU time (advancing w25m_now), half
+ * before its nested call and half after. At every lookup the region
+ * must hold the module's bytes, and the entry point must be in it;
+ * after the module returns its region must still hold it (a busy
+ * module is never replaced).
+ *
+ * The same calls are run with 2, 4 and 6 regions, then 4 and 6 with
+ * prefetch from the call graph hints, and the time callers waited
+ * for loads is reported. The simulated DMA runs while the
+ * caller spends CPU time, as on the MCU. Exits non-zero on bad
+ * data, a failed lookup, or if prefetch does not cut the waits.
+ *
+ * Usage: ovltest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "overlay.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+#define US		1000ull
+#define NMODS		10
+#define REGION		512
+#define LOOPS		2000
+#define ENTRY		0x11		// Thumb entry, after a literal pool
+
+enum { MENU, PARSE, CMD_A, CMD_B, CMD_C, FORMAT, DISPLAY, LOG, CONFIG, SELFTEST };
+
+static const struct {
+	const char	*name;
+	uint16_t	size;
+	uint16_t	cpu_us;		// Run time
+	uint8_t		hints[OVL_HINTS];
+} spec[NMODS] = {
+	{ "menu",	320, 120, { PARSE+1 } },
+	{ "parse",	480, 200, { CMD_A+1, CMD_B+1 } },
+	{ "cmd_a",	400, 300, { FORMAT+1 } },
+	{ "cmd_b",	360, 250, { FORMAT+1 } },
+	{ "cmd_c",	440, 400, { FORMAT+1 } },
+	{ "format",	280, 150, { DISPLAY+1 } },
+	{ "display",	460, 350, { MENU+1 } },
+	{ "log",	240, 100, { MENU+1 } },
+	{ "config",	300, 500, { MENU+1 } },
+	{ "selftest",	200, 800, { MENU+1 } },
+};
+
+static uint8_t ovlmem[6 * REGION];	// Static: loaded by DMA
+static struct s_ovl_module mods[NMODS];
+static struct s_ovl ovl;
+static unsigned failures;
+
+static void
+fail(const char *what,unsigned mx) {
+
+	if ( failures++ < 10 )
+		printf("FAIL: %s (%s)\n",what,spec[mx].name);
+}
+
+/*********************************************************************
+ * Module images in flash, 4K apart, and their table entries
+ *********************************************************************/
+
+static const uint8_t *
+image(unsigned mx) {
+	return w25m_memory() + mx * 4096;
+}
+
+static void
+make_modules(void) {
+
+	w25m_init(W25Q32_ID);
+	srand(39);
+	for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+		uint8_t *img = w25m_memory() + mx * 4096;
+
+		for ( unsigned ux = 0; ux < spec[mx].size; ++ux )
+			img[ux] = rand();
+		mods[mx].name = spec[mx].name;
+		mods[mx].start = (const char *)(uintptr_t)(mx * 4096);
+		mods[mx].stop = mods[mx].start + spec[mx].size;
+		mods[mx].func = ovlmem + ENTRY;
+		memcpy(mods[mx].hints,spec[mx].hints,OVL_HINTS);
+	}
+}
+
+/*********************************************************************
+ * Call module mx, running nested (if not -1) in the middle
+ *********************************************************************/
+
+static void
+call(unsigned mx,int nested) {
+	const struct s_ovl_module *m = &mods[mx];
+	uint8_t *f = ovl_lookup(&ovl,m->start);
+
+	if ( !f ) {
+		fail("lookup",mx);
+		return;
+	}
+	if ( m->region < 0 || f != ovl.region[m->region].mem + ENTRY
+	  || memcmp(ovl.region[m->region].mem,image(mx),m->size) != 0 ) {
+		fail("module not loaded",mx);
+		return;
+	}
+
+	w25m_now += spec[mx].cpu_us * US / 2;
+	if ( nested >= 0 )
+		call(nested,-1);
+	w25m_now += spec[mx].cpu_us * US / 2;
+
+	if ( f != ovl.region[m->region].mem + ENTRY
+	  || memcmp(ovl.region[m->region].mem,image(mx),m->size) != 0 )
+		fail("replaced while running",mx);
+	ovl_done(&ovl,m->start);
+}
+
+/*********************************************************************
+ * Run the application loop with nregions, and report
+ *********************************************************************/
+
+static uint64_t
+run(const char *what,unsigned nregions,bool prefetch) {
+	struct s_ovl_stats sum;
+	uint64_t t0, wait_ns;
+	unsigned r;
+
+	if ( !ovl_init(&ovl,SPI1,ovlmem,nregions,REGION,mods,NMODS) ) {
+		puts("FAIL: ovl_init()");
+		exit(1);
+	}
+	ovl.noprefetch = !prefetch;
+	srand(1);
+	t0 = w25m_now;
+
+	for ( unsigned lx = 0; lx < LOOPS; ++lx ) {
+		call(MENU,-1);
+		call(PARSE,-1);
+		r = rand() % 10;
+		call(r < 5 ? CMD_A : r < 8 ? CMD_B : CMD_C,FORMAT);
+		call(DISPLAY,-1);
+		if ( rand() % 8 == 0 )
+			call(LOG,-1);
+		if ( rand() % 40 == 0 )
+			call(CONFIG,-1);
+		if ( rand() % 90 == 0 )
+			call(SELFTEST,-1);
+	}
+	ovl_sync(&ovl);
+
+	memset(&sum,0,sizeof sum);
+	for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+		const struct s_ovl_stats *st = &mods[mx].stats;
+
+		sum.calls += st->calls;
+		sum.hits += st->hits;
+		sum.loads += st->loads;
+		sum.prefetches += st->prefetches;
+		sum.prefetch_hits += st->prefetch_hits;
+		sum.waits += st->waits;
+		sum.wait_cycles += st->wait_cycles;
+	}
+	wait_ns = sum.wait_cycles * 1000ull / 72;
+	printf("%-11s %6u calls, %5.1f%% hits, %5u loads, %5u prefetched (%u used, %u waited)\n"
+		"            waited %7.1f ms (%5.1f us/call), run %7.1f ms\n",
+		what,sum.calls,sum.hits * 100.0 / sum.calls,sum.loads,
+		sum.prefetches,sum.prefetch_hits,sum.waits,
+		wait_ns / 1e6,wait_ns / 1e3 / sum.calls,(w25m_now - t0) / 1e6);
+	return wait_ns;
+}
+
+static void
+report(void) {
+
+	puts("  module    size  calls   hits  loads  pref  used  evict  wait us  max us");
+	for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+		const struct s_ovl_stats *st = &mods[mx].stats;
+
+		printf("  %-8s %5u %6u %6u %6u %5u %5u %6u %8.1f %7.1f\n",
+			mods[mx].name,mods[mx].size,st->calls,st->hits,st->loads,
+			st->prefetches,st->prefetch_hits,st->evictions,
+			st->wait_cycles / 72.0,st->max_cycles / 72.0);
+	}
+}
+
+/*********************************************************************
+ * Lookups by address, and nesting deeper than the regions
+ *********************************************************************/
+
+static void
+lookups(void) {
+	void *f;
+
+	if ( !ovl_init(&ovl,SPI1,ovlmem,4,REGION,mods,NMODS) ) {
+		puts("FAIL: ovl_init()");
+		exit(1);
+	}
+	for ( unsigned mx = 0; mx < NMODS; ++mx ) {
+		if ( !(f = ovl_lookup(&ovl,mods[mx].start)) || f != ovl.region[mods[mx].region].mem + ENTRY )
+			fail("hash lookup",mx);
+		ovl_done(&ovl,mods[mx].start);
+	}
+	if ( ovl_lookup(&ovl,(const void *)(uintptr_t)0x123456) )
+		fail("unknown address found",0);
+	ovl_sync(&ovl);
+
+	// One region: a module calling another cannot be replaced
+	ovl_init(&ovl,SPI1,ovlmem,1,REGION,mods,NMODS);
+	if ( !ovl_lookup(&ovl,mods[MENU].start) || ovl_lookup(&ovl,mods[PARSE].start) )
+		fail("busy module replaced",MENU);
+	ovl_done(&ovl,mods[MENU].start);
+	if ( !ovl_lookup(&ovl,mods[PARSE].start) )
+		fail("lookup after ovl_done()",PARSE);
+	ovl_done(&ovl,mods[PARSE].start);
+
+	// A module larger than a region is refused
+	if ( ovl_init(&ovl,SPI1,ovlmem,4,256,mods,NMODS) )
+		fail("ovl_init() took a module over the region size",PARSE);
+}
+
+static int
+tests(void) {
+	uint64_t lru, pref;
+
+	make_modules();
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_4);
+	w25_dma_init(SPI1);
+
+	lookups();
+	printf("%u modules, %u loops, SPI1 /4, %u byte regions\n",NMODS,LOOPS,REGION);
+	run("2 regions",2,false);
+	lru = run("4 regions",4,false);
+	run("6 regions",6,false);
+	pref = run("4+prefetch",4,true);
+	run("6+prefetch",6,true);
+	report();
+
+	if ( pref * 2 > lru )
+		puts("FAIL: prefetch did not halve the time waited");
+	if ( failures || pref * 2 > lru || w25m_errs.busy_cmds )
+		return 1;
+	puts("PASS");
+	return 0;
+}
+
+int
+main(void) {
+	return w25sim_run(tests);
+}
+
+// End ovltest.c
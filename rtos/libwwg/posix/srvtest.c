@@ -0,0 +1,288 @@
+/* srvtest.c : Exercise ../src/w25srv.c against the W25Qxx model,
+ *	       with several clients sharing the flash
+ * Warren W. Gay VE3WWG
+ *
+ * Three clients run for RUN_MS of simulated time:
+ *
+ *	overlay	 every 5 ms, loads a 2K module as 8 page reads
+ *		 queued at once (interactive)
+ *	monitor	 every 3 ms, reads 16 bytes (interactive)
+ *	logger	 every 8 ms, programs the next log page (bulk),
+ *		 erasing two sectors ahead as it enters one (bulk),
+ *		 and reads each page back (interactive)
+ *
+ * Requests complete by callback, which checks the data. The server
+ * is run between client submits, as its task would be. The logger's
+ * read back is queued with its program, so it checks a read never
+ * passes the write or erase it overlaps.
+ *
+ * This is run with the server in FIFO mode (arrival order, no
+ * merging, erases waited out: as if each client called w25_*() in
+ * turn), and then normally, and the latencies are reported. Exits
+ * non-zero on bad data, chip misuse, or if the normal run's worst
+ * module load exceeds its bound.
+ *
+ * Usage: srvtest
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "w25srv.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+#define MS		1000000ull
+#define RUN_MS		2000
+#define BOUND_NS	(3 * MS)	// Worst module load, normal run
+
+#define OVL_BASE	0x000000	// Modules: 64 x 4K, read only
+#define OVL_PAGES	8		// 2K loaded per module
+#define LOG_BASE	0x200000
+#define LOG_SLOTS	16		// Log pages in flight
+
+struct s_lat {
+	uint64_t	total, worst;
+	unsigned	count;
+};
+
+struct s_slot {
+	struct s_w25req	write, read;
+	uint8_t		wbuf[256], rbuf[256];
+	unsigned	pending;	// Requests not done
+	uint64_t	t0;		// Program submitted
+};
+
+static struct s_w25srv srv;
+static struct s_w25req ovl_req[OVL_PAGES], mon_req;
+static uint8_t ovl_buf[OVL_PAGES * 256], mon_buf[16];
+static struct s_slot slots[LOG_SLOTS];
+static struct s_w25req erases[4];	// By sector, in flight
+static unsigned ovl_pending;
+static uint64_t ovl_t0, mon_t0;
+static struct s_lat lat_ovl, lat_mon, lat_log;
+static unsigned failures, overruns;
+
+static uint8_t
+pattern(uint32_t addr) {
+	return addr * 7 ^ addr >> 11;
+}
+
+static void
+fail(const char *what,uint32_t addr) {
+
+	if ( failures++ < 10 )
+		printf("FAIL: %s (0x%06X)\n",what,(unsigned)addr);
+}
+
+static void
+sample(struct s_lat *l,uint64_t t0) {
+	uint64_t ns = w25m_now - t0;
+
+	l->total += ns;
+	l->count++;
+	if ( ns > l->worst )
+		l->worst = ns;
+}
+
+/*********************************************************************
+ * Completion callbacks (run by w25srv_service())
+ *********************************************************************/
+
+static void
+ovl_done(struct s_w25req *req) {
+	const uint8_t *p = (const uint8_t *)req->buf;
+
+	if ( req->status != 0 )
+		fail("overlay read status",req->addr);
+	for ( uint32_t ux = 0; ux < req->bytes; ++ux )
+		if ( p[ux] != pattern(req->addr + ux) ) {
+			fail("overlay data",req->addr + ux);
+			break;
+		}
+	if ( --ovl_pending == 0 )
+		sample(&lat_ovl,ovl_t0);
+}
+
+static void
+mon_done(struct s_w25req *req) {
+
+	if ( req->status != 0 || memcmp(mon_buf,w25m_memory() + req->addr,sizeof mon_buf) != 0 )
+		fail("monitor read",req->addr);
+	sample(&lat_mon,mon_t0);
+}
+
+static void
+log_done(struct s_w25req *req) {
+	struct s_slot *s = (struct s_slot *)req->arg;
+
+	if ( req->status != 0 )
+		fail("log request status",req->addr);
+	if ( req == &s->read && memcmp(s->rbuf,s->wbuf,256) != 0 )
+		fail("log read back (read passed its write?)",req->addr);
+	if ( req == &s->write )
+		sample(&lat_log,s->t0);
+	--s->pending;
+}
+
+static void
+erase_done(struct s_w25req *req) {
+
+	if ( req->status != 0 || w25m_memory()[req->addr] != 0xFF )
+		fail("log erase",req->addr);
+}
+
+/*********************************************************************
+ * Clients: submit whatever is due at this tick
+ *********************************************************************/
+
+static void
+submit(struct s_w25req *req,uint8_t op,bool bulk,uint32_t addr,void *buf,uint32_t bytes,
+  void (*done)(struct s_w25req *),void *arg) {
+
+	req->op = op;
+	req->bulk = bulk;
+	req->addr = addr;
+	req->buf = buf;
+	req->bytes = bytes;
+	req->done = done;
+	req->arg = arg;
+	w25srv_submit(&srv,req);
+}
+
+static void
+clients(unsigned ms,unsigned *seed,uint32_t *logpg) {
+	uint32_t addr;
+
+	if ( ms % 5 == 0 && ovl_pending == 0 ) {
+		*seed = *seed * 1103515245 + 12345;
+		addr = OVL_BASE + (*seed >> 16) % 64 * 4096;
+		ovl_t0 = w25m_now;
+		ovl_pending = OVL_PAGES;
+		for ( unsigned ux = 0; ux < OVL_PAGES; ++ux )	// Read-ahead
+			submit(&ovl_req[ux],W25SRV_READ,false,addr + ux * 256,
+				ovl_buf + ux * 256,256,ovl_done,0);
+	}
+
+	if ( ms % 3 == 1 && mon_req.status != W25SRV_QUEUED ) {
+		*seed = *seed * 1103515245 + 12345;
+		mon_t0 = w25m_now;
+		submit(&mon_req,W25SRV_READ,false,(*seed >> 8) % 0x80000,mon_buf,
+			sizeof mon_buf,mon_done,0);
+	}
+
+	if ( ms % 8 == 2 ) {
+		struct s_slot *s = &slots[*logpg % LOG_SLOTS];
+		struct s_w25req *e = &erases[*logpg / 16 % 4];
+
+		addr = LOG_BASE + *logpg * 256;
+		if ( s->pending || (addr % 4096 == 0 && e->status == W25SRV_QUEUED) ) {
+			++overruns;			// Logger fell behind
+			return;
+		}
+		for ( unsigned ux = 0; ux < 256; ++ux )
+			s->wbuf[ux] = *logpg * 5 + ux;
+		s->t0 = w25m_now;
+		if ( addr % 4096 == 0 ) {		// Erase two sectors ahead
+			submit(e,W25SRV_ERASE,true,addr + 8192,0,0,erase_done,0);
+		}
+		s->pending += 2;
+		submit(&s->write,W25SRV_WRITE,true,addr,s->wbuf,256,log_done,s);
+		submit(&s->read,W25SRV_READ,false,addr,s->rbuf,256,log_done,s);
+		++*logpg;
+	}
+}
+
+static void
+report(const char *name,const struct s_lat *l) {
+	printf("           %-8s %5u, latency mean %7.3f ms, worst %7.3f ms\n",
+		name,l->count,l->count ? l->total / 1e6 / l->count : 0.0,l->worst / 1e6);
+}
+
+/*********************************************************************
+ * Run the clients for RUN_MS, with the server between submits
+ *********************************************************************/
+
+static void
+run(bool fifo) {
+	struct s_w25srv_stats st;
+	unsigned seed = 1, busy;
+	uint32_t logpg = 0;
+
+	w25m_init(W25Q32_ID);
+	for ( uint32_t ux = 0; ux < 0x80000; ++ux )
+		w25m_memory()[ux] = pattern(ux);
+	memset(w25m_memory() + LOG_BASE + 8192,0x00,0x10000);	// Dirty after sector 1
+	w25m_now = 0;
+
+	w25srv_init(&srv,SPI1);
+	srv.fifo = fifo;
+	memset(&lat_ovl,0,sizeof lat_ovl);
+	memset(&lat_mon,0,sizeof lat_mon);
+	memset(&lat_log,0,sizeof lat_log);
+	memset(slots,0,sizeof slots);
+	memset(erases,0,sizeof erases);
+	ovl_pending = 0;
+	overruns = 0;
+
+	for ( unsigned ms = 0; ms < RUN_MS; ) {
+		for ( ; ms <= w25m_now / MS && ms < RUN_MS; ++ms )
+			clients(ms,&seed,&logpg);	// Ticks passed while serving
+		while ( w25srv_service(&srv) && w25m_now < ms * MS )
+			;
+		if ( w25m_now < ms * MS )
+			vTaskDelay(1);			// Server sleeps
+	}
+	do	{					// Drain the queues
+		while ( w25srv_service(&srv) )
+			;
+		busy = ovl_pending + (mon_req.status == W25SRV_QUEUED);
+		for ( unsigned ux = 0; ux < LOG_SLOTS; ++ux )
+			busy += slots[ux].pending;
+		for ( unsigned ux = 0; ux < 4; ++ux )
+			busy += erases[ux].status == W25SRV_QUEUED;
+		if ( busy )
+			vTaskDelay(1);
+	} while ( busy );
+
+	w25srv_stats(&srv,&st,false);
+	printf("%-10s %u requests, %u read commands, %u reads merged, %u suspends, %u log overruns\n",
+		fifo ? "fifo:" : "server:",(unsigned)st.requests,(unsigned)st.reads,
+		(unsigned)st.merged,(unsigned)st.suspends,overruns);
+	report("modules",&lat_ovl);
+	report("monitor",&lat_mon);
+	report("log page",&lat_log);
+
+	if ( w25m_errs.overwrites || w25m_errs.busy_cmds
+	  || w25m_errs.suspended_reads || w25m_errs.bad_suspends )
+		fail("flash misused",0);
+	if ( !fifo && (lat_ovl.worst > BOUND_NS || overruns) )
+		fail("module load latency over bound, or log overrun",0);
+}
+
+static int
+tests(void) {
+
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_4);
+	w25_dma_init(SPI1);
+
+	run(true);
+	run(false);
+	if ( failures )
+		return 1;
+	puts("PASS");
+	return 0;
+}
+
+int
+main(void) {
+	return w25sim_run(tests);	// w25srv.c keeps its read list on the stack
+}
+
+// End srvtest.c
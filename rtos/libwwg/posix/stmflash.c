@@ -0,0 +1,199 @@
+/* stmflash.c : Model of the STM32F103 internal flash and CRC unit
+ * Warren W. Gay VE3WWG
+ *
+ * The flash is mapped at its MCU address (0x08000000, free in a
+ * -no-pie program), so ../src/bootctl.c reads it through pointers
+ * as on the MCU, and changes it only through the flash_*() calls
+ * modelled here: a page erase sets it to 0xFF, and a half-word may
+ * only be programmed when erased (else PGERR, as on the chip).
+ * Each erase and program advances stmf_now by stmf_timing.
+ *
+ * stmf_powerfail() cuts the power part way through a later erase
+ * or program: an erase leaves part of the page unchanged, and a
+ * program leaves some bits of the half-word unprogrammed. Then the
+ * cut() callback is made (which must not return).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/f1/bkp.h>
+#include <libopencm3/cm3/scb.h>
+
+#include "stmflash.h"
+
+unsigned long stmf_programs = 0;
+unsigned long stmf_erases = 0;
+unsigned long stmf_resets = 0;
+uint64_t stmf_now = 0;
+struct s_stmf_timing stmf_timing = { 52500, 40000000 };	// tPROG typ, tERASE max
+struct s_stmf_errs stmf_errs;
+volatile uint16_t sim_bkp_dr1 = 0;
+
+static uint8_t *mem = 0;
+static bool locked = true;
+static uint32_t sr = 0;
+static uint32_t crc_dr = 0xFFFFFFFF;
+static unsigned long pf_ops = 0;
+static void (*pf_cut)(void) = 0;
+
+/*********************************************************************
+ * Map the flash (erased) at its MCU address
+ *********************************************************************/
+
+void
+stmf_init(void) {
+
+	if ( !mem ) {
+		mem = mmap((void *)STMF_BASE,STMF_SIZE,PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED_NOREPLACE,-1,0);
+		if ( mem != (uint8_t *)STMF_BASE ) {
+			perror("stmflash: mmap(0x08000000)");
+			exit(2);
+		}
+	}
+	memset(mem,0xFF,STMF_SIZE);
+	locked = true;
+	sr = 0;
+	stmf_programs = stmf_erases = 0;
+	pf_ops = 0;
+}
+
+void
+stmf_powerfail(unsigned long ops,void (*cut)(void)) {
+
+	pf_ops = ops;
+	pf_cut = cut;
+}
+
+/*********************************************************************
+ * Internal: Check an operation may go ahead, and count it toward a
+ * power failure (returns true if the power fails during it)
+ *********************************************************************/
+
+static bool
+stmf_op(uint32_t addr) {
+
+	if ( locked ) {
+		++stmf_errs.locked;
+		sr |= FLASH_SR_WRPRTERR;
+		return false;
+	}
+	if ( addr < STMF_BASE || addr >= STMF_BASE + STMF_SIZE ) {
+		++stmf_errs.bounds;
+		sr |= FLASH_SR_PGERR;
+		return false;
+	}
+	return pf_ops > 0 && --pf_ops == 0;
+}
+
+/*********************************************************************
+ * libopencm3 flash API
+ *********************************************************************/
+
+void
+flash_unlock(void) {
+	locked = false;
+}
+
+void
+flash_lock(void) {
+	locked = true;
+}
+
+uint32_t
+flash_get_status_flags(void) {
+	return sr;
+}
+
+void
+flash_clear_status_flags(void) {
+	sr = 0;
+}
+
+void
+flash_erase_page(uint32_t page_address) {
+	uint32_t ax = (page_address - STMF_BASE) & ~(STMF_PAGE - 1);
+
+	if ( locked || page_address < STMF_BASE || page_address >= STMF_BASE + STMF_SIZE ) {
+		stmf_op(page_address);
+		return;
+	}
+	if ( stmf_op(page_address) ) {
+		memset(mem + ax,0xFF,rand() % STMF_PAGE);	// Cut short
+		pf_cut();
+	}
+	memset(mem + ax,0xFF,STMF_PAGE);
+	stmf_now += stmf_timing.terase;
+	++stmf_erases;
+	sr |= FLASH_SR_EOP;
+}
+
+void
+flash_program_half_word(uint32_t address,uint16_t data) {
+	uint32_t ax = address - STMF_BASE;
+	uint16_t *hp = (uint16_t *)(mem + (ax & ~1u));
+	bool cut;
+
+	if ( locked || address < STMF_BASE || address >= STMF_BASE + STMF_SIZE ) {
+		stmf_op(address);
+		return;
+	}
+	if ( *hp != 0xFFFF && data != 0x0000 ) {
+		++stmf_errs.overwrites;		// Not erased: PGERR
+		sr |= FLASH_SR_PGERR;
+		return;
+	}
+	cut = stmf_op(address);
+	if ( cut ) {
+		*hp &= data | rand();		// Some bits programmed
+		pf_cut();
+	}
+	*hp &= data;
+	stmf_now += stmf_timing.tprog;
+	++stmf_programs;
+	sr |= FLASH_SR_EOP;
+}
+
+/*********************************************************************
+ * CRC unit: CRC-32 (poly 0x04C11DB7, MSB first) over whole words
+ *********************************************************************/
+
+uint32_t
+stmf_crc(const void *data,uint32_t words) {
+
+	crc_reset();
+	return crc_calculate_block((uint32_t *)data,words);
+}
+
+void
+crc_reset(void) {
+	crc_dr = 0xFFFFFFFF;
+}
+
+uint32_t
+crc_calculate(uint32_t data) {
+
+	crc_dr ^= data;
+	for ( unsigned bx = 0; bx < 32; ++bx )
+		crc_dr = crc_dr & 0x80000000 ? crc_dr << 1 ^ 0x04C11DB7 : crc_dr << 1;
+	return crc_dr;
+}
+
+uint32_t
+crc_calculate_block(uint32_t *datap,int size) {
+
+	for ( int ix = 0; ix < size; ++ix )
+		crc_calculate(datap[ix]);
+	return crc_dr;
+}
+
+void
+scb_reset_system(void) {
+	++stmf_resets;
+}
+
+// End stmflash.c
@@ -0,0 +1,39 @@
+/* stmflash.h : Model of the STM32F103 internal flash and CRC unit
+ * Warren W. Gay VE3WWG
+ */
+#ifndef STMFLASH_H
+#define STMFLASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STMF_BASE	0x08000000u
+#define STMF_SIZE	(128u*1024u)
+#define STMF_PAGE	1024u
+
+struct s_stmf_timing {			// Busy times, nanoseconds
+	uint32_t	tprog;		// Half-word program
+	uint32_t	terase;		// Page erase
+};
+
+struct s_stmf_errs {			// Misuse of the flash
+	unsigned long	locked;		// Erase/program while locked
+	unsigned long	overwrites;	// Programs of unerased half-words
+	unsigned long	bounds;		// Addresses outside the flash
+};
+
+void stmf_init(void);
+void stmf_powerfail(unsigned long ops,void (*cut)(void));
+
+extern unsigned long stmf_programs;	// Half-words programmed
+extern unsigned long stmf_erases;	// Pages erased
+extern unsigned long stmf_resets;	// scb_reset_system() calls
+extern uint64_t stmf_now;		// Simulated time (ns)
+extern struct s_stmf_timing stmf_timing;
+extern struct s_stmf_errs stmf_errs;
+
+uint32_t stmf_crc(const void *data,uint32_t words);
+
+#endif // STMFLASH_H
+
+// End stmflash.h
@@ -0,0 +1,157 @@
+/* w25bench.c : Flash throughput of ../src/winbond.c, in simulated time
+ * Warren W. Gay VE3WWG
+ *
+ * Times reads, page programs and erases through the real driver,
+ * using the model's clock (SPI byte times, busy times, the DWT cycle
+ * counter and the 1 ms tick), and checks each result against the model's memory. Exits
+ * non-zero if data is wrong, if the driver sent commands the chip
+ * would ignore, or if a rate falls below its floor (for CI).
+ *
+ * Usage: w25bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+#define BENCH_BYTES	65536
+
+static uint8_t buf[BENCH_BYTES];	// Static: DMA needs a 32-bit address
+static unsigned failures = 0;
+
+static const struct {
+	const char	*name;
+	uint32_t	br;
+	uint32_t	min_dma_pct;	// DMA read floor, % of wire speed
+} rates[] = {
+	{ "/4",	  SPI_CR1_BAUDRATE_FPCLK_DIV_4,   90 },
+	{ "/16",  SPI_CR1_BAUDRATE_FPCLK_DIV_16,  95 },
+	{ "/256", SPI_CR1_BAUDRATE_FPCLK_DIV_256, 95 }
+};
+
+#define NRATES	(sizeof rates / sizeof rates[0])
+
+static double
+kbs(uint32_t bytes,uint64_t ns) {
+	return ns ? bytes * 1e9 / 1024.0 / ns : 0.0;
+}
+
+static void
+check(bool ok,const char *what) {
+
+	if ( !ok ) {
+		printf("FAIL: %s\n",what);
+		++failures;
+	}
+}
+
+/*********************************************************************
+ * Read BENCH_BYTES, return ns taken
+ *********************************************************************/
+
+static uint64_t
+time_read(uint32_t addr) {
+	uint64_t t0 = w25m_now;
+
+	memset(buf,0,sizeof buf);
+	w25_read_data(SPI1,addr,buf,BENCH_BYTES);
+	check(memcmp(buf,w25m_memory() + addr,BENCH_BYTES) == 0,"read data");
+	return w25m_now - t0;
+}
+
+/*********************************************************************
+ * Erase and program BENCH_BYTES, return ns for the program
+ *********************************************************************/
+
+static uint64_t
+time_program(uint32_t addr) {
+	uint64_t t0;
+
+	for ( uint32_t ux = 0; ux < BENCH_BYTES; ++ux )
+		buf[ux] = ux * 29 + (ux >> 9);
+	w25_write_en(SPI1,true);
+	w25_erase_block(SPI1,addr,W25_CMD_ERA_64K);
+
+	t0 = w25m_now;
+	w25_write_data(SPI1,addr,buf,BENCH_BYTES);
+	w25_wait(SPI1);
+	check(memcmp(buf,w25m_memory() + addr,BENCH_BYTES) == 0,"program data");
+	return w25m_now - t0;
+}
+
+/*********************************************************************
+ * Erase one block, return ns until the driver returned
+ *********************************************************************/
+
+static uint64_t
+time_erase(uint32_t addr,uint8_t cmd,uint32_t blksiz) {
+	uint64_t t0;
+
+	memset(w25m_memory() + addr,0x00,blksiz);
+	t0 = w25m_now;
+	w25_write_en(SPI1,true);
+	check(w25_erase_block(SPI1,addr,cmd),"erase returned false");
+	check(w25m_memory()[addr] == 0xFF && w25m_memory()[addr + blksiz - 1] == 0xFF,"erase");
+	return w25m_now - t0;
+}
+
+int
+main(void) {
+	uint64_t wire, ns, polled[NRATES];
+	double pct;
+
+	w25m_init(W25Q32_ID);
+	for ( uint32_t ux = 0; ux < w25m_size(); ++ux )
+		w25m_memory()[ux] = ux * 7 ^ ux >> 11;
+
+	// Polled first: once w25_dma_init() is called, large reads use DMA
+	for ( unsigned rx = 0; rx < NRATES; ++rx ) {
+		w25_spi_setup(SPI1,true,true,true,rates[rx].br);
+		polled[rx] = time_read(0x010000);
+	}
+	w25_dma_init(SPI1);
+
+	puts("READ 64K       wire KB/s   spi_xfer KB/s        DMA KB/s");
+	for ( unsigned rx = 0; rx < NRATES; ++rx ) {
+		w25_spi_setup(SPI1,true,true,true,rates[rx].br);
+		wire = (uint64_t)8000 * (2u << (rates[rx].br >> 3)) / 72 * BENCH_BYTES;
+		ns = time_read(0x010000);
+		pct = 100.0 * wire / ns;
+		printf("  SPI1 %-5s %12.1f %9.1f (%3.0f%%) %9.1f (%3.0f%%)\n",
+			rates[rx].name,kbs(BENCH_BYTES,wire),
+			kbs(BENCH_BYTES,polled[rx]),100.0 * wire / polled[rx],
+			kbs(BENCH_BYTES,ns),pct);
+		check(pct >= rates[rx].min_dma_pct,"DMA read below floor");
+	}
+
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_4);
+	ns = time_program(0x100000);
+	printf("PROGRAM 64K  %7.1f KB/s (DMA, SPI1 /4, tPP %u us)\n",
+		kbs(BENCH_BYTES,ns),(unsigned)w25m_timing.tpp);
+	check(kbs(BENCH_BYTES,ns) >= 290.0,"program below 290 KB/s");
+
+	ns = time_erase(0x200000,W25_CMD_ERA_SECTOR,4096);
+	printf("ERASE  4K %8.1f ms (tSE   %6.1f ms)\n",ns / 1e6,w25m_timing.tse / 1e3);
+	check(ns < (w25m_timing.tse + 2000) * 1000ull,"4K erase too slow");
+	ns = time_erase(0x210000,W25_CMD_ERA_32K,32768);
+	printf("ERASE 32K %8.1f ms (tBE1  %6.1f ms)\n",ns / 1e6,w25m_timing.tbe32 / 1e3);
+	ns = time_erase(0x220000,W25_CMD_ERA_64K,65536);
+	printf("ERASE 64K %8.1f ms (tBE2  %6.1f ms)\n",ns / 1e6,w25m_timing.tbe64 / 1e3);
+
+	check(w25m_errs.overwrites == 0,"program over unerased bits");
+	check(w25m_errs.busy_cmds == 0,"command sent while busy");
+	check(w25m_errs.suspended_reads == 0 && w25m_errs.bad_suspends == 0,"suspend misuse");
+
+	if ( failures )
+		return 1;
+	puts("PASS");
+	return 0;
+}
+
+// End w25bench.c
@@ -0,0 +1,383 @@
+/* w25model.c : Byte level model of a Winbond W25Qxx SPI flash
+ * Warren W. Gay VE3WWG
+ *
+ * Erased flash reads 0xFF, and page program can only clear bits,
+ * wrapping within the 256 byte page, as on the real chip. Program
+ * and erase take effect when /CS goes high, and need WEL set.
+ *
+ * w25m_powerfail() cuts the power part way through a later program
+ * or erase: only some of its bytes (and bits of one byte) change,
+ * and then the cut() callback is made (which must not return).
+ *
+ * Timing: program, erase and status register writes keep BUSY set
+ * for w25m_timing's time, measured on the w25m_now clock that
+ * w25sim.c advances as the SPI runs and the task sleeps. Commands
+ * sent while busy are ignored (only SR reads and suspend are heard),
+ * as on the chip, and counted in w25m_errs, as are programs that
+ * would need an erase first. Erase/program suspend (0x75) and resume
+ * (0x7A) follow the datasheet, with SR2 SUS set while suspended.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "winbond.h"
+#include "w25model.h"
+
+static uint8_t *mem = 0;		// Flash contents
+static uint32_t size = 0;		// Bytes
+static uint32_t jedec = 0;		// Manuf, type, capacity
+
+static bool selected = false;
+static bool powered = true;
+static bool ignored = false;		// Command refused while busy
+static uint8_t sr1 = 0, sr2 = 0;
+static uint8_t sr_new[2];		// Write status register data
+static uint8_t cmd;			// Command byte of this select
+static uint32_t count;			// Bytes since select
+static uint32_t addr;			// Address being read/programmed
+static uint8_t page[256];		// Page program data
+static uint32_t plen;			// Bytes in page[]
+
+unsigned long w25m_cmds[256];
+unsigned long w25m_ops = 0;
+
+uint64_t w25m_now = 0;			// Simulated time, ns
+struct s_w25m_timing w25m_timing = {	// W25Q32 typical, microseconds
+	700, 45000, 120000, 150000, 10000000, 10000, 20
+};
+struct s_w25m_errs w25m_errs;
+
+static struct {
+	uint64_t	until;		// BUSY until this time
+	uint8_t		cmd;		// Operation keeping it busy
+	uint32_t	addr;		// Region it affects
+	uint32_t	size;
+} busy;
+
+static struct {
+	bool		on;		// SR2 SUS
+	uint64_t	left;		// ns of the operation left to run
+	uint8_t		cmd;		// Operation suspended
+	uint32_t	addr;		// Its region
+	uint32_t	size;
+	bool		noted;		// Read of region counted, this select
+} susp;
+
+static unsigned long pf_ops = 0;	// Ops until power fails, else 0
+static void (*pf_cut)(void) = 0;
+
+static const uint8_t uid[8] = { 0xD2, 0x63, 0x08, 0x73, 0x2F, 0x1A, 0x45, 0x28 };
+
+/*********************************************************************
+ * Create the chip from its JEDEC ID (capacity is 2^(id & 0xFF))
+ *********************************************************************/
+
+void
+w25m_init(uint32_t jedec_id) {
+
+	jedec = jedec_id;
+	size = 1u << (jedec_id & 0xFF);
+	free(mem);
+	mem = malloc(size);
+	memset(mem,0xFF,size);
+	w25m_reset();
+	memset(&w25m_errs,0,sizeof w25m_errs);
+}
+
+/*********************************************************************
+ * Power cycle: memory is kept, all else is reset
+ *********************************************************************/
+
+void
+w25m_reset(void) {
+
+	sr1 = sr2 = 0;
+	powered = true;
+	selected = false;
+	busy.until = 0;
+	susp.on = false;
+}
+
+/*********************************************************************
+ * Fail power during the ops'th program or erase from now
+ *********************************************************************/
+
+void
+w25m_powerfail(unsigned long ops,void (*cut)(void)) {
+
+	pf_ops = ops;
+	pf_cut = cut;
+}
+
+/*********************************************************************
+ * Apply a cut short program (AND) or erase (OR) of n bytes at a
+ *********************************************************************/
+
+static void
+w25m_partial(uint32_t a,const uint8_t *data,uint32_t n,uint32_t wrap) {
+	uint32_t done = rand() % (n + 1);
+
+	for ( uint32_t ux = 0; ux <= done && ux < n; ++ux ) {
+		uint32_t ax = wrap ? (a & ~(wrap - 1)) | ((a + ux) & (wrap - 1)) : a + ux;
+		uint8_t bits = ux < done ? 0xFF : rand();	// Last one partly
+
+		if ( data )
+			mem[ax % size] &= data[ux] | ~bits;
+		else	mem[ax % size] |= bits;
+	}
+}
+
+/*********************************************************************
+ * True while a program, erase or status write is running
+ *********************************************************************/
+
+static bool
+w25m_busy(void) {
+	return w25m_now < busy.until;
+}
+
+static void
+w25m_start(uint8_t op,uint32_t a,uint32_t n,uint32_t us) {
+
+	busy.until = w25m_now + (uint64_t)us * 1000;
+	busy.cmd = op;
+	busy.addr = a;
+	busy.size = n;
+}
+
+static inline bool
+w25m_in(uint32_t a,uint32_t base,uint32_t n) {
+	return a - base < n;
+}
+
+static uint32_t
+w25m_blksiz(uint8_t op) {
+	return op == W25_CMD_ERA_SECTOR ? 4096 : op == W25_CMD_ERA_32K ? 32768 : 65536;
+}
+
+uint8_t *
+w25m_memory(void) {
+	return mem;
+}
+
+uint32_t
+w25m_size(void) {
+	return size;
+}
+
+/*********************************************************************
+ * Complete a command when /CS goes high
+ *********************************************************************/
+
+static void
+w25m_execute(void) {
+	uint32_t blksiz;
+	bool over = false;
+
+	if ( ignored )
+		return;
+
+	if ( susp.on && (cmd == W25_CMD_ERA_SECTOR || cmd == W25_CMD_ERA_32K
+	  || cmd == W25_CMD_ERA_64K || cmd == W25_CMD_CHIP_ERASE || cmd == W25_CMD_WRITE_SR
+	  || (cmd == W25_CMD_WRITE_DATA && (susp.cmd == W25_CMD_WRITE_DATA
+	  || w25m_in(addr % size,susp.addr,susp.size)))) ) {
+		++w25m_errs.bad_suspends;	// Not allowed while suspended
+		return;
+	}
+
+	if ( (cmd == W25_CMD_WRITE_DATA || cmd == W25_CMD_ERA_SECTOR
+	  || cmd == W25_CMD_ERA_32K || cmd == W25_CMD_ERA_64K
+	  || cmd == W25_CMD_CHIP_ERASE) && (sr1 & W25_SR1_WEL) ) {
+		++w25m_ops;
+		if ( pf_ops > 0 && --pf_ops == 0 ) {
+			if ( cmd == W25_CMD_WRITE_DATA )
+				w25m_partial(addr,page,plen,256);
+			else if ( cmd == W25_CMD_CHIP_ERASE )
+				w25m_partial(0,0,size,0);
+			else	{
+				blksiz = w25m_blksiz(cmd);
+				w25m_partial(addr % size & ~(blksiz - 1),0,blksiz,0);
+			}
+			selected = false;
+			pf_cut();		// Does not return
+		}
+	}
+
+	switch ( cmd ) {
+	case W25_CMD_WRITE_EN:
+		sr1 |= W25_SR1_WEL;
+		return;
+	case W25_CMD_WRITE_DI:
+		sr1 &= ~W25_SR1_WEL;
+		return;
+	case W25_CMD_PWR_OFF:
+		powered = false;
+		return;
+	case W25_CMD_WRITE_DATA:
+		if ( !(sr1 & W25_SR1_WEL) || count < 4 )
+			return;
+		for ( uint32_t ux = 0; ux < plen; ++ux ) {
+			uint32_t a = (addr & ~0xFFu) | ((addr + ux) & 0xFFu);
+			if ( page[ux] & ~mem[a % size] )
+				over = true;	// Needs a 0 bit set to 1
+			mem[a % size] &= page[ux];
+		}
+		if ( over )
+			++w25m_errs.overwrites;
+		w25m_start(cmd,addr % size & ~0xFFu,256,w25m_timing.tpp);
+		break;
+	case W25_CMD_ERA_SECTOR:
+	case W25_CMD_ERA_32K:
+	case W25_CMD_ERA_64K:
+		if ( !(sr1 & W25_SR1_WEL) || count != 4 )
+			return;
+		blksiz = w25m_blksiz(cmd);
+		memset(mem + (addr % size & ~(blksiz - 1)),0xFF,blksiz);
+		w25m_start(cmd,addr % size & ~(blksiz - 1),blksiz,
+			cmd == W25_CMD_ERA_SECTOR ? w25m_timing.tse
+			: cmd == W25_CMD_ERA_32K ? w25m_timing.tbe32 : w25m_timing.tbe64);
+		break;
+	case W25_CMD_CHIP_ERASE:
+		if ( !(sr1 & W25_SR1_WEL) )
+			return;
+		memset(mem,0xFF,size);
+		w25m_start(cmd,0,size,w25m_timing.tce);
+		break;
+	case W25_CMD_WRITE_SR:
+		if ( !(sr1 & W25_SR1_WEL) || count < 2 )
+			return;
+		sr1 = (sr1 & 0x03) | (sr_new[0] & 0xFC);
+		if ( count >= 3 )
+			sr2 = (sr2 & W25_SR2_SUS) | (sr_new[1] & 0x7F);
+		w25m_start(cmd,0,0,w25m_timing.tw);
+		break;
+	case W25_CMD_SUSPEND:
+		if ( !w25m_busy() || susp.on || busy.cmd == W25_CMD_CHIP_ERASE
+		  || busy.cmd == W25_CMD_WRITE_SR || busy.cmd == W25_CMD_SUSPEND ) {
+			++w25m_errs.bad_suspends;
+			return;
+		}
+		susp.on = true;
+		susp.left = busy.until - w25m_now;
+		susp.cmd = busy.cmd;
+		susp.addr = busy.addr;
+		susp.size = busy.size;
+		sr2 |= W25_SR2_SUS;
+		w25m_start(cmd,0,0,w25m_timing.tsus);
+		return;
+	case W25_CMD_RESUME:
+		if ( !susp.on ) {
+			++w25m_errs.bad_suspends;
+			return;
+		}
+		susp.on = false;
+		sr2 &= ~W25_SR2_SUS;
+		w25m_start(susp.cmd,susp.addr,susp.size,0);
+		busy.until = w25m_now + susp.left;
+		return;
+	default:
+		return;
+	}
+	sr1 &= ~W25_SR1_WEL;			// Cleared after program/erase
+}
+
+/*********************************************************************
+ * /CS change
+ *********************************************************************/
+
+void
+w25m_select(bool sel) {
+
+	if ( sel && !selected ) {
+		count = 0;
+		addr = 0;
+		plen = 0;
+		ignored = false;
+		susp.noted = false;
+	} else if ( !sel && selected && count > 0 ) {
+		if ( powered )
+			w25m_execute();
+		else if ( cmd == W25_CMD_PWR_ON )
+			powered = true;
+	}
+	selected = sel;
+}
+
+/*********************************************************************
+ * Exchange one byte
+ *********************************************************************/
+
+uint8_t
+w25m_xfer(uint8_t mosi) {
+	uint32_t n = count++;
+
+	if ( !selected )
+		return 0xFF;			// MISO floats (pulled up)
+	if ( n == 0 ) {
+		cmd = mosi;
+		++w25m_cmds[cmd];
+		if ( powered && w25m_busy() && cmd != W25_CMD_READ_SR1
+		  && cmd != W25_CMD_READ_SR2 && cmd != W25_CMD_SUSPEND ) {
+			ignored = true;		// Chip does not listen
+			++w25m_errs.busy_cmds;
+		}
+		return 0xFF;
+	}
+	if ( !powered || ignored )
+		return 0xFF;
+
+	switch ( cmd ) {
+	case W25_CMD_JEDEC_ID:
+		return n <= 3 ? jedec >> (8 * (3 - n)) : 0xFF;
+	case W25_CMD_MANUF_DEVICE:
+		if ( n < 4 )
+			return 0xFF;
+		return (n & 1) == 0 ? jedec >> 16 : (jedec & 0xFF) - 1;
+	case W25_CMD_READ_SR1:
+		return w25m_busy() ? sr1 | W25_SR1_BUSY : sr1;
+	case W25_CMD_READ_SR2:
+		return sr2;
+	case W25_CMD_WRITE_SR:
+		if ( n <= 2 )
+			sr_new[n - 1] = mosi;
+		return 0xFF;
+	case W25_CMD_READ_UID:
+		return n >= 5 && n < 13 ? uid[n - 5] : 0xFF;
+	case W25_CMD_READ_DATA:
+	case W25_CMD_FAST_READ:
+	case W25_CMD_WRITE_DATA:
+	case W25_CMD_ERA_SECTOR:
+	case W25_CMD_ERA_32K:
+	case W25_CMD_ERA_64K:
+		if ( n <= 3 ) {
+			addr = addr << 8 | mosi;
+			return 0xFF;
+		}
+		break;
+	default:
+		return 0xFF;
+	}
+
+	if ( cmd == W25_CMD_FAST_READ && n == 4 )
+		return 0xFF;			// Dummy byte
+	if ( cmd == W25_CMD_READ_DATA || cmd == W25_CMD_FAST_READ ) {
+		if ( susp.on && !susp.noted && w25m_in(addr % size,susp.addr,susp.size) ) {
+			susp.noted = true;	// Data there is not valid yet
+			++w25m_errs.suspended_reads;
+		}
+		return mem[addr++ % size];
+	}
+	if ( cmd == W25_CMD_WRITE_DATA ) {
+		if ( plen < sizeof page )
+			page[plen++] = mosi;
+		else	{
+			// More than a page: the last 256 bytes are kept
+			memmove(page,page + 1,sizeof page - 1);
+			page[sizeof page - 1] = mosi;
+			addr = (addr & ~0xFFu) | ((addr + 1) & 0xFFu);
+		}
+	}
+	return 0xFF;
+}
+
+// End w25model.c
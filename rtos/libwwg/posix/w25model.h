@@ -0,0 +1,47 @@
+/* w25model.h : Byte level model of a Winbond W25Qxx SPI flash
+ * Warren W. Gay VE3WWG
+ *
+ * The model sees the same SPI bytes the chip would: w25m_select()
+ * follows /CS and w25m_xfer() exchanges one byte (MOSI in, MISO out).
+ */
+#ifndef W25MODEL_H
+#define W25MODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct s_w25m_timing {			// Busy times, microseconds
+	uint32_t	tpp;		// Page program
+	uint32_t	tse;		// 4K sector erase
+	uint32_t	tbe32;		// 32K block erase
+	uint32_t	tbe64;		// 64K block erase
+	uint32_t	tce;		// Chip erase
+	uint32_t	tw;		// Write status register
+	uint32_t	tsus;		// Suspend latency
+};
+
+struct s_w25m_errs {			// Misuse of the chip
+	unsigned long	overwrites;	// Programs over unerased bits
+	unsigned long	busy_cmds;	// Commands ignored while busy
+	unsigned long	suspended_reads; // Reads of a suspended region
+	unsigned long	bad_suspends;	// Suspend/resume misuse
+};
+
+void w25m_init(uint32_t jedec_id);
+void w25m_reset(void);
+void w25m_powerfail(unsigned long ops,void (*cut)(void));
+uint8_t *w25m_memory(void);
+uint32_t w25m_size(void);
+
+extern unsigned long w25m_cmds[256];	// Count of each command
+extern unsigned long w25m_ops;		// Programs and erases done
+extern uint64_t w25m_now;		// Simulated time (ns)
+extern struct s_w25m_timing w25m_timing;
+extern struct s_w25m_errs w25m_errs;
+
+void w25m_select(bool selected);
+uint8_t w25m_xfer(uint8_t mosi);
+
+#endif // W25MODEL_H
+
+// End w25model.h
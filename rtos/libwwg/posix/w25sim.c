@@ -0,0 +1,326 @@
+/* w25sim.c : Host SPI/DMA/FreeRTOS stand-ins for the flash routines
+ * Warren W. Gay VE3WWG
+ *
+ * The real ../src/winbond.c is compiled against include/, and its
+ * SPI traffic goes to the model in w25model.c. DMA transfers run
+ * when the task would block (ulTaskNotifyTake() or taskYIELD()),
+ * and then the ISR for the channel is called, as on the MCU.
+ *
+ * Buffers handed to DMA must have 32-bit addresses, so the program
+ * is linked -no-pie, and DMA buffers must be static unless the code
+ * is run by w25sim_run(), on a stack below 4G.
+ *
+ * Time: each byte advances w25m_now by its time on the wire, at the
+ * rate given to spi_init_master() (APB2 72 MHz for SPI1, APB1 36 MHz
+ * for SPI2), plus W25SIM_XFER_NS of CPU time when polled by
+ * spi_xfer(). vTaskDelay() sleeps to a later 1 ms tick.
+ *
+ * A DMA transfer is timed from when its TX channel was enabled, so
+ * CPU time the caller spends (by advancing w25m_now) before it
+ * blocks overlaps the transfer, as it would on the MCU.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/dwt.h>
+
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25SIM_XFER_NS	400		// spi_xfer() call and poll loop
+#define W25SIM_TICK_NS	1000000ull	// configTICK_RATE_HZ 1000
+
+struct s_w25sim_stats w25sim_stats;
+volatile uint32_t sim_spi_dr;
+
+struct s_dmach {
+	uint32_t	maddr;		// Memory address
+	uint16_t	count;		// CNDTR
+	bool		from_mem;	// DIR
+	bool		minc;		// Memory increment
+	bool		enabled;
+	bool		tcie, teie;	// Interrupt enables
+	uint32_t	flags;		// ISR flags
+	uint64_t	t0;		// When enabled (w25m_now)
+};
+
+static struct s_dmach dmach[8];		// DMA1 channels 1..7
+static bool rx_dma[2], tx_dma[2];	// SPIx_CR2 RXDMAEN, TXDMAEN
+static uint32_t notify = 0;		// Task notification count
+static uint32_t byte_ns[2] = { 1000, 1000 };	// SPI byte time
+
+void dma1_channel2_isr(void) __attribute__((weak));
+void dma1_channel3_isr(void) __attribute__((weak));
+void dma1_channel4_isr(void) __attribute__((weak));
+void dma1_channel5_isr(void) __attribute__((weak));
+
+static void (*const isr[8])(void) = {
+	0, 0, dma1_channel2_isr, dma1_channel3_isr,
+	dma1_channel4_isr, dma1_channel5_isr, 0, 0
+};
+
+static inline unsigned
+spix(uint32_t spi) {
+	return spi == SPI1 ? 0 : 1;
+}
+
+/*********************************************************************
+ * SPI: every SPI talks to the one flash model
+ *********************************************************************/
+
+int
+spi_init_master(uint32_t spi,uint32_t br,uint32_t cpol,uint32_t cpha,uint32_t dff,uint32_t lsbfirst) {
+	uint32_t pclk_mhz = spi == SPI1 ? 72 : 36;
+
+	(void)cpol; (void)cpha; (void)dff; (void)lsbfirst;
+	byte_ns[spix(spi)] = 8000u * (2u << (br >> 3)) / pclk_mhz;
+	return 0;
+}
+
+void
+spi_enable(uint32_t spi) {
+	(void)spi;
+	++w25sim_stats.selects;
+	w25m_select(true);
+}
+
+void
+spi_disable(uint32_t spi) {
+	(void)spi;
+	w25m_select(false);
+}
+
+uint16_t
+spi_xfer(uint32_t spi,uint16_t data) {
+	++w25sim_stats.xfers;
+	w25m_now += byte_ns[spix(spi)] + W25SIM_XFER_NS;
+	return w25m_xfer(data);
+}
+
+void spi_enable_rx_dma(uint32_t spi) { rx_dma[spix(spi)] = true; }
+void spi_disable_rx_dma(uint32_t spi) { rx_dma[spix(spi)] = false; }
+void spi_enable_tx_dma(uint32_t spi) { tx_dma[spix(spi)] = true; }
+void spi_disable_tx_dma(uint32_t spi) { tx_dma[spix(spi)] = false; }
+
+/*********************************************************************
+ * DMA1 channel registers
+ *********************************************************************/
+
+void
+dma_channel_reset(uint32_t dma,uint8_t ch) {
+	(void)dma;
+	dmach[ch] = (struct s_dmach){ 0 };
+}
+
+void
+dma_set_peripheral_address(uint32_t dma,uint8_t ch,uint32_t address) {
+	(void)dma; (void)ch; (void)address;	// Always SPI_DR
+}
+
+void dma_set_memory_address(uint32_t dma,uint8_t ch,uint32_t a) { (void)dma; dmach[ch].maddr = a; }
+void dma_set_number_of_data(uint32_t dma,uint8_t ch,uint16_t n) { (void)dma; dmach[ch].count = n; }
+void dma_set_read_from_peripheral(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].from_mem = false; }
+void dma_set_read_from_memory(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].from_mem = true; }
+void dma_enable_memory_increment_mode(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].minc = true; }
+void dma_disable_memory_increment_mode(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].minc = false; }
+void dma_enable_transfer_complete_interrupt(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].tcie = true; }
+void dma_enable_transfer_error_interrupt(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].teie = true; }
+void dma_enable_channel(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].enabled = true; dmach[ch].t0 = w25m_now; }
+void dma_disable_channel(uint32_t dma,uint8_t ch) { (void)dma; dmach[ch].enabled = false; }
+
+bool
+dma_get_interrupt_flag(uint32_t dma,uint8_t ch,uint32_t interrupts) {
+	(void)dma;
+	return (dmach[ch].flags & interrupts) != 0;
+}
+
+void
+dma_clear_interrupt_flags(uint32_t dma,uint8_t ch,uint32_t interrupts) {
+	(void)dma;
+	dmach[ch].flags &= ~interrupts;
+}
+
+/*********************************************************************
+ * Run pending SPI DMA transfers to completion, calling the ISRs
+ *
+ * A transfer is paced by TX: each byte sent by the TX channel is
+ * exchanged with the model, and the reply is stored by the RX
+ * channel if it is armed.
+ *********************************************************************/
+
+void
+w25sim_run_dma(void) {
+	bool again = true;
+
+	while ( again ) {
+		again = false;
+		for ( unsigned sx = 0; sx < 2; ++sx ) {
+			struct s_dmach *rx = &dmach[sx == 0 ? 2 : 4];
+			struct s_dmach *tx = &dmach[sx == 0 ? 3 : 5];
+			bool rx_on = rx_dma[sx] && rx->enabled && rx->count > 0;
+			uint8_t miso;
+
+			if ( !tx_dma[sx] || !tx->enabled || tx->count == 0 )
+				continue;
+
+			while ( tx->count > 0 ) {
+				tx->t0 += byte_ns[sx];	// On the wire while the CPU ran
+				if ( w25m_now < tx->t0 )
+					w25m_now = tx->t0;
+				miso = w25m_xfer(*(uint8_t *)(uintptr_t)tx->maddr);
+				if ( tx->minc )
+					++tx->maddr;
+				--tx->count;
+				if ( rx_on && rx->count > 0 ) {
+					*(uint8_t *)(uintptr_t)rx->maddr = miso;
+					if ( rx->minc )
+						++rx->maddr;
+					--rx->count;
+				}
+				++w25sim_stats.dma_bytes;
+			}
+			tx->flags |= DMA_GIF|DMA_TCIF;
+			if ( rx_on && rx->count == 0 )
+				rx->flags |= DMA_GIF|DMA_TCIF;
+
+			for ( unsigned ch = 2 + sx * 2; ch <= 3 + sx * 2; ++ch ) {
+				if ( dmach[ch].tcie && (dmach[ch].flags & DMA_TCIF) ) {
+					if ( !isr[ch] ) {
+						fprintf(stderr,"w25sim: no ISR for DMA1 channel %u\n",ch);
+						exit(2);
+					}
+					++w25sim_stats.dma_irqs;
+					isr[ch]();
+				}
+			}
+			again = true;		// ISR may have re-armed
+		}
+	}
+}
+
+/*********************************************************************
+ * DWT cycle counter: simulated time at 72 MHz, frozen at 0 until
+ * enabled (as after reset)
+ *********************************************************************/
+
+static bool dwt_on = false;
+
+bool
+dwt_enable_cycle_counter(void) {
+	dwt_on = true;
+	return true;
+}
+
+uint32_t
+dwt_read_cycle_counter(void) {
+	return dwt_on ? w25m_now * 72 / 1000 : 0;
+}
+
+/*********************************************************************
+ * Spend CPU cycles (72 MHz) that the host code does not take itself
+ *********************************************************************/
+
+void
+w25sim_cpu(uint32_t cycles) {
+	w25m_now += cycles * 1000ull / 72;
+}
+
+/*********************************************************************
+ * Run fn() on a stack with 32-bit addresses, so that buffers on the
+ * stack can be given to DMA, as on the MCU
+ *********************************************************************/
+
+#define W25SIM_STACK	(1024*1024)
+
+static ucontext_t ctx_main, ctx_run;
+static int (*run_fn)(void);
+static int run_rc;
+
+static void
+w25sim_trampoline(void) {
+	run_rc = run_fn();
+}
+
+int
+w25sim_run(int (*fn)(void)) {
+	void *stack = mmap(0,W25SIM_STACK,PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS|MAP_32BIT,-1,0);
+
+	if ( stack == MAP_FAILED ) {
+		perror("w25sim: mmap(MAP_32BIT)");
+		exit(2);
+	}
+	run_fn = fn;
+	getcontext(&ctx_run);
+	ctx_run.uc_stack.ss_sp = stack;
+	ctx_run.uc_stack.ss_size = W25SIM_STACK;
+	ctx_run.uc_link = &ctx_main;
+	makecontext(&ctx_run,w25sim_trampoline,0);
+	swapcontext(&ctx_main,&ctx_run);
+	munmap(stack,W25SIM_STACK);
+	return run_rc;
+}
+
+/*********************************************************************
+ * FreeRTOS: one task, which "blocks" while DMA runs
+ *********************************************************************/
+
+void
+taskYIELD(void) {
+	w25sim_run_dma();
+}
+
+void
+vTaskDelay(TickType_t ticks) {
+	++w25sim_stats.delays;
+	w25sim_run_dma();
+	w25m_now = (w25m_now / W25SIM_TICK_NS + ticks) * W25SIM_TICK_NS;
+}
+
+TickType_t
+xTaskGetTickCount(void) {
+	return w25m_now / W25SIM_TICK_NS;
+}
+
+TaskHandle_t
+xTaskGetCurrentTaskHandle(void) {
+	return (TaskHandle_t)&notify;
+}
+
+uint32_t
+ulTaskNotifyTake(BaseType_t clear,TickType_t ticks) {
+	uint32_t n;
+
+	(void)ticks;
+	++w25sim_stats.blocks;
+	w25sim_run_dma();
+	if ( notify == 0 ) {
+		fprintf(stderr,"w25sim: task would block forever\n");
+		exit(2);
+	}
+	n = notify;
+	notify = clear ? 0 : n - 1;
+	return n;
+}
+
+BaseType_t
+xTaskNotifyGive(TaskHandle_t task) {
+	(void)task;			// No other task to wake here
+	return pdPASS;
+}
+
+void
+vTaskNotifyGiveFromISR(TaskHandle_t task,BaseType_t *woken) {
+	(void)task;
+	++notify;
+	*woken = pdTRUE;
+}
+
+// End w25sim.c
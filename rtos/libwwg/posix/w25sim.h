@@ -0,0 +1,31 @@
+/* w25sim.h : Host SPI/DMA/FreeRTOS stand-ins for the flash routines
+ * Warren W. Gay VE3WWG
+ */
+#ifndef W25SIM_H
+#define W25SIM_H
+
+#include <stdint.h>
+
+struct s_w25sim_stats {
+	unsigned long	selects;	// /CS assertions
+	unsigned long	xfers;		// Bytes paced by spi_xfer()
+	unsigned long	dma_bytes;	// Bytes moved by DMA
+	unsigned long	dma_irqs;	// DMA ISR calls
+	unsigned long	blocks;		// ulTaskNotifyTake() calls
+	unsigned long	delays;		// vTaskDelay() calls
+};
+
+extern struct s_w25sim_stats w25sim_stats;
+
+void w25sim_run_dma(void);
+int w25sim_run(int (*fn)(void));
+void w25sim_cpu(uint32_t cycles);
+
+// overlay.c LZ decode, in Cortex-M3 cycles (estimated from its loops:
+// per token, per literal byte, per match byte copied)
+#define OVL_LZ_CPU(tokens,literals,copies) \
+	w25sim_cpu(20 * (tokens) + 6 * (literals) + 7 * (copies))
+
+#endif // W25SIM_H
+
+// End w25sim.h
@@ -0,0 +1,364 @@
+/* w25test.c : Exercise ../src/winbond.c against the W25Qxx model
+ * Warren W. Gay VE3WWG
+ *
+ * Reads of many sizes and alignments, and page programs across page
+ * boundaries, with and without DMA, are checked against the model's
+ * memory. The SPI traffic used by each path is reported. Exits
+ * non-zero on the first mismatch.
+ *
+ * The page cache is then checked for coherence through a random mix
+ * of reads, writes and erases, async reads are checked to use it
+ * only for full hits, and its hit rate is reported for a few sizes
+ * on a workload with a small hot set of pages.
+ *
+ * Last, the model's erase suspend/resume and busy handling are
+ * checked with raw commands.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libopencm3/stm32/spi.h>
+
+#include "winbond.h"
+#include "w25model.h"
+#include "w25sim.h"
+
+#define W25Q32_ID	0xEF4016
+
+static uint8_t buf[80000];		// Static: DMA needs a 32-bit address
+static uint8_t wbuf[65536 + 300];
+static uint32_t cache[W25_CACHE_SIZE(32)/4];
+
+static const uint32_t sizes[] = {
+	0, 1, 2, 31, 32, 33, 255, 256, 257, 4096, 65535, 65536, 65537, 80000
+};
+
+static const uint32_t addrs[] = {
+	0x000000, 0x000001, 0x0000FF, 0x001000, 0x0FFFF0, 0x3E0000
+};
+
+/*********************************************************************
+ * Fill the chip with an address dependent pattern
+ *********************************************************************/
+
+static void
+fill_pattern(void) {
+	uint8_t *mem = w25m_memory();
+
+	for ( uint32_t ux = 0; ux < w25m_size(); ++ux )
+		mem[ux] = (ux >> 8) ^ (ux * 7) ^ (ux >> 16);
+}
+
+/*********************************************************************
+ * Check one read (by w25_read_start() if start)
+ *********************************************************************/
+
+static void
+check_read(uint32_t addr,uint32_t bytes,bool start) {
+	uint32_t next;
+
+	memset(buf,0x5A,sizeof buf);
+	if ( start ) {
+		w25_read_start(SPI1,addr,buf,bytes);
+		next = w25_read_wait(SPI1);
+	} else	next = w25_read_data(SPI1,addr,buf,bytes);
+
+	if ( next != addr + bytes ) {
+		printf("FAIL: read %u at 0x%06X returned 0x%06X\n",
+			(unsigned)bytes,(unsigned)addr,(unsigned)next);
+		exit(1);
+	}
+	if ( memcmp(buf,w25m_memory() + addr,bytes) != 0 ) {
+		printf("FAIL: read %u at 0x%06X: data mismatch\n",(unsigned)bytes,(unsigned)addr);
+		exit(1);
+	}
+	if ( bytes < sizeof buf && buf[bytes] != 0x5A ) {
+		printf("FAIL: read %u at 0x%06X: overran buffer\n",(unsigned)bytes,(unsigned)addr);
+		exit(1);
+	}
+}
+
+/*********************************************************************
+ * Run all reads, return the bytes read
+ *********************************************************************/
+
+static unsigned long
+read_all(const char *what) {
+	unsigned long total = 0;
+
+	memset(&w25sim_stats,0,sizeof w25sim_stats);
+	for ( unsigned ax = 0; ax < sizeof addrs / sizeof addrs[0]; ++ax ) {
+		for ( unsigned sx = 0; sx < sizeof sizes / sizeof sizes[0]; ++sx ) {
+			if ( addrs[ax] + sizes[sx] > w25m_size() )
+				continue;
+			check_read(addrs[ax],sizes[sx],false);
+			total += sizes[sx];
+		}
+	}
+	printf("%-8s %8lu bytes: spi_xfer %8lu, DMA %8lu, DMA irqs %4lu, blocked %3lu\n",
+		what,total,w25sim_stats.xfers,w25sim_stats.dma_bytes,
+		w25sim_stats.dma_irqs,w25sim_stats.blocks);
+	return total;
+}
+
+/*********************************************************************
+ * Program wbuf[] at an unaligned address, and check the result
+ *********************************************************************/
+
+static void
+write_all(const char *what) {
+	const uint32_t addr = 0x200011, bytes = 65536 + 300;
+	uint32_t next, pages;
+	uint8_t *mem = w25m_memory();
+
+	for ( uint32_t ux = 0; ux < bytes; ++ux )
+		wbuf[ux] = ux * 13 + (ux >> 8);
+	memset(mem + addr - 0x11,0xFF,bytes + 0x100);	// Erase
+
+	memset(&w25sim_stats,0,sizeof w25sim_stats);
+	memset(w25m_cmds,0,sizeof w25m_cmds);
+	next = w25_write_data(SPI1,addr,wbuf,bytes);
+
+	if ( next != addr + bytes || memcmp(mem + addr,wbuf,bytes) != 0 ) {
+		printf("FAIL: %s write %u at 0x%06X\n",what,(unsigned)bytes,(unsigned)addr);
+		exit(1);
+	}
+	if ( mem[addr - 1] != 0xFF || mem[addr + bytes] != 0xFF ) {
+		printf("FAIL: %s write disturbed neighbours\n",what);
+		exit(1);
+	}
+
+	pages = w25m_cmds[W25_CMD_WRITE_DATA];
+	printf("%-8s %8u bytes: spi_xfer %8lu, DMA %8lu, %lu pages, %.2f SR1 reads/page\n",
+		what,(unsigned)bytes,w25sim_stats.xfers,w25sim_stats.dma_bytes,
+		(unsigned long)pages,(double)w25m_cmds[W25_CMD_READ_SR1] / pages);
+}
+
+/*********************************************************************
+ * Random reads, writes and erases in a 64K window, with the cache
+ *********************************************************************/
+
+static void
+cache_coherence(unsigned npages) {
+	const uint32_t base = 0x300000, span = 0x10000;
+	struct s_w25cache_stats st;
+	unsigned seed = 7;
+	uint32_t addr, bytes;
+
+	w25_cache_init(SPI1,cache,W25_CACHE_SIZE(npages));
+	for ( unsigned op = 0; op < 20000; ++op ) {
+		seed = seed * 1103515245 + 12345;
+		addr = base + (seed >> 8) % span;
+		bytes = 1 + (seed >> 4) % ((seed & 0x10000) ? 16 : 600);
+		if ( addr + bytes > base + span )
+			bytes = base + span - addr;
+
+		switch ( (seed >> 24) % 16 ) {
+		case 0:				// Erase a 4K sector
+			w25_erase_block(SPI1,addr & ~0xFFFu,W25_CMD_ERA_SECTOR);
+			w25_wait(SPI1);
+			break;
+		case 1:
+		case 2:				// Program (ANDs with the old data)
+			for ( uint32_t ux = 0; ux < bytes; ++ux )
+				wbuf[ux] = seed >> (ux & 7);
+			w25_write_data(SPI1,addr,wbuf,bytes);
+			w25_wait(SPI1);
+			break;
+		case 3:				// Cached only if all held
+			check_read(addr,bytes,true);
+			break;
+		default:
+			check_read(addr,bytes,false);
+		}
+	}
+	w25_cache_stats(SPI1,&st,false);
+	printf("cache %2u pages: coherent, %lu hits, %lu misses, %lu bypassed, %lu dropped\n",
+		npages,(unsigned long)st.hits,(unsigned long)st.misses,
+		(unsigned long)st.bypassed,(unsigned long)st.invalidated);
+}
+
+/*********************************************************************
+ * w25_read_start() and w25_readv_start() served from the cache only
+ * when it holds the whole read, and not after a write drops it
+ *********************************************************************/
+
+static void
+cache_async(void) {
+	const uint32_t addr = 0x1234F0, bytes = 300;
+	static uint8_t a[100], b[200];
+	const struct s_w25seg seg[2] = { { a, sizeof a }, { b, sizeof b } };
+	struct s_w25cache_stats st;
+	unsigned long xfers;
+
+	w25_cache_init(SPI1,cache,W25_CACHE_SIZE(8));
+	check_read(addr + 16,bytes - 16,true);		// Not held: to flash
+	check_read(addr,bytes,false);			// Now held
+	w25_cache_stats(SPI1,&st,true);
+
+	memset(&w25sim_stats,0,sizeof w25sim_stats);
+	check_read(addr,bytes,true);
+	w25_readv_start(SPI1,addr,seg,2);
+	if ( w25_read_wait(SPI1) != addr + bytes
+	  || memcmp(a,w25m_memory() + addr,sizeof a) != 0
+	  || memcmp(b,w25m_memory() + addr + sizeof a,sizeof b) != 0 ) {
+		printf("FAIL: cached w25_readv_start()\n");
+		exit(1);
+	}
+	xfers = w25sim_stats.xfers + w25sim_stats.dma_bytes;
+	w25_cache_stats(SPI1,&st,true);
+	if ( xfers != 0 || st.hits != 7 || st.bypassed != 0 ) {
+		printf("FAIL: async reads not served from the cache (%lu SPI bytes)\n",xfers);
+		exit(1);
+	}
+
+	w25_write_data(SPI1,addr + 200,wbuf,1);		// Drops a page
+	w25_wait(SPI1);
+	check_read(addr,bytes,true);
+	w25_cache_stats(SPI1,&st,false);
+	if ( st.bypassed != 1 ) {
+		printf("FAIL: async read of a dropped page used the cache\n");
+		exit(1);
+	}
+	puts("cache async reads: PASS");
+}
+
+/*********************************************************************
+ * Hit rate: small reads, 7 in 8 to a hot set of 12 pages
+ *********************************************************************/
+
+static void
+cache_hitrate(unsigned npages) {
+	struct s_w25cache_stats st;
+	unsigned seed = 11;
+	uint32_t page, spibytes;
+
+	w25_cache_init(SPI1,npages ? cache : 0,W25_CACHE_SIZE(npages));
+	memset(&w25sim_stats,0,sizeof w25sim_stats);
+
+	for ( unsigned op = 0; op < 20000; ++op ) {
+		seed = seed * 1103515245 + 12345;
+		if ( (seed >> 16) % 8 )
+			page = 0x1000 + (seed >> 20) % 12 * 37;
+		else	page = (seed >> 8) % (w25m_size() >> 8);
+		check_read((page << 8) + (seed & 0xC0),16,false);
+	}
+
+	w25_cache_stats(SPI1,&st,true);
+	spibytes = w25sim_stats.xfers + w25sim_stats.dma_bytes;
+	printf("cache %2u pages (%5u bytes): %5.1f%% hits, %8lu SPI bytes\n",
+		npages,W25_CACHE_SIZE(npages),
+		st.hits + st.misses ? 100.0 * st.hits / (st.hits + st.misses) : 0.0,
+		(unsigned long)spibytes);
+}
+
+/*********************************************************************
+ * Raw SPI command (no waiting), with optional 3 byte address
+ *********************************************************************/
+
+static void
+raw_cmd(uint8_t cmd,int32_t addr) {
+
+	spi_enable(SPI1);
+	spi_xfer(SPI1,cmd);
+	if ( addr >= 0 ) {
+		spi_xfer(SPI1,addr >> 16);
+		spi_xfer(SPI1,addr >> 8);
+		spi_xfer(SPI1,addr);
+	}
+	spi_disable(SPI1);
+}
+
+static void
+expect(bool ok,const char *what) {
+
+	if ( !ok ) {
+		printf("FAIL: suspend: %s\n",what);
+		exit(1);
+	}
+}
+
+/*********************************************************************
+ * Erase suspend and resume, as the chip would do them
+ *********************************************************************/
+
+static void
+suspend_check(void) {
+	const uint32_t sector = 0x3F0000;
+	uint8_t *mem = w25m_memory();
+	struct s_w25m_errs e0 = w25m_errs;
+	uint64_t t0 = w25m_now;
+	uint8_t b;
+
+	memset(mem + sector,0x00,4096);
+	raw_cmd(W25_CMD_WRITE_EN,-1);
+	raw_cmd(W25_CMD_ERA_SECTOR,sector);
+	expect(w25_read_sr1(SPI1) & W25_SR1_BUSY,"not busy erasing");
+
+	raw_cmd(W25_CMD_READ_DATA,0);			// Ignored while busy
+	expect(w25m_errs.busy_cmds == e0.busy_cmds + 1,"busy command not counted");
+
+	raw_cmd(W25_CMD_SUSPEND,-1);
+	w25_wait(SPI1);					// tSUS
+	expect(w25_read_sr2(SPI1) & W25_SR2_SUS,"SUS not set");
+	expect(w25m_now - t0 < 2000000,"suspend took too long");
+	w25_read_data(SPI1,0x000100,&b,1);		// Outside: fine
+	expect(w25m_errs.suspended_reads == e0.suspended_reads,"outside read counted");
+	w25_read_data(SPI1,sector + 5,&b,1);		// Inside: not valid
+	expect(w25m_errs.suspended_reads == e0.suspended_reads + 1,"inside read not counted");
+
+	raw_cmd(W25_CMD_WRITE_EN,-1);
+	raw_cmd(W25_CMD_ERA_SECTOR,0x3E0000);		// No erase while suspended
+	expect(w25m_errs.bad_suspends == e0.bad_suspends + 1,"erase while suspended");
+
+	raw_cmd(W25_CMD_RESUME,-1);
+	expect(!(w25_read_sr2(SPI1) & W25_SR2_SUS),"SUS still set");
+	expect(w25_read_sr1(SPI1) & W25_SR1_BUSY,"not busy after resume");
+	w25_wait(SPI1);
+	expect(w25m_now - t0 >= w25m_timing.tse * 1000ull,"erase time lost by suspend");
+	printf("suspend: erase %.1f ms with a suspend: PASS\n",(w25m_now - t0) / 1e6);
+
+	w25m_errs = e0;
+}
+
+int
+main(void) {
+	uint32_t jedec;
+
+	w25m_init(W25Q32_ID);
+	fill_pattern();
+
+	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_2);
+	if ( (jedec = w25_JEDEC_ID(SPI1)) != W25Q32_ID ) {
+		printf("FAIL: JEDEC ID %06X\n",(unsigned)jedec);
+		return 1;
+	}
+
+	read_all("spi_xfer");
+	write_all("spi_xfer");
+	w25_dma_init(SPI1);
+	read_all("DMA");
+	write_all("DMA");
+
+	w25_cache_init(SPI1,cache,sizeof cache);
+	read_all("cached");
+	write_all("cached");
+	cache_coherence(4);
+	cache_coherence(32);
+	cache_async();
+	for ( unsigned npages = 0; npages <= 32; npages = npages ? npages * 2 : 4 )
+		cache_hitrate(npages);
+	suspend_check();
+
+	if ( w25m_errs.busy_cmds || w25m_errs.bad_suspends ) {
+		printf("FAIL: %lu commands while busy, %lu bad suspends\n",
+			w25m_errs.busy_cmds,w25m_errs.bad_suspends);
+		return 1;
+	}
+
+	puts("PASS");
+	return 0;
+}
+
+// End w25test.c
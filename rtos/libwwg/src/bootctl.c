@@ -0,0 +1,375 @@
+/* bootctl.c : A/B application slots, boot log and image writing
+ * Warren W. Gay VE3WWG
+ *
+ * Used by bootldr to choose and write slots, and by applications
+ * to confirm themselves (boot_confirm()) or ask for an update
+ * (boot_update()). See bootctl.h NOTES.
+ */
+#include <string.h>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/f1/bkp.h>
+#include <libopencm3/cm3/scb.h>
+
+#include "bootctl.h"
+
+#define FLASH_ERRS	(FLASH_SR_PGERR | FLASH_SR_WRPRTERR)
+
+/*********************************************************************
+ * Slot address, CRC of flash (CRC unit)
+ *********************************************************************/
+
+uint32_t
+boot_slot_addr(unsigned slot) {
+	return slot ? BOOT_SLOT_B : BOOT_SLOT_A;
+}
+
+uint32_t
+boot_crc(uint32_t addr,uint32_t bytes) {
+
+	rcc_periph_clock_enable(RCC_CRC);
+	crc_reset();
+	return crc_calculate_block((uint32_t *)addr,bytes / 4);
+}
+
+/*********************************************************************
+ * Internal: Flash erase and program, checking status
+ *********************************************************************/
+
+static int
+boot_erase(uint32_t addr) {
+
+	flash_clear_status_flags();
+	flash_erase_page(addr);
+	return flash_get_status_flags() & FLASH_ERRS ? BOOT_EIO : 0;
+}
+
+static int
+boot_program(uint32_t addr,const uint8_t *data,unsigned bytes) {
+
+	flash_clear_status_flags();
+	for ( unsigned ux = 0; ux < bytes; ux += 2 ) {
+		flash_program_half_word(addr + ux,data[ux] | data[ux+1] << 8);
+		if ( flash_get_status_flags() & FLASH_ERRS )
+			return BOOT_EIO;
+	}
+	return 0;
+}
+
+/*********************************************************************
+ * Internal: Boot log records
+ *********************************************************************/
+
+static uint8_t
+rec_check(const struct s_bootrec *rec) {
+	const uint8_t *bp = (const uint8_t *)rec;
+	uint8_t sum = 0;
+
+	for ( unsigned ux = 0; ux < sizeof *rec; ++ux )
+		if ( ux != 5 )			// Not check itself
+			sum += bp[ux];
+	return ~sum;
+}
+
+static bool
+rec_valid(const struct s_bootrec *rec) {
+	return rec->magic == BOOTREC_MAGIC && rec->check == rec_check(rec);
+}
+
+static bool
+rec_erased(const struct s_bootrec *rec) {
+	const uint32_t *wp = (const uint32_t *)rec;
+
+	return (wp[0] & wp[1] & wp[2] & wp[3]) == 0xFFFFFFFF;
+}
+
+static bool
+page_erased(const struct s_bootrec *rec) {
+
+	for ( unsigned ux = 0; ux < BOOT_LOG_RECS; ++ux )
+		if ( !rec_erased(rec + ux) )
+			return false;
+	return true;
+}
+
+static const struct s_bootrec *
+log_page(unsigned page) {
+	return (const struct s_bootrec *)(BOOT_LOG + page * BOOT_PAGE);
+}
+
+/*********************************************************************
+ * Internal: Program a record, its magic last
+ *********************************************************************/
+
+static int
+rec_put(const struct s_bootrec *at,uint8_t kind,uint8_t slot,uint8_t state,uint32_t length,uint32_t crc) {
+	struct s_bootrec rec;
+	uint32_t addr = (uint32_t)at;
+
+	memset(&rec,0xFF,sizeof rec);
+	rec.magic = BOOTREC_MAGIC;
+	rec.kind = kind;
+	rec.slot = slot;
+	rec.state = state;
+	rec.length = length;
+	rec.crc = crc;
+	rec.check = rec_check(&rec);
+
+	if ( boot_program(addr + 2,(const uint8_t *)&rec + 2,sizeof rec - 2) )
+		return BOOT_EIO;
+	return boot_program(addr,(const uint8_t *)&rec,2);
+}
+
+/*********************************************************************
+ * Read the boot state from the log
+ *********************************************************************/
+
+void
+boot_state(struct s_bootstate *st) {
+	const struct s_bootrec *rec;
+
+	memset(st,0,sizeof *st);
+	st->state = BOOT_NONE;
+	st->page = -1;
+
+	for ( unsigned page = 0; page < 2; ++page ) {
+		rec = log_page(page);
+		if ( rec_valid(rec) && rec->kind == BOOTREC_PAGE
+		  && (st->page < 0 || rec->length > st->gen) ) {
+			st->page = page;
+			st->gen = rec->length;
+		}
+	}
+	if ( st->page < 0 )
+		return;
+
+	rec = log_page(st->page);
+	for ( st->next = 1; st->next < BOOT_LOG_RECS; ++st->next ) {
+		const struct s_bootrec *r = rec + st->next;
+
+		if ( rec_erased(r) )
+			break;
+		if ( !rec_valid(r) || r->slot > 1 )
+			continue;		// Cut short by a reset
+		if ( r->kind == BOOTREC_IMAGE ) {
+			st->length[r->slot] = r->length;
+			st->crc[r->slot] = r->crc;
+		} else if ( r->kind == BOOTREC_STATE ) {
+			st->slot = r->slot;
+			st->state = r->state;
+		}
+	}
+}
+
+/*********************************************************************
+ * Internal: Append a record, moving the state to the other page
+ * first if this one is full (or there is none yet)
+ *********************************************************************/
+
+static int
+log_append(uint8_t kind,uint8_t slot,uint8_t state,uint32_t length,uint32_t crc) {
+	struct s_bootstate st;
+	const struct s_bootrec *rec;
+	unsigned page;
+	int rc = 0;
+
+	boot_state(&st);
+	flash_unlock();
+
+	if ( st.page < 0 || st.next >= BOOT_LOG_RECS ) {
+		page = st.page < 0 ? 0 : st.page ^ 1;
+		rec = log_page(page);
+		if ( !page_erased(rec) )
+			rc = boot_erase((uint32_t)rec);
+		for ( unsigned sx = 0; !rc && sx < 2; ++sx )
+			rc = rec_put(rec + 1 + sx,BOOTREC_IMAGE,sx,BOOT_NONE,st.length[sx],st.crc[sx]);
+		st.next = 3;
+		if ( !rc && st.state != BOOT_NONE )
+			rc = rec_put(rec + st.next++,BOOTREC_STATE,st.slot,st.state,0,0);
+		if ( !rc )			// Header last: page now current
+			rc = rec_put(rec,BOOTREC_PAGE,0,BOOT_NONE,st.gen + 1,0);
+	} else	{
+		rec = log_page(st.page);
+	}
+
+	if ( !rc )
+		rc = rec_put(rec + st.next,kind,slot,state,length,crc);
+	flash_lock();
+	return rc;
+}
+
+/*********************************************************************
+ * Test if a slot holds a whole image, linked for the slot
+ *********************************************************************/
+
+bool
+boot_valid(unsigned slot) {
+	struct s_bootstate st;
+	uint32_t base = boot_slot_addr(slot);
+	const uint32_t *vt = (const uint32_t *)base;
+
+	boot_state(&st);
+	if ( slot > 1 || st.length[slot] < 8 || st.length[slot] > BOOT_SLOT_SIZE )
+		return false;
+	if ( vt[0] <= BOOT_RAM || vt[0] > BOOT_RAM + BOOT_RAM_SIZE
+	  || vt[1] < base || vt[1] >= base + st.length[slot] )
+		return false;
+	return boot_crc(base,st.length[slot]) == st.crc[slot];
+}
+
+/*********************************************************************
+ * Choose the slot to boot (bootldr), recording trial boots and
+ * rollbacks. Returns the slot, else -1 if neither is bootable.
+ *********************************************************************/
+
+int
+boot_select(void) {
+	struct s_bootstate st;
+	unsigned slot, other;
+
+	boot_state(&st);
+	slot = st.slot;
+	other = slot ^ 1;
+
+	switch ( st.state ) {
+	case BOOT_TRIAL:
+		if ( boot_valid(slot) ) {
+			log_append(BOOTREC_STATE,slot,BOOT_TRYING,0,0);
+			return slot;
+		}
+		break;
+	case BOOT_TRYING:			// Trial was never confirmed
+		break;
+	default:
+		if ( boot_valid(slot) )
+			return slot;
+	}
+
+	if ( boot_valid(other) ) {		// Roll back
+		log_append(BOOTREC_STATE,other,BOOT_GOOD,0,0);
+		return other;
+	}
+	if ( st.state == BOOT_TRYING && boot_valid(slot) )
+		return slot;			// Nothing better to run
+	return -1;
+}
+
+/*********************************************************************
+ * Boot slot on trial at the next reset (after writing it)
+ *********************************************************************/
+
+int
+boot_trial(unsigned slot) {
+
+	if ( slot > 1 || !boot_valid(slot) )
+		return BOOT_EINVAL;
+	return log_append(BOOTREC_STATE,slot,BOOT_TRIAL,0,0);
+}
+
+/*********************************************************************
+ * Application: the image on trial is good (no-op if not on trial)
+ *********************************************************************/
+
+int
+boot_confirm(void) {
+	struct s_bootstate st;
+
+	boot_state(&st);
+	if ( st.state != BOOT_TRYING && st.state != BOOT_TRIAL )
+		return 0;
+	return log_append(BOOTREC_STATE,st.slot,BOOT_GOOD,0,0);
+}
+
+/*********************************************************************
+ * Application: reset into the bootloader, to be sent an update
+ *********************************************************************/
+
+void
+boot_update(void) {
+
+	rcc_periph_clock_enable(RCC_PWR);
+	rcc_periph_clock_enable(RCC_BKP);
+	pwr_disable_backup_domain_write_protect();
+	BKP_DR1 = BOOT_DR_UPDATE;
+	scb_reset_system();
+}
+
+/*********************************************************************
+ * Start writing an image of length bytes into slot. The slot's old
+ * image is forgotten first, so a write cut short never boots.
+ *********************************************************************/
+
+int
+boot_write_begin(struct s_bootwr *wr,unsigned slot,uint32_t length,uint32_t crc) {
+
+	if ( slot > 1 || length < 8 || length > BOOT_SLOT_SIZE || (length & 3) )
+		return BOOT_EINVAL;
+
+	wr->slot = slot;
+	wr->base = boot_slot_addr(slot);
+	wr->length = length;
+	wr->crc = crc;
+	wr->done = 0;
+	wr->erased = wr->base;
+	return log_append(BOOTREC_IMAGE,slot,BOOT_NONE,0,0);
+}
+
+/*********************************************************************
+ * Program the next bytes (an even number) of the image,
+ * erasing each page as it is reached
+ *********************************************************************/
+
+int
+boot_write(struct s_bootwr *wr,const void *data,unsigned bytes) {
+	const uint8_t *bp = (const uint8_t *)data;
+	uint32_t addr = wr->base + wr->done;
+	unsigned n;
+	int rc = 0;
+
+	if ( (bytes & 1) || bytes > wr->length - wr->done )
+		return BOOT_EINVAL;
+	if ( wr->done == 0 ) {
+		const uint32_t *vt = (const uint32_t *)data;
+
+		if ( bytes < 8 || vt[1] < wr->base || vt[1] >= wr->base + wr->length )
+			return BOOT_EADDR;	// Reset vector is not in the slot
+	}
+
+	flash_unlock();
+	while ( !rc && bytes > 0 ) {
+		if ( addr >= wr->erased ) {
+			rc = boot_erase(wr->erased);
+			wr->erased += BOOT_PAGE;
+			continue;
+		}
+		n = wr->erased - addr;		// Up to the next page
+		if ( n > bytes )
+			n = bytes;
+		rc = boot_program(addr,bp,n);
+		addr += n;
+		bp += n;
+		bytes -= n;
+		wr->done += n;
+	}
+	flash_lock();
+	return rc;
+}
+
+/*********************************************************************
+ * Verify the whole image with the CRC unit, and record it
+ *********************************************************************/
+
+int
+boot_write_end(struct s_bootwr *wr) {
+
+	if ( wr->done != wr->length )
+		return BOOT_EINVAL;
+	if ( boot_crc(wr->base,wr->length) != wr->crc )
+		return BOOT_ECRC;
+	return log_append(BOOTREC_IMAGE,wr->slot,BOOT_NONE,wr->length,wr->crc);
+}
+
+// End bootctl.c
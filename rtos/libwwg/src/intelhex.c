@@ -1,12 +1,35 @@
 /* Intel Hex Routines
  * Warren W. Gay VE3WWG
  * Sat Oct 28 19:52:52 2017
+ *
+ * Hex digits are decoded by table lookup, and each record's checksum
+ * is summed as its bytes are decoded, in one pass over the text.
  */
-#include <stdlib.h>
 #include <string.h>
 
 #include "intelhex.h"
 
+#define NIB(c,v)	[c] = 0x10 | (v)	// 0x10: valid hex digit
+
+static const uint8_t hexnib[128] = {
+	NIB('0',0),  NIB('1',1),  NIB('2',2),  NIB('3',3),
+	NIB('4',4),  NIB('5',5),  NIB('6',6),  NIB('7',7),
+	NIB('8',8),  NIB('9',9),
+	NIB('A',10), NIB('B',11), NIB('C',12), NIB('D',13), NIB('E',14), NIB('F',15),
+	NIB('a',10), NIB('b',11), NIB('c',12), NIB('d',13), NIB('e',14), NIB('f',15)
+};
+
+/*********************************************************************
+ * Internal: Hex digit value, else -1 (also for NUL)
+ *********************************************************************/
+
+static inline int
+hexval(char ch) {
+	uint8_t n = (uint8_t)ch < 0x80 ? hexnib[(uint8_t)ch] : 0;
+
+	return n ? n & 0x0F : -1;
+}
+
 /*********************************************************************
  * Initialize struct s_ihex
  *********************************************************************/
@@ -17,16 +40,18 @@ ihex_init(s_ihex *ihex) {
 }
 
 /*********************************************************************
- * Internal: Parse starting from text, for n chars.
+ * Internal: Decode two hex digits at *cp, adding the byte to *csum
  *********************************************************************/
 
-static uint32_t
-to_hex(const char *text,unsigned n,const char **rp) {
-	char buf[n+1];
+static int
+hexbyte(const char **cp,unsigned *csum) {
+	int hi = hexval((*cp)[0]), lo;
 
-	strncpy(buf,text,n)[n] = 0;
-	*rp = text + strlen(buf);
-	return strtoul(buf,0,16);
+	if ( hi < 0 || (lo = hexval((*cp)[1])) < 0 )
+		return -1;
+	*cp += 2;
+	*csum += (unsigned)(hi << 4 | lo);
+	return hi << 4 | lo;
 }
 
 /*********************************************************************
@@ -38,30 +63,34 @@ to_hex(const char *text,unsigned n,const char **rp) {
 unsigned
 ihex_parse(s_ihex *ihex,const char *text) {
 	const char *cp = strchr(text,':');
-	unsigned csum;
+	unsigned csum = 0;
+	int b[5];
 
 	if ( !cp )
 		return IHEX_FAIL;
+	++cp;
 
 	memset(ihex->data,0,sizeof ihex->data);
 
-	++cp;
-	ihex->length = to_hex(cp,2,&cp);
-	ihex->addr   = to_hex(cp,4,&cp);
-	ihex->rtype  = to_hex(cp,2,&cp);
+	for ( unsigned ux=0; ux<4; ++ux )
+		if ( (b[ux] = hexbyte(&cp,&csum)) < 0 )
+			return IHEX_FAIL;
+	ihex->length = b[0];
+	ihex->addr   = (uint32_t)b[1] << 8 | b[2];
+	ihex->rtype  = b[3];
 
 	if ( ihex->length > sizeof ihex->data )
 		return IHEX_FAIL;
 
-	csum = ihex->length + ((ihex->addr >> 8) & 0xFF) + (ihex->addr & 0xFF)
-		+ ihex->rtype;
-
 	for ( unsigned ux=0; ux<ihex->length; ++ux ) {
-		ihex->data[ux] = to_hex(cp,2,&cp);
-		csum += ihex->data[ux];
+		if ( (b[4] = hexbyte(&cp,&csum)) < 0 )
+			return IHEX_FAIL;
+		ihex->data[ux] = b[4];
 	}
-	ihex->checksum = to_hex(cp,2,&cp);
 	ihex->compcsum = (-(int)(csum & 0x0FF)) & 0xFF;
+	if ( (b[4] = hexbyte(&cp,&csum)) < 0 )
+		return IHEX_FAIL;
+	ihex->checksum = b[4];
 	if ( ihex->compcsum != ihex->checksum )
 		return IHEX_FAIL;
 
@@ -79,4 +108,166 @@ ihex_parse(s_ihex *ihex,const char *text) {
 	return ihex->rtype;
 }
 
+/*********************************************************************
+ * Initialize a streaming decoder, with its write callback
+ *********************************************************************/
+
+void
+ihex_dec_init(struct s_ihexdec *dec,ihex_write_t write,void *arg) {
+
+	memset(dec,0,sizeof *dec);
+	dec->nibble = 0xFF;
+	dec->write = write;
+	dec->arg = arg;
+}
+
+/*********************************************************************
+ * Hand the gathered run (if any) to the write callback
+ * (returns false once a write has failed)
+ *********************************************************************/
+
+bool
+ihex_dec_flush(struct s_ihexdec *dec) {
+
+	if ( dec->runlen > 0 ) {
+		if ( dec->write(dec->arg,dec->runaddr,dec->run,dec->runlen) ) {
+			++dec->writes;
+		} else	{
+			dec->failed = true;
+			dec->failaddr = dec->runaddr;
+		}
+		dec->runaddr += dec->runlen;
+		dec->runlen = 0;
+	}
+	return !dec->failed;
+}
+
+/*********************************************************************
+ * Address the next data byte is expected at
+ *********************************************************************/
+
+uint32_t
+ihex_dec_addr(struct s_ihexdec *dec) {
+	return dec->runaddr + dec->runlen;
+}
+
+/*********************************************************************
+ * Internal: Add a data record's bytes to the run, a page at a time
+ *********************************************************************/
+
+static void
+ihex_dec_data(struct s_ihexdec *dec,uint32_t addr,const uint8_t *data,unsigned bytes) {
+	unsigned n;
+
+	if ( dec->runlen > 0 && addr != dec->runaddr + dec->runlen )
+		ihex_dec_flush(dec);		// Not contiguous
+	if ( dec->failed ) {
+		dec->runaddr = addr + bytes;	// Dropped: a write failed
+		return;
+	}
+
+	while ( bytes > 0 ) {
+		if ( dec->runlen == 0 )
+			dec->runaddr = addr;
+		n = 0x100 - (addr & 0xFF);	// Up to the page boundary
+		if ( n > bytes )
+			n = bytes;
+		memcpy(dec->run + dec->runlen,data,n);
+		dec->runlen += n;
+		addr += n;
+		data += n;
+		bytes -= n;
+		if ( (addr & 0xFF) == 0 && !ihex_dec_flush(dec) ) {
+			dec->runaddr += bytes;	// Page write failed:
+			return;			// drop the rest
+		}
+	}
+}
+
+/*********************************************************************
+ * Internal: Act on a complete record with a good checksum
+ *********************************************************************/
+
+static unsigned
+ihex_dec_record(struct s_ihexdec *dec) {
+	const uint8_t *r = dec->rec;
+	uint32_t v = (uint32_t)r[4] << 8 | r[5];
+	bool failed = dec->failed;
+
+	++dec->records;
+	switch ( r[3] ) {
+	case IHEX_RT_DATA:
+		ihex_dec_data(dec,dec->baseaddr + ((uint32_t)r[1] << 8 | r[2]),r+4,r[0]);
+		break;
+	case IHEX_RT_EOF:
+		ihex_dec_flush(dec);
+		break;
+	case IHEX_RT_XSEG:
+		dec->baseaddr = v << 4;
+		break;
+	case IHEX_RT_XLADDR:
+		dec->baseaddr = v << 16;
+		break;
+	case IHEX_RT_SSADDR:
+	case IHEX_RT_SLADDR:
+		dec->startaddr = v << 16 | (uint32_t)r[6] << 8 | r[7];
+		break;
+	}
+	return dec->failed && !failed ? IHEX_EWRITE | r[3] : r[3];
+}
+
+/*********************************************************************
+ * Decode one character of Intel Hex text.
+ * RETURNS:
+ *	The record type, when ch completes a good record
+ *	IHEX_EWRITE | the record type, when a write for it failed
+ *	IHEX_FAIL, when ch shows the record is bad (it is dropped)
+ *	IHEX_MORE otherwise
+ *********************************************************************/
+
+unsigned
+ihex_dec_putc(struct s_ihexdec *dec,char ch) {
+	int v = hexval(ch);
+
+	if ( v >= 0 && dec->inrec ) {
+		if ( dec->nibble == 0xFF ) {
+			dec->nibble = v;
+			return IHEX_MORE;
+		}
+		dec->rec[dec->nbytes] = dec->nibble << 4 | v;
+		dec->csum += dec->rec[dec->nbytes++];
+		dec->nibble = 0xFF;
+
+		if ( dec->nbytes < 5 || dec->nbytes < dec->rec[0] + 5u )
+			return IHEX_MORE;
+
+		dec->inrec = false;
+		if ( dec->csum != 0 ) {
+			++dec->errors;		// Checksum
+			return IHEX_FAIL;
+		}
+		return ihex_dec_record(dec);
+	}
+
+	if ( ch == ':' ) {
+		bool cut = dec->inrec;
+
+		dec->inrec = true;		// New record
+		dec->nibble = 0xFF;
+		dec->nbytes = 0;
+		dec->csum = 0;
+		if ( cut ) {
+			++dec->errors;		// Last one was cut short
+			return IHEX_FAIL;
+		}
+		return IHEX_MORE;
+	}
+	if ( !dec->inrec )
+		return IHEX_MORE;		// Between records
+
+	++dec->errors;				// Short record or junk
+	dec->inrec = false;
+	return IHEX_FAIL;
+}
+
 // End intelhex.c
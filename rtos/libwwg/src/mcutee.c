@@ -0,0 +1,272 @@
+/* MCU I/O Tee: Fan out std output to several devices
+ * Warren W. Gay VE3WWG
+ */
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+
+#include <mcutee.h>
+#include <miniprintf.h>
+
+#define TEE_CHUNK	32			// Bytes per queue item (and device write)
+
+struct s_tee_chunk {
+	uint8_t		len;
+	char		data[TEE_CHUNK-1];
+};
+
+struct s_tee_sink {
+	const struct s_mcuio *dev;		// Real output device
+	QueueHandle_t	txq;			// Async output buffer (chunks)
+	TickType_t	block;			// Max ticks to wait when full, per call
+	volatile uint32_t dropped;		// Bytes dropped
+};
+
+/*
+ * One output call (putc, puts, printf or write). A sink that times
+ * out drops the rest of the call, so no call waits longer than the
+ * largest block ticks.
+ */
+struct s_tee_call {
+	TickType_t	t0;			// Call start
+	bool		full[MCU_TEE_MAX_SINKS]; // Timed out: drop the rest
+	struct s_tee_chunk chunk;		// Being filled
+	int		count;			// Bytes formatted (printf)
+};
+
+static struct s_tee_sink sinks[MCU_TEE_MAX_SINKS];
+static unsigned n_sinks = 0;
+static const struct s_mcuio *tee_in = 0;	// Input device
+
+/*********************************************************************
+ * Drain task: One per sink, moves queued chunks to the real device
+ *********************************************************************/
+
+static void
+tee_task(void *arg) {
+	struct s_tee_sink *sinkp = (struct s_tee_sink *)arg;
+	struct s_tee_chunk chunk;
+
+	for (;;) {
+		if ( xQueueReceive(sinkp->txq,&chunk,portMAX_DELAY) == pdPASS )
+			sinkp->dev->write(chunk.data,chunk.len);	// Only this task waits here
+	}
+}
+
+/*********************************************************************
+ * Internal: Queue the call's chunk to every sink, per sink policy.
+ * Every sink is offered it without waiting first, so that a full
+ * sink does not hold up the others; then the full ones wait for
+ * what is left of their block ticks.
+ *********************************************************************/
+
+static void
+tee_flush(struct s_tee_call *callp) {
+	bool sent[MCU_TEE_MAX_SINKS] = { false };
+	TickType_t waited, wait;
+
+	if ( !callp->chunk.len )
+		return;
+
+	for ( unsigned pass=0; pass<2; ++pass ) {
+		for ( unsigned ux=0; ux<n_sinks; ++ux ) {
+			struct s_tee_sink *sinkp = &sinks[ux];
+
+			if ( sent[ux] || callp->full[ux] )
+				continue;
+			wait = 0;
+			if ( pass ) {
+				waited = xTaskGetTickCount() - callp->t0;
+				wait = waited < sinkp->block ? sinkp->block - waited : 0;
+			}
+			if ( xQueueSend(sinkp->txq,&callp->chunk,wait) == pdPASS )
+				sent[ux] = true;
+			else if ( pass )
+				callp->full[ux] = true;
+		}
+	}
+	for ( unsigned ux=0; ux<n_sinks; ++ux )
+		if ( callp->full[ux] )
+			sinks[ux].dropped += callp->chunk.len;
+	callp->chunk.len = 0;
+}
+
+static void
+tee_begin(struct s_tee_call *callp) {
+
+	callp->t0 = xTaskGetTickCount();
+	for ( unsigned ux=0; ux<MCU_TEE_MAX_SINKS; ++ux )
+		callp->full[ux] = false;
+	callp->chunk.len = 0;
+	callp->count = 0;
+}
+
+static void
+tee_add(struct s_tee_call *callp,char ch) {
+
+	callp->chunk.data[callp->chunk.len++] = ch;
+	if ( callp->chunk.len >= sizeof callp->chunk.data )
+		tee_flush(callp);
+}
+
+static void
+tee_cooked(struct s_tee_call *callp,char ch) {
+
+	if ( ch == '\n' )
+		tee_add(callp,'\r');
+	tee_add(callp,ch);
+}
+
+/*********************************************************************
+ * s_mcuio output routines (cooked like the other devices)
+ *********************************************************************/
+
+static void
+tee_putc(char ch) {
+	struct s_tee_call call;
+
+	tee_begin(&call);
+	tee_cooked(&call,ch);
+	tee_flush(&call);
+}
+
+static void
+tee_puts(const char *buf) {
+	struct s_tee_call call;
+
+	tee_begin(&call);
+	while ( *buf )
+		tee_cooked(&call,*buf++);
+	tee_flush(&call);
+}
+
+static void
+tee_vputc(char ch,void *argp) {
+	struct s_tee_call *callp = (struct s_tee_call *)argp;
+
+	tee_cooked(callp,ch);
+	++callp->count;
+}
+
+static int
+tee_vprintf(const char *format,va_list ap) {
+	struct s_tee_call call;
+
+	tee_begin(&call);
+	mini_vprintf_arg(tee_vputc,&call,format,ap);
+	tee_flush(&call);
+	return call.count;
+}
+
+static void
+tee_write(const char *buf,unsigned bytes) {
+	struct s_tee_call call;
+
+	tee_begin(&call);
+	while ( bytes-- > 0 )
+		tee_add(&call,*buf++);
+	tee_flush(&call);
+}
+
+/*********************************************************************
+ * s_mcuio input routines (from the chosen input device)
+ *********************************************************************/
+
+static int
+tee_getc(void) {
+	return tee_in ? tee_in->getc() : -1;
+}
+
+static int
+tee_peek(void) {
+	return tee_in ? tee_in->peek() : -1;
+}
+
+static int
+tee_gets(char *buf,unsigned maxbuf) {
+	return tee_in ? tee_in->gets(buf,maxbuf) : -1;
+}
+
+static int
+tee_getline(char *buf,unsigned maxbuf) {
+	return getline(buf,maxbuf,tee_getc,tee_putc);
+}
+
+static const struct s_mcuio dev_tee =
+	{ tee_putc, tee_puts, tee_vprintf, tee_getc, tee_peek, tee_gets, tee_write, tee_getline };
+
+const struct s_mcuio
+	*mcu_tee = &dev_tee;
+
+/*********************************************************************
+ * Add an output sink to the tee:
+ *
+ * ARGUMENTS:
+ *	dev		Device to write to (mcu_usb, mcu_uart1 etc.)
+ *	depth		Async buffer size in bytes (whole 32 byte chunks)
+ *	block_ticks	0 to drop when full, else max ticks to wait
+ *			in one output call
+ *	priority	Drain task priority
+ *
+ * RETURNS:
+ *	>= 0		Sink index (for mcu_tee_dropped())
+ *	-1		Too many sinks
+ *	-2		Out of memory
+ *
+ * NOTES:
+ *	Add all sinks before the tee is used for output. The first
+ *	sink added becomes the input device, unless mcu_tee_input()
+ *	is used.
+ *********************************************************************/
+
+int
+mcu_tee_add(const struct s_mcuio *dev,unsigned depth,uint32_t block_ticks,unsigned priority) {
+	struct s_tee_sink *sinkp;
+
+	if ( n_sinks >= MCU_TEE_MAX_SINKS )
+		return -1;
+
+	sinkp = &sinks[n_sinks];
+	sinkp->dev = dev;
+	sinkp->block = block_ticks;
+	sinkp->dropped = 0;
+	depth /= sizeof(struct s_tee_chunk);
+	sinkp->txq = xQueueCreate(depth > 2 ? depth : 2,sizeof(struct s_tee_chunk));
+	if ( !sinkp->txq )
+		return -2;
+
+	if ( xTaskCreate(tee_task,"TEE",100,sinkp,priority,NULL) != pdPASS ) {
+		vQueueDelete(sinkp->txq);
+		return -2;
+	}
+
+	if ( !tee_in )
+		tee_in = dev;
+	return n_sinks++;
+}
+
+/*********************************************************************
+ * Choose the device that std_getc() etc. read from
+ *********************************************************************/
+
+void
+mcu_tee_input(const struct s_mcuio *dev) {
+	tee_in = dev;
+}
+
+/*********************************************************************
+ * Return the count of bytes dropped by a sink
+ *********************************************************************/
+
+uint32_t
+mcu_tee_dropped(int sinkx) {
+
+	if ( sinkx < 0 || (unsigned)sinkx >= n_sinks )
+		return 0;
+	return sinks[sinkx].dropped;
+}
+
+// End mcutee.c
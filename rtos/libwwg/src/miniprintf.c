@@ -281,6 +281,19 @@ mini_vprintf_uncooked(void (*putc)(char),const char *format,va_list args) {
 	return mini_vprintf0(putc,0,format,args);
 }
 
+/*********************************************************************
+ * External: Perform uncooked printf() to a putc() taking argp
+ *********************************************************************/
+
+void
+mini_vprintf_arg(void (*putc)(char,void *),void *argp,const char *format,va_list args) {
+	miniarg_t mini;
+
+	mini.putc = putc;
+	mini.argp = argp;
+	internal_vprintf(&mini,format,args);
+}
+
 /*********************************************************************
  * Sprintf
  *********************************************************************/
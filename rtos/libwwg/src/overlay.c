@@ -0,0 +1,434 @@
+/* overlay.c : Overlay runtime: RAM regions, LRU, prefetch by DMA
+ * Warren W. Gay VE3WWG
+ *
+ * Modules are found by load address in an open addressed hash
+ * table, built once by ovl_init(). A module is resident in at most
+ * one region. See overlay.h NOTES.
+ */
+#include <string.h>
+
+#include <libopencm3/cm3/dwt.h>
+
+#include "winbond.h"
+#include "overlay.h"
+
+#define W25_FAIL	0xFFFFFFFF	// w25_read_*() failed
+
+#ifndef OVL_LZ_CPU			// Host simulation: decode time
+#define OVL_LZ_CPU(tokens,literals,copies)
+#endif
+
+/*********************************************************************
+ * Internal: Hash a load address, find a module
+ *********************************************************************/
+
+static unsigned
+ovl_hash(const void *start) {
+	return ((uint32_t)start * 2654435761u) >> 16 & (OVL_HASH - 1);
+}
+
+static int
+ovl_find(struct s_ovl *ov,const void *start) {
+	unsigned hx = ovl_hash(start), mx;
+
+	for ( unsigned n = 0; n < OVL_HASH; ++n ) {
+		if ( !(mx = ov->hash[hx]) )
+			break;
+		if ( ov->mods[mx-1].start == start )
+			return mx - 1;
+		hx = (hx + 1) & (OVL_HASH - 1);
+	}
+	return -1;
+}
+
+/*********************************************************************
+ * Set up nregions of region_size bytes each, from linked onwards,
+ * for the modules in mods[]. Returns false if a module does not fit
+ * a region, or there are too many regions or modules.
+ *********************************************************************/
+
+bool
+ovl_init(struct s_ovl *ov,uint32_t spi,void *linked,unsigned nregions,unsigned region_size,struct s_ovl_module *mods,unsigned nmods) {
+	struct s_ovl_module *m;
+	unsigned hx;
+
+	if ( nregions < 1 || nregions > OVL_MAX_REGIONS || nmods > OVL_MAX_MODULES )
+		return false;
+
+	memset(ov,0,sizeof *ov);
+	ov->spi = spi;
+	ov->linked = (uint8_t *)linked;
+	ov->region_size = region_size;
+	ov->nregions = nregions;
+	ov->mods = mods;
+	ov->nmods = nmods;
+	ov->pending = -1;
+
+	for ( unsigned rx = 0; rx < nregions; ++rx ) {
+		ov->region[rx].mem = ov->linked + rx * region_size;
+		ov->region[rx].module = -1;
+	}
+
+	for ( unsigned mx = 0; mx < nmods; ++mx ) {
+		m = &mods[mx];
+		m->size = m->stop - m->start;
+		m->entry = (const uint8_t *)m->func - ov->linked;
+		m->raw = m->zsize = m->zgap = 0;
+		m->region = -1;
+		m->busy = 0;
+		m->prefetched = false;
+		memset(&m->stats,0,sizeof m->stats);
+		if ( m->size > region_size || m->entry >= m->size )
+			return false;
+
+		hx = ovl_hash(m->start);
+		while ( ov->hash[hx] )
+			hx = (hx + 1) & (OVL_HASH - 1);
+		ov->hash[hx] = mx + 1;
+	}
+
+	dwt_enable_cycle_counter();
+	return true;
+}
+
+/*********************************************************************
+ * Internal: Choose a region to load into: a free one, else the
+ * least recently used one whose module is not busy or arriving.
+ * Returns -1 if every region is in use.
+ *********************************************************************/
+
+static int
+ovl_victim(struct s_ovl *ov) {
+	struct s_ovl_region *r;
+	int vx = -1;
+
+	for ( unsigned rx = 0; rx < ov->nregions; ++rx ) {
+		r = &ov->region[rx];
+		if ( r->module < 0 )
+			return rx;
+		if ( ov->mods[r->module].busy || r->module == ov->pending )
+			continue;
+		if ( vx < 0 || (int32_t)(r->stamp - ov->region[vx].stamp) < 0 )
+			vx = rx;
+	}
+	return vx;
+}
+
+/*********************************************************************
+ * Internal: Give region rx to module mx, evicting its module
+ *********************************************************************/
+
+static void
+ovl_assign(struct s_ovl *ov,unsigned rx,unsigned mx) {
+	struct s_ovl_region *r = &ov->region[rx];
+
+	if ( r->module >= 0 ) {
+		struct s_ovl_module *old = &ov->mods[r->module];
+
+		old->region = -1;
+		old->prefetched = false;
+		++old->stats.evictions;
+	}
+	r->module = mx;
+	r->stamp = ov->clock;
+	ov->mods[mx].region = rx;
+}
+
+static void
+ovl_charge(struct s_ovl_stats *st,uint32_t cycles) {
+
+	st->wait_cycles += cycles;
+	if ( cycles > st->max_cycles )
+		st->max_cycles = cycles;
+}
+
+/*********************************************************************
+ * Internal: Add a length's extension bytes (up to one < 255)
+ *********************************************************************/
+
+static unsigned
+ovl_lz_len(const uint8_t **inp,const uint8_t *end,unsigned len) {
+	unsigned b;
+
+	do	{
+		if ( *inp >= end )
+			return 0xFFFF;		// Bad: fails the caller's checks
+		len += (b = *(*inp)++);
+	} while ( b == 255 );
+	return len;
+}
+
+/*********************************************************************
+ * Internal: Decode packed sequences in[0..n) (starting on a chunk
+ * boundary) onto *outp, which must not pass oend. A match may copy
+ * from anywhere after obase. Returns false if the data is bad.
+ *
+ * Sequence: token (literals << 4 | match), literals (15: plus
+ * following bytes up to one < 255), the literal bytes, then if
+ * match != 0, a 16 bit offset and match + 2 bytes copied (15: plus
+ * following bytes, as literals). Token 0 pads out a chunk.
+ *********************************************************************/
+
+static bool
+ovl_lz_decode(const uint8_t *in,unsigned n,uint8_t **outp,uint8_t *obase,uint8_t *oend) {
+	const uint8_t *base = in, *end = in + n;
+	uint8_t *out = *outp, *from;
+	unsigned token, len, off;
+	unsigned tokens = 0, literals = 0, copies = 0;
+
+	while ( in < end && out < oend ) {
+		if ( !(token = *in++) ) {	// Pad: to the next chunk
+			in = base + ((in - base - 1) / OVL_LZ_CHUNK + 1) * OVL_LZ_CHUNK;
+			continue;
+		}
+		++tokens;
+		if ( (len = token >> 4) == 15 )
+			len = ovl_lz_len(&in,end,len);
+		if ( len > (unsigned)(end - in) || len > (unsigned)(oend - out) )
+			return false;
+		literals += len;
+		while ( len-- > 0 )
+			*out++ = *in++;
+
+		if ( !(len = token & 15) )
+			continue;
+		if ( end - in < 2 )
+			return false;
+		off = in[0] | in[1] << 8;
+		in += 2;
+		if ( (len += 2) == 17 )
+			len = ovl_lz_len(&in,end,len);
+		if ( off == 0 || off > (unsigned)(out - obase) || len > (unsigned)(oend - out) )
+			return false;
+		copies += len;
+		for ( from = out - off; len-- > 0; )
+			*out++ = *from++;
+	}
+	OVL_LZ_CPU(tokens,literals,copies);
+	*outp = out;
+	return true;
+}
+
+/*********************************************************************
+ * Internal: Read a packed module's header (once). The SPI must be
+ * idle. Returns false if it is unreadable or does not fit.
+ *********************************************************************/
+
+static bool
+ovl_header(struct s_ovl *ov,struct s_ovl_module *m) {
+	uint8_t hdr[OVL_LZ_HDR];
+
+	if ( m->raw )
+		return true;
+	if ( w25_read_data(ov->spi,(uint32_t)m->start,hdr,sizeof hdr) == W25_FAIL )
+		return false;
+	m->stats.spi_bytes += sizeof hdr;
+	m->zsize = hdr[0] | hdr[1] << 8;
+	m->raw = hdr[2] | hdr[3] << 8;
+	m->zgap = hdr[4] | hdr[5] << 8;
+	if ( m->raw > ov->region_size || m->entry >= m->raw
+	  || m->zsize > m->size - OVL_LZ_HDR || (!m->zsize && m->raw > m->size - OVL_LZ_HDR) ) {
+		m->raw = 0;
+		return false;
+	}
+	return true;
+}
+
+/*********************************************************************
+ * Internal: Load module m into mem, and wait for it. A packed module
+ * is read a chunk at a time, each decoded while the next is read.
+ *********************************************************************/
+
+static bool
+ovl_load(struct s_ovl *ov,struct s_ovl_module *m,uint8_t *mem) {
+	uint32_t addr = (uint32_t)m->start + OVL_LZ_HDR;
+	uint8_t *out = mem, *chunk;
+	unsigned left, n, k = 0;
+	bool ok = true;
+
+	if ( !m->packed ) {
+		m->stats.spi_bytes += m->size;
+		return w25_read_data(ov->spi,(uint32_t)m->start,mem,m->size) != W25_FAIL;
+	}
+	if ( !ovl_header(ov,m) )
+		return false;
+	if ( !m->zsize ) {
+		m->stats.spi_bytes += m->raw;
+		return w25_read_data(ov->spi,addr,mem,m->raw) != W25_FAIL;
+	}
+	if ( !ov->lzbuf )
+		return false;
+
+	left = m->zsize;
+	n = left < OVL_LZ_CHUNK ? left : OVL_LZ_CHUNK;
+	m->stats.spi_bytes += left;
+	w25_read_start(ov->spi,addr,ov->lzbuf,n);
+
+	while ( left > 0 ) {
+		if ( w25_read_wait(ov->spi) == W25_FAIL )
+			return false;
+		chunk = ov->lzbuf + k * OVL_LZ_CHUNK;
+		addr += n;
+		left -= n;
+		if ( left > 0 ) {		// Read the next while decoding
+			k ^= 1;
+			w25_read_start(ov->spi,addr,ov->lzbuf + k * OVL_LZ_CHUNK,
+				left < OVL_LZ_CHUNK ? left : OVL_LZ_CHUNK);
+		}
+		if ( ok )
+			ok = ovl_lz_decode(chunk,n,&out,mem,mem + m->raw);
+		n = left < OVL_LZ_CHUNK ? left : OVL_LZ_CHUNK;
+	}
+	return ok && out == mem + m->raw;
+}
+
+/*********************************************************************
+ * Wait for the prefetch in progress, if any
+ *********************************************************************/
+
+void
+ovl_sync(struct s_ovl *ov) {
+	struct s_ovl_module *m;
+
+	if ( ov->pending < 0 )
+		return;
+	m = &ov->mods[ov->pending];
+	ov->pending = -1;
+	if ( w25_read_wait(ov->spi) != W25_FAIL ) {
+		uint8_t *mem = ov->region[m->region].mem, *out = mem;
+
+		if ( !m->packed || !m->zsize )
+			return;
+		if ( ovl_lz_decode(mem + ov->region_size - m->zsize,m->zsize,&out,mem,mem + m->raw)
+		  && out == mem + m->raw )
+			return;			// Unpacked in place
+	}
+	ov->region[m->region].module = -1;
+	m->region = -1;
+	m->prefetched = false;
+}
+
+/*********************************************************************
+ * Internal: Start reading the first hint of m that is not resident
+ *********************************************************************/
+
+static void
+ovl_prefetch(struct s_ovl *ov,const struct s_ovl_module *m) {
+	struct s_ovl_module *h;
+	uint32_t addr;
+	unsigned n, at;
+	int rx;
+
+	if ( ov->noprefetch || ov->pending >= 0 )
+		return;
+
+	for ( unsigned ux = 0; ux < OVL_HINTS; ++ux ) {
+		if ( !m->hints[ux] || m->hints[ux] > ov->nmods )
+			continue;
+		h = &ov->mods[m->hints[ux] - 1];
+		if ( h->region >= 0 )
+			continue;
+
+		addr = (uint32_t)h->start;
+		n = h->size;
+		at = 0;
+		if ( h->packed ) {		// Packed: at the region's end
+			if ( !ovl_header(ov,h) )
+				continue;
+			addr += OVL_LZ_HDR;
+			n = h->zsize ? h->zsize : h->raw;
+			if ( h->zsize ) {
+				at = ov->region_size - h->zsize;
+				if ( at < h->zgap )
+					continue;	// Can't unpack in place
+			}
+		}
+		if ( (rx = ovl_victim(ov)) < 0 )
+			return;
+		ovl_assign(ov,rx,m->hints[ux] - 1);
+		h->prefetched = true;
+		++h->stats.prefetches;
+		h->stats.spi_bytes += n;
+		ov->pending = m->hints[ux] - 1;
+		w25_read_start(ov->spi,addr,ov->region[rx].mem + at,n);
+		return;
+	}
+}
+
+/*********************************************************************
+ * Look up a module by its load address, loading it if need be.
+ * Returns its entry point in the region it is in, else 0 (unknown
+ * module, read failure, or every region busy). The module stays
+ * put until ovl_done().
+ *********************************************************************/
+
+void *
+ovl_lookup(struct s_ovl *ov,const void *start) {
+	int mx = ovl_find(ov,start), rx;
+	struct s_ovl_module *m;
+	uint32_t t0;
+
+	if ( mx < 0 )
+		return 0;
+	m = &ov->mods[mx];
+	++m->stats.calls;
+	++ov->clock;
+
+	if ( mx == ov->pending ) {		// Still arriving
+		t0 = dwt_read_cycle_counter();
+		ovl_sync(ov);
+		++m->stats.waits;
+		ovl_charge(&m->stats,dwt_read_cycle_counter() - t0);
+	}
+
+	if ( m->region >= 0 ) {
+		++m->stats.hits;
+		if ( m->prefetched ) {
+			++m->stats.prefetch_hits;
+			m->prefetched = false;
+		}
+	} else	{
+		t0 = dwt_read_cycle_counter();
+		ovl_sync(ov);			// SPI is needed now
+		if ( (rx = ovl_victim(ov)) < 0 )
+			return 0;
+		ovl_assign(ov,rx,mx);
+		if ( !ovl_load(ov,m,ov->region[rx].mem) ) {
+			ov->region[rx].module = -1;
+			m->region = -1;
+			return 0;
+		}
+		++m->stats.loads;
+		ovl_charge(&m->stats,dwt_read_cycle_counter() - t0);
+	}
+
+	ov->region[m->region].stamp = ov->clock;
+	++m->busy;
+	ovl_prefetch(ov,m);
+	return ov->region[m->region].mem + m->entry;
+}
+
+/*********************************************************************
+ * The caller has returned from the module: it may be replaced
+ *********************************************************************/
+
+void
+ovl_done(struct s_ovl *ov,const void *start) {
+	int mx = ovl_find(ov,start);
+
+	if ( mx >= 0 && ov->mods[mx].busy > 0 )
+		--ov->mods[mx].busy;
+}
+
+/*********************************************************************
+ * Zero the statistics of all modules
+ *********************************************************************/
+
+void
+ovl_stats_reset(struct s_ovl *ov) {
+
+	for ( unsigned mx = 0; mx < ov->nmods; ++mx )
+		memset(&ov->mods[mx].stats,0,sizeof ov->mods[mx].stats);
+}
+
+// End overlay.c
@@ -0,0 +1,198 @@
+/* sampler.c : Periodic register/memory sampler (TIM3 driven)
+ * Warren W. Gay VE3WWG
+ */
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/cm3/nvic.h>
+
+#include <sampler.h>
+
+#define SAMP_IRQ_PRIO	0x10		// Above FreeRTOS syscall priority
+
+static struct s_samp_chan chan[SAMP_MAX_CHANS];
+static unsigned n_chans = 0;
+static unsigned framesize = 0;		// Bytes per frame
+static unsigned frames_per_half = 0;
+
+static uint8_t buf[2][SAMP_BUFSIZ];	// Double buffer
+static volatile bool full[2];		// Half is ready for the reader
+static volatile uint32_t seqno[2];	// Sequence no. of each half
+static volatile unsigned fill = 0;	// Half being filled by ISR
+static volatile unsigned fillx = 0;	// Frames in that half
+static volatile uint32_t seq = 0;	// Next sequence no.
+static volatile uint32_t overruns = 0;	// Samples dropped
+
+/*********************************************************************
+ * TIM3 update: take one frame
+ *********************************************************************/
+
+void
+tim3_isr(void) {
+	uint8_t *p;
+	uint32_t v;
+
+	TIM_SR(TIM3) = ~TIM_SR_UIF;
+
+	if ( full[fill] ) {
+		++overruns;			// Reader has not caught up
+		return;
+	}
+
+	p = &buf[fill][fillx * framesize];
+	for ( unsigned cx = 0; cx < n_chans; ++cx ) {
+		switch ( chan[cx].width ) {
+		case 1:
+			*p++ = *(volatile uint8_t *)chan[cx].addr;
+			break;
+		case 2:
+			v = *(volatile uint16_t *)chan[cx].addr;
+			*p++ = v;
+			*p++ = v >> 8;
+			break;
+		default:
+			v = *(volatile uint32_t *)chan[cx].addr;
+			*p++ = v;
+			*p++ = v >> 8;
+			*p++ = v >> 16;
+			*p++ = v >> 24;
+		}
+	}
+
+	if ( ++fillx >= frames_per_half ) {
+		seqno[fill] = seq++;
+		full[fill] = true;		// Hand to reader
+		fill ^= 1;
+		fillx = 0;
+	}
+}
+
+/*********************************************************************
+ * TIM3 input clock: APB1, or twice APB1 when APB1 is divided
+ *********************************************************************/
+
+static uint32_t
+tim3_clock(void) {
+
+	if ( RCC_CFGR & (4 << 8) )	// PPRE1 divides HCLK
+		return rcc_apb1_frequency * 2;
+	return rcc_apb1_frequency;
+}
+
+/*********************************************************************
+ * Start sampling
+ *
+ * ARGUMENTS:
+ *	chans		Channels (addresses and widths) to sample
+ *	nchans		# of channels (1..SAMP_MAX_CHANS)
+ *	rate_hz		Frames per second (16..100000), which must
+ *			divide the TIM3 clock (72 MHz) exactly, so
+ *			that frames are exactly 1/rate_hz apart
+ *
+ * RETURNS:
+ *	0		Success
+ *	-1		Bad channel count or width
+ *	-2		Bad rate (range, or not exact)
+ *********************************************************************/
+
+int
+sampler_start(const struct s_samp_chan *chans,unsigned nchans,uint32_t rate_hz) {
+	uint32_t clk = tim3_clock(), ticks, psc;
+
+	if ( nchans < 1 || nchans > SAMP_MAX_CHANS )
+		return -1;
+	if ( rate_hz < 16 || rate_hz > 100000 || clk % rate_hz != 0 )
+		return -2;
+
+	/* Split ticks exactly into prescaler * period, each <= 65536 */
+	ticks = clk / rate_hz;
+	for ( psc = (ticks + 65535) / 65536; psc <= 65536; ++psc )
+		if ( ticks % psc == 0 )
+			break;
+	if ( psc > 65536 )
+		return -2;
+
+	sampler_stop();
+
+	framesize = 0;
+	for ( unsigned cx = 0; cx < nchans; ++cx ) {
+		if ( chans[cx].width != 1 && chans[cx].width != 2 && chans[cx].width != 4 )
+			return -1;
+		chan[cx] = chans[cx];
+		framesize += chans[cx].width;
+	}
+	n_chans = nchans;
+	frames_per_half = SAMP_BUFSIZ / framesize;
+	full[0] = full[1] = false;
+	fill = fillx = 0;
+	seq = overruns = 0;
+
+	rcc_periph_clock_enable(RCC_TIM3);
+	rcc_periph_reset_pulse(RST_TIM3);
+	timer_set_mode(TIM3,TIM_CR1_CKD_CK_INT,TIM_CR1_CMS_EDGE,TIM_CR1_DIR_UP);
+	timer_set_prescaler(TIM3,psc - 1);
+	timer_set_period(TIM3,ticks / psc - 1);
+	timer_enable_irq(TIM3,TIM_DIER_UIE);
+	nvic_set_priority(NVIC_TIM3_IRQ,SAMP_IRQ_PRIO);
+	nvic_enable_irq(NVIC_TIM3_IRQ);
+	timer_enable_counter(TIM3);
+	return 0;
+}
+
+/*********************************************************************
+ * Stop sampling (partial half is discarded)
+ *********************************************************************/
+
+void
+sampler_stop(void) {
+
+	timer_disable_counter(TIM3);
+	timer_disable_irq(TIM3,TIM_DIER_UIE);
+	nvic_disable_irq(NVIC_TIM3_IRQ);
+}
+
+/*********************************************************************
+ * Get the next full half, if any
+ *
+ * RETURNS:
+ *	0 or 1		Half index, to pass to sampler_release()
+ *	-1		Nothing ready
+ *********************************************************************/
+
+int
+sampler_get(const uint8_t **data,unsigned *nframes,uint32_t *seqp) {
+	int half;
+
+	if ( full[0] && full[1] )
+		half = seqno[0] < seqno[1] ? 0 : 1;	// Older half first
+	else if ( full[0] )
+		half = 0;
+	else if ( full[1] )
+		half = 1;
+	else	return -1;
+
+	*data = buf[half];
+	*nframes = frames_per_half;
+	*seqp = seqno[half];
+	return half;
+}
+
+/*********************************************************************
+ * Return a half to the ISR
+ *********************************************************************/
+
+void
+sampler_release(int half) {
+	full[half & 1] = false;
+}
+
+uint32_t
+sampler_overruns(void) {
+	return overruns;
+}
+
+unsigned
+sampler_framesize(void) {
+	return framesize;
+}
+
+// End sampler.c
@@ -0,0 +1,575 @@
+/* w25kv.c : Log structured key/value store on W25Qxx flash
+ * Warren W. Gay VE3WWG
+ *
+ * Sector layout:
+ *	struct kv_shdr		Magic and sequence no. (newer is higher)
+ *	struct kv_rec + data	Records, packed, in the order written
+ *	0xFF...			Erased space
+ *
+ * A record's state byte is programmed to KV_COMMIT only after its
+ * header and data are in flash. Replay at mount applies committed
+ * records sector by sector in sequence order, so the newest value
+ * of each key wins. A sector holding an uncommitted or torn record
+ * is closed: nothing more is appended to it.
+ *
+ * Sector erases are started by w25kv_service() and left running,
+ * without the mutex held. Anyone needing the chip meanwhile takes
+ * it with kv_lock(), which suspends the erase, and kv_unlock()
+ * resumes it.
+ */
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "winbond.h"
+#include "w25kv.h"
+
+#define SECTOR		4096u
+#define NONE		0xFFFF		// No sector
+#define KEY_FREE	0xFFFF		// Free index slot (and erased flash)
+
+#define KV_MAGIC	0x4B353257u	// "W25K"
+#define SSEQ_FREE	0x00000000u	// Sector erased, ready for use
+#define SSEQ_DIRTY	0xFFFFFFFFu	// Sector must be erased
+
+#define KV_DELETE	0x01		// Record flag: key deleted
+#define KV_COMMIT	0x00		// Record state: committed
+
+#ifndef W25KV_IDLE_TICKS
+#define W25KV_IDLE_TICKS 50		// w25kv_task() sleep when idle
+#endif
+#ifndef W25KV_POLL_TICKS
+#define W25KV_POLL_TICKS 1		// w25kv_task() poll while erasing
+#endif
+#ifndef W25KV_SKIP_MAX
+#define W25KV_SKIP_MAX	32		// Dead records passed per compaction step
+#endif
+
+struct kv_shdr {
+	uint32_t	magic;		// KV_MAGIC
+	uint32_t	seq;		// Sector sequence no.
+};
+
+struct kv_rec {
+	uint16_t	key;
+	uint16_t	len;		// Data bytes following
+	uint8_t		flags;		// KV_DELETE
+	uint8_t		state;		// 0xFF until KV_COMMIT
+	uint16_t	crc;		// CRC-16 of key, len, flags and data
+};
+
+#define REC_CRC_BYTES	5		// key, len, flags
+#define REC_STATE	5		// Offset of state
+
+enum e_rec {
+	REC_END,			// Erased: no more records
+	REC_OK,				// Committed record
+	REC_SKIP,			// Uncommitted or bad CRC, length valid
+	REC_TORN			// Header unusable
+};
+
+/*********************************************************************
+ * CRC-16 CCITT
+ *********************************************************************/
+
+static uint16_t
+crc16(uint16_t crc,const uint8_t *data,unsigned bytes) {
+
+	while ( bytes-- > 0 ) {
+		crc ^= (uint16_t)*data++ << 8;
+		for ( unsigned bx = 0; bx < 8; ++bx )
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+static inline uint32_t
+sector_addr(struct s_w25kv *kv,unsigned s) {
+	return kv->base + s * SECTOR;
+}
+
+/*********************************************************************
+ * Test if flash is erased from offset to the end of a sector
+ *********************************************************************/
+
+static bool
+kv_blank(struct s_w25kv *kv,unsigned s,unsigned off) {
+	uint32_t buf[16];
+
+	for ( ; off < SECTOR; off += sizeof buf ) {
+		w25_read_data(kv->spi,sector_addr(kv,s)+off,buf,sizeof buf);
+		for ( unsigned ux = 0; ux < sizeof buf / sizeof buf[0]; ++ux )
+			if ( buf[ux] != 0xFFFFFFFFu )
+				return false;
+	}
+	return true;
+}
+
+/*********************************************************************
+ * The erase in progress has finished
+ *********************************************************************/
+
+static void
+kv_erased(struct s_w25kv *kv) {
+
+	kv->sseq[kv->erasing] = SSEQ_FREE;
+	kv->erasing = NONE;
+	++kv->erases;
+}
+
+/*********************************************************************
+ * Take the mutex, and get the chip out of any erase in progress
+ *********************************************************************/
+
+static void
+kv_lock(struct s_w25kv *kv) {
+
+	xSemaphoreTake(kv->mutex,portMAX_DELAY);
+	if ( kv->erasing == NONE )
+		return;
+
+	if ( !(w25_read_sr1(kv->spi) & W25_SR1_BUSY) )
+		kv_erased(kv);
+	else if ( kv->nosuspend ) {
+		w25_wait(kv->spi);		// Sit out the erase
+		kv_erased(kv);
+	} else if ( w25_suspend(kv->spi) ) {
+		kv->suspended = true;
+		++kv->suspends;
+	} else	kv_erased(kv);			// Finished just now
+}
+
+/*********************************************************************
+ * Resume a suspended erase, and give the mutex
+ *********************************************************************/
+
+static void
+kv_unlock(struct s_w25kv *kv) {
+
+	if ( kv->suspended ) {
+		w25_wait(kv->spi);		// Our program must finish first
+		w25_resume(kv->spi);
+		kv->suspended = false;
+	}
+	xSemaphoreGive(kv->mutex);
+}
+
+/*********************************************************************
+ * Index: open addressing with linear probing
+ *********************************************************************/
+
+static inline unsigned
+kv_hash(uint16_t key) {
+	return ((uint32_t)key * 40503u >> 8) & (W25KV_HASH - 1);
+}
+
+static struct s_w25kv_slot *
+kv_find(struct s_w25kv *kv,uint16_t key) {
+	unsigned x = kv_hash(key);
+
+	while ( kv->index[x].key != KEY_FREE ) {
+		if ( kv->index[x].key == key )
+			return &kv->index[x];
+		x = (x + 1) & (W25KV_HASH - 1);
+	}
+	return 0;
+}
+
+static bool
+kv_index_put(struct s_w25kv *kv,uint16_t key,uint16_t len,uint32_t addr) {
+	unsigned x = kv_hash(key);
+
+	while ( kv->index[x].key != KEY_FREE && kv->index[x].key != key )
+		x = (x + 1) & (W25KV_HASH - 1);
+
+	if ( kv->index[x].key == KEY_FREE ) {
+		if ( kv->nkeys >= W25KV_MAX_KEYS )
+			return false;
+		++kv->nkeys;
+	} else	kv->live -= sizeof(struct kv_rec) + kv->index[x].len;
+
+	kv->index[x].key = key;
+	kv->index[x].len = len;
+	kv->index[x].addr = addr;
+	kv->live += sizeof(struct kv_rec) + len;
+	return true;
+}
+
+static void
+kv_index_del(struct s_w25kv *kv,uint16_t key) {
+	struct s_w25kv_slot *sp = kv_find(kv,key);
+	unsigned x, y, h;
+
+	if ( !sp )
+		return;
+	kv->live -= sizeof(struct kv_rec) + sp->len;
+	--kv->nkeys;
+
+	// Shift later entries of the probe run back, so lookups still work
+	x = sp - kv->index;
+	for (;;) {
+		kv->index[x].key = KEY_FREE;
+		y = x;
+		for (;;) {
+			y = (y + 1) & (W25KV_HASH - 1);
+			if ( kv->index[y].key == KEY_FREE )
+				return;
+			h = kv_hash(kv->index[y].key);
+			if ( x <= y ? (h <= x || h > y) : (h <= x && h > y) )
+				break;		// Entry y may move to x
+		}
+		kv->index[x] = kv->index[y];
+		x = y;
+	}
+}
+
+/*********************************************************************
+ * Read and check the record at offset off of sector s
+ *********************************************************************/
+
+static enum e_rec
+kv_rec_read(struct s_w25kv *kv,unsigned s,unsigned off,struct kv_rec *rec) {
+	uint8_t buf[32];
+	uint32_t addr = sector_addr(kv,s) + off;
+	uint16_t crc;
+	unsigned n;
+
+	if ( off + sizeof *rec > SECTOR )
+		return REC_END;
+	w25_read_data(kv->spi,addr,rec,sizeof *rec);
+	if ( rec->key == KEY_FREE && rec->len == 0xFFFF && rec->flags == 0xFF
+	  && rec->state == 0xFF && rec->crc == 0xFFFF )
+		return REC_END;
+	if ( rec->key == KEY_FREE || rec->len > W25KV_MAX_LEN
+	  || off + sizeof *rec + rec->len > SECTOR )
+		return REC_TORN;
+	if ( rec->state != KV_COMMIT )
+		return REC_SKIP;
+
+	crc = crc16(0xFFFF,(const uint8_t *)rec,REC_CRC_BYTES);
+	addr += sizeof *rec;
+	for ( unsigned ux = 0; ux < rec->len; ux += n ) {
+		n = rec->len - ux < sizeof buf ? rec->len - ux : sizeof buf;
+		w25_read_data(kv->spi,addr+ux,buf,n);
+		crc = crc16(crc,buf,n);
+	}
+	return crc == rec->crc ? REC_OK : REC_SKIP;
+}
+
+/*********************************************************************
+ * Start a new head sector (the next erased one around the ring)
+ *
+ * Appends leave one erased sector for compaction to copy into.
+ *********************************************************************/
+
+static int
+kv_open(struct s_w25kv *kv,bool compacting) {
+	struct kv_shdr sh;
+	unsigned nfree = 0, s = NONE;
+
+	for ( unsigned ux = 0; ux < kv->nsectors; ++ux ) {
+		unsigned sx = (kv->head == NONE ? ux : kv->head + 1 + ux) % kv->nsectors;
+
+		if ( kv->sseq[sx] == SSEQ_FREE ) {
+			if ( s == NONE )
+				s = sx;
+			++nfree;
+		}
+	}
+	if ( nfree <= (compacting ? 0u : 1u) )
+		return W25KV_EAGAIN;
+
+	sh.magic = KV_MAGIC;
+	sh.seq = ++kv->seq;
+	if ( w25_write_data(kv->spi,sector_addr(kv,s),&sh,sizeof sh) == 0xFFFFFFFF ) {
+		kv->sseq[s] = SSEQ_DIRTY;
+		return W25KV_EIO;
+	}
+	kv->sseq[s] = sh.seq;
+	kv->head = s;
+	kv->wroff = sizeof sh;
+	return 0;
+}
+
+/*********************************************************************
+ * Append a record: data from RAM, or (data null) copied from flash
+ *********************************************************************/
+
+static int
+kv_append(struct s_w25kv *kv,struct kv_rec *rec,const void *data,uint32_t src,bool compacting) {
+	static const uint8_t commit = KV_COMMIT;
+	unsigned reclen = sizeof *rec + rec->len, n;
+	uint32_t addr;
+	uint8_t buf[32];
+	int rc;
+
+	if ( kv->head == NONE || kv->wroff + reclen > SECTOR )
+		if ( (rc = kv_open(kv,compacting)) < 0 )
+			return rc;
+
+	addr = sector_addr(kv,kv->head) + kv->wroff;
+	kv->wroff += reclen;		// Space is used, even on failure
+
+	rec->state = 0xFF;		// Commit comes last
+	if ( w25_write_data(kv->spi,addr,rec,sizeof *rec) == 0xFFFFFFFF )
+		return W25KV_EIO;
+
+	if ( data ) {
+		if ( rec->len > 0
+		  && w25_write_data(kv->spi,addr+sizeof *rec,(void *)data,rec->len) == 0xFFFFFFFF )
+			return W25KV_EIO;
+	} else	{
+		for ( unsigned ux = 0; ux < rec->len; ux += n ) {
+			n = rec->len - ux < sizeof buf ? rec->len - ux : sizeof buf;
+			w25_read_data(kv->spi,src+ux,buf,n);
+			if ( w25_write_data(kv->spi,addr+sizeof *rec+ux,buf,n) == 0xFFFFFFFF )
+				return W25KV_EIO;
+		}
+	}
+
+	if ( w25_write_data(kv->spi,addr+REC_STATE,(void *)&commit,1) == 0xFFFFFFFF )
+		return W25KV_EIO;
+
+	if ( rec->flags & KV_DELETE )
+		kv_index_del(kv,rec->key);
+	else	kv_index_put(kv,rec->key,rec->len,addr);
+	return 0;
+}
+
+/*********************************************************************
+ * Mount: scan sector headers, then replay records oldest first
+ *
+ * The kv struct must be zeroed (static) when first mounted.
+ *********************************************************************/
+
+int
+w25kv_mount(struct s_w25kv *kv,uint32_t spi,uint32_t base,unsigned nsectors) {
+	SemaphoreHandle_t mutex = kv->mutex;
+	struct kv_shdr sh;
+	struct kv_rec rec;
+	enum e_rec rc;
+	uint32_t last = 0, low;
+	unsigned s, off;
+	bool open;
+
+	if ( (base & (SECTOR - 1)) != 0
+	  || nsectors < W25KV_SPARE + 2 || nsectors > W25KV_MAX_SECTORS )
+		return W25KV_EINVAL;
+
+	memset(kv,0,sizeof *kv);
+	kv->mutex = mutex ? mutex : xSemaphoreCreateMutex();
+	kv->spi = spi;
+	kv->base = base;
+	kv->nsectors = nsectors;
+	kv->head = kv->ctail = kv->erasing = NONE;
+	w25_wait(spi);			// Any erase left running
+	for ( unsigned ux = 0; ux < W25KV_HASH; ++ux )
+		kv->index[ux].key = KEY_FREE;
+
+	for ( s = 0; s < nsectors; ++s ) {
+		w25_read_data(spi,sector_addr(kv,s),&sh,sizeof sh);
+		if ( sh.magic == KV_MAGIC && sh.seq != SSEQ_FREE && sh.seq != SSEQ_DIRTY ) {
+			kv->sseq[s] = sh.seq;
+			if ( sh.seq > kv->seq )
+				kv->seq = sh.seq;
+		} else if ( sh.magic == 0xFFFFFFFFu && sh.seq == 0xFFFFFFFFu && kv_blank(kv,s,0) )
+			kv->sseq[s] = SSEQ_FREE;
+		else	kv->sseq[s] = SSEQ_DIRTY;	// Torn erase or header
+	}
+
+	for (;;) {
+		// Next sector in sequence order
+		s = NONE;
+		low = SSEQ_DIRTY;
+		for ( unsigned ux = 0; ux < nsectors; ++ux ) {
+			if ( kv->sseq[ux] > last && kv->sseq[ux] < low ) {
+				low = kv->sseq[ux];
+				s = ux;
+			}
+		}
+		if ( s == NONE )
+			break;
+		last = low;
+
+		open = true;
+		for ( off = sizeof sh; (rc = kv_rec_read(kv,s,off,&rec)) != REC_END; off += sizeof rec + rec.len ) {
+			if ( rc == REC_TORN ) {
+				open = false;
+				break;
+			}
+			if ( rc == REC_SKIP ) {
+				open = false;		// Write was cut short
+				continue;
+			}
+			if ( rec.flags & KV_DELETE )
+				kv_index_del(kv,rec.key);
+			else	kv_index_put(kv,rec.key,rec.len,sector_addr(kv,s)+off);
+		}
+		kv->head = s;
+		kv->wroff = open && kv_blank(kv,s,off) ? off : SECTOR;
+	}
+	return 0;
+}
+
+/*********************************************************************
+ * Get a value: returns its length (copies at most bufsiz bytes)
+ *********************************************************************/
+
+int
+w25kv_get(struct s_w25kv *kv,uint16_t key,void *buf,unsigned bufsiz) {
+	struct s_w25kv_slot *sp;
+	int rc = W25KV_ENOENT;
+
+	kv_lock(kv);
+	if ( (sp = kv_find(kv,key)) != 0 ) {
+		if ( bufsiz > sp->len )
+			bufsiz = sp->len;
+		if ( bufsiz > 0 )
+			w25_read_data(kv->spi,sp->addr+sizeof(struct kv_rec),buf,bufsiz);
+		rc = sp->len;
+	}
+	kv_unlock(kv);
+	return rc;
+}
+
+/*********************************************************************
+ * Put a value (never erases: may return W25KV_EAGAIN)
+ *********************************************************************/
+
+int
+w25kv_put(struct s_w25kv *kv,uint16_t key,const void *data,unsigned len) {
+	struct s_w25kv_slot *sp;
+	struct kv_rec rec;
+	uint32_t live, cap;
+	int rc;
+
+	if ( key == KEY_FREE || len > W25KV_MAX_LEN )
+		return W25KV_EINVAL;
+
+	rec.key = key;
+	rec.len = len;
+	rec.flags = 0;
+	rec.crc = crc16(crc16(0xFFFF,(const uint8_t *)&rec,REC_CRC_BYTES),data,len);
+
+	// Live data must fit with the spare sectors free, and a max
+	// record's worth of slack at the end of each sector.
+	cap = (kv->nsectors - W25KV_SPARE - 1)
+		* (SECTOR - sizeof(struct kv_shdr) - sizeof rec - W25KV_MAX_LEN);
+
+	kv_lock(kv);
+	sp = kv_find(kv,key);
+	live = kv->live - (sp ? sizeof rec + sp->len : 0) + sizeof rec + len;
+	if ( (!sp && kv->nkeys >= W25KV_MAX_KEYS) || live > cap )
+		rc = W25KV_EFULL;
+	else	rc = kv_append(kv,&rec,data,0,false);
+	kv_unlock(kv);
+	return rc;
+}
+
+/*********************************************************************
+ * Delete a key
+ *********************************************************************/
+
+int
+w25kv_delete(struct s_w25kv *kv,uint16_t key) {
+	struct kv_rec rec;
+	int rc;
+
+	rec.key = key;
+	rec.len = 0;
+	rec.flags = KV_DELETE;
+	rec.crc = crc16(0xFFFF,(const uint8_t *)&rec,REC_CRC_BYTES);
+
+	kv_lock(kv);
+	rc = kv_find(kv,key) ? kv_append(kv,&rec,0,0,false) : W25KV_ENOENT;
+	kv_unlock(kv);
+	return rc;
+}
+
+/*********************************************************************
+ * Background work, one step per call (returns false when waiting
+ * or idle):
+ *
+ *	1. If an erase is running, note when it finishes
+ *	2. Else start erasing a dirty sector
+ *	3. With fewer than W25KV_SPARE erased sectors, pick the oldest
+ *	   sector, and copy its live records to the head one at a time
+ *	   (passing up to W25KV_SKIP_MAX dead ones on the way)
+ *	4. When all are copied, mark it dirty (erased by step 2)
+ *********************************************************************/
+
+bool
+w25kv_service(struct s_w25kv *kv) {
+	struct s_w25kv_slot *sp;
+	struct kv_rec rec;
+	enum e_rec rc;
+	unsigned s, nfree = 0;
+	uint32_t addr, low = SSEQ_DIRTY;
+	bool worked = true;
+
+	xSemaphoreTake(kv->mutex,portMAX_DELAY);
+
+	for ( s = 0; s < kv->nsectors && kv->sseq[s] != SSEQ_DIRTY; ++s )
+		nfree += kv->sseq[s] == SSEQ_FREE;
+
+	if ( kv->erasing != NONE ) {
+		if ( !(w25_read_sr1(kv->spi) & W25_SR1_BUSY) )
+			kv_erased(kv);
+		else	worked = false;		// Still erasing
+	} else if ( s < kv->nsectors ) {
+		w25_write_en(kv->spi,true);
+		if ( w25_erase_start(kv->spi,sector_addr(kv,s),W25_CMD_ERA_SECTOR) )
+			kv->erasing = s;
+		else	worked = false;		// Write protected: retry later
+	} else if ( kv->ctail == NONE ) {
+		if ( nfree < W25KV_SPARE ) {
+			for ( unsigned ux = 0; ux < kv->nsectors; ++ux ) {
+				if ( ux != kv->head && kv->sseq[ux] != SSEQ_FREE && kv->sseq[ux] < low ) {
+					low = kv->sseq[ux];
+					kv->ctail = ux;
+				}
+			}
+			kv->coff = sizeof(struct kv_shdr);
+		}
+		worked = kv->ctail != NONE;
+	} else	{
+		for ( unsigned ux = 0; ux < W25KV_SKIP_MAX; ++ux ) {
+			rc = kv_rec_read(kv,kv->ctail,kv->coff,&rec);
+			if ( rc == REC_END || rc == REC_TORN ) {
+				kv->sseq[kv->ctail] = SSEQ_DIRTY;
+				kv->ctail = NONE;
+				break;
+			}
+			addr = sector_addr(kv,kv->ctail) + kv->coff;
+			if ( rc == REC_OK && !(rec.flags & KV_DELETE)
+			  && (sp = kv_find(kv,rec.key)) != 0 && sp->addr == addr ) {
+				if ( kv_append(kv,&rec,0,addr+sizeof rec,true) < 0 )
+					worked = false;	// Retry this record
+				else	kv->coff += sizeof rec + rec.len;
+				break;			// One copy per step
+			}
+			kv->coff += sizeof rec + rec.len;	// Dead record
+		}
+	}
+
+	xSemaphoreGive(kv->mutex);
+	return worked;
+}
+
+/*********************************************************************
+ * Task: run w25kv_service() whenever there is work (arg is the kv)
+ *********************************************************************/
+
+void
+w25kv_task(void *arg) {
+	struct s_w25kv *kv = (struct s_w25kv *)arg;
+
+	for (;;) {
+		if ( !w25kv_service(kv) )
+			vTaskDelay(kv->erasing != NONE ? W25KV_POLL_TICKS : W25KV_IDLE_TICKS);
+	}
+}
+
+// End w25kv.c
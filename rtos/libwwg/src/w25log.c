@@ -0,0 +1,486 @@
+/* w25log.c : Append-only data log on W25Qxx flash, erased ahead
+ * Warren W. Gay VE3WWG
+ *
+ * Sector layout:
+ *	struct log_shdr		Magic and sequence no. (newer is higher)
+ *	uint16_t len, data	Records, packed, in the order written
+ *	0xFF...			Erased space
+ *
+ * Appends are gathered in a RAM copy of the head's current page, and
+ * a page is programmed once, when it fills (or on w25log_flush()).
+ * A page program takes about as long for 4 bytes as for 256, so
+ * this keeps the chip free for the erases ahead. The sector header
+ * goes out with the first page, so a sector opened but never
+ * programmed is still blank (free) after a power loss.
+ *
+ * The log task erases the sectors ahead of the head, one at a time,
+ * without holding the mutex while the chip is busy. Anyone needing
+ * the chip meanwhile calls log_idle(), which suspends the erase, and
+ * log_unlock() resumes it.
+ */
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "winbond.h"
+#include "w25log.h"
+
+#define SECTOR		4096u
+#define NONE		0xFFFF		// No sector
+#define LEN_END		0xFFFF		// Erased record length
+
+#define LOG_MAGIC	0x4C353257u	// "W25L"
+#define SSEQ_FREE	0x00000000u	// Sector erased, ready for use
+#define SSEQ_DIRTY	0xFFFFFFFFu	// Sector must be erased
+
+#ifndef W25LOG_POLL_TICKS
+#define W25LOG_POLL_TICKS 1		// w25log_task() poll while erasing
+#endif
+#ifndef W25LOG_IDLE_TICKS
+#define W25LOG_IDLE_TICKS 20		// w25log_task() sleep when idle
+#endif
+
+struct log_shdr {
+	uint32_t	magic;		// LOG_MAGIC
+	uint32_t	seq;		// Sector sequence no.
+};
+
+static inline uint32_t
+sector_addr(struct s_w25log *log,unsigned s) {
+	return log->base + s * SECTOR;
+}
+
+/*********************************************************************
+ * Test if flash is erased from offset to the end of a sector
+ *********************************************************************/
+
+static bool
+log_blank(struct s_w25log *log,unsigned s,unsigned off) {
+	uint32_t buf[16];
+
+	for ( ; off < SECTOR; off += sizeof buf ) {
+		w25_read_data(log->spi,sector_addr(log,s)+off,buf,sizeof buf);
+		for ( unsigned ux = 0; ux < sizeof buf / sizeof buf[0]; ++ux )
+			if ( buf[ux] != 0xFFFFFFFFu )
+				return false;
+	}
+	return true;
+}
+
+/*********************************************************************
+ * The erase in progress has finished
+ *********************************************************************/
+
+static void
+log_erased(struct s_w25log *log) {
+
+	log->sseq[log->erasing] = SSEQ_FREE;
+	log->erasing = NONE;
+	++log->stats.erases;
+}
+
+/*********************************************************************
+ * Get the chip out of any erase in progress (mutex held)
+ *********************************************************************/
+
+static void
+log_idle(struct s_w25log *log) {
+
+	if ( log->erasing == NONE || log->suspended )
+		return;
+
+	if ( !(w25_read_sr1(log->spi) & W25_SR1_BUSY) )
+		log_erased(log);
+	else if ( log->nosuspend ) {
+		w25_wait(log->spi);		// Sit out the erase
+		log_erased(log);
+	} else if ( w25_suspend(log->spi) ) {
+		log->suspended = true;
+		++log->stats.suspends;
+	} else	log_erased(log);		// Finished just now
+}
+
+/*********************************************************************
+ * Resume a suspended erase, and give the mutex
+ *********************************************************************/
+
+static void
+log_unlock(struct s_w25log *log) {
+
+	if ( log->suspended ) {
+		w25_wait(log->spi);		// Our program must finish first
+		w25_resume(log->spi);
+		log->suspended = false;
+	}
+	xSemaphoreGive(log->mutex);
+}
+
+/*********************************************************************
+ * Program the buffered page, from what is already out to wroff
+ *********************************************************************/
+
+static int
+log_flush_page(struct s_w25log *log) {
+	unsigned end = log->wroff - log->pgbase;
+
+	if ( log->head == NONE || end <= log->pgoff )
+		return 0;
+
+	log_idle(log);
+	if ( w25_write_data(log->spi,sector_addr(log,log->head)+log->pgbase+log->pgoff,
+	    log->page+log->pgoff,end-log->pgoff) == 0xFFFFFFFF )
+		return W25LOG_EIO;
+	log->pgoff = end;
+	log->flushed = log->wroff;
+	return 0;
+}
+
+/*********************************************************************
+ * Add bytes at wroff, programming each page as it fills
+ *********************************************************************/
+
+static int
+log_put(struct s_w25log *log,const void *data,unsigned bytes) {
+	const uint8_t *udata = (const uint8_t *)data;
+	unsigned n;
+	int rc;
+
+	while ( bytes > 0 ) {
+		n = W25_PAGE_SIZE - (log->wroff - log->pgbase);
+		if ( n > bytes )
+			n = bytes;
+		memcpy(log->page+(log->wroff-log->pgbase),udata,n);
+		log->wroff += n;
+		udata += n;
+		bytes -= n;
+
+		if ( log->wroff - log->pgbase == W25_PAGE_SIZE ) {
+			rc = log_flush_page(log);
+			log->pgbase += W25_PAGE_SIZE;
+			log->pgoff = 0;
+			if ( rc < 0 )
+				return rc;
+		}
+	}
+	return 0;
+}
+
+/*********************************************************************
+ * Start a new head sector: the next one, which must be erased
+ *********************************************************************/
+
+static int
+log_open(struct s_w25log *log) {
+	struct log_shdr sh;
+	unsigned s = NONE;
+	int rc;
+
+	if ( (rc = log_flush_page(log)) < 0 )
+		return rc;
+
+	if ( log->head != NONE )
+		s = (log->head + 1) % log->nsectors;
+	else	{
+		for ( unsigned ux = 0; ux < log->nsectors && s == NONE; ++ux )
+			if ( log->sseq[ux] == SSEQ_FREE )
+				s = ux;
+	}
+	if ( s == NONE || log->sseq[s] != SSEQ_FREE )
+		return W25LOG_EAGAIN;
+
+	sh.magic = LOG_MAGIC;
+	sh.seq = ++log->seq;
+	log->sseq[s] = sh.seq;
+	log->head = s;
+	log->wroff = log->pgbase = log->pgoff = log->flushed = 0;
+	return log_put(log,&sh,sizeof sh);	// Programmed with the page
+}
+
+/*********************************************************************
+ * Sector holding sequence no. seq, else NONE
+ *********************************************************************/
+
+static unsigned
+log_find(struct s_w25log *log,uint32_t seq) {
+
+	for ( unsigned s = 0; s < log->nsectors; ++s )
+		if ( log->sseq[s] == seq )
+			return s;
+	return NONE;
+}
+
+static uint32_t
+log_oldest(struct s_w25log *log) {
+	uint32_t low = SSEQ_DIRTY;
+
+	for ( unsigned s = 0; s < log->nsectors; ++s )
+		if ( log->sseq[s] != SSEQ_FREE && log->sseq[s] < low )
+			low = log->sseq[s];
+	return low;
+}
+
+/*********************************************************************
+ * Mount: scan sector headers, and find the end of the newest
+ *
+ * The log struct must be zeroed (static) when first mounted.
+ *********************************************************************/
+
+int
+w25log_mount(struct s_w25log *log,uint32_t spi,uint32_t base,unsigned nsectors) {
+	SemaphoreHandle_t mutex = log->mutex;
+	struct log_shdr sh;
+	uint16_t len = LEN_END;
+	unsigned off;
+
+	if ( (base & (SECTOR - 1)) != 0
+	  || nsectors < W25LOG_AHEAD + 2 || nsectors > W25LOG_MAX_SECTORS )
+		return W25LOG_EINVAL;
+
+	memset(log,0,sizeof *log);
+	log->mutex = mutex ? mutex : xSemaphoreCreateMutex();
+	log->spi = spi;
+	log->base = base;
+	log->nsectors = nsectors;
+	log->head = log->erasing = NONE;
+
+	for ( unsigned s = 0; s < nsectors; ++s ) {
+		w25_read_data(spi,sector_addr(log,s),&sh,sizeof sh);
+		if ( sh.magic == LOG_MAGIC && sh.seq != SSEQ_FREE && sh.seq != SSEQ_DIRTY ) {
+			log->sseq[s] = sh.seq;
+			if ( sh.seq > log->seq ) {
+				log->seq = sh.seq;
+				log->head = s;
+			}
+		} else if ( sh.magic == 0xFFFFFFFFu && sh.seq == 0xFFFFFFFFu && log_blank(log,s,0) )
+			log->sseq[s] = SSEQ_FREE;
+		else	log->sseq[s] = SSEQ_DIRTY;	// Torn erase or header
+	}
+
+	if ( log->head != NONE ) {
+		for ( off = sizeof sh; off + sizeof len <= SECTOR; off += sizeof len + len ) {
+			w25_read_data(spi,sector_addr(log,log->head)+off,&len,sizeof len);
+			if ( len == LEN_END || len > W25LOG_MAX_LEN || off + sizeof len + len > SECTOR )
+				break;
+		}
+		log->wroff = len == LEN_END && log_blank(log,log->head,off) ? off : SECTOR;
+		log->pgbase = log->wroff & ~(W25_PAGE_SIZE - 1);
+		log->pgoff = log->wroff - log->pgbase;	// Already programmed
+		log->flushed = log->wroff;
+	}
+	return 0;
+}
+
+/*********************************************************************
+ * Append a record (never erases: may return W25LOG_EAGAIN)
+ *
+ * The record is readable, and safe from power loss, once its page
+ * is programmed: when the page fills, or at w25log_flush().
+ *********************************************************************/
+
+int
+w25log_append(struct s_w25log *log,const void *data,unsigned len) {
+	TickType_t t0 = xTaskGetTickCount(), dt;
+	uint16_t rlen = len;
+	unsigned b;
+	int rc = 0;
+
+	if ( len == 0 || len > W25LOG_MAX_LEN )
+		return W25LOG_EINVAL;
+
+	xSemaphoreTake(log->mutex,portMAX_DELAY);
+	if ( log->head == NONE || log->wroff + sizeof rlen + len > SECTOR )
+		rc = log_open(log);
+	if ( rc == 0 && (rc = log_put(log,&rlen,sizeof rlen)) == 0 )
+		rc = log_put(log,data,len);
+
+	if ( rc == W25LOG_EAGAIN )
+		++log->stats.eagain;
+	else if ( rc == 0 ) {
+		++log->stats.appends;
+		log->stats.bytes += len;
+	}
+
+	if ( log->suspended )
+		w25_wait(log->spi);		// Count the program's time
+	dt = xTaskGetTickCount() - t0;
+	if ( dt > log->stats.max_ticks )
+		log->stats.max_ticks = dt;
+	for ( b = 0; b < W25LOG_NBUCKETS - 1 && dt >= (1u << b); ++b )
+		;
+	++log->stats.hist[b];
+
+	log_unlock(log);
+	return rc;
+}
+
+/*********************************************************************
+ * Program any records still in RAM
+ *********************************************************************/
+
+int
+w25log_flush(struct s_w25log *log) {
+	int rc;
+
+	xSemaphoreTake(log->mutex,portMAX_DELAY);
+	rc = log_flush_page(log);
+	log_unlock(log);
+	return rc;
+}
+
+/*********************************************************************
+ * Point a cursor at the oldest record
+ *********************************************************************/
+
+void
+w25log_rewind(struct s_w25log *log,struct s_w25log_cursor *cur) {
+	uint32_t oldest;
+
+	xSemaphoreTake(log->mutex,portMAX_DELAY);
+	oldest = log_oldest(log);
+	cur->seq = oldest != SSEQ_DIRTY ? oldest : log->seq + 1;
+	cur->off = sizeof(struct log_shdr);
+	xSemaphoreGive(log->mutex);
+}
+
+/*********************************************************************
+ * Read the record at the cursor, and advance it
+ *
+ * Only records programmed to flash are seen (see w25log_flush()).
+ *
+ * RETURNS:
+ *	>= 0		Record length (at most bufsiz bytes are copied)
+ *	W25LOG_ENOENT	No more records (yet)
+ *	W25LOG_ELOST	Records were dropped before they were read:
+ *			the cursor is moved to the oldest
+ *********************************************************************/
+
+int
+w25log_read(struct s_w25log *log,struct s_w25log_cursor *cur,void *buf,unsigned bufsiz) {
+	uint16_t len;
+	uint32_t addr;
+	unsigned s, limit;
+	int rc;
+
+	xSemaphoreTake(log->mutex,portMAX_DELAY);
+	log_idle(log);
+	for (;;) {
+		if ( (s = log_find(log,cur->seq)) == NONE ) {
+			if ( cur->seq > log->seq ) {
+				rc = W25LOG_ENOENT;
+				break;
+			}
+			if ( cur->seq < log_oldest(log) ) {
+				cur->seq = log_oldest(log);
+				cur->off = sizeof(struct log_shdr);
+				rc = W25LOG_ELOST;
+				break;
+			}
+			++cur->seq;		// Lost to a failed write: skip
+			cur->off = sizeof(struct log_shdr);
+			continue;
+		}
+
+		limit = s == log->head ? log->flushed : SECTOR;
+		addr = sector_addr(log,s) + cur->off;
+		len = LEN_END;
+		if ( cur->off + sizeof len <= limit )
+			w25_read_data(log->spi,addr,&len,sizeof len);
+		if ( len == LEN_END || len > W25LOG_MAX_LEN || cur->off + sizeof len + len > limit ) {
+			if ( s == log->head ) {
+				rc = W25LOG_ENOENT;
+				break;
+			}
+			++cur->seq;		// On to the next sector
+			cur->off = sizeof(struct log_shdr);
+			continue;
+		}
+
+		if ( bufsiz > len )
+			bufsiz = len;
+		if ( bufsiz > 0 )
+			w25_read_data(log->spi,addr+sizeof len,buf,bufsiz);
+		cur->off += sizeof len + len;
+		rc = len;
+		break;
+	}
+	log_unlock(log);
+	return rc;
+}
+
+/*********************************************************************
+ * Background work, one step per call (returns false when waiting,
+ * idle, or the erase would not start, so the task backs off):
+ *
+ *	1. If an erase is running, note when it finishes
+ *	2. Else start erasing the first of the W25LOG_AHEAD sectors
+ *	   after the head that is not erased (dropping its data, if
+ *	   the ring has come round to the oldest sector)
+ *********************************************************************/
+
+bool
+w25log_service(struct s_w25log *log) {
+	unsigned s, hd;
+	bool worked = false;
+
+	xSemaphoreTake(log->mutex,portMAX_DELAY);
+
+	if ( log->erasing != NONE ) {
+		if ( !log->suspended && !(w25_read_sr1(log->spi) & W25_SR1_BUSY) ) {
+			log_erased(log);
+			worked = true;
+		}
+	} else	{
+		hd = log->head == NONE ? log->nsectors - 1 : log->head;
+		for ( unsigned k = 1; k <= W25LOG_AHEAD; ++k ) {
+			s = (hd + k) % log->nsectors;
+			if ( log->sseq[s] == SSEQ_FREE )
+				continue;
+			if ( log->sseq[s] != SSEQ_DIRTY )
+				++log->stats.dropped;	// Oldest data
+			log->sseq[s] = SSEQ_DIRTY;
+			w25_write_en(log->spi,true);
+			if ( !w25_erase_start(log->spi,sector_addr(log,s),W25_CMD_ERA_SECTOR) ) {
+				++log->stats.erase_fails;	// Write protected:
+				break;				// retry when idle
+			}
+			log->erasing = s;
+			worked = true;
+			break;
+		}
+	}
+
+	xSemaphoreGive(log->mutex);
+	return worked;
+}
+
+/*********************************************************************
+ * Task: keep sectors erased ahead (arg is the log)
+ *********************************************************************/
+
+void
+w25log_task(void *arg) {
+	struct s_w25log *log = (struct s_w25log *)arg;
+
+	for (;;) {
+		if ( !w25log_service(log) )
+			vTaskDelay(log->erasing != NONE ? W25LOG_POLL_TICKS : W25LOG_IDLE_TICKS);
+	}
+}
+
+/*********************************************************************
+ * Copy out the statistics (optionally zeroing them)
+ *********************************************************************/
+
+void
+w25log_stats(struct s_w25log *log,struct s_w25log_stats *stats,bool reset) {
+
+	xSemaphoreTake(log->mutex,portMAX_DELAY);
+	*stats = log->stats;
+	if ( reset )
+		memset(&log->stats,0,sizeof log->stats);
+	xSemaphoreGive(log->mutex);
+}
+
+// End w25log.c
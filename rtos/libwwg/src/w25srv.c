@@ -0,0 +1,367 @@
+/* w25srv.c : W25Qxx flash server task, with a request queue
+ * Warren W. Gay VE3WWG
+ *
+ * Two queues, interactive and bulk, are each kept in address order.
+ * w25srv_service() picks the next request (see w25srv.h), removes it
+ * and any reads merged with it from the queue under the mutex, then
+ * does the flash work without the mutex, so clients can submit
+ * while the SPI is busy.
+ *
+ * A flash address has no seek time, so address order buys nothing
+ * by itself on NOR flash. It is what brings reads that follow on
+ * from each other together to be merged, and it keeps every client
+ * moving, however many requests one of them queues.
+ */
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "winbond.h"
+#include "w25srv.h"
+
+#define SECTOR		4096u
+
+#ifndef W25SRV_POLL_TICKS
+#define W25SRV_POLL_TICKS 1		// w25srv_task() poll while erasing
+#endif
+
+/*********************************************************************
+ * Flash span of a request: lo .. hi-1
+ *********************************************************************/
+
+static void
+srv_span(const struct s_w25req *r,uint32_t *lo,uint32_t *hi) {
+
+	if ( r->op == W25SRV_ERASE ) {
+		*lo = r->addr & ~(SECTOR-1);
+		*hi = *lo + SECTOR;
+	} else	{
+		*lo = r->addr;
+		*hi = r->addr + r->bytes;
+	}
+}
+
+static bool
+srv_overlap(const struct s_w25req *a,const struct s_w25req *b) {
+	uint32_t alo, ahi, blo, bhi;
+
+	srv_span(a,&alo,&ahi);
+	srv_span(b,&blo,&bhi);
+	return alo < bhi && blo < ahi;
+}
+
+/*********************************************************************
+ * Test if r must wait: for the erase in progress, or for an earlier
+ * request it overlaps, where either one changes the flash
+ *********************************************************************/
+
+static bool
+srv_blocked(struct s_w25srv *srv,const struct s_w25req *r) {
+
+	if ( srv->erasing && srv_overlap(r,srv->erasing) )
+		return true;
+
+	for ( unsigned cls = 0; cls < 2; ++cls )
+		for ( const struct s_w25req *q = srv->queue[cls]; q; q = q->next )
+			if ( q->seq < r->seq
+			  && (q->op != W25SRV_READ || r->op != W25SRV_READ)
+			  && srv_overlap(q,r) )
+				return true;
+	return false;
+}
+
+/*********************************************************************
+ * C-SCAN: the link to the first request at or above pos that may
+ * go, else the lowest one that may (no erases, if noerase)
+ *********************************************************************/
+
+static struct s_w25req **
+srv_pick(struct s_w25srv *srv,unsigned cls,bool noerase) {
+	struct s_w25req **pp, **low = 0;
+
+	for ( pp = &srv->queue[cls]; *pp; pp = &(*pp)->next ) {
+		if ( (noerase && (*pp)->op == W25SRV_ERASE) || srv_blocked(srv,*pp) )
+			continue;
+		if ( (*pp)->addr >= srv->pos )
+			return pp;
+		if ( !low )
+			low = pp;
+	}
+	if ( low )
+		++srv->stats.sweeps;
+	return low;
+}
+
+/*********************************************************************
+ * Choose the next request, and unlink it (caller has the mutex)
+ *********************************************************************/
+
+static struct s_w25req **
+srv_choose(struct s_w25srv *srv) {
+	bool erasing = srv->erasing != 0;
+	struct s_w25req **pp = 0;
+
+	if ( srv->fifo )
+		return srv->queue[0] && !erasing ? &srv->queue[0] : 0;
+	if ( erasing && srv->nosuspend )
+		return 0;				// Wait out the erase
+
+	if ( !erasing && !srv->nosuspend ) {
+		// An erase runs in the background: start it first
+		for ( unsigned cls = 2; cls-- > 0; )
+			for ( pp = &srv->queue[cls]; *pp; pp = &(*pp)->next )
+				if ( (*pp)->op == W25SRV_ERASE && !srv_blocked(srv,*pp) )
+					return pp;
+		pp = 0;
+	}
+
+	if ( srv->burst < W25SRV_BULK_EVERY )
+		pp = srv_pick(srv,0,erasing);
+	if ( pp ) {
+		++srv->burst;
+	} else if ( (pp = srv_pick(srv,1,erasing)) != 0 ) {
+		srv->burst = 0;
+	} else	pp = srv_pick(srv,0,erasing);	// No bulk work waiting
+	return pp;
+}
+
+/*********************************************************************
+ * Complete a request: status, stats, then callback or notify
+ *********************************************************************/
+
+static void
+srv_done(struct s_w25srv *srv,struct s_w25req *r,int status) {
+	TickType_t ticks = xTaskGetTickCount() - r->ticks;
+	TaskHandle_t task = r->task;
+	void (*done)(struct s_w25req *req) = r->done;
+
+	++srv->stats.requests;
+	if ( ticks > srv->stats.max_ticks[r->bulk] )
+		srv->stats.max_ticks[r->bulk] = ticks;
+
+	r->status = status;			// A waiter may now return
+	if ( done )
+		done(r);
+	else	xTaskNotifyGive(task);
+}
+
+/*********************************************************************
+ * Initialize a server for SPI1 or SPI2 (after w25_spi_setup())
+ *********************************************************************/
+
+void
+w25srv_init(struct s_w25srv *srv,uint32_t spi) {
+
+	memset(srv,0,sizeof *srv);
+	srv->spi = spi;
+	srv->mutex = xSemaphoreCreateMutex();
+}
+
+/*********************************************************************
+ * Queue a request (returns at once: see w25srv.h NOTES (2))
+ *********************************************************************/
+
+void
+w25srv_submit(struct s_w25srv *srv,struct s_w25req *req) {
+	struct s_w25req **pp;
+	unsigned cls = req->bulk && !srv->fifo;
+
+	req->status = W25SRV_QUEUED;
+	req->task = xTaskGetCurrentTaskHandle();
+	req->ticks = xTaskGetTickCount();
+
+	xSemaphoreTake(srv->mutex,portMAX_DELAY);
+	req->seq = srv->seq++;
+	for ( pp = &srv->queue[cls]; *pp; pp = &(*pp)->next )
+		if ( !srv->fifo && (*pp)->addr > req->addr )
+			break;
+	req->next = *pp;
+	*pp = req;
+	xSemaphoreGive(srv->mutex);
+
+	if ( srv->task )
+		xTaskNotifyGive(srv->task);
+}
+
+/*********************************************************************
+ * Serve the next request(s). Returns false if there was nothing to
+ * do (the server may sleep until a submit, or a poll of the erase).
+ *********************************************************************/
+
+bool
+w25srv_service(struct s_w25srv *srv) {
+	struct s_w25req *batch[W25SRV_MAX_MERGE], **pp, *r;
+	struct s_w25seg seg[W25SRV_MAX_MERGE];
+	unsigned n = 0;
+	int status = 0;
+
+	if ( srv->erasing && !srv->suspended
+	  && !(w25_read_sr1(srv->spi) & W25_SR1_BUSY) ) {
+		r = srv->erasing;
+		srv->erasing = 0;
+		srv_done(srv,r,w25_is_wprotect(srv->spi) ? 0 : W25SRV_EIO);
+		return true;
+	}
+
+	xSemaphoreTake(srv->mutex,portMAX_DELAY);
+	if ( (pp = srv_choose(srv)) != 0 ) {
+		r = batch[n++] = *pp;
+		*pp = r->next;
+		// Gather the reads following on from r
+		while ( r->op == W25SRV_READ && !srv->fifo && n < W25SRV_MAX_MERGE
+		  && *pp && (*pp)->op == W25SRV_READ && (*pp)->bytes > 0
+		  && (*pp)->addr == batch[n-1]->addr + batch[n-1]->bytes
+		  && !srv_blocked(srv,*pp) ) {
+			batch[n++] = *pp;
+			*pp = (*pp)->next;
+		}
+	}
+	xSemaphoreGive(srv->mutex);
+
+	if ( n == 0 ) {
+		if ( srv->suspended ) {
+			w25_resume(srv->spi);
+			srv->suspended = false;
+		}
+		return false;
+	}
+	r = batch[0];
+	srv->pos = batch[n-1]->addr + batch[n-1]->bytes;
+
+	if ( srv->erasing && !srv->suspended ) {
+		if ( w25_suspend(srv->spi) ) {
+			srv->suspended = true;
+			++srv->stats.suspends;
+		} else	{
+			struct s_w25req *e = srv->erasing;
+
+			srv->erasing = 0;		// Finished just now
+			srv_done(srv,e,w25_is_wprotect(srv->spi) ? 0 : W25SRV_EIO);
+		}
+	}
+
+	switch ( r->op ) {
+	case W25SRV_READ:
+		++srv->stats.reads;
+		if ( n == 1 ) {
+			if ( w25_read_data(srv->spi,r->addr,r->buf,r->bytes) == 0xFFFFFFFF )
+				status = W25SRV_EIO;
+		} else	{
+			for ( unsigned ux = 0; ux < n; ++ux ) {
+				seg[ux].data = batch[ux]->buf;
+				seg[ux].bytes = batch[ux]->bytes;
+			}
+			srv->stats.merged += n - 1;
+			w25_readv_start(srv->spi,r->addr,seg,n);
+			if ( w25_read_wait(srv->spi) == 0xFFFFFFFF )
+				status = W25SRV_EIO;
+		}
+		break;
+	case W25SRV_WRITE:
+		if ( w25_write_data(srv->spi,r->addr,r->buf,r->bytes) == 0xFFFFFFFF )
+			status = W25SRV_EIO;
+		w25_wait(srv->spi);
+		break;
+	case W25SRV_ERASE:
+		w25_write_en(srv->spi,true);
+		if ( w25_erase_start(srv->spi,r->addr,W25_CMD_ERA_SECTOR) ) {
+			srv->erasing = r;		// Done when BUSY clears
+			return true;
+		}
+		status = W25SRV_EIO;
+		break;
+	default:
+		status = W25SRV_EINVAL;
+	}
+
+	if ( srv->suspended ) {
+		w25_resume(srv->spi);
+		srv->suspended = false;
+	}
+	for ( unsigned ux = 0; ux < n; ++ux )
+		srv_done(srv,batch[ux],status);
+	return true;
+}
+
+/*********************************************************************
+ * The server task (arg is the struct s_w25srv)
+ *********************************************************************/
+
+void
+w25srv_task(void *arg) {
+	struct s_w25srv *srv = (struct s_w25srv *)arg;
+
+	srv->task = xTaskGetCurrentTaskHandle();
+	for (;;) {
+		if ( !w25srv_service(srv) )
+			ulTaskNotifyTake(pdTRUE,srv->erasing ? W25SRV_POLL_TICKS : portMAX_DELAY);
+	}
+}
+
+/*********************************************************************
+ * Submit and wait (not from the server task, nor a done() callback)
+ *********************************************************************/
+
+static int
+srv_wait(struct s_w25srv *srv,struct s_w25req *req) {
+
+	req->done = 0;
+	w25srv_submit(srv,req);
+	while ( req->status == W25SRV_QUEUED )
+		ulTaskNotifyTake(pdTRUE,portMAX_DELAY);
+	return req->status;
+}
+
+int
+w25srv_read(struct s_w25srv *srv,uint32_t addr,void *buf,uint32_t bytes,bool bulk) {
+	struct s_w25req req;
+
+	req.op = W25SRV_READ;
+	req.bulk = bulk;
+	req.addr = addr;
+	req.buf = buf;
+	req.bytes = bytes;
+	return srv_wait(srv,&req);
+}
+
+int
+w25srv_write(struct s_w25srv *srv,uint32_t addr,const void *buf,uint32_t bytes) {
+	struct s_w25req req;
+
+	req.op = W25SRV_WRITE;
+	req.bulk = true;
+	req.addr = addr;
+	req.buf = (void *)buf;
+	req.bytes = bytes;
+	return srv_wait(srv,&req);
+}
+
+int
+w25srv_erase(struct s_w25srv *srv,uint32_t addr) {
+	struct s_w25req req;
+
+	req.op = W25SRV_ERASE;
+	req.bulk = true;
+	req.addr = addr;
+	req.buf = 0;
+	req.bytes = 0;
+	return srv_wait(srv,&req);
+}
+
+/*********************************************************************
+ * Return statistics, optionally resetting them
+ *********************************************************************/
+
+void
+w25srv_stats(struct s_w25srv *srv,struct s_w25srv_stats *stats,bool reset) {
+
+	xSemaphoreTake(srv->mutex,portMAX_DELAY);
+	*stats = srv->stats;
+	if ( reset )
+		memset(&srv->stats,0,sizeof srv->stats);
+	xSemaphoreGive(srv->mutex);
+}
+
+// End w25srv.c
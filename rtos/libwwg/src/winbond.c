@@ -10,9 +10,88 @@
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/dwt.h>
 
 #include "winbond.h"
 
+#ifndef W25_DMA_MIN
+#define W25_DMA_MIN	32		// Shorter transfers use spi_xfer()
+#endif
+#ifndef W25_POLL_TICKS
+#define W25_POLL_TICKS	1		// Ticks between BUSY polls
+#endif
+#ifndef W25_SPIN_US
+#define W25_SPIN_US	1000		// Poll BUSY this long before sleeping
+#endif
+#define W25_SPIN_CYCLES	(W25_SPIN_US * (configCPU_CLOCK_HZ / 1000000u))
+#define W25_DMA_CHUNK	65535u		// Max DMA count per transfer
+#define W25_DMA_PRIO	(configMAX_SYSCALL_INTERRUPT_PRIORITY + 0x10)
+
+/*
+ * DMA transfer state, per SPI:
+ */
+struct s_w25dma {
+	bool		enabled;	// w25_dma_init() was called
+	uint8_t		rx, tx;		// DMA1 channels
+	uint8_t		irq;		// RX channel IRQ
+	volatile bool	busy;		// Transfer in progress
+	volatile bool	error;		// DMA transfer error
+	TaskHandle_t	task;		// Task to notify at completion
+	uint8_t		*rxp;		// Next byte in, else discarded
+	const uint8_t	*txp;		// Next byte out, else DUMMY
+	uint32_t	left;		// Bytes not yet started
+	uint32_t	addr;		// Flash address after the read
+	const struct s_w25seg *seg;	// Next segment of a w25_readv_start()
+	unsigned	nseg;		// Segments left (0 when idle)
+};
+
+static struct s_w25dma w25dma[2] = {
+	{ false, DMA_CHANNEL2, DMA_CHANNEL3, NVIC_DMA1_CHANNEL2_IRQ },	// SPI1
+	{ false, DMA_CHANNEL4, DMA_CHANNEL5, NVIC_DMA1_CHANNEL4_IRQ }	// SPI2
+};
+
+static const uint8_t dummy_tx = DUMMY;	// Sent while reading by DMA
+static uint8_t dummy_rx;		// Received while writing by DMA
+
+static inline struct s_w25dma *
+w25_dma(uint32_t spi) {
+	return &w25dma[spi == SPI1 ? 0 : 1];
+}
+
+/*
+ * Page cache, per SPI (see w25_cache_init()):
+ */
+#define W25_NOPAGE	0xFFFFFFFFu	// Cache line is empty
+#define W25_CHUNK	16		// Bytes per cache line valid bit
+
+struct s_w25line {
+	uint32_t	page;		// Flash address >> 8, or W25_NOPAGE
+	uint32_t	stamp;		// Time of last use, for LRU
+	uint16_t	held;		// Bit k: data[k*W25_CHUNK..] is valid
+	uint8_t		data[W25_PAGE_SIZE];
+};
+
+struct s_w25cache {
+	struct s_w25line *lines;
+	unsigned	nlines;
+	uint32_t	clock;		// Use counter
+	struct s_w25cache_stats stats;
+};
+
+static struct s_w25cache w25cache[2];
+
+static inline struct s_w25cache *
+w25_cache(uint32_t spi) {
+	return &w25cache[spi == SPI1 ? 0 : 1];
+}
+
+static inline uint16_t		// Valid bits covering data[off..off+n-1]
+w25_chunks(uint32_t off,uint32_t n) {
+	return ((2u << (off + n - 1) / W25_CHUNK) - 1) & ~((1u << off / W25_CHUNK) - 1);
+}
+
 /*********************************************************************
  * Read status register 1
  *********************************************************************/
@@ -45,13 +124,29 @@ w25_read_sr2(uint32_t spi) {
 
 /*********************************************************************
  * Wait until not busy
+ *
+ * BUSY is polled without sleeping for W25_SPIN_US, which covers a
+ * page program (tPP 0.7 ms typical), so a page costs its tPP rather
+ * than a whole tick. Past that (erases, slow pages) it is polled
+ * every W25_POLL_TICKS, and other tasks run. W25_SPIN_US 0 always
+ * sleeps. The DWT cycle counter is enabled here on first use, since
+ * the app may have set up SPI without w25_spi_setup(); without it,
+ * BUSY is only polled by sleeping.
  *********************************************************************/
 
 void
 w25_wait(uint32_t spi) {
+	static bool dwt_on = false;
+	uint32_t t0;
 
-	while ( w25_read_sr1(spi) & W25_SR1_BUSY )
-		taskYIELD();
+	if ( !dwt_on )
+		dwt_on = dwt_enable_cycle_counter();
+	t0 = dwt_read_cycle_counter();
+
+	while ( w25_read_sr1(spi) & W25_SR1_BUSY ) {
+		if ( !dwt_on || dwt_read_cycle_counter() - t0 >= W25_SPIN_CYCLES )
+			vTaskDelay(W25_POLL_TICKS);
+	}
 }
 
 /*********************************************************************
@@ -65,6 +160,18 @@ w25_is_wprotect(uint32_t spi) {
 	return !(w25_read_sr1(spi) & W25_SR1_WEL);
 }
 
+/*********************************************************************
+ * Send a one byte command (caller ensures not busy)
+ *********************************************************************/
+
+static void
+w25_cmd(uint32_t spi,uint8_t cmd) {
+
+	spi_enable(spi);
+	spi_xfer(spi,cmd);
+	spi_disable(spi);
+}
+
 /*********************************************************************
  * Write enable/disable:
  *********************************************************************/
@@ -73,10 +180,7 @@ void
 w25_write_en(uint32_t spi,bool en) {
 
 	w25_wait(spi);
-
-	spi_enable(spi);
-	spi_xfer(spi,en ? W25_CMD_WRITE_EN : W25_CMD_WRITE_DI);
-	spi_disable(spi);
+	w25_cmd(spi,en ? W25_CMD_WRITE_EN : W25_CMD_WRITE_DI);
 }
 
 /*********************************************************************
@@ -165,6 +269,8 @@ w25_chip_erase(uint32_t spi) {
 	if ( w25_is_wprotect(spi) )
 		return false;
 
+	w25_cache_inval(spi,0,0xFFFFFFFF);
+
 	spi_enable(spi);
 	spi_xfer(spi,W25_CMD_CHIP_ERASE);
 	spi_disable(spi);
@@ -173,11 +279,163 @@ w25_chip_erase(uint32_t spi) {
 }
 
 /*********************************************************************
- * Read Data
+ * Arm both DMA channels for the next chunk of a transfer
  *********************************************************************/
 
-uint32_t		// New address is returned
-w25_read_data(uint32_t spi,uint32_t addr,void *data,uint32_t bytes) {
+static void
+w25_dma_chunk(struct s_w25dma *d) {
+	uint32_t n = d->left > W25_DMA_CHUNK ? W25_DMA_CHUNK : d->left;
+
+	if ( d->rxp ) {
+		dma_set_memory_address(DMA1,d->rx,(uint32_t)d->rxp);
+		d->rxp += n;
+	}
+	if ( d->txp ) {
+		dma_set_memory_address(DMA1,d->tx,(uint32_t)d->txp);
+		d->txp += n;
+	}
+	dma_set_number_of_data(DMA1,d->rx,n);
+	dma_set_number_of_data(DMA1,d->tx,n);
+	d->left -= n;
+
+	dma_enable_channel(DMA1,d->rx);		// RX must be ready first
+	dma_enable_channel(DMA1,d->tx);
+}
+
+/*********************************************************************
+ * RX DMA complete (or error): next chunk, else release /CS and notify
+ *********************************************************************/
+
+static void
+w25_dma_isr(uint32_t spi,struct s_w25dma *d) {
+	BaseType_t woken = pdFALSE;
+	bool error = dma_get_interrupt_flag(DMA1,d->rx,DMA_TEIF);
+
+	dma_clear_interrupt_flags(DMA1,d->rx,DMA_GIF|DMA_TCIF|DMA_TEIF);
+	dma_disable_channel(DMA1,d->tx);
+	dma_disable_channel(DMA1,d->rx);
+
+	while ( d->left == 0 && d->nseg > 0 && !error ) {
+		d->rxp = (uint8_t *)d->seg->data;	// Next segment of a readv
+		d->left = d->seg->bytes;
+		++d->seg;
+		--d->nseg;
+	}
+	if ( d->left > 0 && !error ) {
+		w25_dma_chunk(d);		// Continues under same /CS
+		return;
+	}
+
+	d->nseg = 0;
+	spi_disable_tx_dma(spi);
+	spi_disable_rx_dma(spi);
+	spi_disable(spi);
+	d->error = error;
+	d->busy = false;
+
+	vTaskNotifyGiveFromISR(d->task,&woken);
+	portYIELD_FROM_ISR(woken);
+}
+
+void
+dma1_channel2_isr(void) {
+	w25_dma_isr(SPI1,&w25dma[0]);
+}
+
+void
+dma1_channel4_isr(void) {
+	w25_dma_isr(SPI2,&w25dma[1]);
+}
+
+/*********************************************************************
+ * Enable DMA transfers on SPI1 or SPI2 (call after w25_spi_setup())
+ *********************************************************************/
+
+void
+w25_dma_init(uint32_t spi) {
+	struct s_w25dma *d = w25_dma(spi);
+
+	rcc_periph_clock_enable(RCC_DMA1);
+
+	dma_channel_reset(DMA1,d->rx);
+	dma_set_peripheral_address(DMA1,d->rx,(uint32_t)&SPI_DR(spi));
+	dma_set_read_from_peripheral(DMA1,d->rx);
+	dma_enable_memory_increment_mode(DMA1,d->rx);
+	dma_set_peripheral_size(DMA1,d->rx,DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1,d->rx,DMA_CCR_MSIZE_8BIT);
+	dma_set_priority(DMA1,d->rx,DMA_CCR_PL_VERY_HIGH);
+	dma_enable_transfer_complete_interrupt(DMA1,d->rx);
+	dma_enable_transfer_error_interrupt(DMA1,d->rx);
+
+	dma_channel_reset(DMA1,d->tx);
+	dma_set_peripheral_address(DMA1,d->tx,(uint32_t)&SPI_DR(spi));
+	dma_set_read_from_memory(DMA1,d->tx);
+	dma_set_peripheral_size(DMA1,d->tx,DMA_CCR_PSIZE_8BIT);
+	dma_set_memory_size(DMA1,d->tx,DMA_CCR_MSIZE_8BIT);
+	dma_set_priority(DMA1,d->tx,DMA_CCR_PL_HIGH);
+
+	nvic_set_priority(d->irq,W25_DMA_PRIO);
+	nvic_enable_irq(d->irq);
+	d->enabled = true;
+}
+
+/*********************************************************************
+ * Start a DMA transfer under the current /CS, which the ISR releases.
+ * RX is always armed (to a dummy byte if rxbuf is null), so that the
+ * RX complete interrupt means the last byte has left the SPI.
+ *********************************************************************/
+
+static void
+w25_dma_start(uint32_t spi,uint8_t *rxbuf,const uint8_t *txbuf,uint32_t bytes) {
+	struct s_w25dma *d = w25_dma(spi);
+
+	if ( rxbuf )
+		dma_enable_memory_increment_mode(DMA1,d->rx);
+	else	{
+		dma_disable_memory_increment_mode(DMA1,d->rx);
+		dma_set_memory_address(DMA1,d->rx,(uint32_t)&dummy_rx);
+	}
+	if ( txbuf )
+		dma_enable_memory_increment_mode(DMA1,d->tx);
+	else	{
+		dma_disable_memory_increment_mode(DMA1,d->tx);
+		dma_set_memory_address(DMA1,d->tx,(uint32_t)&dummy_tx);
+	}
+
+	d->task = xTaskGetCurrentTaskHandle();
+	d->rxp = rxbuf;
+	d->txp = txbuf;
+	d->left = bytes;
+	d->error = false;
+	d->busy = true;
+
+	spi_enable_rx_dma(spi);
+	w25_dma_chunk(d);
+	spi_enable_tx_dma(spi);			// TXE starts the transfer
+}
+
+/*********************************************************************
+ * Block until the DMA transfer completes (false if it failed)
+ *********************************************************************/
+
+static bool
+w25_dma_wait(uint32_t spi) {
+	struct s_w25dma *d = w25_dma(spi);
+
+	while ( d->busy )
+		ulTaskNotifyTake(pdTRUE,portMAX_DELAY);
+	return !d->error;
+}
+
+static bool w25_cache_get(uint32_t spi,uint32_t addr,void *data,uint32_t bytes);
+
+/*********************************************************************
+ * Start a FAST_READ from the flash itself
+ *********************************************************************/
+
+static void
+w25_read_flash(uint32_t spi,uint32_t addr,void *data,uint32_t bytes) {
+	struct s_w25dma *d = w25_dma(spi);
 	uint8_t *udata = (uint8_t*)data;
 
 	w25_wait(spi);
@@ -189,54 +447,374 @@ w25_read_data(uint32_t spi,uint32_t addr,void *data,uint32_t bytes) {
 	spi_xfer(spi,addr & 0xFF);
 	spi_xfer(spi,DUMMY);
 
-	for ( ; bytes-- > 0; ++addr )
-		*udata++ = spi_xfer(spi,0x00);
+	d->addr = addr + bytes;
+	d->error = false;
 
-	spi_disable(spi);
-	return addr;	
+	if ( !d->enabled || bytes < W25_DMA_MIN ) {
+		while ( bytes-- > 0 )
+			*udata++ = spi_xfer(spi,DUMMY);
+		spi_disable(spi);
+		return;
+	}
+
+	w25_dma_start(spi,udata,0,bytes);
+}
+
+/*********************************************************************
+ * Start reading data (FAST_READ)
+ *
+ * With DMA enabled, and at least W25_DMA_MIN bytes, the data is
+ * clocked in by DMA at the full SPI rate and this returns at once.
+ * The calling task must then call w25_read_wait() before using the
+ * buffer, or calling any other w25_*() routine on this SPI.
+ *
+ * If the page cache holds every byte, they are copied from it and
+ * w25_read_wait() returns at once. Otherwise the flash is read into
+ * data directly, without filling the cache: these are the big
+ * overlay and server reads, which would only evict the hot pages
+ * w25_read_data() keeps (filling would also need a bounce buffer).
+ *********************************************************************/
+
+void
+w25_read_start(uint32_t spi,uint32_t addr,void *data,uint32_t bytes) {
+	struct s_w25dma *d = w25_dma(spi);
+
+	if ( w25_cache_get(spi,addr,data,bytes) ) {
+		d->addr = addr + bytes;
+		d->error = false;
+		return;
+	}
+	if ( w25_cache(spi)->nlines > 0 )
+		++w25_cache(spi)->stats.bypassed;
+	w25_read_flash(spi,addr,data,bytes);
+}
+
+/*********************************************************************
+ * Start reading addr onwards into a list of buffers (FAST_READ)
+ *
+ * One read command fills seg[0], then seg[1] and so on. As for
+ * w25_read_start(), w25_read_wait() must be called before the
+ * buffers are used, and seg[] must stay put until then. Segments
+ * are served from the page cache only when it holds all of them.
+ *********************************************************************/
+
+void
+w25_readv_start(uint32_t spi,uint32_t addr,const struct s_w25seg *seg,unsigned nseg) {
+	struct s_w25dma *d = w25_dma(spi);
+	uint32_t bytes = 0, at;
+	uint8_t *udata;
+	unsigned ux;
+
+	for ( ux = 0; ux < nseg; ++ux )
+		bytes += seg[ux].bytes;
+
+	d->addr = addr + bytes;
+	d->error = false;
+	if ( w25_cache_get(spi,addr,0,bytes) ) {
+		for ( ux = 0, at = addr; ux < nseg; at += seg[ux++].bytes )
+			w25_cache_get(spi,at,seg[ux].data,seg[ux].bytes);
+		return;
+	}
+	if ( w25_cache(spi)->nlines > 0 )
+		++w25_cache(spi)->stats.bypassed;
+
+	w25_wait(spi);
+
+	spi_enable(spi);
+	spi_xfer(spi,W25_CMD_FAST_READ);
+	spi_xfer(spi,addr >> 16);
+	spi_xfer(spi,(addr >> 8) & 0xFF);
+	spi_xfer(spi,addr & 0xFF);
+	spi_xfer(spi,DUMMY);
+
+	if ( !d->enabled || bytes < W25_DMA_MIN || seg[0].bytes == 0 ) {
+		for ( ; nseg-- > 0; ++seg ) {
+			udata = (uint8_t *)seg->data;
+			for ( uint32_t n = seg->bytes; n-- > 0; )
+				*udata++ = spi_xfer(spi,DUMMY);
+		}
+		spi_disable(spi);
+		return;
+	}
+
+	d->seg = seg + 1;		// The ISR moves on to these
+	d->nseg = nseg - 1;
+	w25_dma_start(spi,(uint8_t *)seg[0].data,0,seg[0].bytes);
+}
+
+/*********************************************************************
+ * Wait for w25_read_start() to complete
+ *********************************************************************/
+
+uint32_t		// New address is returned (0xFFFFFFFF if DMA failed)
+w25_read_wait(uint32_t spi) {
+
+	if ( !w25_dma_wait(spi) )
+		return 0xFFFFFFFF;
+	return w25_dma(spi)->addr;
+}
+
+/*********************************************************************
+ * Give SPI1 or SPI2 a page cache in caller supplied memory
+ *
+ * ARGUMENTS:
+ *	mem		Word aligned, W25_CACHE_SIZE(npages) bytes
+ *	bytes		Size of mem (0 disables the cache)
+ *
+ * w25_read_data() reads through the cache. w25_read_start() and
+ * w25_readv_start() use it only when it holds the whole read.
+ * w25_write_data() and the erase routines drop the pages they change.
+ *********************************************************************/
+
+void
+w25_cache_init(uint32_t spi,void *mem,unsigned bytes) {
+	struct s_w25cache *c = w25_cache(spi);
+
+	c->lines = (struct s_w25line *)mem;
+	c->nlines = bytes / sizeof(struct s_w25line);
+	c->clock = 0;
+	memset(&c->stats,0,sizeof c->stats);
+	for ( unsigned ux = 0; ux < c->nlines; ++ux )
+		c->lines[ux].page = W25_NOPAGE;
+}
+
+/*********************************************************************
+ * Drop cached pages overlapping addr .. addr+bytes-1
+ *********************************************************************/
+
+void
+w25_cache_inval(uint32_t spi,uint32_t addr,uint32_t bytes) {
+	struct s_w25cache *c = w25_cache(spi);
+	uint32_t first = addr >> 8;
+	uint32_t last = bytes > 0xFFFFFFFF - addr ? 0xFFFFFFFE >> 8 : (addr + bytes - 1) >> 8;
+
+	if ( bytes == 0 )
+		return;
+	for ( unsigned ux = 0; ux < c->nlines; ++ux ) {
+		struct s_w25line *lp = &c->lines[ux];
+
+		if ( lp->page != W25_NOPAGE && lp->page >= first && lp->page <= last ) {
+			lp->page = W25_NOPAGE;
+			++c->stats.invalidated;
+		}
+	}
+}
+
+/*********************************************************************
+ * Copy out the cache statistics (optionally zeroing them)
+ *********************************************************************/
+
+void
+w25_cache_stats(uint32_t spi,struct s_w25cache_stats *stats,bool reset) {
+	struct s_w25cache *c = w25_cache(spi);
+
+	*stats = c->stats;
+	if ( reset )
+		memset(&c->stats,0,sizeof c->stats);
+}
+
+/*********************************************************************
+ * Find the line holding page, if any
+ *********************************************************************/
+
+static struct s_w25line *
+w25_cache_find(struct s_w25cache *c,uint32_t page) {
+
+	for ( unsigned ux = 0; ux < c->nlines; ++ux )
+		if ( c->lines[ux].page == page )
+			return &c->lines[ux];
+	return 0;
+}
+
+/*********************************************************************
+ * Copy addr .. addr+bytes-1 out of the cache, if it holds all of it
+ * (data == 0 only checks)
+ *********************************************************************/
+
+static bool
+w25_cache_get(uint32_t spi,uint32_t addr,void *data,uint32_t bytes) {
+	struct s_w25cache *c = w25_cache(spi);
+	struct s_w25line *lp;
+	uint8_t *udata = (uint8_t*)data;
+	uint32_t a, off, n;
+
+	if ( c->nlines == 0 || bytes == 0 )
+		return false;
+
+	for ( a = addr; a < addr + bytes; a += n ) {
+		off = a & (W25_PAGE_SIZE - 1);
+		n = W25_PAGE_SIZE - off;
+		if ( n > addr + bytes - a )
+			n = addr + bytes - a;
+		if ( !(lp = w25_cache_find(c,a >> 8)) || (w25_chunks(off,n) & ~lp->held) )
+			return false;
+	}
+	if ( !data )
+		return true;
+
+	for ( a = addr; a < addr + bytes; a += n ) {
+		off = a & (W25_PAGE_SIZE - 1);
+		n = W25_PAGE_SIZE - off;
+		if ( n > addr + bytes - a )
+			n = addr + bytes - a;
+		lp = w25_cache_find(c,a >> 8);
+		lp->stamp = ++c->clock;
+		++c->stats.hits;
+		memcpy(udata,lp->data + off,n);
+		udata += n;
+	}
+	return true;
+}
+
+/*********************************************************************
+ * Return the cache line for a page, holding data[off..off+n-1]
+ *
+ * On a miss, the least recently used line is taken. Only the chunks
+ * the line lacks are read (first missing to last missing, in one
+ * command), so a small read moves at most a chunk either side more
+ * than it would uncached, and reads elsewhere in the page are kept.
+ *********************************************************************/
+
+static struct s_w25line *
+w25_cache_line(uint32_t spi,struct s_w25cache *c,uint32_t page,uint16_t off,uint16_t n) {
+	struct s_w25line *lp, *victim = c->lines;
+	uint16_t need;
+	unsigned from, to;
+
+	if ( !(lp = w25_cache_find(c,page)) ) {
+		for ( unsigned ux = 1; ux < c->nlines; ++ux ) {
+			lp = &c->lines[ux];
+			if ( victim->page != W25_NOPAGE
+			  && (lp->page == W25_NOPAGE || lp->stamp < victim->stamp) )
+				victim = lp;	// Empty, else least recently used
+		}
+		lp = victim;
+		lp->page = page;
+		lp->held = 0;
+	}
+	lp->stamp = ++c->clock;
+
+	if ( !(need = w25_chunks(off,n) & ~lp->held) ) {
+		++c->stats.hits;
+		return lp;
+	}
+
+	++c->stats.misses;
+	for ( from = 0; !(need & 1u << from); ++from )
+		;
+	for ( to = W25_PAGE_SIZE / W25_CHUNK - 1; !(need & 1u << to); --to )
+		;
+	w25_read_flash(spi,(page << 8) + from * W25_CHUNK,lp->data + from * W25_CHUNK,
+		(to - from + 1) * W25_CHUNK);
+	if ( w25_read_wait(spi) == 0xFFFFFFFF ) {
+		lp->page = W25_NOPAGE;
+		return 0;
+	}
+	lp->held |= w25_chunks(from * W25_CHUNK,(to - from + 1) * W25_CHUNK);
+	return lp;
+}
+
+/*********************************************************************
+ * Read Data
+ *
+ * With a page cache, pages are served from (or read into) it, unless
+ * the read spans more than half the cache, which would only evict
+ * pages for data unlikely to be read again soon.
+ *********************************************************************/
+
+uint32_t		// New address is returned
+w25_read_data(uint32_t spi,uint32_t addr,void *data,uint32_t bytes) {
+	struct s_w25cache *c = w25_cache(spi);
+	struct s_w25line *lp;
+	uint8_t *udata = (uint8_t*)data;
+	uint32_t off, n;
+
+	if ( bytes == 0 || c->nlines == 0
+	  || ((addr + bytes - 1) >> 8) - (addr >> 8) + 1 > (c->nlines + 1) / 2 ) {
+		if ( c->nlines > 0 )
+			++c->stats.bypassed;
+		w25_read_flash(spi,addr,data,bytes);
+		return w25_read_wait(spi);
+	}
+
+	while ( bytes > 0 ) {
+		off = addr & (W25_PAGE_SIZE - 1);
+		n = W25_PAGE_SIZE - off;
+		if ( n > bytes )
+			n = bytes;
+		if ( !(lp = w25_cache_line(spi,c,addr >> 8,off,n)) )
+			return 0xFFFFFFFF;
+		memcpy(udata,lp->data + off,n);
+		udata += n;
+		addr += n;
+		bytes -= n;
+	}
+	return addr;
 }
 
 /*********************************************************************
  * Write data
+ *
+ * Status is read once up front to check that WEL sets (not write
+ * protected). After that, each page costs WREN, the page program
+ * (sent by DMA when enabled), and w25_wait() while the chip
+ * programs (polled for up to W25_SPIN_US, then sleeping).
+ * The last page is left programming: the next command waits.
  *********************************************************************/
 
 unsigned		// New address is returned
 w25_write_data(uint32_t spi,uint32_t addr,void *data,uint32_t bytes) {
-	uint8_t *udata = (uint8_t*)data;
+	const uint8_t *udata = (const uint8_t*)data;
+	bool dma = w25_dma(spi)->enabled;
+	uint32_t n;
 
-	w25_write_en(spi,true);
 	w25_wait(spi);
-
-	if ( w25_is_wprotect(spi) )
+	w25_cmd(spi,W25_CMD_WRITE_EN);
+	if ( !(w25_read_sr1(spi) & W25_SR1_WEL) )
 		return 0xFFFFFFFF;	// Indicate error
 
+	w25_cache_inval(spi,addr,bytes);
+
 	while ( bytes > 0 ) {
+		n = 0x100 - (addr & 0xFF);	// Up to the page boundary
+		if ( n > bytes )
+			n = bytes;
+
 		spi_enable(spi);
 		spi_xfer(spi,W25_CMD_WRITE_DATA);
 		spi_xfer(spi,addr >> 16);
 		spi_xfer(spi,(addr >> 8) & 0xFF);
 		spi_xfer(spi,addr & 0xFF);
-		while ( bytes > 0 ) {
-			spi_xfer(spi,*udata++);
-			--bytes;
-			if ( (++addr & 0xFF) == 0x00 )
-				break;
+		if ( dma && n >= W25_DMA_MIN ) {
+			w25_dma_start(spi,0,udata,n);
+			if ( !w25_dma_wait(spi) )
+				return 0xFFFFFFFF;
+		} else	{
+			for ( uint32_t ux = 0; ux < n; ++ux )
+				spi_xfer(spi,udata[ux]);
+			spi_disable(spi);	// Page program starts
+		}
+
+		addr += n;
+		udata += n;
+		bytes -= n;
+
+		if ( bytes > 0 ) {
+			w25_wait(spi);		// Sleep while programming
+			w25_cmd(spi,W25_CMD_WRITE_EN);
 		}
-		spi_disable(spi);
-	
-		if ( bytes > 0 )
-			w25_write_en(spi,true); // More to write
 	}
 
 	return addr;	
 }
 
 /*********************************************************************
- * Erase 4K/32K/64K block
+ * Start a 4K/32K/64K block erase, without waiting for it to finish
+ * (write enable first; returns false if not enabled)
  *********************************************************************/
 
 bool
-w25_erase_block(uint32_t spi,uint32_t addr,uint8_t cmd) {
+w25_erase_start(uint32_t spi,uint32_t addr,uint8_t cmd) {
 	
 	if ( w25_is_wprotect(spi) )
 		return false;
@@ -255,16 +833,59 @@ w25_erase_block(uint32_t spi,uint32_t addr,uint8_t cmd) {
 		return false;
 	}
 
+	w25_cache_inval(spi,addr,
+		cmd == W25_CMD_ERA_SECTOR ? 4*1024 : cmd == W25_CMD_ERA_32K ? 32*1024 : 64*1024);
+
 	spi_enable(spi);
 	spi_xfer(spi,cmd);
 	spi_xfer(spi,addr >> 16);
 	spi_xfer(spi,(addr >> 8) & 0xFF);
 	spi_xfer(spi,addr & 0xFF);
 	spi_disable(spi);
+	return true;
+}
+
+/*********************************************************************
+ * Erase 4K/32K/64K block
+ *********************************************************************/
 
+bool
+w25_erase_block(uint32_t spi,uint32_t addr,uint8_t cmd) {
+
+	if ( !w25_erase_start(spi,addr,cmd) )
+		return false;
 	return w25_is_wprotect(spi); // True if successful
 }
 
+/*********************************************************************
+ * Suspend an erase or program in progress
+ *
+ * The chip is ready within tSUS (20us), so BUSY is polled without
+ * sleeping. Returns true if suspended (SR2 SUS), or false if there
+ * was nothing to suspend (the operation had finished). While
+ * suspended, the chip can be read, and programmed outside the block
+ * being erased. w25_resume() must follow.
+ *********************************************************************/
+
+bool
+w25_suspend(uint32_t spi) {
+
+	w25_cmd(spi,W25_CMD_SUSPEND);
+	while ( w25_read_sr1(spi) & W25_SR1_BUSY )
+		;
+	return (w25_read_sr2(spi) & W25_SR2_SUS) != 0;
+}
+
+/*********************************************************************
+ * Resume a suspended erase or program (caller ensures not busy)
+ *********************************************************************/
+
+void
+w25_resume(uint32_t spi) {
+
+	w25_cmd(spi,W25_CMD_RESUME);
+}
+
 /*********************************************************************
  * Setup SPI
  *********************************************************************/
@@ -0,0 +1,313 @@
+#!/usr/bin/env python3
+######################################################################
+#  ovlgen.py -- Generate overlay tables, thunks and linker fragment
+#
+#  Usage:
+#	ovlgen.py [-p profile]... [-s nm.txt] [-r bytes] [-n regions]
+#		  [-z region_size] [-c] [-o prefix] overlays.def
+#
+#  overlays.def lists the functions that may be overlaid, one
+#  prototype per line, then options:
+#
+#	int fee(int arg)	hints=fie
+#	int fie(int arg)	hints=foo,fum
+#	void dump(void)		resident
+#
+#	hints=a,b	functions usually called next (prefetched)
+#	resident	always in internal flash
+#	overlay		always overlaid
+#
+#  Functions are defined as OVL_FN(name), and called by name:
+#
+#	int OVL_FN(fee)(int arg) { ... }	// Body
+#	r = fee(arg);				// Caller
+#
+#  An overlaid function's body goes in section .ov_<name>, and
+#  <name>() is a thunk calling it through ovl_lookup()/ovl_done().
+#  A resident function's body is <name>() itself.
+#
+#  Profiles (-p) are the overlay statistics tables printed on the
+#  target (overlay1) or by the host simulation (ovltest): a heading
+#  line naming the columns, then a line per function. The NAME (or
+#  OVERLAY or MODULE), CALLS, and if given SIZE and LOADS columns
+#  are used; several profiles are summed. Sizes may also come from
+#  arm-none-eabi-nm -S (-s), for functions that were resident.
+#
+#  Unforced functions are made resident, best first, while they fit
+#  in -r bytes of internal flash. A function's benefit is the bytes
+#  its loads read from SPI flash (loads x size, or calls x size when
+#  there is no LOADS column), plus OVL_CALL_BYTES per call for the
+#  lookup itself. They are ranked by benefit per byte of flash.
+#
+#  Output, for prefix ovl_gen:
+#
+#	ovl_gen.h	OVL_FN(), prototypes and section attributes
+#	ovl_gen.c	Module table, thunks, ovl_gen_init(spi)
+#	ovl_gen.ld	OVERLAY statement (INCLUDE it in SECTIONS; the
+#			script must have an "ovl" and "xflash" region)
+#	ovl_gen.mk	OVL_SECTIONS = the overlay output sections
+#
+#  With -c the modules are packed: each section gets OVL_LZ_HDR more
+#  bytes, for ovlpack.py to rewrite the section's .ov file in place
+#  (OVL_PACK = 1 in ovl_gen.mk), and ovl_gen_init() gives the
+#  runtime a chunk buffer.
+#
+#  The decisions are reported on stderr.
+######################################################################
+
+import sys
+import re
+import getopt
+
+OVL_CALL_BYTES = 16		# Lookup cost per call, in SPI byte times
+OVL_LZ_HDR = 6			# overlay.h, ovlpack.py
+
+class Func:
+	def __init__(self,proto,opts,lineno):
+		m = re.match(r"^(.*?)\b([A-Za-z_]\w*)\s*\((.*)\)\s*$",proto)
+		if not m:
+			sys.exit("ovlgen: line %d: not a prototype: %s" % (lineno,proto))
+		self.rtype = m.group(1).strip()
+		self.name = m.group(2)
+		self.params = m.group(3).strip()
+		self.args = []
+		if self.params not in ("", "void"):
+			for p in self.params.split(","):
+				a = re.search(r"([A-Za-z_]\w*)\s*(\[[^\]]*\])?\s*$",p)
+				if not a or "(" in p or p.strip() == "...":
+					sys.exit("ovlgen: line %d: unsupported parameter: %s" % (lineno,p.strip()))
+				self.args.append(a.group(1))
+		self.hints = []
+		self.force = None
+		for o in opts:
+			if o.startswith("hints="):
+				self.hints = [h for h in o[6:].split(",") if h]
+			elif o in ("resident","overlay"):
+				self.force = o
+			else:
+				sys.exit("ovlgen: line %d: unknown option %s" % (lineno,o))
+		self.calls = self.loads = 0
+		self.size = None
+		self.resident = False
+		self.why = ""
+
+	def decl(self,name):
+		return "%s %s(%s)" % (self.rtype,name,self.params or "void")
+
+def load_defs(path):
+	funcs = []
+	for lineno, line in enumerate(open(path),1):
+		line = line.split("#")[0].strip()
+		if not line:
+			continue
+		close = line.rindex(")") + 1
+		funcs.append(Func(line[:close],line[close:].split(),lineno))
+	names = [f.name for f in funcs]
+	for f in funcs:
+		for h in f.hints:
+			if h not in names:
+				sys.exit("ovlgen: %s: hint %s is not listed" % (f.name,h))
+	return funcs
+
+def load_profile(path,byname):
+	cols = None
+	for line in open(path):
+		words = line.split()
+		if not words:
+			continue
+		heads = [w.upper() for w in words]
+		if heads[0] in ("NAME","OVERLAY","MODULE") and "CALLS" in heads:
+			cols = { h: x for x, h in enumerate(heads) }
+			continue
+		if cols is None or words[0] not in byname:
+			continue
+		f = byname[words[0]]
+		try:
+			f.calls += int(words[cols["CALLS"]])
+			if "LOADS" in cols:
+				f.loads += int(words[cols["LOADS"]])
+			else:
+				f.loads += int(words[cols["CALLS"]])
+			if "SIZE" in cols:
+				f.size = int(words[cols["SIZE"]])
+		except (ValueError,IndexError):
+			continue
+
+def load_nm(path,byname):
+	# arm-none-eabi-nm -S: address size type name
+	for line in open(path):
+		words = line.split()
+		if len(words) != 4:
+			continue
+		name = words[3]
+		if name.endswith("_ovl"):
+			name = name[:-4]
+		if name in byname and byname[name].size is None:
+			byname[name].size = int(words[1],16)
+
+def place(funcs,budget,region_size):
+	candidates = []
+	for f in funcs:
+		if f.force == "resident":
+			f.resident, f.why = True, "forced"
+		elif f.force == "overlay":
+			f.why = "forced"
+		elif f.size is not None and f.size > region_size:
+			f.resident, f.why = True, "over region size"
+		elif f.size is None:
+			f.why = "size unknown"
+		elif f.calls == 0:
+			f.why = "not called"
+		else:
+			candidates.append(f)
+	for f in funcs:
+		if f.resident and f.size:
+			budget -= f.size
+
+	benefit = lambda f: f.loads * f.size + f.calls * OVL_CALL_BYTES
+	candidates.sort(key=lambda f: -benefit(f) / max(f.size,1))
+	for f in candidates:
+		if f.size <= budget:
+			budget -= f.size
+			f.resident, f.why = True, "benefit %d" % benefit(f)
+		else:
+			f.why = "benefit %d, no room" % benefit(f)
+	return budget
+
+def write_header(out,funcs,prefix):
+	guard = prefix.split("/")[-1].upper() + "_H"
+	out.write("/* %s.h : Generated by ovlgen.py -- DO NOT EDIT */\n" % prefix.split("/")[-1])
+	out.write("#ifndef %s\n#define %s\n\n" % (guard,guard))
+	out.write("#include <stdint.h>\n#include \"overlay.h\"\n\n")
+	out.write("#define OVL_FN(name)\tname ## _ovl\t// Function body\n\n")
+	for f in funcs:
+		if f.resident:
+			out.write("// %s: resident (%s)\n" % (f.name,f.why))
+			out.write("#define %s_ovl %s\n" % (f.name,f.name))
+			out.write("%s;\n\n" % f.decl(f.name))
+		else:
+			out.write("// %s: overlaid (%s)\n" % (f.name,f.why))
+			out.write("%s;\n" % f.decl(f.name))
+			out.write("%s __attribute__((noinline,section(\".ov_%s\")));\n\n" % (f.decl(f.name + "_ovl"),f.name))
+	out.write("extern struct s_ovl ovl_gen;\n")
+	out.write("extern struct s_ovl_module ovl_modules[];\n")
+	out.write("#define OVL_NMODS\t%d\n\n" % len([f for f in funcs if not f.resident]))
+	out.write("bool ovl_gen_init(uint32_t spi);\n")
+	out.write("void ovl_gen_fault(const char *name);\n\n")
+	out.write("#endif // %s\n\n// End %s.h\n" % (guard,prefix.split("/")[-1]))
+
+def write_source(out,funcs,prefix,nregions,region_size,packed):
+	base = prefix.split("/")[-1]
+	ovls = [f for f in funcs if not f.resident]
+	index = { f.name: x for x, f in enumerate(ovls) }
+
+	out.write("/* %s.c : Generated by ovlgen.py -- DO NOT EDIT */\n" % base)
+	out.write("#include \"%s.h\"\n\n" % base)
+	out.write("extern char ovl_region;\t\t// %s.ld\n" % base)
+	for f in ovls:
+		out.write("extern char __load_start_%s, __load_stop_%s;\n" % (f.name,f.name))
+	out.write("\nstruct s_ovl ovl_gen;\n")
+	if packed:
+		out.write("static uint8_t ovl_lzbuf[2 * OVL_LZ_CHUNK];\n")
+	out.write("\n")
+	out.write("struct s_ovl_module ovl_modules[%d] = {\n" % max(len(ovls),1))
+	for f in ovls:
+		hints = [str(index[h] + 1) for h in f.hints if h in index][:2]
+		out.write("\t{ .name = \"%s\", .start = &__load_start_%s, .stop = &__load_stop_%s,\n\t  .func = (const void *)%s_ovl, .hints = { %s }%s },\n"
+			% (f.name,f.name,f.name,f.name,", ".join(hints) or "0",", .packed = true" if packed else ""))
+	out.write("};\n\n")
+
+	out.write("bool\novl_gen_init(uint32_t spi) {\n")
+	if packed:
+		out.write("\tif ( !ovl_init(&ovl_gen,spi,&ovl_region,%d,%d,ovl_modules,%d) )\n\t\treturn false;\n"
+			% (nregions,region_size,len(ovls)))
+		out.write("\tovl_gen.lzbuf = ovl_lzbuf;\n\treturn true;\n}\n\n")
+	else:
+		out.write("\treturn ovl_init(&ovl_gen,spi,&ovl_region,%d,%d,ovl_modules,%d);\n}\n\n"
+			% (nregions,region_size,len(ovls)))
+	out.write("void __attribute__((weak))\novl_gen_fault(const char *name) {\n")
+	out.write("\t(void)name;\n\tfor (;;);\t\t\t// Lookup failed: see ovl_lookup()\n}\n")
+
+	for f in ovls:
+		ptr = "%s (*f)(%s)" % (f.rtype,f.params or "void")
+		call = "f(%s)" % ",".join(f.args)
+		out.write("\n%s\n%s(%s) {\n" % (f.rtype,f.name,f.params or "void"))
+		out.write("\t%s = ovl_lookup(&ovl_gen,&__load_start_%s);\n" % (ptr,f.name))
+		if f.rtype != "void":
+			out.write("\t%s r;\n" % f.rtype)
+		out.write("\n\tif ( !f )\n\t\tovl_gen_fault(\"%s\");\n" % f.name)
+		if f.rtype != "void":
+			out.write("\tr = %s;\n" % call)
+		else:
+			out.write("\t%s;\n" % call)
+		out.write("\tovl_done(&ovl_gen,&__load_start_%s);\n" % f.name)
+		if f.rtype != "void":
+			out.write("\treturn r;\n")
+		out.write("}\n")
+	out.write("\n// End %s.c\n" % base)
+
+def write_ld(out,funcs,prefix,packed):
+	ovls = [f for f in funcs if not f.resident]
+	out.write("/* %s.ld : Generated by ovlgen.py -- DO NOT EDIT */\n\n" % prefix.split("/")[-1])
+	out.write("\tovl_region = ORIGIN(ovl);\n")
+	if ovls:
+		out.write("\tOVERLAY : NOCROSSREFS {\n")
+		for f in ovls:
+			out.write("\t    .%s { *(.ov_%s)%s }\n" % (f.name,f.name,
+				" . += %d;" % OVL_LZ_HDR if packed else ""))
+		out.write("\t} >ovl AT >xflash\n")
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:],"p:s:r:n:z:co:")
+	profiles, nm = [], None
+	budget, nregions, region_size, prefix = 0, 4, 512, "ovl_gen"
+	packed = False
+	for o, a in opts:
+		if o == "-p":
+			profiles.append(a)
+		elif o == "-s":
+			nm = a
+		elif o == "-r":
+			budget = int(a,0)
+		elif o == "-n":
+			nregions = int(a,0)
+		elif o == "-z":
+			region_size = int(a,0)
+		elif o == "-c":
+			packed = True
+		elif o == "-o":
+			prefix = a
+	if len(args) != 1:
+		sys.exit("Usage: ovlgen.py [-p profile]... [-s nm.txt] [-r bytes] [-n regions] [-z region_size] [-c] [-o prefix] overlays.def")
+
+	funcs = load_defs(args[0])
+	byname = { f.name: f for f in funcs }
+	for p in profiles:
+		load_profile(p,byname)
+	if nm:
+		load_nm(nm,byname)
+	left = place(funcs,budget,region_size)
+
+	with open(prefix + ".h","w") as out:
+		write_header(out,funcs,prefix)
+	with open(prefix + ".c","w") as out:
+		write_source(out,funcs,prefix,nregions,region_size,packed)
+	with open(prefix + ".ld","w") as out:
+		write_ld(out,funcs,prefix,packed)
+	with open(prefix + ".mk","w") as out:
+		out.write("# Generated by ovlgen.py -- DO NOT EDIT\n")
+		out.write("OVL_SECTIONS = %s\n" % " ".join(f.name for f in funcs if not f.resident))
+		out.write("OVL_PACK = %d\n" % packed)
+
+	for f in funcs:
+		sys.stderr.write("ovlgen: %-16s %-9s %6s bytes %7d calls %7d loads  %s\n" % (f.name,
+			"resident" if f.resident else "overlaid","?" if f.size is None else f.size,
+			f.calls,f.loads,f.why))
+	sys.stderr.write("ovlgen: %d overlaid, %d resident, %d of %d resident bytes left\n" % (
+		len([f for f in funcs if not f.resident]),len([f for f in funcs if f.resident]),
+		max(left,0),budget))
+
+if __name__ == "__main__":
+	main()
+
+# End ovlgen.py
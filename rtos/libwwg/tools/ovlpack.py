@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+######################################################################
+#  ovlpack.py -- Pack overlay sections for overlay.c (LZ, chunked)
+#
+#  Usage:
+#	ovlpack.py [-k chunk] section.ov	(Intel Hex, rewritten)
+#	ovlpack.py -b [-k chunk] raw.bin packed.bin
+#
+#  An Intel Hex section is one overlay output section, as objcopy
+#  writes it, ending in the OVL_LZ_HDR bytes of room ovlgen.py -c
+#  leaves. It is rewritten at the same address, packed. With -b, a
+#  raw module is packed from one binary file to another.
+#
+#  Packed module (all little endian):
+#
+#	u16 zsize	Packed bytes after the header (0: stored as is)
+#	u16 raw		Unpacked bytes
+#	u16 zgap	Least offset of the packed bytes in the region,
+#			ahead of its start, to unpack in place
+#	zsize bytes	LZ sequences, in chunks of -k bytes (default 128,
+#			overlay.h OVL_LZ_CHUNK) that no sequence crosses
+#
+#  Sequence: token (literals << 4 | match), literal count extension
+#  if literals is 15 (bytes added until one is < 255), the literals,
+#  then if match != 0, a 16 bit offset back into the output, and a
+#  match length extension if match is 15. Match length is match + 2
+#  (plus the extension). Token 0 pads to the end of a chunk.
+#
+#  The ratio is written to stderr.
+######################################################################
+
+import sys
+import getopt
+import struct
+
+OVL_LZ_HDR = 6
+MIN_MATCH = 3
+MAX_CANDIDATES = 64
+
+def ext(v):
+	b = bytearray()
+	while v >= 255:
+		b.append(255)
+		v -= 255
+	b.append(v)
+	return b
+
+def sequence(lits,mlen,off):
+	m = mlen - 2 if mlen else 0
+	b = bytearray([min(len(lits),15) << 4 | min(m,15)])
+	if len(lits) >= 15:
+		b += ext(len(lits) - 15)
+	b += lits
+	if mlen:
+		b += struct.pack("<H",off)
+		if m >= 15:
+			b += ext(m - 15)
+	return b
+
+def literal_fit(room):
+	"""Most literals a literal only sequence can carry in room bytes"""
+	k = room - 1
+	while k > 0 and len(sequence(bytes(k),0,0)) > room:
+		k -= 1
+	return k
+
+class Packer:
+	def __init__(self,chunk):
+		self.chunk = chunk
+		self.out = bytearray()
+
+	def pad(self):
+		room = self.chunk - len(self.out) % self.chunk
+		self.out += bytes(room)		# Token 0, then filler
+
+	def emit(self,lits,mlen=0,off=0):
+		while True:
+			room = self.chunk - len(self.out) % self.chunk
+			seq = sequence(lits,mlen,off)
+			if len(seq) <= room:
+				self.out += seq
+				return
+			k = literal_fit(room)
+			if k > 0 and lits:
+				k = min(k,len(lits))
+				self.out += sequence(lits[:k],0,0)
+				lits = lits[k:]
+				if not lits and not mlen:
+					return
+			else:
+				self.pad()
+
+def lz_pack(raw,chunk):
+	table = {}
+	p = Packer(chunk)
+	i = lit = 0
+	n = len(raw)
+
+	def index(pos):
+		if pos + MIN_MATCH <= n:
+			table.setdefault(raw[pos:pos+MIN_MATCH],[]).append(pos)
+
+	while i < n:
+		best, off = 0, 0
+		for c in reversed(table.get(raw[i:i+MIN_MATCH],[])[-MAX_CANDIDATES:]):
+			k = 0
+			while i + k < n and raw[c + k] == raw[i + k]:
+				k += 1
+			if k > best:
+				best, off = k, i - c
+		if best >= MIN_MATCH:
+			p.emit(raw[lit:i],best,off)
+			for pos in range(i,i + best):
+				index(pos)
+			i += best
+			lit = i
+		else:
+			index(i)
+			i += 1
+	if lit < n:
+		p.emit(raw[lit:n])
+	return bytes(p.out)
+
+def lz_unpack(data,nraw,chunk):
+	"""Decode as overlay.c does: returns (output, least in place gap)"""
+	out = bytearray()
+	i = gap = 0
+
+	def length(v):
+		nonlocal i
+		while True:
+			b = data[i]
+			i += 1
+			v += b
+			if b != 255:
+				return v
+
+	while i < len(data) and len(out) < nraw:
+		token = data[i]
+		i += 1
+		if token == 0:
+			i = ((i - 1) // chunk + 1) * chunk
+			continue
+		n = token >> 4
+		if n == 15:
+			n = length(n)
+		for _ in range(n):
+			i += 1
+			gap = max(gap,len(out) - i + 1)
+			out.append(data[i-1])
+		m = token & 15
+		if m:
+			off = data[i] | data[i+1] << 8
+			i += 2
+			m += 2
+			if m == 17:
+				m = length(m)
+			for _ in range(m):
+				gap = max(gap,len(out) - i + 1)
+				out.append(out[-off])
+	return bytes(out), gap
+
+def pack_module(raw,chunk):
+	packed = lz_pack(raw,chunk)
+	if len(packed) >= len(raw):
+		return struct.pack("<HHH",0,len(raw),0) + raw
+	check, gap = lz_unpack(packed,len(raw),chunk)
+	if check != raw:
+		sys.exit("ovlpack: internal error: round trip failed")
+	return struct.pack("<HHH",len(packed),len(raw),max(gap,0)) + packed
+
+def read_ihex(path):
+	base, upper, data = None, 0, bytearray()
+	for line in open(path):
+		line = line.strip()
+		if not line.startswith(":"):
+			continue
+		rec = bytes.fromhex(line[1:])
+		count, addr, rtype = rec[0], rec[1] << 8 | rec[2], rec[3]
+		if rtype == 0:
+			addr |= upper
+			if base is None:
+				base = addr
+			if addr != base + len(data):
+				sys.exit("ovlpack: %s: not one contiguous section" % path)
+			data += rec[4:4+count]
+		elif rtype == 4:
+			upper = (rec[4] << 8 | rec[5]) << 16
+	if base is None:
+		sys.exit("ovlpack: %s: no data" % path)
+	return base, bytes(data)
+
+def ihex_record(rtype,addr,data):
+	rec = bytes([len(data),addr >> 8 & 0xFF,addr & 0xFF,rtype]) + data
+	return ":%s%02X\n" % (rec.hex().upper(),-sum(rec) & 0xFF)
+
+def write_ihex(path,base,data):
+	upper = None
+	with open(path,"w") as f:
+		x = 0
+		while x < len(data):
+			addr = base + x
+			n = min(16,len(data) - x,0x10000 - (addr & 0xFFFF))
+			if addr >> 16 != upper:
+				upper = addr >> 16
+				f.write(ihex_record(4,0,struct.pack(">H",upper)))
+			f.write(ihex_record(0,addr & 0xFFFF,data[x:x+n]))
+			x += n
+		f.write(ihex_record(1,0,b""))
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:],"bk:")
+	binary, chunk = False, 128
+	for o, a in opts:
+		if o == "-b":
+			binary = True
+		elif o == "-k":
+			chunk = int(a,0)
+
+	if binary and len(args) == 2:
+		raw = open(args[0],"rb").read()
+		out = pack_module(raw,chunk)
+		open(args[1],"wb").write(out)
+		name = args[0]
+	elif not binary and len(args) == 1:
+		name = args[0]
+		base, data = read_ihex(name)
+		if len(data) <= OVL_LZ_HDR:
+			sys.exit("ovlpack: %s: too short (built without ovlgen.py -c?)" % name)
+		raw = data[:-OVL_LZ_HDR]
+		out = pack_module(raw,chunk)
+		if len(out) > len(data):
+			sys.exit("ovlpack: internal error: %s grew" % name)
+		write_ihex(name,base,out)
+	else:
+		sys.exit("Usage: ovlpack.py [-k chunk] section.ov | ovlpack.py -b [-k chunk] raw.bin packed.bin")
+
+	zsize, _, gap = struct.unpack("<HHH",out[:OVL_LZ_HDR])
+	sys.stderr.write("ovlpack: %s: %d -> %d bytes (%.0f%%)%s, in place gap %d\n" % (name,len(raw),
+		len(out),len(out) * 100.0 / max(len(raw),1),"" if zsize else " stored",gap))
+
+if __name__ == "__main__":
+	main()
+
+# End ovlpack.py
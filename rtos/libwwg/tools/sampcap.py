@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+######################################################################
+#  sampcap.py -- Capture monitor sampler streams as CSV or VCD
+#
+#  Usage:
+#	sampcap.py [-v] [-n frames] -r rate -o out PORT CHANNEL...
+#	sampcap.py [-v] -o out capture.bin
+#
+#  Examples:
+#	sampcap.py -r 20000 -n 100000 -o pwm.vcd -v /dev/ttyACM0 \
+#		TIM4.CCR1:2 DMA1.CNDTR3:2 0x20000104:1=lamp_status
+#	sampcap.py -o pwm.csv raw_capture.bin
+#
+#  With a port, the monitor's 'w' command is issued and the stream is
+#  captured until -n frames (default 10000) arrive or ^C, then a
+#  RETURN stops the target. The stream format is described at watch()
+#  in ../src/monitor.c.
+#
+#	-v	Write VCD (for GTKWave etc.) instead of CSV
+######################################################################
+
+import os
+import sys
+import struct
+import getopt
+
+from snapdecode import open_port
+
+SAMP_VERSION = 1
+
+class Stream:
+	def __init__(self):
+		self.data = b""
+		self.chans = None			# [(addr,width,name)]
+		self.rate = 0
+		self.lost = 0
+
+	def feed(self,chunk):
+		"""Add bytes, return a list of decoded frames (tuples)"""
+		self.data += chunk
+		frames = []
+		while True:
+			if self.chans is None:
+				if not self.header():
+					break
+				continue
+			x = self.data.find(b"MSMP")
+			if x < 0 or len(self.data) < x + 16:
+				break
+			seq, ovr, nframes, fsize = struct.unpack_from("<IIHH",self.data,x+4)
+			end = x + 16 + nframes * fsize + 2
+			if len(self.data) < end:
+				break
+			body = self.data[x+4:end-2]
+			(csum,) = struct.unpack_from("<H",self.data,end-2)
+			self.data = self.data[end:]
+			if sum(body) & 0xFFFF != csum:
+				sys.stderr.write("sampcap: checksum error, block %u dropped\n" % seq)
+				continue
+			self.lost = ovr
+			frames.extend(self.frames(body[12:],seq,nframes,fsize))
+		return frames
+
+	def header(self):
+		x = self.data.find(b"MSMH")
+		if x < 0 or len(self.data) < x + 12:
+			return False
+		version, nchans, _, rate = struct.unpack_from("<BBHI",self.data,x+4)
+		if version != SAMP_VERSION:
+			sys.exit("sampcap: stream version %d not supported" % version)
+		p, chans = x + 12, []
+		for _ in range(nchans):
+			if len(self.data) < p + 6:
+				return False
+			addr, width, nlen = struct.unpack_from("<IBB",self.data,p)
+			if len(self.data) < p + 6 + nlen:
+				return False
+			chans.append((addr,width,self.data[p+6:p+6+nlen].decode()))
+			p += 6 + nlen
+		self.chans, self.rate = chans, rate
+		self.data = self.data[p:]
+		return True
+
+	def frames(self,body,seq,nframes,fsize):
+		"""Return [(frame no.,values)], numbered from seq so gaps keep time"""
+		fmt = "<" + "".join({1:"B",2:"H",4:"I"}[w] for _, w, _ in self.chans)
+		return [ (seq*nframes+f,struct.unpack_from(fmt,body,f*fsize)) for f in range(nframes) ]
+
+class CsvOut:
+	def __init__(self,f,stream):
+		self.f = f
+		self.period = 1.0 / stream.rate
+		f.write("time_s," + ",".join(n for _, _, n in stream.chans) + "\n")
+
+	def frame(self,t,values):
+		self.f.write("%.7f,%s\n" % (t * self.period,",".join(str(v) for v in values)))
+
+class VcdOut:
+	def __init__(self,f,stream):
+		self.f, self.last = f, None
+		self.rate = stream.rate
+		self.ids = [ chr(33 + x) for x in range(len(stream.chans)) ]
+		f.write("$timescale 1ns $end\n$scope module stm32 $end\n")
+		for (addr, width, name), vid in zip(stream.chans,self.ids):
+			f.write("$var wire %d %s %s $end\n" % (width*8,vid,name.replace(" ","_") or "0x%08X" % addr))
+		f.write("$upscope $end\n$enddefinitions $end\n")
+
+	def frame(self,t,values):
+		changed = [ x for x, v in enumerate(values) if self.last is None or self.last[x] != v ]
+		if changed:
+			self.f.write("#%d\n" % (t * 1000000000 // self.rate))
+			for x in changed:
+				self.f.write("b{:b} {}\n".format(values[x],self.ids[x]))
+		self.last = values
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:],"vn:r:o:")
+	vcd, limit, rate, outpath = False, 10000, None, None
+	for o, a in opts:
+		if o == "-v":
+			vcd = True
+		elif o == "-n":
+			limit = int(a)
+		elif o == "-r":
+			rate = int(a)
+		elif o == "-o":
+			outpath = a
+	if not outpath or not args or (len(args) > 1 and not rate):
+		sys.exit("Usage: sampcap.py [-v] [-n frames] -r rate -o out port channel...\n"
+			 "       sampcap.py [-v] -o out capture.bin")
+
+	stream = Stream()
+	out = None
+	count = 0
+	with open(outpath,"w") as f:
+		if len(args) == 1:
+			with open(args[0],"rb") as cap:
+				frames = stream.feed(cap.read())
+			if stream.chans is None:
+				sys.exit("sampcap: no stream header found")
+			out = (VcdOut if vcd else CsvOut)(f,stream)
+			for t, v in frames:
+				out.frame(t,v)
+			count = len(frames)
+		else:
+			fd = open_port(args[0])
+			os.write(fd,b"w")
+			os.write(fd,b"%d\r" % rate)
+			os.write(fd,(" ".join(args[1:]) + "\r").encode())
+			try:
+				while count < limit:
+					chunk = os.read(fd,4096)
+					if not chunk:
+						if stream.chans is None:
+							sys.exit("sampcap: no stream header received")
+						continue
+					frames = stream.feed(chunk)
+					if out is None and stream.chans is not None:
+						out = (VcdOut if vcd else CsvOut)(f,stream)
+					for t, v in frames:
+						out.frame(t,v)
+					count += len(frames)
+			except KeyboardInterrupt:
+				pass
+			os.write(fd,b"\r")		# Stop the target
+			os.close(fd)
+
+	sys.stderr.write("sampcap: %d frames, %d overruns\n" % (count,stream.lost))
+
+if __name__ == "__main__":
+	main()
+
+# End sampcap.py
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+######################################################################
+#  snapdecode.py -- Decode monitor binary register snapshots
+#
+#  Usage:
+#	snapdecode.py [-c] -s stm32f103-mon.svd -p PATTERN /dev/ttyACM0
+#	snapdecode.py [-c] -s stm32f103-mon.svd capture.bin
+#
+#  With -p, the monitor's 'z' command is sent with PATTERN (for
+#  example "GPIO*" or "DMA1.CNDTR*") and the reply is decoded.
+#  Otherwise the file is scanned for "MSNP" blobs. The blob format
+#  is described at snap_binary() in ../src/monitor.c.
+#
+#	-c	CSV output (register,address,value,field,field value)
+######################################################################
+
+import os
+import sys
+import struct
+import getopt
+import termios
+
+from svd2mon import load_periphs
+
+SNAP_VERSION = 1
+
+def open_port(path):
+	fd = os.open(path,os.O_RDWR|os.O_NOCTTY)
+	if os.isatty(fd):
+		attr = termios.tcgetattr(fd)
+		attr[0] = 0				# iflag: no CR/LF mapping
+		attr[1] = 0				# oflag
+		attr[3] = 0				# lflag: raw, no echo
+		attr[6][termios.VMIN] = 0
+		attr[6][termios.VTIME] = 20		# 2 second read timeout
+		termios.tcsetattr(fd,termios.TCSANOW,attr)
+	return fd
+
+def read_blob(fd,pattern):
+	os.write(fd,b"z")
+	os.write(fd,pattern.encode() + b"\r")
+	data = b""
+	while True:
+		chunk = os.read(fd,4096)
+		if not chunk:
+			break
+		data += chunk
+		blob = find_blob(data)
+		if blob:
+			return blob
+	sys.exit("snapdecode: no snapshot received")
+
+def find_blob(data,start=0):
+	"""Return (records,end) for the first complete blob, else None"""
+	x = data.find(b"MSNP",start)
+	if x < 0 or len(data) < x + 8:
+		return None
+	version, _, count = struct.unpack_from("<BBH",data,x+4)
+	end = x + 8 + count * 8 + 2
+	if len(data) < end:
+		return None
+	if version != SNAP_VERSION:
+		sys.exit("snapdecode: blob version %d not supported" % version)
+	body = data[x+4:end-2]
+	(csum,) = struct.unpack_from("<H",data,end-2)
+	if sum(body) & 0xFFFF != csum:
+		sys.exit("snapdecode: checksum error")
+	return [ struct.unpack_from("<II",data,x+8+r*8) for r in range(count) ], end
+
+def build_map(svd):
+	regmap = {}
+	for pname, base, regs in load_periphs(svd):
+		for rname, offset, _, fields in regs:
+			regmap.setdefault(base+offset,("%s_%s" % (pname,rname),fields))
+	return regmap
+
+def decode(records,regmap,csv):
+	for addr, value in records:
+		name, fields = regmap.get(addr,("?",()))
+		if csv:
+			print("%s,0x%08X,0x%08X,," % (name,addr,value))
+		else:
+			print("%-16s $%08X @ $%08X" % (name,value,addr))
+		for fname, lsb, width, _ in fields:
+			v = (value >> lsb) & ((1 << width) - 1)
+			if csv:
+				print("%s,0x%08X,0x%08X,%s,%u" % (name,addr,value,fname,v))
+			else:
+				print("    %-12s %u" % (fname,v))
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:],"cs:p:")
+	csv, svd, pattern = False, None, None
+	for o, a in opts:
+		if o == "-c":
+			csv = True
+		elif o == "-s":
+			svd = a
+		elif o == "-p":
+			pattern = a
+	if not svd or len(args) != 1:
+		sys.exit("Usage: snapdecode.py [-c] -s file.svd [-p PATTERN] port|file")
+
+	regmap = build_map(svd)
+	if pattern:
+		fd = open_port(args[0])
+		records, _ = read_blob(fd,pattern)
+		os.close(fd)
+		decode(records,regmap,csv)
+		return
+
+	with open(args[0],"rb") as f:
+		data = f.read()
+	x = 0
+	while True:
+		blob = find_blob(data,x)
+		if not blob:
+			break
+		records, x = blob
+		decode(records,regmap,csv)
+
+if __name__ == "__main__":
+	main()
+
+# End snapdecode.py
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+######################################################################
+#  svd2mon.py -- Generate monitor register tables from a CMSIS SVD
+#
+#  Usage:
+#	svd2mon.py [-x PERIPH]... STM32F103.svd >monregs.h
+#
+#  The STM32F103 SVD file is distributed by ST (and in the cmsis-svd
+#  collection). The generated header is included by monitor.c only.
+#
+#  Table layout (all const, so placed in flash):
+#
+#	mon_strpool[]	Every name once, NUL terminated. A name that is
+#			the tail of a longer name shares its bytes.
+#	mon_fields[]	One uint32_t per field:
+#			  bits  0-4	lsb
+#			  bits  5-9	width - 1
+#			  bits 10-11	format (MF_BIN, MF_DEC, MF_HEX)
+#			  bits 16-31	name offset into mon_strpool[]
+#			Identical field lists are stored once.
+#	mon_regs[]	Register: name, offset, field list, flags.
+#			Derived peripherals share their register list.
+#	mon_periphs[]	Peripheral: base address, name, register list.
+#
+#  A table size summary is written to stderr.
+######################################################################
+
+import sys
+import getopt
+import xml.etree.ElementTree as ET
+
+MF_BIN, MF_DEC, MF_HEX = 0, 1, 2
+MR_NOREAD = 0x01		# Write only, or reading has side effects
+
+# Peripherals in the family SVD that the C8T6 does not have:
+DEFAULT_EXCLUDE = [
+	"FSMC", "SDIO", "DAC", "DMA2", "ADC3", "UART4", "UART5", "SPI3",
+	"TIM5", "TIM6", "TIM7", "TIM8", "TIM9", "TIM10", "TIM11",
+	"TIM12", "TIM13", "TIM14", "ETHERNET_MAC", "ETHERNET_MMC",
+	"ETHERNET_PTP", "ETHERNET_DMA", "OTG_FS_DEVICE", "OTG_FS_GLOBAL",
+	"OTG_FS_HOST", "OTG_FS_PWRCLK", "CAN2",
+]
+
+def num(text):
+	text = text.strip().lower()
+	if text.startswith("0x"):
+		return int(text,16)
+	if text.startswith("#"):
+		return int(text[1:].replace("x","0"),2)
+	return int(text,0)
+
+def child(elem,tag,default=None):
+	c = elem.find(tag)
+	return c.text.strip() if c is not None and c.text else default
+
+def expand_dim(elem,name):
+	"""Yield (name,offset_delta) for dim arrays, else (name,0)"""
+	dim = child(elem,"dim")
+	if dim is None:
+		yield name, 0
+		return
+	incr = num(child(elem,"dimIncrement","0"))
+	index = child(elem,"dimIndex")
+	if index and "-" in index:
+		lo, hi = index.split("-")
+		index = [str(x) for x in range(int(lo),int(hi)+1)]
+	elif index:
+		index = index.split(",")
+	else:
+		index = [str(x) for x in range(num(dim))]
+	for x, ix in enumerate(index):
+		yield name.replace("[%s]",ix).replace("%s",ix), x * incr
+
+def field_bits(f):
+	if f.find("bitOffset") is not None:
+		return num(child(f,"bitOffset")), num(child(f,"bitWidth","1"))
+	if f.find("lsb") is not None:
+		lsb = num(child(f,"lsb"))
+		return lsb, num(child(f,"msb")) - lsb + 1
+	rng = child(f,"bitRange").strip("[]").split(":")
+	msb, lsb = int(rng[0]), int(rng[1])
+	return lsb, msb - lsb + 1
+
+def field_format(width,regsize):
+	if width <= 8:
+		return MF_BIN
+	if width == regsize or width == 16:
+		return MF_HEX
+	return MF_DEC
+
+def parse_registers(periph,defaccess):
+	regs = []
+	rnode = periph.find("registers")
+	if rnode is None:
+		return regs
+	for r in rnode.findall("register"):
+		size = num(child(r,"size","32"))
+		access = child(r,"access",defaccess)
+		flags = 0
+		if access == "write-only" or r.find("readAction") is not None:
+			flags |= MR_NOREAD
+		fields = []
+		fnode = r.find("fields")
+		if fnode is not None:
+			for f in fnode.findall("field"):
+				fname = child(f,"name")
+				lsb, width = field_bits(f)
+				if f.find("readAction") is not None:
+					flags |= MR_NOREAD
+				for n, _ in expand_dim(f,fname):
+					fields.append((n,lsb,width,field_format(width,size)))
+		fields.sort(key=lambda t: -t[1])	# MSB first, like the book
+		for name, delta in expand_dim(r,child(r,"name")):
+			regs.append((name,num(child(r,"addressOffset"))+delta,flags,tuple(fields)))
+	regs.sort(key=lambda t: t[1])
+	return regs
+
+def load_periphs(path,exclude=()):
+	"""Return sorted [(name,base,((reg,offset,flags,fields),...)),...]"""
+	dev = ET.parse(path).getroot()
+	defaccess = child(dev,"access","read-write")
+	byname = { child(p,"name"): p for p in dev.find("peripherals") }
+
+	periphs = []
+	for name, p in byname.items():
+		if name in exclude:
+			continue
+		base = num(child(p,"baseAddress"))
+		src = p
+		while src.find("registers") is None and src.get("derivedFrom"):
+			src = byname[src.get("derivedFrom")]
+		regs = tuple(parse_registers(src,defaccess))
+		if regs:
+			periphs.append((name,base,regs))
+	periphs.sort(key=lambda t: t[0])
+	return periphs
+
+class StrPool:
+	def __init__(self):
+		self.names = set()
+		self.offsets = {}
+		self.data = ""
+
+	def add(self,name):
+		self.names.add(name)
+
+	def build(self):
+		# Longest first, so that tails can share a longer name's bytes
+		for name in sorted(self.names,key=lambda s: (-len(s),s)):
+			pos = self.data.find(name + "\0")
+			if pos < 0:
+				pos = len(self.data)
+				self.data += name + "\0"
+			self.offsets[name] = pos
+		if len(self.data) > 0xFFFF:
+			sys.exit("svd2mon: string pool exceeds 64K")
+
+	def __getitem__(self,name):
+		return self.offsets[name]
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:],"x:a")
+	exclude = set(DEFAULT_EXCLUDE)
+	for o, a in opts:
+		if o == "-x":
+			exclude.add(a)
+		elif o == "-a":
+			exclude = set()		# Keep every peripheral
+	if len(args) != 1:
+		sys.exit("Usage: svd2mon.py [-a] [-x PERIPH]... file.svd")
+
+	periphs = load_periphs(args[0],exclude)
+
+	pool = StrPool()
+	for name, _, regs in periphs:
+		pool.add(name)
+		for rname, _, _, fields in regs:
+			pool.add(rname)
+			for f in fields:
+				pool.add(f[0])
+	pool.build()
+
+	fields_out = []				# packed words
+	fieldlists = {}				# fields tuple -> index
+	regs_out = []
+	regindex = {}				# regs tuple -> index
+	for _, _, regs in periphs:
+		if regs in regindex:
+			continue
+		regindex[regs] = len(regs_out)
+		for rname, offset, flags, fields in regs:
+			if fields not in fieldlists:
+				fieldlists[fields] = len(fields_out)
+				for fname, lsb, width, fmt in fields:
+					fields_out.append(pool[fname] << 16 | fmt << 10 | (width-1) << 5 | lsb)
+			regs_out.append((pool[rname],offset,fieldlists[fields],len(fields),flags))
+
+	out = sys.stdout
+	out.write("/* monregs.h : Generated by svd2mon.py from %s -- DO NOT EDIT */\n" % args[0].split("/")[-1])
+	out.write("\nstatic const char mon_strpool[%d] = \n" % len(pool.data))
+	line = ""
+	for name in pool.data.split("\0")[:-1]:
+		item = name + "\\0"
+		if len(line) + len(item) > 64:
+			out.write("\t\"%s\"\n" % line)
+			line = ""
+		line += item
+	out.write("\t\"%s\";\n" % line)
+
+	out.write("\nstatic const uint32_t mon_fields[%d] = {\n" % max(len(fields_out),1))
+	for x in range(0,len(fields_out),6):
+		out.write("\t" + " ".join("0x%08X," % w for w in fields_out[x:x+6]) + "\n")
+	out.write("};\n")
+
+	out.write("\nstatic const struct mon_reg mon_regs[%d] = {\n" % len(regs_out))
+	for r in regs_out:
+		out.write("\t{ %u, 0x%03X, %u, %u, %u },\n" % r)
+	out.write("};\n")
+
+	out.write("\nstatic const struct mon_periph mon_periphs[%d] = {\n" % len(periphs))
+	for name, base, regs in periphs:
+		out.write("\t{ 0x%08X, %u, %u, %u },\t// %s\n" % (base,pool[name],regindex[regs],len(regs),name))
+	out.write("};\n\n// End monregs.h\n")
+
+	sizes = (len(pool.data),len(fields_out)*4,len(regs_out)*8,len(periphs)*12)
+	sys.stderr.write("svd2mon: %d peripherals, %d registers, %d fields\n" % (len(periphs),len(regs_out),len(fields_out)))
+	sys.stderr.write("svd2mon: strpool %d + fields %d + regs %d + periphs %d = %d bytes flash\n"
+		% (sizes + (sum(sizes),)))
+
+if __name__ == "__main__":
+	main()
+
+# End svd2mon.py
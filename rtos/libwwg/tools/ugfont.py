@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+######################################################################
+#  ugfont.py -- Pre-render uGUI fonts as SSD1306 page columns
+#
+#  Usage:
+#	ugfont.py [-r first-last] [-o fontcols.h] ugui.c ugui_config.h
+#		  FONT_8X12 [FONT_4X6]...
+#
+#  The named 1BPP fonts are read from ugui.c, taking the variant
+#  ugui_config.h enables (FONT_8X12 may be the Cyrillic table). For
+#  characters first to last (default 0x20-0x7E), each glyph column
+#  is written as (height + 7) / 8 bytes, bottom row first: bit 0 of
+#  byte 0 is the glyph's last row. That is the SSD1306 page layout
+#  with y inverted (Y = 63 - y), so a glyph whose last row lands on
+#  a page boundary is a plain copy into the pixmap.
+#
+#  The header declares struct s_fontcols fontcols[], one entry per
+#  font, for a single file (meter.c) to include.
+######################################################################
+
+import sys
+import re
+import getopt
+import os
+
+def enabled(config):
+	"""USE_FONT_* macros ugui_config.h defines"""
+	uses = set()
+	for line in open(config):
+		m = re.match(r"\s*#define\s+(USE_FONT_\w+)",line)
+		if m:
+			uses.add(m.group(1))
+	return uses
+
+def read_fonts(path,uses):
+	"""Font arrays and UG_FONT definitions inside enabled #ifdefs"""
+	arrays, fonts = {}, {}
+	guard, name, rows = None, None, None
+
+	for line in open(path,encoding="latin-1"):
+		m = re.match(r"#ifdef\s+(USE_FONT_\w+)",line)
+		if m:
+			guard = m.group(1)
+			continue
+		if line.startswith("#endif"):
+			guard = None
+			continue
+		if guard not in uses:
+			continue
+		if name:
+			if line.startswith("};"):
+				arrays[name], name = rows, None
+			else:
+				body = line.split("//")[0]
+				rows.append([int(v,16) for v in re.findall(r"0x[0-9A-Fa-f]+",body)])
+			continue
+		m = re.match(r"__UG_FONT_DATA\s+unsigned\s+char\s+(\w+)\s*\[",line)
+		if m:
+			name, rows = m.group(1), []
+			continue
+		m = re.match(r"\s*const\s+UG_FONT\s+(\w+)\s*=\s*\{\(unsigned char\*\)(\w+),(\w+),(\d+),(\d+),(\d+),(\d+),(\w+)\}",line)
+		if m:
+			fonts[m.group(1)] = dict(array=m.group(2),type=m.group(3),width=int(m.group(4)),
+				height=int(m.group(5)),start=int(m.group(6)),end=int(m.group(7)),widths=m.group(8))
+	return arrays, fonts
+
+def columns(glyph,width,height):
+	"""Glyph rows (LSB = leftmost pixel) to bottom first column words"""
+	bn = (width + 7) // 8
+	cols = [0] * width
+	for j in range(height):
+		for i in range(width):
+			if glyph[j * bn + i // 8] >> (i % 8) & 1:
+				cols[i] |= 1 << (height - 1 - j)
+	return cols
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:],"r:o:")
+	first, last, out = 0x20, 0x7E, "fontcols.h"
+	for o, a in opts:
+		if o == "-r":
+			first, last = [int(v,0) for v in a.split("-")]
+		elif o == "-o":
+			out = a
+	if len(args) < 3:
+		sys.exit("Usage: ugfont.py [-r first-last] [-o fontcols.h] ugui.c ugui_config.h FONT_NAME...")
+
+	arrays, fonts = read_fonts(args[0],enabled(args[1]))
+	entries, total = [], 0
+	f = open(out,"w")
+	f.write("/* %s -- generated by ugfont.py from %s: do not edit */\n" % (os.path.basename(out),os.path.basename(args[0])))
+	f.write("#ifndef FONTCOLS_H\n#define FONTCOLS_H\n\n#include <stdint.h>\n\n#include \"ugui.h\"\n\n")
+	f.write("struct s_fontcols {\n")
+	f.write("\tconst UG_FONT\t*font;\n")
+	f.write("\tuint8_t\t\tfirst, last;\t// Characters held\n")
+	f.write("\tuint8_t\t\twidth;\t\t// Columns per glyph\n")
+	f.write("\tuint8_t\t\tbytes;\t\t// Bytes per column, bottom row in bit 0\n")
+	f.write("\tconst uint8_t\t*cols;\t\t// [last - first + 1][width][bytes]\n")
+	f.write("};\n")
+
+	for name in args[2:]:
+		font = fonts.get(name)
+		if not font:
+			sys.exit("ugfont: %s: not enabled in %s" % (name,args[1]))
+		if font["type"] != "FONT_TYPE_1BPP" or font["widths"] != "NULL":
+			sys.exit("ugfont: %s: only fixed width 1BPP fonts" % name)
+		w, h = font["width"], font["height"]
+		if h > 32:
+			sys.exit("ugfont: %s: taller than 32 rows" % name)
+		lo, hi = max(first,font["start"]), min(last,font["end"])
+		glyphs = arrays[font["array"]]
+		nb = (h + 7) // 8
+		var = "fontcols_" + name[5:].lower()
+
+		f.write("\nstatic const uint8_t %s[%d][%d][%d] = {\n" % (var,hi - lo + 1,w,nb))
+		for c in range(lo,hi + 1):
+			cols = columns(glyphs[c - font["start"]],w,h)
+			text = ",".join("{%s}" % ",".join("0x%02X" % (v >> 8 * k & 0xFF) for k in range(nb)) for v in cols)
+			f.write("\t{%s},\t// 0x%02X%s\n" % (text,c," '%s'" % chr(c) if 0x20 < c < 0x7F and chr(c) != "\\" else ""))
+		f.write("};\n")
+		entries.append("\t{ &%s, 0x%02X, 0x%02X, %d, %d, &%s[0][0][0] },\n" % (name,lo,hi,w,nb,var))
+		total += (hi - lo + 1) * w * nb
+
+	f.write("\nstatic const struct s_fontcols fontcols[] = {\n")
+	f.writelines(entries)
+	f.write("};\n\n#endif // FONTCOLS_H\n")
+	f.close()
+	sys.stderr.write("ugfont: %s: %d fonts, %d bytes\n" % (out,len(entries),total))
+
+if __name__ == "__main__":
+	main()
+
+# End ugfont.py
@@ -56,6 +56,23 @@ draw_point(short x,short y,short pen) {
 	}
 }
 
+#ifdef USE_COLOR_MONO
+
+/*
+ * 1 bit colours are the pens: C_BLACK 0, C_WHITE 1, C_INVERT 2
+ */
+static inline int
+ug_to_pen(UG_COLOR c) {
+	return c;
+}
+
+static inline UG_COLOR
+pen_to_ug(int pen) {
+	return pen;
+}
+
+#else
+
 static int
 ug_to_pen(UG_COLOR c) {
 
@@ -82,11 +99,292 @@ pen_to_ug(int pen) {
 	}	
 }
 
+#endif
+
 static void
 local_draw_point(UG_S16 x,UG_S16 y,UG_COLOR c) {
 	draw_point(x,y,ug_to_pen(c));
 }
 
+/*
+ * Accelerated 1bpp drivers (UG_DriverRegister): these write pixmap a
+ * byte (8 rows of a column) or a word at a time in the SSD1306 page
+ * layout, instead of a pset() call chain per pixel. XOR (C_RED) pens
+ * toggle each pixel as often as uGUI would, so they come out the same.
+ * Y is the page layout row: 63 - y.
+ */
+
+__attribute__((always_inline)) static inline uint8_t
+pen_byte(uint8_t b,uint8_t mask,int pen) {
+
+	switch ( pen ) {
+	case 0:
+		return b & ~mask;
+	case 1:
+		return b | mask;
+	default:
+		return b ^ mask;
+	}
+}
+
+/*
+ * One pixel, for the drivers (no pset() or pen lookup per call):
+ */
+__attribute__((always_inline)) static inline void
+plot(int x,int y,int pen) {
+	unsigned Y = 63 - y;
+	uint8_t *bp;
+
+	if ( (unsigned)x >= OLED_COLS || Y >= 64 )
+		return;
+	bp = &pixmap[(Y >> 3) * OLED_COLS + x];
+	*bp = pen_byte(*bp,1 << (Y & 7),pen);
+}
+
+/*
+ * Fill columns x1..x2 of rows Y1..Y2 (clipped):
+ */
+static void
+fill_rows(int x1,int x2,int Y1,int Y2,int pen) {
+	unsigned p1, p2;
+	uint8_t *row, mask;
+
+	if ( x1 < 0 )
+		x1 = 0;
+	if ( x2 > OLED_COLS - 1 )
+		x2 = OLED_COLS - 1;
+	if ( Y1 < 0 )
+		Y1 = 0;
+	if ( Y2 > 63 )
+		Y2 = 63;
+	if ( x1 > x2 || Y1 > Y2 )
+		return;
+
+	p1 = Y1 >> 3;
+	p2 = Y2 >> 3;
+	for ( unsigned px=p1; px<=p2; ++px ) {
+		mask = 0xFF;
+		if ( px == p1 )
+			mask &= 0xFF << (Y1 & 7);
+		if ( px == p2 )
+			mask &= 0xFF >> (7 - (Y2 & 7));
+		row = &pixmap[px * OLED_COLS];
+
+		int x = x1;
+		if ( mask == 0xFF && pen != 2 ) {
+			uint32_t w = pen ? 0xFFFFFFFF : 0;
+
+			// Whole bytes: a word at a time
+			for ( ; x + 3 <= x2; x += 4 )
+				memcpy(&row[x],&w,4);
+		}
+		for ( ; x <= x2; ++x )
+			row[x] = pen_byte(row[x],mask,pen);
+	}
+}
+
+static UG_RESULT
+drv_fill_frame(UG_S16 x1,UG_S16 y1,UG_S16 x2,UG_S16 y2,UG_COLOR c) {
+
+	// uGUI passes x1 <= x2, y1 <= y2
+	fill_rows(x1,x2,63-y2,63-y1,ug_to_pen(c));
+	return UG_RESULT_OK;
+}
+
+/*
+ * Lines: column and row fills when straight, else uGUI's own
+ * stepping (the same pixels), plotted in place:
+ */
+static UG_RESULT
+drv_draw_line(UG_S16 x1,UG_S16 y1,UG_S16 x2,UG_S16 y2,UG_COLOR c) {
+	int pen = ug_to_pen(c);
+	int dx, dy, sgndx, sgndy, dxabs, dyabs, x, y, drawx, drawy;
+
+	if ( x1 == x2 ) {
+		fill_rows(x1,x1,63-(y1 > y2 ? y1 : y2),63-(y1 > y2 ? y2 : y1),pen);
+		return UG_RESULT_OK;
+	}
+	if ( y1 == y2 ) {
+		fill_rows(x1 < x2 ? x1 : x2,x1 < x2 ? x2 : x1,63-y1,63-y1,pen);
+		return UG_RESULT_OK;
+	}
+
+	dx = x2 - x1;
+	dy = y2 - y1;
+	dxabs = dx > 0 ? dx : -dx;
+	dyabs = dy > 0 ? dy : -dy;
+	sgndx = dx > 0 ? 1 : -1;
+	sgndy = dy > 0 ? 1 : -1;
+	x = dyabs >> 1;
+	y = dxabs >> 1;
+	drawx = x1;
+	drawy = y1;
+
+	plot(drawx,drawy,pen);
+	if ( dxabs >= dyabs ) {
+		for ( int n=0; n<dxabs; n++ ) {
+			y += dyabs;
+			if ( y >= dxabs ) {
+				y -= dxabs;
+				drawy += sgndy;
+			}
+			drawx += sgndx;
+			plot(drawx,drawy,pen);
+		}
+	} else	{
+		for ( int n=0; n<dyabs; n++ ) {
+			x += dxabs;
+			if ( x >= dyabs ) {
+				x -= dyabs;
+				drawx += sgndx;
+			}
+			drawy += sgndy;
+			plot(drawx,drawy,pen);
+		}
+	}
+	return UG_RESULT_OK;
+}
+
+/*
+ * Circles: uGUI's stepping and plotting order (XOR safe):
+ */
+static UG_RESULT
+drv_draw_circle(UG_S16 x0,UG_S16 y0,UG_S16 r,UG_COLOR c) {
+	int pen = ug_to_pen(c);
+	int x = r, y = 0, xd = 1 - (r << 1), yd = 0, e = 0;
+
+	while ( x >= y ) {
+		plot(x0 - x,y0 + y,pen);
+		plot(x0 - x,y0 - y,pen);
+		plot(x0 + x,y0 + y,pen);
+		plot(x0 + x,y0 - y,pen);
+		plot(x0 - y,y0 + x,pen);
+		plot(x0 - y,y0 - x,pen);
+		plot(x0 + y,y0 + x,pen);
+		plot(x0 + y,y0 - x,pen);
+
+		y++;
+		e += yd;
+		yd += 2;
+		if ( (e << 1) + xd > 0 ) {
+			x--;
+			e += xd;
+			xd += 2;
+		}
+	}
+	return UG_RESULT_OK;
+}
+
+/*
+ * Filled circles (set or clear pens): each column filled once, to
+ * the greatest height of uGUI's lines there, then the outline.
+ */
+static UG_RESULT
+drv_fill_circle(UG_S16 x0,UG_S16 y0,UG_S16 r,UG_COLOR c) {
+	int pen = ug_to_pen(c);
+	int x = 0, y = r, xd = 3 - (r << 1);
+	int8_t h[OLED_COLS];		// Half height by column offset
+	uint8_t *bp, mask;
+
+	if ( pen == 2 || r >= OLED_COLS )
+		return UG_RESULT_FAIL;	// XOR: overlaps must repeat
+
+	memset(h,-1,r + 1);
+	while ( x <= y ) {
+		if ( y > 0 && y > h[x] )
+			h[x] = y;
+		if ( x > 0 && x > h[y] )
+			h[y] = x;
+		if ( xd < 0 ) {
+			xd += (x << 2) + 6;
+		} else	{
+			xd += ((x - y) << 2) + 10;
+			y--;
+		}
+		x++;
+	}
+
+	for ( int dx=-r; dx<=r; ++dx ) {
+		int hh = h[dx < 0 ? -dx : dx], Y1, Y2;
+
+		x = x0 + dx;
+		if ( hh < 0 || x < 0 || x >= OLED_COLS )
+			continue;
+		Y1 = 63 - (y0 + hh);
+		Y2 = 63 - (y0 - hh);
+		if ( Y1 < 0 )
+			Y1 = 0;
+		if ( Y2 > 63 )
+			Y2 = 63;
+		for ( int px=Y1 >> 3; Y1 <= Y2 && px<=Y2 >> 3; ++px ) {
+			mask = 0xFF;
+			if ( px == Y1 >> 3 )
+				mask &= 0xFF << (Y1 & 7);
+			if ( px == Y2 >> 3 )
+				mask &= 0xFF >> (7 - (Y2 & 7));
+			bp = &pixmap[px * OLED_COLS + x];
+			*bp = pen_byte(*bp,mask,pen);
+		}
+	}
+	return drv_draw_circle(x0,y0,r,c);
+}
+
+/*
+ * Glyphs (1bpp, up to 32x32): the set bits of each row are gathered
+ * into column words, which are then or'ed into the 2..5 page bytes
+ * each covers, foreground and background at once.
+ */
+static UG_RESULT
+drv_put_char(UG_U8 chr,UG_S16 x,UG_S16 y,UG_COLOR fc,UG_COLOR bc,const UG_FONT *font) {
+	unsigned h = font->char_height, bn, w;
+	int fpen = ug_to_pen(fc), bpen = ug_to_pen(bc);
+	int Yb = 63 - (y + (int)h - 1);		// Bottom row of the cell
+	int p0 = Yb >> 3, sh = Yb & 7;
+	const uint8_t *gp;
+	uint32_t cols[32];
+	uint64_t fbits, cbits;
+	uint8_t *bp, fm, cm, b;
+
+	if ( font->font_type != FONT_TYPE_1BPP || h > 32 || font->char_width > 32 )
+		return UG_RESULT_FAIL;
+
+	bn = (font->char_width + 7) >> 3;
+	w = font->widths ? font->widths[chr - font->start_char] : font->char_width;
+	gp = font->p + (chr - font->start_char) * h * bn;
+	cbits = ((1ull << h) - 1) << sh;
+
+	memset(cols,0,w * sizeof cols[0]);
+	for ( unsigned j=0; j<h; ++j ) {
+		uint32_t rbit = 1u << (h - 1 - j);
+
+		for ( unsigned k=0; k<bn; ++k ) {
+			b = *gp++;
+			for ( unsigned i=k*8; b && i<w; ++i, b >>= 1 )
+				if ( b & 1 )
+					cols[i] |= rbit;
+		}
+	}
+
+	for ( unsigned i=0; i<w; ++i ) {
+		int cx = x + i;
+
+		if ( cx < 0 || cx >= OLED_COLS )
+			continue;
+		fbits = (uint64_t)cols[i] << sh;
+
+		for ( int px=p0, k=0; k*8 < (int)h + sh; ++px, ++k ) {
+			if ( px < 0 || px >= OLED_PAGES )
+				continue;
+			cm = cbits >> (k * 8);
+			fm = fbits >> (k * 8);
+			bp = &pixmap[px * OLED_COLS + cx];
+			b = pen_byte(*bp,fm,fpen);
+			*bp = pen_byte(b,cm & ~fm,bpen);
+		}
+	}
+	return UG_RESULT_OK;
+}
+
 void
 meter_init(struct Meter *m,float range) {
 
@@ -101,6 +399,11 @@ meter_init(struct Meter *m,float range) {
 	m->range = range;
 
 	UG_Init(&gui,local_draw_point,128,64);
+	UG_DriverRegister(DRIVER_FILL_FRAME,(void *)drv_fill_frame);
+	UG_DriverRegister(DRIVER_DRAW_LINE,(void *)drv_draw_line);
+	UG_DriverRegister(DRIVER_PUT_CHAR,(void *)drv_put_char);
+	UG_DriverRegister(DRIVER_DRAW_CIRCLE,(void *)drv_draw_circle);
+	UG_DriverRegister(DRIVER_FILL_CIRCLE,(void *)drv_fill_circle);
 	m->cx = 128 / 2;
 	m->cy = 64 - 1;
 	m->ocr = m->cr + m->rd;
@@ -6,6 +6,9 @@
 #ifndef OLED_H
 #define OLED_H
 
+#define OLED_PAGES	8		// 8 rows of pixels per page
+#define OLED_COLS	128
+
 void oled_command(uint8_t byte);
 void oled_command2(uint8_t byte,uint8_t byte2);
 void oled_data(uint8_t byte);
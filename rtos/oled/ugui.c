@@ -4581,6 +4581,9 @@ UG_S16 UG_Init( UG_GUI* g, void (*p)(UG_S16,UG_S16,UG_COLOR), UG_S16 x, UG_S16 y
    #ifdef USE_COLOR_RGB565
    g->desktop_color = 0x5C5D;
    #endif
+   #ifdef USE_COLOR_MONO
+   g->desktop_color = C_WHITE;
+   #endif
    g->fore_color = C_WHITE;
    g->back_color = C_BLACK;
    g->next_window = NULL;
@@ -4772,6 +4775,12 @@ void UG_DrawCircle( UG_S16 x0, UG_S16 y0, UG_S16 r, UG_COLOR c )
    if ( y0<0 ) return;
    if ( r<=0 ) return;
 
+   /* Is hardware acceleration available? */
+   if ( gui->driver[DRIVER_DRAW_CIRCLE].state & DRIVER_ENABLED )
+   {
+      if( ((UG_RESULT(*)(UG_S16 x0, UG_S16 y0, UG_S16 r, UG_COLOR c))gui->driver[DRIVER_DRAW_CIRCLE].driver)(x0,y0,r,c) == UG_RESULT_OK ) return;
+   }
+
    xd = 1 - (r << 1);
    yd = 0;
    e = 0;
@@ -4809,6 +4818,12 @@ void UG_FillCircle( UG_S16 x0, UG_S16 y0, UG_S16 r, UG_COLOR c )
    if ( y0<0 ) return;
    if ( r<=0 ) return;
 
+   /* Is hardware acceleration available? */
+   if ( gui->driver[DRIVER_FILL_CIRCLE].state & DRIVER_ENABLED )
+   {
+      if( ((UG_RESULT(*)(UG_S16 x0, UG_S16 y0, UG_S16 r, UG_COLOR c))gui->driver[DRIVER_FILL_CIRCLE].driver)(x0,y0,r,c) == UG_RESULT_OK ) return;
+   }
+
    xd = 3 - (r << 1);
    x = 0;
    y = r;
@@ -5248,6 +5263,103 @@ const UG_COLOR pal_checkbox_released[] =
 };
 #endif
 
+#ifdef USE_COLOR_MONO
+const UG_COLOR pal_window[] =
+{
+   /* Frame 0 */
+   0x00,
+   0x00,
+   0x00,
+   0x00,
+   /* Frame 1 */
+   0x01,
+   0x01,
+   0x00,
+   0x00,
+   /* Frame 2 */
+   0x01,
+   0x01,
+   0x01,
+   0x01,
+};
+
+const UG_COLOR pal_button_pressed[] =
+{
+   /* Frame 0 */
+   0x00,
+   0x00,
+   0x00,
+   0x00,
+   /* Frame 1 */
+   0x01,
+   0x01,
+   0x01,
+   0x01,
+   /* Frame 2 */
+   0x01,
+   0x01,
+   0x01,
+   0x01,
+};
+
+const UG_COLOR pal_button_released[] =
+{
+   /* Frame 0 */
+   0x00,
+   0x00,
+   0x00,
+   0x00,
+   /* Frame 1 */
+   0x01,
+   0x01,
+   0x00,
+   0x00,
+   /* Frame 2 */
+   0x01,
+   0x01,
+   0x01,
+   0x01,
+};
+
+const UG_COLOR pal_checkbox_pressed[] =
+{
+   /* Frame 0 */
+   0x00,
+   0x00,
+   0x00,
+   0x00,
+   /* Frame 1 */
+   0x01,
+   0x01,
+   0x01,
+   0x01,
+   /* Frame 2 */
+   0x01,
+   0x01,
+   0x01,
+   0x01,
+};
+
+const UG_COLOR pal_checkbox_released[] =
+{
+   /* Frame 0 */
+   0x00,
+   0x00,
+   0x00,
+   0x00,
+   /* Frame 1 */
+   0x01,
+   0x01,
+   0x00,
+   0x00,
+   /* Frame 2 */
+   0x01,
+   0x01,
+   0x01,
+   0x01,
+};
+#endif
+
 
 
 /* -------------------------------------------------------------------------------- */
@@ -5284,6 +5396,12 @@ void _UG_PutChar( char chr, UG_S16 x, UG_S16 y, UG_COLOR fc, UG_COLOR bc, const
    if ( font->char_width % 8 ) bn++;
    actual_char_width = (font->widths ? font->widths[bt - font->start_char] : font->char_width);
 
+   /* Does the driver draw whole glyphs? */
+   if ( gui->driver[DRIVER_PUT_CHAR].state & DRIVER_ENABLED )
+   {
+      if( ((UG_RESULT(*)(UG_U8 chr, UG_S16 x, UG_S16 y, UG_COLOR fc, UG_COLOR bc, const UG_FONT* font))gui->driver[DRIVER_PUT_CHAR].driver)(bt,x,y,fc,bc,font) == UG_RESULT_OK ) return;
+   }
+
    /* Is hardware acceleration available? */
    if ( gui->driver[DRIVER_FILL_AREA].state & DRIVER_ENABLED )
    {
@@ -5323,9 +5441,13 @@ void _UG_PutChar( char chr, UG_S16 x, UG_S16 y, UG_COLOR fc, UG_COLOR bc, const
 			  for( i=0;i<actual_char_width;i++ )
 			  {
 				 b = font->p[index++];
+				 #ifdef USE_COLOR_MONO
+				 color = b >= 0x80 ? fc : bc;
+				 #else
 				 color = (((fc & 0xFF) * b + (bc & 0xFF) * (256 - b)) >> 8) & 0xFF |//Blue component
 				         (((fc & 0xFF00) * b + (bc & 0xFF00) * (256 - b)) >> 8)  & 0xFF00|//Green component
 				         (((fc & 0xFF0000) * b + (bc & 0xFF0000) * (256 - b)) >> 8) & 0xFF0000; //Red component
+				 #endif
 				 push_pixel(color);
 			  }
 			  index += font->char_width - actual_char_width;
@@ -5372,9 +5494,13 @@ void _UG_PutChar( char chr, UG_S16 x, UG_S16 y, UG_COLOR fc, UG_COLOR bc, const
             for( i=0;i<actual_char_width;i++ )
             {
                b = font->p[index++];
+               #ifdef USE_COLOR_MONO
+               color = b >= 0x80 ? fc : bc;
+               #else
                color = (((fc & 0xFF) * b + (bc & 0xFF) * (256 - b)) >> 8) & 0xFF |//Blue component
                        (((fc & 0xFF00) * b + (bc & 0xFF00) * (256 - b)) >> 8)  & 0xFF00|//Green component
                        (((fc & 0xFF0000) * b + (bc & 0xFF0000) * (256 - b)) >> 8) & 0xFF0000; //Red component
+               #endif
                gui->pset(xo,yo,color);
                xo++;
             }
@@ -5880,6 +6006,10 @@ UG_RESULT UG_WindowCreate( UG_WINDOW* wnd, UG_OBJECT* objlst, UG_U8 objcnt, void
    wnd->fc = 0x0000;
    wnd->bc = 0xEF7D;
    #endif
+   #ifdef USE_COLOR_MONO
+   wnd->fc = C_BLACK;
+   wnd->bc = C_WHITE;
+   #endif
    wnd->xs = 0;
    wnd->ys = 0;
    wnd->xe = UG_GetXDim()-1;
@@ -105,6 +105,9 @@ typedef UG_U32                                        UG_COLOR;
 #ifdef USE_COLOR_RGB565
 typedef UG_U16                                        UG_COLOR;
 #endif
+#ifdef USE_COLOR_MONO
+typedef UG_U8                                         UG_COLOR;
+#endif
 /* -------------------------------------------------------------------------------- */
 /* -- DEFINES                                                                    -- */
 /* -------------------------------------------------------------------------------- */
@@ -317,8 +320,8 @@ typedef struct
 /* Window structure */
 struct S_WINDOW
 {
-   UG_U8 objcnt;
    UG_OBJECT* objlst;
+   UG_U8 objcnt;
    UG_U8 state;
    UG_COLOR fc;
    UG_COLOR bc;
@@ -548,10 +551,13 @@ typedef struct
 #define DRIVER_ENABLED                                (1<<1)
 
 /* Supported drivers */
-#define NUMBER_OF_DRIVERS                             3
+#define NUMBER_OF_DRIVERS                             6
 #define DRIVER_DRAW_LINE                              0
 #define DRIVER_FILL_FRAME                             1
 #define DRIVER_FILL_AREA                              2
+#define DRIVER_PUT_CHAR                               3
+#define DRIVER_DRAW_CIRCLE                            4
+#define DRIVER_FILL_CIRCLE                            5
 
 /* -------------------------------------------------------------------------------- */
 /* -- µGUI CORE STRUCTURE                                                        -- */
@@ -876,6 +882,151 @@ typedef struct
 #define  C_WHITE                      0xFFFFFF
 #endif
 
+#ifdef USE_COLOR_MONO
+/* 1 bit: each colour is black or white, by its luminance. C_INVERT
+   flips pixels, where the pset() and drivers do so. */
+#define  C_INVERT                     0x02
+#define  C_MAROON                     0x00
+#define  C_DARK_RED                   0x00
+#define  C_BROWN                      0x00
+#define  C_FIREBRICK                  0x00
+#define  C_CRIMSON                    0x00
+#define  C_RED                        0x00
+#define  C_TOMATO                     0x01
+#define  C_CORAL                      0x01
+#define  C_INDIAN_RED                 0x00
+#define  C_LIGHT_CORAL                0x01
+#define  C_DARK_SALMON                0x01
+#define  C_SALMON                     0x01
+#define  C_LIGHT_SALMON               0x01
+#define  C_ORANGE_RED                 0x00
+#define  C_DARK_ORANGE                0x01
+#define  C_ORANGE                     0x01
+#define  C_GOLD                       0x01
+#define  C_DARK_GOLDEN_ROD            0x01
+#define  C_GOLDEN_ROD                 0x01
+#define  C_PALE_GOLDEN_ROD            0x01
+#define  C_DARK_KHAKI                 0x01
+#define  C_KHAKI                      0x01
+#define  C_OLIVE                      0x00
+#define  C_YELLOW                     0x01
+#define  C_YELLOW_GREEN               0x01
+#define  C_DARK_OLIVE_GREEN           0x00
+#define  C_OLIVE_DRAB                 0x00
+#define  C_LAWN_GREEN                 0x01
+#define  C_CHART_REUSE                0x01
+#define  C_GREEN_YELLOW               0x01
+#define  C_DARK_GREEN                 0x00
+#define  C_GREEN                      0x01
+#define  C_FOREST_GREEN               0x00
+#define  C_LIME                       0x01
+#define  C_LIME_GREEN                 0x01
+#define  C_LIGHT_GREEN                0x01
+#define  C_PALE_GREEN                 0x01
+#define  C_DARK_SEA_GREEN             0x01
+#define  C_MEDIUM_SPRING_GREEN        0x01
+#define  C_SPRING_GREEN               0x01
+#define  C_SEA_GREEN                  0x00
+#define  C_MEDIUM_AQUA_MARINE         0x01
+#define  C_MEDIUM_SEA_GREEN           0x01
+#define  C_LIGHT_SEA_GREEN            0x01
+#define  C_DARK_SLATE_GRAY            0x00
+#define  C_TEAL                       0x00
+#define  C_DARK_CYAN                  0x00
+#define  C_AQUA                       0x01
+#define  C_CYAN                       0x01
+#define  C_LIGHT_CYAN                 0x01
+#define  C_DARK_TURQUOISE             0x01
+#define  C_TURQUOISE                  0x01
+#define  C_MEDIUM_TURQUOISE           0x01
+#define  C_PALE_TURQUOISE             0x01
+#define  C_AQUA_MARINE                0x01
+#define  C_POWDER_BLUE                0x01
+#define  C_CADET_BLUE                 0x01
+#define  C_STEEL_BLUE                 0x00
+#define  C_CORN_FLOWER_BLUE           0x01
+#define  C_DEEP_SKY_BLUE              0x01
+#define  C_DODGER_BLUE                0x00
+#define  C_LIGHT_BLUE                 0x01
+#define  C_SKY_BLUE                   0x01
+#define  C_LIGHT_SKY_BLUE             0x01
+#define  C_MIDNIGHT_BLUE              0x00
+#define  C_NAVY                       0x00
+#define  C_DARK_BLUE                  0x00
+#define  C_MEDIUM_BLUE                0x00
+#define  C_BLUE                       0x00
+#define  C_ROYAL_BLUE                 0x00
+#define  C_BLUE_VIOLET                0x00
+#define  C_INDIGO                     0x00
+#define  C_DARK_SLATE_BLUE            0x00
+#define  C_SLATE_BLUE                 0x00
+#define  C_MEDIUM_SLATE_BLUE          0x00
+#define  C_MEDIUM_PURPLE              0x01
+#define  C_DARK_MAGENTA               0x00
+#define  C_DARK_VIOLET                0x00
+#define  C_DARK_ORCHID                0x00
+#define  C_MEDIUM_ORCHID              0x01
+#define  C_PURPLE                     0x00
+#define  C_THISTLE                    0x01
+#define  C_PLUM                       0x01
+#define  C_VIOLET                     0x01
+#define  C_MAGENTA                    0x00
+#define  C_ORCHID                     0x01
+#define  C_MEDIUM_VIOLET_RED          0x00
+#define  C_PALE_VIOLET_RED            0x01
+#define  C_DEEP_PINK                  0x00
+#define  C_HOT_PINK                   0x01
+#define  C_LIGHT_PINK                 0x01
+#define  C_PINK                       0x01
+#define  C_ANTIQUE_WHITE              0x01
+#define  C_BEIGE                      0x01
+#define  C_BISQUE                     0x01
+#define  C_BLANCHED_ALMOND            0x01
+#define  C_WHEAT                      0x01
+#define  C_CORN_SILK                  0x01
+#define  C_LEMON_CHIFFON              0x01
+#define  C_LIGHT_GOLDEN_ROD_YELLOW    0x01
+#define  C_LIGHT_YELLOW               0x01
+#define  C_SADDLE_BROWN               0x00
+#define  C_SIENNA                     0x00
+#define  C_CHOCOLATE                  0x00
+#define  C_PERU                       0x01
+#define  C_SANDY_BROWN                0x01
+#define  C_BURLY_WOOD                 0x01
+#define  C_TAN                        0x01
+#define  C_ROSY_BROWN                 0x01
+#define  C_MOCCASIN                   0x01
+#define  C_NAVAJO_WHITE               0x01
+#define  C_PEACH_PUFF                 0x01
+#define  C_MISTY_ROSE                 0x01
+#define  C_LAVENDER_BLUSH             0x01
+#define  C_LINEN                      0x01
+#define  C_OLD_LACE                   0x01
+#define  C_PAPAYA_WHIP                0x01
+#define  C_SEA_SHELL                  0x01
+#define  C_MINT_CREAM                 0x01
+#define  C_SLATE_GRAY                 0x00
+#define  C_LIGHT_SLATE_GRAY           0x01
+#define  C_LIGHT_STEEL_BLUE           0x01
+#define  C_LAVENDER                   0x01
+#define  C_FLORAL_WHITE               0x01
+#define  C_ALICE_BLUE                 0x01
+#define  C_GHOST_WHITE                0x01
+#define  C_HONEYDEW                   0x01
+#define  C_IVORY                      0x01
+#define  C_AZURE                      0x01
+#define  C_SNOW                       0x01
+#define  C_BLACK                      0x00
+#define  C_DIM_GRAY                   0x00
+#define  C_GRAY                       0x00
+#define  C_DARK_GRAY                  0x01
+#define  C_SILVER                     0x01
+#define  C_LIGHT_GRAY                 0x01
+#define  C_GAINSBORO                  0x01
+#define  C_WHITE_SMOKE                0x01
+#define  C_WHITE                      0x01
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
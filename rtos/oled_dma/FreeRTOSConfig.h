@@ -93,7 +93,7 @@
 #define configTICK_RATE_HZ		( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES		( 5 )
 #define configMINIMAL_STACK_SIZE	( ( unsigned short ) 128 )
-#define configTOTAL_HEAP_SIZE		( ( size_t ) ( 15 * 1024 ) )
+#define configTOTAL_HEAP_SIZE		( ( size_t ) ( 14 * 1024 ) )	// 1K went to the meter dial image
 #define configMAX_TASK_NAME_LEN		( 16 )
 #define configUSE_TRACE_FACILITY	0
 #define configUSE_16_BIT_TICKS		0
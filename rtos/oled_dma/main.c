@@ -36,15 +36,101 @@
 #include <libopencm3/stm32/spi.h>
 #include <libopencm3/stm32/dma.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/dwt.h>
 	
+#define OLED_XFER_COST	4	// Transfer overhead in byte times (at DIV_64)
+
+#ifndef OLED_SPI_DIV
+#define OLED_SPI_DIV	8	// SCK = 72 MHz / 8 = 9 MHz (SSD1306: 10 MHz at most)
+#endif
+#if OLED_SPI_DIV < 8 || OLED_SPI_DIV > 256 || (OLED_SPI_DIV & (OLED_SPI_DIV - 1))
+#error "OLED_SPI_DIV must be 8, 16, 32, 64, 128 or 256"
+#endif
+
+static const struct {
+	uint16_t	div;
+	uint8_t		br;
+} spi_speeds[] = {
+	{ 8,	SPI_CR1_BAUDRATE_FPCLK_DIV_8 },		// 9 MHz
+	{ 16,	SPI_CR1_BAUDRATE_FPCLK_DIV_16 },	// 4.5 MHz
+	{ 32,	SPI_CR1_BAUDRATE_FPCLK_DIV_32 },
+	{ 64,	SPI_CR1_BAUDRATE_FPCLK_DIV_64 },	// 1.125 MHz
+	{ 128,	SPI_CR1_BAUDRATE_FPCLK_DIV_128 },
+	{ 256,	SPI_CR1_BAUDRATE_FPCLK_DIV_256 },
+};
+
 static TaskHandle_t h_spidma = NULL;
 static volatile bool dma_busy = false;
 static volatile bool dma_idle = true;
 static volatile bool dma_more = false;
-static volatile uint8_t *pixmapp = NULL;
-static volatile uint8_t pageno = 0;
-
-static void start_dma(void);
+static struct s_oled_span pending[OLED_PAGES];	// Flushed, not yet started
+static volatile uint32_t dma_t0;		// Cycle count at transfer start
+static volatile uint32_t dma_t1;		// ..and at its ISR
+static volatile bool dma_isr = false;		// ISR ran, task not yet
+static unsigned spi_div = 64;			// SCK = 72 MHz / spi_div
+static unsigned xfer_cost = OLED_XFER_COST;	// ..in byte times at spi_div
+
+/*
+ * Frame pacing (oled_fps): presents start on a grid of frame times,
+ * at most one per frame. Presents asked while one waits for its time
+ * (or for DMA) are coalesced into it. Frame times that pass while a
+ * present waits count as drops.
+ */
+unsigned oled_fps = OLED_FPS;
+static TickType_t due;				// Next frame time
+static unsigned due_rem;			// ..plus due_rem / oled_fps ticks
+static TickType_t since;			// Present waiting since
+
+/*
+ * Double buffered (OLED_DOUBLE_BUFFER), the drawing task draws into
+ * pixmap (the back buffer) while DMA reads front. Presenting swaps
+ * them, then copies the changed spans to the new back buffer, so both
+ * hold the presented frame. Presenting while DMA is busy leaves the
+ * swap to the end of the transfer, unless drawing has started again
+ * (then the next present supersedes it, and it counts as dropped).
+ */
+#if OLED_DOUBLE_BUFFER
+static uint8_t frames[2][OLED_PAGES*OLED_COLS];
+uint8_t *volatile pixmap = frames[0];
+static uint8_t *front = frames[1];
+#else
+static uint8_t frames[1][OLED_PAGES*OLED_COLS];
+uint8_t *volatile pixmap = frames[0];
+static uint8_t *const front = frames[0];
+#endif
+volatile bool oled_drawing = false;		// Drawn into since present
+
+/*
+ * The SSD1306 is kept in horizontal addressing mode. A full frame is
+ * 1024 data bytes in one DMA transfer: with the window at all columns
+ * and pages, the address wraps back to page 0 column 0 afterwards, so
+ * the next full frame needs no commands at all. A partial update is
+ * sent a page at a time: a window command, then the changed columns.
+ */
+struct s_xfer {
+	volatile uint8_t *buf;
+	uint16_t	len;
+	bool		data;		// D/C high
+};
+
+static struct s_xfer plan[2*OLED_PAGES];	// Transfers of this frame
+static volatile uint8_t nplan = 0, step = 0;
+static uint8_t wcmds[OLED_PAGES][6];		// Page windows
+static bool mode_set = false;			// Horizontal mode sent
+static bool window_full = false;		// ..with the full frame window
+
+static uint8_t setup_cmds[] = {
+	0x40,		// Display start line
+	0xD3, 0x00,	// Display offset
+	0x20, 0x00,	// Horizontal addressing
+	0x21, 0x00, 0x7F, // Columns 0..127
+	0x22, 0x00, 0x07 // Pages 0..7
+};
+
+struct s_oled_stats oled_stats;
+bool oled_full_frames = true;			// Else page transfers only
+
+static void start_dma(bool restart);
 
 /*********************************************************************
  * DMA ISR Routine
@@ -52,15 +138,19 @@ static void start_dma(void);
 
 void
 dma1_channel3_isr(void) {
-	BaseType_t woken __attribute__((unused)) = pdFALSE;
+	BaseType_t woken = pdFALSE;
 
 	if ( dma_get_interrupt_flag(DMA1,DMA_CHANNEL3,DMA_TCIF) )
 		dma_clear_interrupt_flags(DMA1,DMA_CHANNEL3,DMA_TCIF);
 
         spi_disable_tx_dma(SPI1);
+	dma_t1 = dwt_read_cycle_counter();
+	oled_stats.busy_cycles += dma_t1 - dma_t0;
+	dma_isr = true;
 
 	// Notify spidma_task to start another:
 	vTaskNotifyGiveFromISR(h_spidma,&woken);
+	portYIELD_FROM_ISR(woken);
 }
 
 /*********************************************************************
@@ -72,102 +162,313 @@ spi_dma_transmit(volatile uint8_t *tx_buf,int tx_len) {
 
 	dma_idle = false;
 	dma_busy = true;
+	oled_stats.bytes += tx_len;
+	++oled_stats.transfers;
 
+	dma_isr = false;
 	dma_disable_channel(DMA1,DMA_CHANNEL3);
         dma_set_memory_address(DMA1,DMA_CHANNEL3,(uint32_t)tx_buf);
         dma_set_number_of_data(DMA1,DMA_CHANNEL3,tx_len);
+	dma_t0 = dwt_read_cycle_counter();
 	dma_enable_channel(DMA1,DMA_CHANNEL3);
 	spi_enable_tx_dma(SPI1);
 	spi_enable(SPI1);
 }
 
 /*********************************************************************
- * Task to manage SPI1 & DMA1
+ * Frame pacing: tick a is before tick b (across wraps)
+ *********************************************************************/
+
+static inline bool
+before(TickType_t a,TickType_t b) {
+	return (TickType_t)(a - b) > portMAX_DELAY / 2;
+}
+
+static void
+next_frame(void) {
+
+	due += configTICK_RATE_HZ / oled_fps;
+	due_rem += configTICK_RATE_HZ % oled_fps;
+	if ( due_rem >= oled_fps ) {
+		due_rem -= oled_fps;
+		++due;
+	}
+}
+
+/*********************************************************************
+ * May the present waiting since 'since' start now? If so, due moves
+ * to the next frame time after now, and the frame times it waited
+ * through (all but the one it takes) are drops. In a critical section.
+ *********************************************************************/
+
+static bool
+frame_start(void) {
+	TickType_t now = xTaskGetTickCount();
+	unsigned passed = 0;
+
+	if ( !oled_fps )
+		return true;
+	if ( before(now,due) )
+		return false;
+	if ( before(due,since) ) {
+		due = since;			// Idle until then: a new grid
+		due_rem = 0;
+	}
+	while ( !before(now,due) ) {
+		++passed;
+		next_frame();
+	}
+	oled_stats.drops += passed - 1;
+	return true;
+}
+
+/*
+ * Ticks spidma_task may block for: until the frame time, if idle with
+ * a present waiting for it:
+ */
+static TickType_t
+frame_wait(void) {
+	TickType_t now = xTaskGetTickCount();
+
+	if ( oled_fps && dma_idle && dma_more && before(now,due) )
+		return due - now;
+	return portMAX_DELAY;
+}
+
+/*********************************************************************
+ * Task to manage SPI1 & DMA1: runs the transfers in plan[], and
+ * starts paced presents at their frame time
  *********************************************************************/
 
 static void
 spidma_task(void *arg __attribute((unused))) {
-	static uint8_t cmds[] = {
-		0x20, 0x02,	// 0: Page mode
-		0x40,		// 2: Display start line
-		0xD3, 0x00,	// 3: Display offset
-		0xB0,		// 5: Page #
-		0x00,		// 6: Lo col
-		0x10		// 7: Hi Col
-	};
+	struct s_xfer *xp;
+	uint32_t wake;
 
 	for (;;) {
-		// Block until ISR notifies
-		ulTaskNotifyTake(pdTRUE,portMAX_DELAY);
+		// Block until ISR notifies (or the frame time)
+		ulTaskNotifyTake(pdTRUE,frame_wait());
+		++oled_stats.wakeups;
+		if ( dma_isr ) {
+			wake = dwt_read_cycle_counter() - dma_t1;
+			oled_stats.wake_cycles += wake;
+			if ( wake > oled_stats.wake_max )
+				oled_stats.wake_max = wake;
+			dma_isr = false;
+		}
 		if ( dma_busy ) {
 			spi_clean_disable(SPI1);
 			dma_busy = false;
-			if ( gpio_get(GPIOB,GPIO10) ) {
-				// Advance data
-				pixmapp += 128;
-				++pageno;
-			}
-			// Toggle between Command/Data
-			gpio_toggle(GPIOB,GPIO10);
+			++step;
 		}
 
-		if ( pageno >= 8 ) {
-			// All OLED pages sent:
-			dma_idle = true;
-			if ( dma_more ) {
-				// Restart update
-				dma_more = false;
-				start_dma();
-			}
+		if ( step >= nplan ) {
+			// Frame sent: start a pending present, if any (and due)
+			start_dma(true);
 		} else	{
-			// Another page to send:
-			cmds[5] = 0xB0 | pageno;
-			if ( !gpio_get(GPIOB,GPIO10) ) {
-				// Send commands:
-				if ( !pageno )
-					spi_dma_transmit(&cmds[0],8);
-				else	spi_dma_transmit(&cmds[5],3);
-			} else	{
-				// Send page data:
-				spi_dma_transmit(pixmapp,128);
-			}
+			xp = &plan[step];
+			if ( xp->data )
+				gpio_set(GPIOB,GPIO10);
+			else	gpio_clear(GPIOB,GPIO10);
+			spi_dma_transmit(xp->buf,xp->len);
+		}
+	}
+}
+
+/*********************************************************************
+ * Internal: Add a transfer to the plan
+ *********************************************************************/
+
+static void
+plan_add(volatile uint8_t *buf,unsigned len,bool data) {
+	struct s_xfer *xp = &plan[nplan++];
+
+	xp->buf = buf;
+	xp->len = len;
+	xp->data = data;
+}
+
+/*********************************************************************
+ * Plan the transfers for the changes in spans[]: a full frame if that
+ * costs no more than the changed pages one at a time, counting each
+ * transfer's overhead (ISR, task wakeup, D/C) as xfer_cost bytes
+ *********************************************************************/
+
+static void
+plan_frame(const struct s_oled_span *spans) {
+	unsigned npages = 0, nbytes = 0, skip;
+	uint8_t *cp;
+
+	nplan = step = 0;
+	for ( unsigned px=0; px<OLED_PAGES; ++px ) {
+		if ( spans[px].lo < spans[px].hi ) {
+			++npages;
+			nbytes += spans[px].hi - spans[px].lo;
+		}
+	}
+	if ( !npages )
+		return;
+
+	skip = mode_set ? 5 : 0;		// Mode commands already sent
+	if ( oled_full_frames
+	  && OLED_PAGES*OLED_COLS + xfer_cost <= nbytes + npages * (6 + 2 * xfer_cost) ) {
+		if ( !window_full )
+			plan_add(&setup_cmds[skip],sizeof setup_cmds-skip,false);
+		plan_add(front,OLED_PAGES*OLED_COLS,true);
+		mode_set = window_full = true;
+		return;
+	}
+
+	for ( unsigned px=0; px<OLED_PAGES; ++px ) {
+		if ( spans[px].lo >= spans[px].hi )
+			continue;
+		if ( !mode_set ) {
+			plan_add(&setup_cmds[0],5,false);
+			mode_set = true;
 		}
+		cp = wcmds[px];
+		cp[0] = 0x21;			// Columns lo..hi-1
+		cp[1] = spans[px].lo;
+		cp[2] = spans[px].hi - 1;
+		cp[3] = 0x22;			// Page px only
+		cp[4] = cp[5] = px;
+		plan_add(cp,6,false);
+		plan_add(&front[px*OLED_COLS+spans[px].lo],spans[px].hi-spans[px].lo,true);
 	}
+	window_full = false;
 }
 
 /*********************************************************************
- * Start DMA transfer from OLED Page 0
+ * Present the pending changes and start their DMA transfer. From
+ * spidma_task (restart), only if a present is waiting, its frame
+ * time has come, and drawing has not started since; else DMA goes
+ * idle.
  *********************************************************************/
 
 static void
-start_dma(void) {
-	extern uint8_t pixmap[128*64/8];
+start_dma(bool restart) {
+	struct s_oled_span spans[OLED_PAGES];
+
+	taskENTER_CRITICAL();
+	if ( restart ) {
+		if ( !dma_more || oled_drawing || !frame_start() ) {
+			dma_idle = true;
+			taskEXIT_CRITICAL();
+			return;
+		}
+		dma_more = false;
+	}
+	memcpy(spans,pending,sizeof spans);
+	memset(pending,0,sizeof pending);	// Unchanged
+#if OLED_DOUBLE_BUFFER
+	{
+		uint8_t *back = front;
+		unsigned off;
+
+		front = pixmap;
+		pixmap = back;
+		for ( unsigned px=0; px<OLED_PAGES; ++px ) {
+			if ( spans[px].lo < spans[px].hi ) {
+				off = px*OLED_COLS+spans[px].lo;
+				memcpy(back+off,front+off,spans[px].hi-spans[px].lo);
+			}
+		}
+	}
+#endif
+	taskEXIT_CRITICAL();
 
-	pageno = 0;
-	pixmapp = &pixmap[0];
-	gpio_clear(GPIOB,GPIO10); // Cmd mode
+	plan_frame(spans);
+	++oled_stats.presents;
 	xTaskNotifyGive(h_spidma);
 }
 
 /*********************************************************************
- * Initiate a DMA OLED update or Queue repeat update
+ * Initiate a DMA OLED update or Queue repeat update. Called by the
+ * drawing task: the pixmap changes since the last call are added to
+ * those pending, and sent at the next start (at once if DMA is idle
+ * and the frame time has come).
  *********************************************************************/
 
 void
 spi_dma_xmit_pixmap(void) {
-	bool prime = false;
+	bool prime = false, wake = false;
 
 	taskENTER_CRITICAL();
-	if ( !dma_idle ) {
-		// Restart dma at DMA completion
-		dma_more = true;// Restart upon completion
-	} else	{
+	++oled_stats.updates;
+	for ( unsigned px=0; px<OLED_PAGES; ++px ) {
+		struct s_oled_span *dp = &oled_dirty[px], *pp = &pending[px];
+
+		if ( dp->lo >= dp->hi )
+			continue;
+		if ( pp->lo >= pp->hi ) {
+			*pp = *dp;
+		} else	{
+			if ( dp->lo < pp->lo )
+				pp->lo = dp->lo;
+			if ( dp->hi > pp->hi )
+				pp->hi = dp->hi;
+		}
+		dp->lo = dp->hi = 0;
+	}
+
+	if ( dma_more )
+		++oled_stats.coalesced;	// Joins the present waiting
+	else	since = xTaskGetTickCount();
+	if ( dma_idle && frame_start() ) {
 		prime = true;	// Start from idle
+		dma_idle = false;
+		dma_more = false;
+	} else	{
+		dma_more = true;	// Start upon completion, or when due
+		wake = dma_idle;	// spidma_task: wait for the frame time
 	}
+	oled_drawing = false;
 	taskEXIT_CRITICAL();
 
 	if ( prime )
-		start_dma();	// Start from idle
+		start_dma(false);	// Start from idle
+	else if ( wake )
+		xTaskNotifyGive(h_spidma);
+}
+
+/*********************************************************************
+ * Block the drawing task until the next frame time, so that it draws
+ * once per frame (returns at once if oled_fps is 0 or it is late)
+ *********************************************************************/
+
+void
+oled_frame_wait(void) {
+	TickType_t now = xTaskGetTickCount(), d = due;
+
+	if ( oled_fps && before(now,d) )
+		vTaskDelay(d - now);
+}
+
+/*********************************************************************
+ * Set SCK to 72 MHz / div (8 to 256, a power of 2), between frames.
+ * The full frame choice (plan_frame()) is rescaled with it.
+ *********************************************************************/
+
+bool
+oled_set_spi_div(unsigned div) {
+
+	for ( unsigned sx=0; sx<sizeof spi_speeds/sizeof spi_speeds[0]; ++sx ) {
+		if ( spi_speeds[sx].div != div )
+			continue;
+		taskENTER_CRITICAL();
+		while ( !dma_idle ) {		// SPI is disabled when idle
+			taskEXIT_CRITICAL();
+			vTaskDelay(1);
+			taskENTER_CRITICAL();
+		}
+		// DIV_256 is all three BR bits
+		SPI_CR1(SPI1) = (SPI_CR1(SPI1) & ~SPI_CR1_BAUDRATE_FPCLK_DIV_256) | spi_speeds[sx].br;
+		spi_div = div;
+		xfer_cost = OLED_XFER_COST * 64 / div;
+		taskEXIT_CRITICAL();
+		return true;
+	}
+	return false;
 }
 
 /*********************************************************************
@@ -222,6 +523,30 @@ oled_init(void) {
 	gpio_set(GPIOC,GPIO13);
 }
 
+/*********************************************************************
+ * Report the display counters, over ms milliseconds
+ *********************************************************************/
+
+static void
+show_stats(unsigned ms) {
+	unsigned busy = oled_stats.busy_cycles / 72000u;	// ms
+	unsigned n = oled_stats.transfers ? oled_stats.transfers : 1;
+
+	std_printf("%u updates, %u presented (%u/s), %u coalesced, %u dropped\n"
+		"%u bytes (%u per update), %u DMA transfers, %u task wakeups\n"
+		"DMA busy %u ms (%u%%), ISR to task %u us mean, %u us worst\n"
+		"SPI 72 MHz /%u, %u fps target\n",
+		(unsigned)oled_stats.updates,(unsigned)oled_stats.presents,
+		(unsigned)(oled_stats.presents*1000/ms),
+		(unsigned)oled_stats.coalesced,(unsigned)oled_stats.drops,
+		(unsigned)oled_stats.bytes,
+		(unsigned)(oled_stats.bytes/oled_stats.updates),
+		(unsigned)oled_stats.transfers,(unsigned)oled_stats.wakeups,
+		busy,busy*100/ms,
+		(unsigned)(oled_stats.wake_cycles/72/n),(unsigned)(oled_stats.wake_max/72),
+		spi_div,oled_fps);
+}
+
 /*********************************************************************
  * Pummel the meter with updates. This tests that the DMA control task
  * does not get overwelmed or incapacitated with high levels of updates
@@ -233,6 +558,7 @@ pummel_test(struct Meter *m1) {
 	double v = 0.0;
 	double incr = 0.05;
 
+	memset(&oled_stats,0,sizeof oled_stats);
 	meter_set_value(m1,v);
 	meter_update();
 	while ( (xTaskGetTickCount() - t0) < 5000 ) {
@@ -248,6 +574,45 @@ pummel_test(struct Meter *m1) {
 		meter_set_value(m1,v);
 		meter_update();
 	}
+	show_stats(5000);
+}
+
+/*********************************************************************
+ * Sweep the meter once per frame (oled_frame_wait()) for 5 seconds,
+ * and report the CPU time drawing took
+ *********************************************************************/
+
+static void
+frame_test(struct Meter *m1) {
+	TickType_t t0 = xTaskGetTickCount();
+	uint32_t c0, cycles = 0, frames = 0;
+	double v = 0.0;
+	double incr = 0.02;
+
+	meter_set_value(m1,v);
+	meter_update();
+	oled_frame_wait();
+	memset(&oled_stats,0,sizeof oled_stats);
+	while ( (xTaskGetTickCount() - t0) < 5000 ) {
+		oled_frame_wait();
+		c0 = dwt_read_cycle_counter();
+		v += incr;
+		if ( v > 3.3 ) {
+			incr = -0.02;
+			v = 3.3;
+		} else if ( v < 0.0 ) {
+			v = 0.0;
+			incr = 0.02;
+		}
+		meter_set_value(m1,v);
+		meter_update();
+		cycles += dwt_read_cycle_counter() - c0;
+		++frames;
+	}
+	show_stats(5000);
+	std_printf("%u frames drawn, %u us each, %u.%u%% CPU\n",
+		(unsigned)frames,(unsigned)(cycles/72/frames),
+		(unsigned)(cycles/3600000),(unsigned)(cycles/360000%10));
 }
 
 /*********************************************************************
@@ -266,6 +631,7 @@ monitor_task(void *arg __attribute((unused))) {
 
 	oled_init();
 	dma_init();
+	oled_set_spi_div(OLED_SPI_DIV);
 	meter_init(&m1,3.5);
 	meter_set_value(&m1,v);
 	meter_update();
@@ -282,6 +648,11 @@ monitor_task(void *arg __attribute((unused))) {
 				"  + .. increase by 0.1 volts\n"
 				"  - .. decrease by 0.1 volts\n"
 				"  p .. Meter pummel test\n"
+				"  a .. Meter at the frame rate (5 s)\n"
+				"  s .. SPI clock (/8, /16, /64)\n"
+				"  t .. Target frame rate (60, 30, off)\n"
+				"  f .. Toggle full frame transfers\n"
+				"  r .. Redraw (full frame)\n"
 			);
 		}
 		menuf = false;
@@ -334,6 +705,37 @@ monitor_task(void *arg __attribute((unused))) {
 			meter_set_value(&m1,v);
 			meter_update();
 			break;
+		case 'F':
+			oled_full_frames = !oled_full_frames;
+			std_printf("Full frame transfers %s\n",
+				oled_full_frames ? "on" : "off");
+			break;
+		case 'S':
+			oled_set_spi_div(spi_div == 8 ? 16 : spi_div == 16 ? 64 : 8);
+			std_printf("SPI clock 72 MHz /%u\n",spi_div);
+			break;
+		case 'T':
+			oled_fps = oled_fps == 60 ? 30 : oled_fps == 30 ? 0 : 60;
+			std_printf("Target frame rate %u fps%s\n",oled_fps,
+				oled_fps ? "" : " (off)");
+			break;
+		case 'R':
+			memset(&oled_stats,0,sizeof oled_stats);
+			meter_redraw(&m1);
+			oled_dirty_all();
+			meter_update();
+			vTaskDelay(200);
+			std_printf("%u bytes, %u DMA transfers, %u task wakeups, DMA busy %u us\n",
+				(unsigned)oled_stats.bytes,
+				(unsigned)oled_stats.transfers,
+				(unsigned)oled_stats.wakeups,
+				(unsigned)(oled_stats.busy_cycles/72));
+			break;
+		case 'A':
+			std_printf("Meter at %u fps..\n",oled_fps);
+			frame_test(&m1);
+			std_printf("Test ended.\n");
+			break;
 		case 'P':
 			std_printf("Meter pummel test..\n");
 			pummel_test(&m1);
@@ -399,7 +801,7 @@ main(void) {
 	rcc_clock_setup_pll(&rcc_hse_configs[RCC_CLOCK_HSE8_72MHZ]);
 	spi_init_master(
 		SPI1,
-                SPI_CR1_BAUDRATE_FPCLK_DIV_64, // 1.125 MHz
+                SPI_CR1_BAUDRATE_FPCLK_DIV_64, // 1.125 MHz for oled_init()
                 SPI_CR1_CPOL_CLK_TO_0_WHEN_IDLE,
 		SPI_CR1_CPHA_CLK_TRANSITION_1,
 	        SPI_CR1_DFF_8BIT,
@@ -410,15 +812,18 @@ main(void) {
 
 	// DMA
 	rcc_periph_clock_enable(RCC_DMA1);
-	nvic_set_priority(NVIC_DMA1_CHANNEL3_IRQ,0);
+	// Calls vTaskNotifyGiveFromISR(): no more urgent than the kernel allows
+	nvic_set_priority(NVIC_DMA1_CHANNEL3_IRQ,configMAX_SYSCALL_INTERRUPT_PRIORITY);
 	nvic_enable_irq(NVIC_DMA1_CHANNEL3_IRQ);
+	dwt_enable_cycle_counter();			// DMA busy time
 
 	usb_start(1,1);
 	std_set_device(mcu_usb);			// Use USB for std I/O
 	gpio_clear(GPIOC,GPIO13);			// PC13 = off
 
 	xTaskCreate(monitor_task,"monitor",500,NULL,1,NULL);
-	xTaskCreate(spidma_task,"spi_dma",100,NULL,1,&h_spidma);
+	// Above the drawing task, to start a frame on time before drawing resumes
+	xTaskCreate(spidma_task,"spi_dma",100,NULL,2,&h_spidma);
 	vTaskStartScheduler();
 	for (;;);
 	return 0;
@@ -3,21 +3,46 @@
 // Date: Wed Dec  6 22:51:32 2017   (C) ve3wwg@gmail.com
 ///////////////////////////////////////////////////////////////////////
 
-#include <math.h>
 #include <string.h>
 
 #include "ugui.h"
 #include "meter.h"
 #include "miniprintf.h"
 #include "oled.h"
+#include "fontcols.h"
 
 #define ABS(x) (x < 0 ? -(x) : (x))
 #define SGN(x) (x < 0 ? -1 : 1)
 
+#define SIN_STEPS	128		// Table steps per quarter turn
+#define SIN_FRAC	6		// Interpolated bits between steps
+#define ANGLE_PI	(2 * SIN_STEPS << SIN_FRAC)	// Pi, in angle units
+
 static UG_GUI gui;
-static float Pi = 3.14159265;
 static uint8_t dummy;
-uint8_t pixmap[128*64/8];
+static uint8_t dial[OLED_PAGES * OLED_COLS];	// Static dial image (meter_dial())
+struct s_oled_span oled_dirty[OLED_PAGES];	// Since the last flush
+
+// sin(a * Pi / 256) * 16384, for a = 0 to 128
+static const int16_t sin_q14[SIN_STEPS + 1] = {
+	    0,   201,   402,   603,   804,  1005,  1205,  1406,
+	 1606,  1806,  2006,  2205,  2404,  2603,  2801,  2999,
+	 3196,  3393,  3590,  3786,  3981,  4176,  4370,  4563,
+	 4756,  4948,  5139,  5330,  5520,  5708,  5897,  6084,
+	 6270,  6455,  6639,  6823,  7005,  7186,  7366,  7545,
+	 7723,  7900,  8076,  8250,  8423,  8595,  8765,  8935,
+	 9102,  9269,  9434,  9598,  9760,  9921, 10080, 10238,
+	10394, 10549, 10702, 10853, 11003, 11151, 11297, 11442,
+	11585, 11727, 11866, 12004, 12140, 12274, 12406, 12537,
+	12665, 12792, 12916, 13039, 13160, 13279, 13395, 13510,
+	13623, 13733, 13842, 13949, 14053, 14155, 14256, 14354,
+	14449, 14543, 14635, 14724, 14811, 14896, 14978, 15059,
+	15137, 15213, 15286, 15357, 15426, 15493, 15557, 15619,
+	15679, 15736, 15791, 15843, 15893, 15941, 15986, 16029,
+	16069, 16107, 16143, 16176, 16207, 16235, 16261, 16284,
+	16305, 16324, 16340, 16353, 16364, 16373, 16379, 16383,
+	16384
+};
 
 static uint8_t *
 to_pixel(short x,short y,unsigned *bitno) {
@@ -40,9 +65,11 @@ draw_point(short x,short y,short pen) {
 	if ( x < 0 || x >= 128 || y < 0 || y >= 64 )
 		return;
 
+	oled_drawing = true;		// Before pixmap is read
 	unsigned bitno;
 	uint8_t *byte = to_pixel(x,y,&bitno);
 	uint8_t mask = 1 << bitno;
+	uint8_t was = *byte;
 	
 	switch ( pen ) {
 	case 0:
@@ -54,8 +81,51 @@ draw_point(short x,short y,short pen) {
 	default:
 		*byte ^= mask;
 	}
+
+	if ( *byte != was ) {
+		// Widen the page's changed columns
+		struct s_oled_span *sp = &oled_dirty[(63 - y) / 8];
+
+		if ( sp->lo >= sp->hi ) {
+			sp->lo = x;
+			sp->hi = x + 1;
+		} else if ( x < sp->lo ) {
+			sp->lo = x;
+		} else if ( x >= sp->hi ) {
+			sp->hi = x + 1;
+		}
+	}
+}
+
+/*
+ * Have the next flush send every page in full:
+ */
+void
+oled_dirty_all(void) {
+
+	for ( unsigned px=0; px<OLED_PAGES; ++px ) {
+		oled_dirty[px].lo = 0;
+		oled_dirty[px].hi = OLED_COLS;
+	}
+}
+
+#ifdef USE_COLOR_MONO
+
+/*
+ * 1 bit colours are the pens: C_BLACK 0, C_WHITE 1, C_INVERT 2
+ */
+static inline int
+ug_to_pen(UG_COLOR c) {
+	return c;
+}
+
+static inline UG_COLOR
+pen_to_ug(int pen) {
+	return pen;
 }
 
+#else
+
 static int
 ug_to_pen(UG_COLOR c) {
 
@@ -82,15 +152,390 @@ pen_to_ug(int pen) {
 	}	
 }
 
+#endif
+
 static void
 local_draw_point(UG_S16 x,UG_S16 y,UG_COLOR c) {
 	draw_point(x,y,ug_to_pen(c));
 }
 
+/*
+ * Accelerated 1bpp drivers (UG_DriverRegister): these write pixmap a
+ * byte (8 rows of a column) or a word at a time in the SSD1306 page
+ * layout, instead of a pset() call chain per pixel. XOR (C_RED) pens
+ * toggle each pixel as often as uGUI would, so they come out the same.
+ * Y is the page layout row: 63 - y.
+ */
+
+__attribute__((always_inline)) static inline uint8_t
+pen_byte(uint8_t b,uint8_t mask,int pen) {
+
+	switch ( pen ) {
+	case 0:
+		return b & ~mask;
+	case 1:
+		return b | mask;
+	default:
+		return b ^ mask;
+	}
+}
+
+__attribute__((always_inline)) static inline void
+mark(unsigned page,unsigned lo,unsigned hi) {
+	struct s_oled_span *sp = &oled_dirty[page];
+
+	if ( sp->lo >= sp->hi ) {
+		sp->lo = lo;
+		sp->hi = hi;
+	} else	{
+		if ( lo < sp->lo )
+			sp->lo = lo;
+		if ( hi > sp->hi )
+			sp->hi = hi;
+	}
+}
+
+/*
+ * One pixel, for the drivers (no pset() or pen lookup per call):
+ */
+__attribute__((always_inline)) static inline void
+plot(int x,int y,int pen) {
+	unsigned Y = 63 - y;
+	uint8_t *bp, b;
+
+	if ( (unsigned)x >= OLED_COLS || Y >= 64 )
+		return;
+	bp = &pixmap[(Y >> 3) * OLED_COLS + x];
+	b = pen_byte(*bp,1 << (Y & 7),pen);
+	if ( b != *bp ) {
+		*bp = b;
+		mark(Y >> 3,x,x + 1);
+	}
+}
+
+/*
+ * Fill columns x1..x2 of rows Y1..Y2 (clipped):
+ */
+static void
+fill_rows(int x1,int x2,int Y1,int Y2,int pen) {
+	unsigned lo, hi, p1, p2;
+	uint8_t *row, mask, b;
+
+	if ( x1 < 0 )
+		x1 = 0;
+	if ( x2 > OLED_COLS - 1 )
+		x2 = OLED_COLS - 1;
+	if ( Y1 < 0 )
+		Y1 = 0;
+	if ( Y2 > 63 )
+		Y2 = 63;
+	if ( x1 > x2 || Y1 > Y2 )
+		return;
+
+	oled_drawing = true;
+	p1 = Y1 >> 3;
+	p2 = Y2 >> 3;
+	for ( unsigned px=p1; px<=p2; ++px ) {
+		mask = 0xFF;
+		if ( px == p1 )
+			mask &= 0xFF << (Y1 & 7);
+		if ( px == p2 )
+			mask &= 0xFF >> (7 - (Y2 & 7));
+		row = &pixmap[px * OLED_COLS];
+		lo = OLED_COLS;
+		hi = 0;
+
+		int x = x1;
+		if ( mask == 0xFF && pen != 2 ) {
+			uint32_t w = pen ? 0xFFFFFFFF : 0;
+
+			// Whole bytes: a word at a time
+			for ( ; x + 3 <= x2; x += 4 ) {
+				uint32_t was;
+
+				memcpy(&was,&row[x],4);
+				if ( was != w ) {
+					memcpy(&row[x],&w,4);
+					if ( lo == OLED_COLS )
+						lo = x;
+					hi = x + 4;
+				}
+			}
+		}
+		for ( ; x <= x2; ++x ) {
+			b = pen_byte(row[x],mask,pen);
+			if ( b != row[x] ) {
+				row[x] = b;
+				if ( lo == OLED_COLS )
+					lo = x;
+				hi = x + 1;
+			}
+		}
+		if ( lo < hi )
+			mark(px,lo,hi);
+	}
+}
+
+static UG_RESULT
+drv_fill_frame(UG_S16 x1,UG_S16 y1,UG_S16 x2,UG_S16 y2,UG_COLOR c) {
+
+	// uGUI passes x1 <= x2, y1 <= y2
+	fill_rows(x1,x2,63-y2,63-y1,ug_to_pen(c));
+	return UG_RESULT_OK;
+}
+
+/*
+ * Lines: column and row fills when straight, else uGUI's own
+ * stepping (the same pixels), plotted in place:
+ */
+static UG_RESULT
+drv_draw_line(UG_S16 x1,UG_S16 y1,UG_S16 x2,UG_S16 y2,UG_COLOR c) {
+	int pen = ug_to_pen(c);
+	int dx, dy, sgndx, sgndy, dxabs, dyabs, x, y, drawx, drawy;
+
+	if ( x1 == x2 ) {
+		fill_rows(x1,x1,63-(y1 > y2 ? y1 : y2),63-(y1 > y2 ? y2 : y1),pen);
+		return UG_RESULT_OK;
+	}
+	if ( y1 == y2 ) {
+		fill_rows(x1 < x2 ? x1 : x2,x1 < x2 ? x2 : x1,63-y1,63-y1,pen);
+		return UG_RESULT_OK;
+	}
+
+	dx = x2 - x1;
+	dy = y2 - y1;
+	dxabs = dx > 0 ? dx : -dx;
+	dyabs = dy > 0 ? dy : -dy;
+	sgndx = dx > 0 ? 1 : -1;
+	sgndy = dy > 0 ? 1 : -1;
+	x = dyabs >> 1;
+	y = dxabs >> 1;
+	drawx = x1;
+	drawy = y1;
+
+	oled_drawing = true;
+	plot(drawx,drawy,pen);
+	if ( dxabs >= dyabs ) {
+		for ( int n=0; n<dxabs; n++ ) {
+			y += dyabs;
+			if ( y >= dxabs ) {
+				y -= dxabs;
+				drawy += sgndy;
+			}
+			drawx += sgndx;
+			plot(drawx,drawy,pen);
+		}
+	} else	{
+		for ( int n=0; n<dyabs; n++ ) {
+			x += dxabs;
+			if ( x >= dyabs ) {
+				x -= dyabs;
+				drawx += sgndx;
+			}
+			drawy += sgndy;
+			plot(drawx,drawy,pen);
+		}
+	}
+	return UG_RESULT_OK;
+}
+
+/*
+ * Circles: uGUI's stepping and plotting order (XOR safe):
+ */
+static UG_RESULT
+drv_draw_circle(UG_S16 x0,UG_S16 y0,UG_S16 r,UG_COLOR c) {
+	int pen = ug_to_pen(c);
+	int x = r, y = 0, xd = 1 - (r << 1), yd = 0, e = 0;
+
+	oled_drawing = true;
+	while ( x >= y ) {
+		plot(x0 - x,y0 + y,pen);
+		plot(x0 - x,y0 - y,pen);
+		plot(x0 + x,y0 + y,pen);
+		plot(x0 + x,y0 - y,pen);
+		plot(x0 - y,y0 + x,pen);
+		plot(x0 - y,y0 - x,pen);
+		plot(x0 + y,y0 + x,pen);
+		plot(x0 + y,y0 - x,pen);
+
+		y++;
+		e += yd;
+		yd += 2;
+		if ( (e << 1) + xd > 0 ) {
+			x--;
+			e += xd;
+			xd += 2;
+		}
+	}
+	return UG_RESULT_OK;
+}
+
+/*
+ * Filled circles (set or clear pens): each column filled once, to
+ * the greatest height of uGUI's lines there, then the outline.
+ */
+static UG_RESULT
+drv_fill_circle(UG_S16 x0,UG_S16 y0,UG_S16 r,UG_COLOR c) {
+	int pen = ug_to_pen(c);
+	int x = 0, y = r, xd = 3 - (r << 1);
+	int8_t h[OLED_COLS];		// Half height by column offset
+	unsigned lo[OLED_PAGES], hi[OLED_PAGES];
+	uint8_t *bp, mask, b;
+
+	if ( pen == 2 || r >= OLED_COLS )
+		return UG_RESULT_FAIL;	// XOR: overlaps must repeat
+
+	memset(h,-1,r + 1);
+	while ( x <= y ) {
+		if ( y > 0 && y > h[x] )
+			h[x] = y;
+		if ( x > 0 && x > h[y] )
+			h[y] = x;
+		if ( xd < 0 ) {
+			xd += (x << 2) + 6;
+		} else	{
+			xd += ((x - y) << 2) + 10;
+			y--;
+		}
+		x++;
+	}
+
+	oled_drawing = true;
+	for ( unsigned px=0; px<OLED_PAGES; ++px ) {
+		lo[px] = OLED_COLS;
+		hi[px] = 0;
+	}
+	for ( int dx=-r; dx<=r; ++dx ) {
+		int hh = h[dx < 0 ? -dx : dx], Y1, Y2;
+
+		x = x0 + dx;
+		if ( hh < 0 || x < 0 || x >= OLED_COLS )
+			continue;
+		Y1 = 63 - (y0 + hh);
+		Y2 = 63 - (y0 - hh);
+		if ( Y1 < 0 )
+			Y1 = 0;
+		if ( Y2 > 63 )
+			Y2 = 63;
+		for ( int px=Y1 >> 3; Y1 <= Y2 && px<=Y2 >> 3; ++px ) {
+			mask = 0xFF;
+			if ( px == Y1 >> 3 )
+				mask &= 0xFF << (Y1 & 7);
+			if ( px == Y2 >> 3 )
+				mask &= 0xFF >> (7 - (Y2 & 7));
+			bp = &pixmap[px * OLED_COLS + x];
+			b = pen_byte(*bp,mask,pen);
+			if ( b != *bp ) {
+				*bp = b;
+				if ( lo[px] == OLED_COLS )
+					lo[px] = x;	// Columns ascend
+				hi[px] = x + 1;
+			}
+		}
+	}
+	for ( unsigned px=0; px<OLED_PAGES; ++px )
+		if ( lo[px] < hi[px] )
+			mark(px,lo[px],hi[px]);
+	return drv_draw_circle(x0,y0,r,c);
+}
+
+/*
+ * Pre-rendered columns of chr in font (fontcols.h), else NULL:
+ */
+static const uint8_t *
+glyph_cols(UG_U8 chr,const UG_FONT *font) {
+	const struct s_fontcols *fp;
+
+	for ( fp = fontcols; fp < fontcols + sizeof fontcols / sizeof fontcols[0]; ++fp )
+		if ( fp->font->p == font->p )
+			return chr >= fp->first && chr <= fp->last
+				? fp->cols + (chr - fp->first) * fp->width * fp->bytes
+				: 0;
+	return 0;
+}
+
+/*
+ * Glyphs (1bpp, up to 32x32), as column words: read from fontcols.h
+ * when the font and character are there, else gathered from the set
+ * bits of each row. Each column is shifted to the cell's bottom row
+ * and written into the 2..5 page bytes it covers, foreground and
+ * background at once. On a page boundary (shift 0) that is a plain
+ * copy of the column bytes.
+ */
+static UG_RESULT
+drv_put_char(UG_U8 chr,UG_S16 x,UG_S16 y,UG_COLOR fc,UG_COLOR bc,const UG_FONT *font) {
+	unsigned h = font->char_height, nb = (h + 7) >> 3, bn, w;
+	int fpen = ug_to_pen(fc), bpen = ug_to_pen(bc);
+	int Yb = 63 - (y + (int)h - 1);		// Bottom row of the cell
+	int p0 = Yb >> 3, sh = Yb & 7;
+	const uint8_t *gp, *cp;
+	uint32_t cols[32];
+	uint64_t fbits, cbits;
+	uint8_t *bp, fm, cm, b;
+	uint8_t fset = fpen == 1 ? 0xFF : 0, bset = bpen == 1 ? 0xFF : 0;
+
+	if ( font->font_type != FONT_TYPE_1BPP || h > 32 || font->char_width > 32 )
+		return UG_RESULT_FAIL;
+
+	oled_drawing = true;
+	w = font->widths ? font->widths[chr - font->start_char] : font->char_width;
+	cbits = ((1ull << h) - 1) << sh;
+
+	if ( !(cp = glyph_cols(chr,font)) ) {
+		bn = (font->char_width + 7) >> 3;
+		gp = font->p + (chr - font->start_char) * h * bn;
+		memset(cols,0,w * sizeof cols[0]);
+		for ( unsigned j=0; j<h; ++j ) {
+			uint32_t rbit = 1u << (h - 1 - j);
+
+			for ( unsigned k=0; k<bn; ++k ) {
+				b = *gp++;
+				for ( unsigned i=k*8; b && i<w; ++i, b >>= 1 )
+					if ( b & 1 )
+						cols[i] |= rbit;
+			}
+		}
+	}
+
+	for ( unsigned i=0; i<w; ++i ) {
+		int cx = x + i;
+
+		if ( cx < 0 || cx >= OLED_COLS )
+			continue;
+		if ( cp ) {
+			fbits = 0;
+			for ( unsigned k=0; k<nb; ++k )
+				fbits |= (uint64_t)cp[i * nb + k] << (k * 8);
+		} else	fbits = cols[i];
+		fbits <<= sh;
+
+		for ( int px=p0, k=0; k*8 < (int)h + sh; ++px, ++k ) {
+			if ( px < 0 || px >= OLED_PAGES )
+				continue;
+			cm = cbits >> (k * 8);
+			fm = fbits >> (k * 8);
+			bp = &pixmap[px * OLED_COLS + cx];
+			if ( fpen < 2 && bpen < 2 )	// Set or clear: no XOR
+				b = (*bp & ~cm) | (fm & fset) | (cm & ~fm & bset);
+			else	{
+				b = pen_byte(*bp,fm,fpen);
+				b = pen_byte(b,cm & ~fm,bpen);
+			}
+			if ( b != *bp ) {
+				*bp = b;
+				mark(px,cx,cx + 1);
+			}
+		}
+	}
+	return UG_RESULT_OK;
+}
+
 void
 meter_init(struct Meter *m,float range) {
 
+	oled_drawing = true;
 	memset(pixmap,0,128*64/8);
+	oled_dirty_all();		// Display RAM is unknown
 
 	m->value = 0.0;
 	m->rd = 6;
@@ -101,27 +546,123 @@ meter_init(struct Meter *m,float range) {
 	m->range = range;
 
 	UG_Init(&gui,local_draw_point,128,64);
+	UG_DriverRegister(DRIVER_FILL_FRAME,(void *)drv_fill_frame);
+	UG_DriverRegister(DRIVER_DRAW_LINE,(void *)drv_draw_line);
+	UG_DriverRegister(DRIVER_PUT_CHAR,(void *)drv_put_char);
+	UG_DriverRegister(DRIVER_DRAW_CIRCLE,(void *)drv_draw_circle);
+	UG_DriverRegister(DRIVER_FILL_CIRCLE,(void *)drv_fill_circle);
 	m->cx = 128 / 2;
 	m->cy = 64 - 1;
 	m->ocr = m->cr + m->rd;
 	m->icr = m->cr - m->rd;
 	UG_SetBackcolor(pen_to_ug(1));
 	UG_SetForecolor(pen_to_ug(0));
+	meter_dial(m);
 	meter_redraw(m);
 }
 
+/*
+ * sin of angle a (0 to ANGLE_PI), in Q20, interpolated between the
+ * table steps:
+ */
+static int
+sin_q20(unsigned a) {
+	unsigned b = a <= ANGLE_PI / 2 ? a : ANGLE_PI - a;
+	unsigned i = b >> SIN_FRAC, f = b & ((1 << SIN_FRAC) - 1);
+	int s = sin_q14[i] << SIN_FRAC;
+
+	if ( f )
+		s += (sin_q14[i + 1] - sin_q14[i]) * (int)f;
+	return s;
+}
+
+/*
+ * r * s (Q20) at angle a, truncated toward zero as the float code's
+ * (int) casts were. Its Pi was rounded up, so past 0 its angles fell
+ * just beyond the true ones, and whole results (at Pi/2 and Pi) came
+ * out one short: a > 0 is pulled toward zero by one Q20 step to match.
+ */
+static int
+r_scale(int r,int s,unsigned a) {
+	int p = r * s;
+
+	if ( a > 0 && p != 0 )
+		p += p > 0 ? -1 : 1;
+	return p >= 0 ? p >> 20 : -(-p >> 20);
+}
+
+static int
+r_sin(int r,unsigned a) {
+	return r_scale(r,sin_q20(a),a);
+}
+
+static int
+r_cos(int r,unsigned a) {
+	int s = a <= ANGLE_PI / 2 ? sin_q20(ANGLE_PI / 2 - a) : -sin_q20(a - ANGLE_PI / 2);
+
+	return r_scale(r,s,a);
+}
+
+/*
+ * Needle angle of v, in ANGLE_PI units:
+ */
+static short
+to_angle(struct Meter *m,float v) {
+	return v / m->range * ANGLE_PI + 0.5;
+}
+
+/*
+ * Copy the dial back over columns x1..x2, rows y1..y2 (whole page
+ * bytes, so nothing drawn over the dial may share them):
+ */
+static void
+restore(int x1,int x2,int y1,int y2) {
+	int Y1 = 63 - y2, Y2 = 63 - y1;
+	unsigned lo, hi;
+	uint8_t *pp, *dp;
+
+	if ( x1 < 0 )
+		x1 = 0;
+	if ( x2 > OLED_COLS - 1 )
+		x2 = OLED_COLS - 1;
+	if ( Y1 < 0 )
+		Y1 = 0;
+	if ( Y2 > 63 )
+		Y2 = 63;
+	if ( x1 > x2 || Y1 > Y2 )
+		return;
+
+	oled_drawing = true;
+	for ( unsigned px=Y1 >> 3; px<=(unsigned)Y2 >> 3; ++px ) {
+		lo = OLED_COLS;
+		hi = 0;
+		pp = &pixmap[px * OLED_COLS];
+		dp = &dial[px * OLED_COLS];
+		for ( int x=x1; x<=x2; ++x ) {
+			if ( pp[x] != dp[x] ) {
+				pp[x] = dp[x];
+				if ( lo == OLED_COLS )
+					lo = x;
+				hi = x + 1;
+			}
+		}
+		if ( lo < hi )
+			mark(px,lo,hi);
+	}
+}
+
 static void
 ticks(struct Meter *m,int t) {
-	float theta = (t * Pi)/8.0;
+	unsigned a = t * ANGLE_PI / 8;
 	int x1, y1, x2, y2, x, y;
 	float incr = m->range / 8;
 	int fm, fr;
 	char buf[16];
 
-	x1 = m->icr * cos(theta);
-	y1 = m->icr * sin(theta);
-	x2 = m->ocr * cos(theta);
-	y2 = m->ocr * sin(theta);
+	x1 = r_cos(m->icr,a);
+	y1 = r_sin(m->icr,a);
+	x2 = r_cos(m->ocr,a);
+	y2 = r_sin(m->ocr,a);
 
 	UG_DrawLine(m->cx-x1,m->cy-y1,x=m->cx-x2,y=m->cy-y2,pen_to_ug(2));
 	if ( t != 4 ) {
@@ -141,8 +682,12 @@ ticks(struct Meter *m,int t) {
 	}
 }
 
+/*
+ * Render the static dial (scale, ticks and labels), and keep its
+ * image for meter_redraw() and meter_set_value() to copy from:
+ */
 void
-meter_redraw(struct Meter *m) {
+meter_dial(struct Meter *m) {
 
 	UG_FillScreen(pen_to_ug(1));
 	UG_FillCircle(m->cx,m->cy,m->cr,pen_to_ug(0));
@@ -153,15 +698,40 @@ meter_redraw(struct Meter *m) {
 	for ( int x=0; x<=4; ++x )
 		ticks(m,x);
 	UG_FillFrame(0,0,127,15,pen_to_ug(1));
+	memcpy(dial,pixmap,sizeof dial);
+	m->angle = -1;			// No needle or text drawn
+	m->text[0] = 0;
+}
+
+void
+meter_redraw(struct Meter *m) {
+
+	restore(0,127,0,63);
+	m->angle = -1;
+	m->text[0] = 0;
 	meter_set_value(m,m->value);
 }
 
+/*
+ * Columns and rows the needle at angle a covers:
+ */
+static void
+pointer_box(struct Meter *m,int a,int *x1,int *x2,int *y1,int *y2) {
+	int pr = m->cr-m->rd-2;		// Pointer radius
+	int xt = m->cx - r_cos(pr,a);
+	int yt = m->cy - r_sin(pr,a);
+
+	*x1 = xt < m->cx-2 ? xt : m->cx-2;
+	*x2 = xt > m->cx+2 ? xt : m->cx+2;
+	*y1 = yt;
+	*y2 = m->cy+1;
+}
+
 static void
-draw_pointer(struct Meter *m,float v,int pen) {
+draw_pointer(struct Meter *m,int a,int pen) {
 	int pr = m->cr-m->rd-2;		// Pointer radius
-	float theta = v / m->range * Pi;
-	int x2 = pr * cos(theta);
-	int y2 = pr * sin(theta);
+	int x2 = r_cos(pr,a);
+	int y2 = r_sin(pr,a);
 	int dy = y2 < 5 ? 1 : 0;
 
 	for ( int x=0; x < 3; ++x ) {
@@ -172,26 +742,40 @@ draw_pointer(struct Meter *m,float v,int pen) {
 	}
 }
 
+/*
+ * Move the needle and change the text: the old needle and text are
+ * replaced by the dial under them, and each is only drawn if changed.
+ */
 void
 meter_set_value(struct Meter *m,float v) {
 	char buf[16];
-	int fm, fr;
+	int fm, fr, a, x1, x2, y1, y2;
 
-	draw_pointer(m,m->value,0);
-	UG_FillFrame(0,0,127,15,pen_to_ug(1));
 	m->value = v > m->range ? m->range : v;
 	if ( m->value < 0.0 )
 		m->value = 0.0;
 
-	draw_pointer(m,m->value,1);
-	UG_FontSelect(&FONT_8X12);
-	UG_FontSetHSpace(0);
+	a = to_angle(m,m->value);
+	if ( a != m->angle ) {
+		if ( m->angle >= 0 ) {
+			pointer_box(m,m->angle,&x1,&x2,&y1,&y2);
+			restore(x1,x2,y1,y2);
+		}
+		draw_pointer(m,a,1);
+		m->angle = a;
+	}
 
 	fm = m->value * 100.0;
 	fr = fm % 100;
 	fm /= 100;
 	int slen = mini_snprintf(buf,sizeof buf,"%d.%02d Volts",fm,fr);
-	UG_PutString(m->cx-8*slen/2,2,buf);
+	if ( strcmp(buf,m->text) != 0 ) {
+		restore(0,127,0,15);
+		UG_FontSelect(&FONT_8X12);
+		UG_FontSetHSpace(0);
+		UG_PutString(m->cx-8*slen/2,2,buf);
+		strcpy(m->text,buf);
+	}
 }
 
 void
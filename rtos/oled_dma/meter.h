@@ -16,9 +16,12 @@ struct Meter {
 	short		dx;		// Tick delta x
 	short		dy;		// Tick delta y
 	short		tw;		// Label text width
+	short		angle;		// Needle drawn at (Pi/16384 units, -1 none)
+	char		text[16];	// Value text drawn
 };
 
 void meter_init(struct Meter *m,float range);
+void meter_dial(struct Meter *m);
 void meter_redraw(struct Meter *m);
 void meter_set_value(struct Meter *m,float v);
 void meter_update(void);
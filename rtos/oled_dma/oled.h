@@ -6,9 +6,50 @@
 #ifndef OLED_H
 #define OLED_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef OLED_DOUBLE_BUFFER
+#define OLED_DOUBLE_BUFFER 1		// Front and back buffers (1K more RAM)
+#endif
+
+#ifndef OLED_FPS
+#define OLED_FPS	60		// Target frame rate (0: present at once)
+#endif
+
+#define OLED_PAGES	8		// 8 rows of pixels per page
+#define OLED_COLS	128
+
+struct s_oled_span {
+	uint8_t		lo, hi;		// Changed columns lo..hi-1 (none if lo >= hi)
+};
+
+struct s_oled_stats {
+	uint32_t	updates;	// spi_dma_xmit_pixmap() calls (presents asked)
+	uint32_t	presents;	// Frames swapped in and sent
+	uint32_t	coalesced;	// Merged into a present still waiting
+	uint32_t	drops;		// Frame times passed with a present waiting
+	uint32_t	bytes;		// Command and data bytes sent
+	uint32_t	transfers;	// DMA transfers (ISR calls)
+	uint32_t	wakeups;	// spidma_task wakeups
+	uint64_t	busy_cycles;	// DMA busy, start to ISR (CPU cycles)
+	uint64_t	wake_cycles;	// ISR to spidma_task running (CPU cycles)
+	uint32_t	wake_max;	// ..worst of those
+};
+
+extern uint8_t *volatile pixmap;		// Drawn into (back buffer)
+extern volatile bool oled_drawing;	// Set by drawing, cleared by present
+extern struct s_oled_span oled_dirty[OLED_PAGES];
+extern struct s_oled_stats oled_stats;
+extern bool oled_full_frames;
+extern unsigned oled_fps;		// Target frame rate (0: present at once)
+
 void oled_command(uint8_t byte);
 void oled_command2(uint8_t byte,uint8_t byte2);
 void spi_dma_xmit_pixmap(void);
+void oled_dirty_all(void);
+void oled_frame_wait(void);
+bool oled_set_spi_div(unsigned div);
 
 #endif // OLED_H
 
@@ -0,0 +1,127 @@
+/* hostfb.c : Host framebuffer for ../meter.c (the OLED, simulated)
+ * Warren W. Gay VE3WWG
+ *
+ * Stands in for ../main.c: meter.c draws into pixmap, and
+ * spi_dma_xmit_pixmap() copies the dirty spans (oled_dirty) to the
+ * display's RAM here, as the DMA refresh sends them. After each
+ * present the display must match pixmap, or an update was lost.
+ *
+ * Snapshots are of the display, in uGUI coordinates (y down), as
+ * plain (P1) PBM files: 1 is black.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "oled.h"
+#include "hostfb.h"
+
+static uint8_t frame[OLED_PAGES * OLED_COLS];
+static uint8_t shown[OLED_PAGES * OLED_COLS];	// As the display has it
+
+uint8_t *volatile pixmap = frame;
+volatile bool oled_drawing;
+struct s_oled_stats oled_stats;
+bool oled_full_frames;
+struct s_hostfb_stats hostfb_stats;
+
+void
+spi_dma_xmit_pixmap(void) {
+
+	for ( unsigned px=0; px<OLED_PAGES; ++px ) {
+		struct s_oled_span *sp = &oled_dirty[px];
+
+		if ( sp->lo < sp->hi ) {
+			memcpy(shown + px * OLED_COLS + sp->lo,frame + px * OLED_COLS + sp->lo,sp->hi - sp->lo);
+			hostfb_stats.bytes += sp->hi - sp->lo;
+		}
+		sp->lo = sp->hi = 0;
+	}
+	oled_drawing = false;
+	++hostfb_stats.presents;
+	if ( memcmp(shown,frame,sizeof frame) != 0 )
+		++hostfb_stats.lost;
+}
+
+/*
+ * Fill pixmap and the display (unlike), with all marked dirty:
+ */
+void
+hostfb_reset(uint8_t fill) {
+
+	memset(frame,fill,sizeof frame);
+	memset(shown,~fill,sizeof shown);
+	oled_dirty_all();
+}
+
+/*
+ * A displayed pixel (uGUI x, y): true if lit
+ */
+bool
+hostfb_pixel(int x,int y) {
+	unsigned Y = 63 - y;
+
+	return (shown[(Y >> 3) * OLED_COLS + x] >> (Y & 7)) & 1;
+}
+
+int
+hostfb_write_pbm(const char *path) {
+	FILE *f = fopen(path,"w");
+
+	if ( !f )
+		return -1;
+	fprintf(f,"P1\n%u %u\n",OLED_COLS,OLED_PAGES * 8);
+	for ( int y=0; y<OLED_PAGES * 8; ++y ) {
+		for ( int x=0; x<OLED_COLS; ++x ) {
+			fputc(hostfb_pixel(x,y) ? '0' : '1',f);
+			if ( x % 64 == 63 )
+				fputc('\n',f);		// Lines of 70 or less
+		}
+	}
+	return fclose(f);
+}
+
+/*
+ * Compare the display with a P1 PBM file: returns 0 and the count
+ * of differing pixels, or -1 if the file is unreadable or not
+ * 128x64.
+ */
+int
+hostfb_compare_pbm(const char *path,unsigned *ndiff) {
+	FILE *f = fopen(path,"r");
+	unsigned w, h, n = 0;
+	int ch;
+
+	*ndiff = 0;
+	if ( !f )
+		return -1;
+	if ( fscanf(f,"P1 %u %u",&w,&h) != 2 || w != OLED_COLS || h != OLED_PAGES * 8 ) {
+		fclose(f);
+		return -1;
+	}
+	while ( n < w * h && (ch = fgetc(f)) != EOF ) {
+		if ( ch == '#' ) {
+			while ( (ch = fgetc(f)) != EOF && ch != '\n' )
+				;
+		} else if ( ch == '0' || ch == '1' ) {
+			if ( hostfb_pixel(n % w,n / w) != (ch == '0') )
+				++*ndiff;
+			++n;
+		}
+	}
+	fclose(f);
+	return n == w * h ? 0 : -1;
+}
+
+/*
+ * CPU time (the host is shared)
+ */
+double
+hostfb_seconds(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// End hostfb.c
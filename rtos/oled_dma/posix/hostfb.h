@@ -0,0 +1,26 @@
+/* hostfb.h : Host framebuffer for ../meter.c (the OLED, simulated)
+ * Warren W. Gay VE3WWG
+ */
+#ifndef HOSTFB_H
+#define HOSTFB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct s_hostfb_stats {
+	uint32_t	presents;	// spi_dma_xmit_pixmap() calls
+	uint32_t	bytes;		// Data bytes sent (dirty spans)
+	uint32_t	lost;		// Presents that left the display wrong
+};
+
+extern struct s_hostfb_stats hostfb_stats;
+
+void hostfb_reset(uint8_t fill);
+bool hostfb_pixel(int x,int y);
+int hostfb_write_pbm(const char *path);
+int hostfb_compare_pbm(const char *path,unsigned *ndiff);
+double hostfb_seconds(void);
+
+#endif // HOSTFB_H
+
+// End hostfb.h
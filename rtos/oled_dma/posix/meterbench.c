@@ -0,0 +1,218 @@
+/* meterbench.c : Time the meter drawing with and without the 1bpp drivers
+ * Warren W. Gay VE3WWG
+ *
+ * ../meter.c and ../ugui.c are built for the host, drawing into the
+ * framebuffer of hostfb.c.
+ * meter_dial(), meter_redraw() and meter_set_value() are timed with
+ * the drivers meter_init() registers (fills, lines, circles and
+ * glyphs), then with them disabled, so uGUI plots every pixel through
+ * pset(). Redraws copy the dial meter_dial() keeps. A status screen
+ * of FONT_8X12 and FONT_4X6 text is timed the same way: half its
+ * rows sit on page boundaries (a copy of fontcols.h's columns), half
+ * are shifted across two or three pages. The degree sign is not in
+ * fontcols.h, so it is gathered from the font's rows.
+ *
+ * Both must leave the same pixels (text too), a needle swept about
+ * must leave the same pixels as one set once, and every changed byte
+ * must lie in a dirty span. Exits non-zero if not, or if the drivers are not
+ * at least MIN_SPEEDUP times faster at drawing the dial.
+ *
+ * Usage: meterbench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ugui.h"
+#include "meter.h"
+#include "oled.h"
+#include "hostfb.h"
+
+#define MIN_SPEEDUP	10.0
+#define BATCHES		20
+#define DIALS		100
+#define REDRAWS		100
+#define SWEEPS		100
+
+static unsigned failures;
+
+static void
+drivers(bool on) {
+	static const UG_U8 types[] = { DRIVER_FILL_FRAME, DRIVER_DRAW_LINE, DRIVER_PUT_CHAR, DRIVER_DRAW_CIRCLE,
+		DRIVER_FILL_CIRCLE };
+
+	for ( unsigned tx=0; tx<sizeof types; ++tx ) {
+		if ( on )
+			UG_DriverEnable(types[tx]);
+		else	UG_DriverDisable(types[tx]);
+	}
+}
+
+struct s_times {
+	double		dial;		// Least mean us per call
+	double		redraw;
+	double		set_value;
+	double		status;
+};
+
+static void
+best(double *t,double t0,unsigned n) {
+	double us = (hostfb_seconds() - t0) * 1e6 / n;
+
+	if ( us < *t )
+		*t = us;
+}
+
+/*
+ * Status screen text, page aligned and not, in both pen pairs:
+ */
+static void
+status(void) {
+
+	UG_SetForecolor(C_WHITE);
+	UG_SetBackcolor(C_BLACK);
+	UG_FontSelect(&FONT_8X12);
+	UG_PutString(0,4,"Status: RUN 3.30V");	// Rows 4..15: aligned
+	UG_PutString(0,17,"Temp 21.5\xB0" "C OK");
+	UG_SetForecolor(C_BLACK);
+	UG_SetBackcolor(C_WHITE);
+	UG_PutString(0,36,"Load 42% 1.2A");	// Rows 36..47: aligned
+	UG_PutString(3,47,"Up 12:34:56");
+	UG_SetForecolor(C_WHITE);
+	UG_SetBackcolor(C_BLACK);
+	UG_FontSelect(&FONT_4X6);
+	UG_PutString(0,58,"ADC 4095 2048 1024 0512 0256");	// 58..63: aligned
+	UG_PutString(1,29,"[~{|}`]");
+	UG_SetForecolor(C_BLACK);		// The meter's pens
+	UG_SetBackcolor(C_WHITE);
+}
+
+/*********************************************************************
+ * One batch of each call, keeping the least mean us per call
+ *********************************************************************/
+
+static void
+batch(struct Meter *m,bool accel,struct s_times *t) {
+	double t0;
+
+	drivers(accel);
+	t0 = hostfb_seconds();
+	for ( unsigned rx=0; rx<DIALS; ++rx )
+		meter_dial(m);
+	best(&t->dial,t0,DIALS);
+
+	t0 = hostfb_seconds();
+	for ( unsigned rx=0; rx<REDRAWS; ++rx ) {
+		meter_redraw(m);
+		meter_update();
+	}
+	best(&t->redraw,t0,REDRAWS);
+
+	t0 = hostfb_seconds();
+	for ( unsigned sx=0; sx<SWEEPS; ++sx ) {
+		meter_set_value(m,(sx % 67) * 0.05);
+		meter_update();
+	}
+	best(&t->set_value,t0,SWEEPS);
+
+	t0 = hostfb_seconds();
+	for ( unsigned rx=0; rx<REDRAWS; ++rx ) {
+		status();
+		meter_update();
+	}
+	best(&t->status,t0,REDRAWS);
+}
+
+/*
+ * The same picture, drawn from a scrambled frame, with the needle
+ * swept there or set once:
+ */
+static void
+picture(struct Meter *m,bool accel,bool sweep,uint8_t *out) {
+
+	drivers(accel);
+	hostfb_reset(0x55);
+	spi_dma_xmit_pixmap();
+	m->value = 1.0;
+	meter_dial(m);
+	meter_redraw(m);
+	meter_update();
+	for ( unsigned sx=0; sweep && sx<67; ++sx ) {
+		meter_set_value(m,sx * 0.05);
+		meter_update();
+	}
+	meter_set_value(m,2.37);
+	meter_update();
+	memcpy(out,pixmap,OLED_PAGES * OLED_COLS);
+}
+
+static void
+text(bool accel,uint8_t *out) {
+
+	drivers(accel);
+	hostfb_reset(0x55);
+	spi_dma_xmit_pixmap();
+	oled_drawing = true;
+	status();
+	meter_update();
+	memcpy(out,pixmap,OLED_PAGES * OLED_COLS);
+}
+
+static void
+same(const uint8_t *a,const uint8_t *b,const char *what) {
+	unsigned n = 0;
+
+	for ( unsigned bx=0; bx<OLED_PAGES * OLED_COLS; ++bx )
+		n += a[bx] != b[bx];
+	if ( n ) {
+		printf("FAIL: %u bytes differ %s\n",n,what);
+		++failures;
+	}
+}
+
+int
+main(void) {
+	static uint8_t fast[OLED_PAGES * OLED_COLS], slow[OLED_PAGES * OLED_COLS], once[OLED_PAGES * OLED_COLS];
+	static uint8_t tfast[OLED_PAGES * OLED_COLS], tslow[OLED_PAGES * OLED_COLS];
+	struct s_times ts = { 1e9, 1e9, 1e9, 1e9 }, tf = ts;
+	struct Meter m;
+
+	meter_init(&m,3.5);
+	meter_update();
+
+	// Alternate, keeping the best batch of each (the host is shared)
+	for ( unsigned bx=0; bx<BATCHES; ++bx ) {
+		batch(&m,false,&ts);
+		batch(&m,true,&tf);
+	}
+	picture(&m,false,true,slow);
+	picture(&m,true,true,fast);
+	picture(&m,true,false,once);
+	text(false,tslow);
+	text(true,tfast);
+
+	puts("              pset() us  drivers us  speedup");
+	printf("  dial      %11.2f %11.2f %7.1fx\n",ts.dial,tf.dial,ts.dial / tf.dial);
+	printf("  redraw    %11.2f %11.2f %7.1fx\n",ts.redraw,tf.redraw,ts.redraw / tf.redraw);
+	printf("  set_value %11.2f %11.2f %7.1fx\n",ts.set_value,tf.set_value,ts.set_value / tf.set_value);
+	printf("  status    %11.2f %11.2f %7.1fx\n",ts.status,tf.status,ts.status / tf.status);
+	printf("  %.0f needle updates/s\n",1e6 / tf.set_value);
+
+	same(fast,slow,"from the pset() frame");
+	same(fast,once,"after a sweep");
+	same(tfast,tslow,"in the status text");
+	if ( hostfb_stats.lost ) {
+		printf("FAIL: %u presents changed bytes outside the dirty spans\n",(unsigned)hostfb_stats.lost);
+		++failures;
+	}
+	if ( ts.dial / tf.dial < MIN_SPEEDUP ) {
+		printf("FAIL: dial speedup under %.0fx\n",MIN_SPEEDUP);
+		++failures;
+	}
+	if ( failures )
+		return 1;
+	puts("PASS");
+	return 0;
+}
+
+// End meterbench.c
@@ -0,0 +1,133 @@
+/* metertest.c : Golden image tests and sweep rate of the meter
+ * Warren W. Gay VE3WWG
+ *
+ * ../meter.c and ../ugui.c draw into hostfb.c's framebuffer, with
+ * the drivers meter_init() registers. Each scene is set, presented,
+ * and the display compared with golden/<scene>.pbm. A scene that
+ * differs is written to <scene>.fail.pbm for a look. The needle is
+ * then swept as pummel_test() in ../main.c does, and the frames per
+ * second (host CPU) and bytes sent per frame are reported.
+ *
+ * Exits non-zero if any scene differs (or its golden image cannot be
+ * read), or a present left the display unlike pixmap.
+ *
+ * Usage: metertest [-g]	(-g writes the golden images instead)
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "ugui.h"
+#include "meter.h"
+#include "oled.h"
+#include "hostfb.h"
+
+#define GOLDEN		"golden/"
+#define SWEEP_FRAMES	20000
+
+static const struct {
+	const char	*name;
+	float		value;
+} scenes[] = {
+	{ "zero",	0.0 },
+	{ "v0_75",	0.75 },
+	{ "v1_75",	1.75 },
+	{ "v2_37",	2.37 },
+	{ "v3_30",	3.3 },
+	{ "full",	3.5 },
+	{ "over",	5.0 },		// Pinned at full scale
+	{ "under",	-1.0 },		// Pinned at zero
+};
+
+static unsigned failures;
+
+static void
+check(const char *name,bool golden) {
+	char path[64], fail[64];
+	unsigned ndiff;
+
+	snprintf(path,sizeof path,GOLDEN "%s.pbm",name);
+	if ( golden ) {
+		if ( hostfb_write_pbm(path) ) {
+			perror(path);
+			++failures;
+		}
+		return;
+	}
+	if ( hostfb_compare_pbm(path,&ndiff) ) {
+		printf("FAIL: %s: unreadable (make golden?)\n",path);
+		++failures;
+	} else if ( ndiff ) {
+		snprintf(fail,sizeof fail,"%s.fail.pbm",name);
+		hostfb_write_pbm(fail);
+		printf("FAIL: %s: %u pixels differ (see %s)\n",name,ndiff,fail);
+		++failures;
+	}
+}
+
+/*
+ * pummel_test()'s sweep: 0 to 3.3 and back, by 0.05
+ */
+static void
+sweep(struct Meter *m) {
+	double v = 0.0, incr = 0.05, t0, t;
+	uint32_t bytes = hostfb_stats.bytes;
+
+	t0 = hostfb_seconds();
+	for ( unsigned fx=0; fx<SWEEP_FRAMES; ++fx ) {
+		v += incr;
+		if ( v > 3.3 ) {
+			incr = -0.05;
+			v = 3.3;
+		} else if ( v < 0.0 ) {
+			v = 0.0;
+			incr = 0.05;
+		}
+		meter_set_value(m,v);
+		meter_update();
+	}
+	t = hostfb_seconds() - t0;
+	bytes = hostfb_stats.bytes - bytes;
+	printf("sweep: %u frames, %.0f frames/s, %.1f bytes/frame\n",SWEEP_FRAMES,
+		SWEEP_FRAMES / t,(double)bytes / SWEEP_FRAMES);
+}
+
+int
+main(int argc,char **argv) {
+	bool golden = argc > 1 && !strcmp(argv[1],"-g");
+	unsigned nscenes = sizeof scenes / sizeof scenes[0];
+	struct Meter m;
+
+	hostfb_reset(0x55);
+	meter_init(&m,3.5);
+	meter_update();
+
+	for ( unsigned sx=0; sx<nscenes; ++sx ) {
+		meter_set_value(&m,scenes[sx].value);
+		meter_update();
+		check(scenes[sx].name,golden);
+	}
+	if ( golden ) {
+		printf("%u golden images written\n",nscenes);
+		return failures ? 1 : 0;
+	}
+
+	// After a sweep, and after a redraw, as if set once
+	sweep(&m);
+	meter_set_value(&m,2.37);
+	meter_update();
+	check("v2_37",false);
+	meter_redraw(&m);
+	meter_update();
+	check("v2_37",false);
+
+	if ( hostfb_stats.lost ) {
+		printf("FAIL: %u presents left the display unlike pixmap\n",(unsigned)hostfb_stats.lost);
+		++failures;
+	}
+	if ( failures )
+		return 1;
+	printf("%u scenes match\nPASS\n",nscenes);
+	return 0;
+}
+
+// End metertest.c
@@ -3,7 +3,9 @@
  * Sat Oct 28 20:32:50 2017
  *
  * This program demonstrates the loading of overlay code
- * from an external SPI flash device (w25Q32).
+ * from an external SPI flash device (w25Q32), by the overlay
+ * runtime in libwwg (overlay.c): four RAM regions, LRU, and
+ * prefetch of the next overlay by DMA.
  *
  * Communication session is via USB to minicom.
  */
@@ -19,103 +21,21 @@
 #include "mcuio.h"
 #include "miniprintf.h"
 #include "winbond.h"
+#include "ovl_gen.h"
 
 /*********************************************************************
- * Overlayed functions
+ * Overlayed functions: listed in overlays.def, from which ovlgen.py
+ * generates ovl_gen.h (sections), ovl_gen.c (module table and the
+ * thunks fee() etc.) and ovl_gen.ld. Bodies are named OVL_FN(name).
  *********************************************************************/
 
-int fee(int arg) __attribute__((noinline,section(".ov_fee")));
-int fie(int arg) __attribute__((noinline,section(".ov_fie")));
-int foo(int arg) __attribute__((noinline,section(".ov_foo")));
-int fum(int arg) __attribute__((noinline,section(".ov_fum")));
-
-/*********************************************************************
- * Overlay Table
- *********************************************************************/
-
-typedef struct {
-	short		regionx;// Overlay region index
-	void		*vma;	// Overlay's mapped address
-	char		*start;	// Load start address
-	char		*stop;	// Load stop address
-	unsigned long	size;	// Size in bytes
-	void		*func;	// Function pointer
-} s_overlay;
-
-#define N_REGIONS	1	// # of overlay regions in RAM
-#define N_OVLY		4	// Total # of overlays (in all regions)
-
-#define OVERLAY(region,ov,sym)	{ region, &ov, &__load_start_ ## sym, &__load_stop_ ## sym, 0, sym }
-#define LOADREF(sym) __load_start_ ## sym, __load_stop_ ## sym 
-
-extern unsigned long overlay1;	// Provides address of overlay region 1
-
-// Function load addresses
-extern char LOADREF(fee), LOADREF(fie), LOADREF(foo), LOADREF(fum);
-
-// Overlay table:
-static s_overlay overlays[N_OVLY] = {
-	OVERLAY(0,overlay1,fee),
-	OVERLAY(0,overlay1,fie),
-	OVERLAY(0,overlay1,foo),
-	OVERLAY(0,overlay1,fum)
-};
-
-// Overlay cache:
-static s_overlay *cur_overlay[N_REGIONS] = { 0 };
-
-/*********************************************************************
- * Overlay lookup: Returns func ptr, after copying code if necessary
- *********************************************************************/
-
-static void *
-module_lookup(void *module) {
-	unsigned regionx;		// Overlay region index
-	s_overlay *ovl = 0;		// Table struct ptr
-
-	std_printf("module_lookup(%p):\n",module);
-
-	for ( unsigned ux=0; ux<N_OVLY; ++ux ) {
-		if ( overlays[ux].start == module ) {
-			regionx = overlays[ux].regionx;
-			ovl = &overlays[ux];
-			break;
-		}
-	}
-
-	if ( !ovl )
-		return 0;		// Not found
-
-	if ( !cur_overlay[regionx] || cur_overlay[regionx] != ovl ) {
-		if ( ovl->size == 0 )
-			ovl->size = (char *)ovl->stop - (char *)ovl->start;
-		cur_overlay[regionx] = ovl;
-
-		std_printf("Reading %u from SPI at 0x%04X into 0x%04X\n",
-			(unsigned)ovl->size,
-			(unsigned)ovl->start,
-			(unsigned)ovl->vma);
-
-		w25_read_data(SPI1,(unsigned)ovl->start,ovl->vma,ovl->size);
-
-		std_printf("Returned...\n");
-		std_printf("Read %u bytes: %02X %02X %02X...\n",
-			(unsigned)ovl->size,
-			((uint8_t*)ovl->vma)[0],
-			((uint8_t*)ovl->vma)[1],
-			((uint8_t*)ovl->vma)[2]);
-	}
-	return ovl->func;
-}
-
 /*********************************************************************
  * Overlay function fee()
  *********************************************************************/
 
 int 
-fee(int arg) {
-	static const char format[] // Placed in overlay
-		__attribute__((section(".ov_fee_data")))
+OVL_FN(fee)(int arg) {
+	static const char format[] // In .rodata: not in the overlay
 		= "***********\n"
 		  "fee(0x%04X)\n"
 		  "***********\n";
@@ -129,7 +49,7 @@ fee(int arg) {
  *********************************************************************/
 
 int 
-fie(int arg) {
+OVL_FN(fie)(int arg) {
 
 	std_printf("fie(0x%04X)\n",arg);
 	return arg + 0x0010;
@@ -140,7 +60,7 @@ fie(int arg) {
  *********************************************************************/
 
 int 
-foo(int arg) {
+OVL_FN(foo)(int arg) {
 
 	std_printf("foo(0x%04X)\n",arg);
 	return arg + 0x0200;
@@ -151,44 +71,12 @@ foo(int arg) {
  *********************************************************************/
 
 int 
-fum(int arg) {
+OVL_FN(fum)(int arg) {
 
 	std_printf("fum(0x%04X)\n",arg);
 	return arg + 0x3000;
 }
 
-/*********************************************************************
- * Stub functions for calling the overlay functions:
- *********************************************************************/
-
-static int
-fee_stub(int arg) {
-	int (*feep)(int arg) = module_lookup(&__load_start_fee);
-
-	return feep(arg);
-}
-
-static int
-fie_stub(int arg) {
-	int (*fiep)(int arg) = module_lookup(&__load_start_fie);
-
-	return fiep(arg);
-}
-
-static int
-foo_stub(int arg) {
-	int (*foop)(int arg) = module_lookup(&__load_start_foo);
-
-	return foop(arg);
-}
-
-static int
-fum_stub(int arg) {
-	int (*fump)(int arg) = module_lookup(&__load_start_fum);
-
-	return fump(arg);
-}
-
 /*********************************************************************
  * Launch a bunch of overlay calls and return the result:
  *********************************************************************/
@@ -197,10 +85,10 @@ static int
 calls(int arg) {
 
 	std_printf("fang(0x%04X)\n",arg);
-	arg = fee_stub(arg);
-	arg = fie_stub(arg);
-	arg = foo_stub(arg);
-	return fum_stub(arg);
+	arg = fee(arg);
+	arg = fie(arg);
+	arg = foo(arg);
+	return fum(arg);
 }
 
 /*********************************************************************
@@ -219,23 +107,24 @@ task1(void *args __attribute((unused))) {
 			r = std_getc();
 		} while ( r != 'R' && r != 'r' );
 
-		// Dump the overlay table:
-		std_printf("OVERLAY TABLE:\n");
-		for ( unsigned ux=0; ux<N_OVLY; ++ux ) {
-			std_printf("[%u] { regionx=%u, vma=%p, start=%p, stop=%p, size=%u, func=%p }\n",
-				ux, 
-				overlays[ux].regionx,
-				overlays[ux].vma,
-				overlays[ux].start,
-				overlays[ux].stop,
-				(unsigned)overlays[ux].size,
-				overlays[ux].func);
-		}
-
 		gpio_toggle(GPIOC,GPIO13);	// Toggle LED
 
 		r = calls(0x0001);		// Exercise overlays
+		ovl_sync(&ovl_gen);			// Before the next w25_read_sr1()
 		std_printf("calls(0xA) returned 0x%04X\n",r);
+
+		// Overlay statistics: a profile for ovlgen.py (-p)
+		std_printf("OVERLAY  SIZE REGION CALLS  HITS LOADS PREF  USED EVICT  WAIT_CY   MAX_CY\n");
+		for ( unsigned ux=0; ux<OVL_NMODS; ++ux ) {
+			const struct s_ovl_module *m = &ovl_modules[ux];
+
+			std_printf("%-7s %5u %6d %5u %5u %5u %4u %5u %5u %8u %8u\n",
+				m->name,m->size,m->region,
+				(unsigned)m->stats.calls,(unsigned)m->stats.hits,
+				(unsigned)m->stats.loads,(unsigned)m->stats.prefetches,
+				(unsigned)m->stats.prefetch_hits,(unsigned)m->stats.evictions,
+				(unsigned)m->stats.wait_cycles,(unsigned)m->stats.max_cycles);
+		}
 		std_printf("\nIt worked!!\n");
 	}
 }
@@ -255,6 +144,8 @@ main(void) {
 	std_set_device(mcu_usb);			// Use USB for std I/O
 
 	w25_spi_setup(SPI1,true,true,true,SPI_CR1_BAUDRATE_FPCLK_DIV_256);
+	w25_dma_init(SPI1);				// Overlays load by DMA
+	ovl_gen_init(SPI1);				// 4 x 512 byte regions
 
 	xTaskCreate(task1,"task1",100,NULL,1,NULL);
 	vTaskStartScheduler();
@@ -446,76 +446,63 @@ erase(uint32_t spi,uint32_t addr) {
 	else	std_printf("%s FAILED.\n",what);
 }
 
+/*
+ * Program a run of Intel Hex data (at most one page):
+ */
+static bool
+ihex_write(void *arg,uint32_t addr,const uint8_t *data,unsigned bytes) {
+	uint32_t spi = *(uint32_t *)arg;
+
+	return w25_write_data(spi,addr&0x00FFFFFF,(void *)data,bytes) != 0xFFFFFFFF;
+}
+
 static void
 load_ihex(uint32_t spi) {
-	s_ihex ihex;
-	char buf[200], ch;
-	unsigned rtype, count = 0, ux;
+	static struct s_ihexdec dec;	// Off the task's stack
+	unsigned rtype, count = 0;
+	char ch;
 
 	if ( w25_is_wprotect(spi) ) {
 		std_printf("Flash is write protected.\n");
 		return;
 	}
 
-	ihex_init(&ihex);
+	ihex_dec_init(&dec,ihex_write,&spi);
 	std_printf("\nReady for Intel Hex upload:\n");
+	std_printf("%08X ",(unsigned)ihex_dec_addr(&dec));
 
 	for (;;) {
-		std_printf("%08X ",(unsigned)ihex.compaddr);
-
-		while ( (ch = std_getc()) != ':' ) {
-			if ( ch == 0x1A || ch == 0x04 ) {
-				std_printf("EOF\n");
-				return;		// ^Z or ^D ends transmission
-			}
+		ch = std_getc();
+		if ( ch == 0x1A || ch == 0x04 ) {
+			if ( !dec.failed && !ihex_dec_flush(&dec) )
+				std_printf("\nError: flash write failed at %08X\n",
+					(unsigned)dec.failaddr);
+			std_printf("EOF\n");
+			return;		// ^Z or ^D ends transmission
 		}
-		buf[0] = ch;
-		std_putc(ch);
-
-		for (  ux=1; ux+1<sizeof buf; ++ux ) {
-			buf[ux] = ch = std_getc();
-			if ( ch == '\r' || ch == '\n' )
-				break;
-			if ( ch == 0x1A || ch == 0x04 ) {
-				std_printf("(EOF)\n");
-				return;		// ^Z or ^D ends transmission
-			}
+		if ( ch != '\r' && ch != '\n' )
 			std_putc(ch);
-		}
-		buf[ux] = 0;		
-		std_putc('\n');
 
-		if ( !strchr(buf,':') ) {
-			// Skip line with no hex
+		rtype = ihex_dec_putc(&dec,ch);
+		if ( rtype == IHEX_MORE )
 			continue;
-		}
-
-		rtype = ihex_parse(&ihex,buf);
-		
-		switch ( rtype ) {
-		case IHEX_RT_DATA:	// data record
-			w25_write_data(spi,ihex.addr&0x00FFFFFF,ihex.data,ihex.length);
-			ihex.compaddr += ihex.length;
-			break;
-		case IHEX_RT_EOF:	// end	// of-file record
-			break;
-		case IHEX_RT_XSEG:	// extended segment address record
-			break;
-		case IHEX_RT_XLADDR:	// extended linear address record
-			ihex.compaddr = ihex.baseaddr + ihex.addr;
-			break;
-		case IHEX_RT_SLADDR:	// start linear address record (MDK-ARM)
-			break;
-		default:
-			std_printf("Error %02X: '%s'\n",(unsigned)rtype,buf);
+		if ( rtype == IHEX_FAIL ) {
+			std_printf("\nError: bad record\n");
 			continue;
 		}
 		++count;
-		
-		if ( rtype == IHEX_RT_EOF )
+		if ( rtype & IHEX_EWRITE ) {
+			std_printf("\nError: flash write failed at %08X (rest not written)\n",
+				(unsigned)dec.failaddr);
+			rtype &= ~IHEX_EWRITE;
+		}
+
+		if ( rtype == IHEX_RT_EOF ) {
+			std_printf("\n%u records, %u page writes%s.\n",
+				count,(unsigned)dec.writes,dec.failed ? ", FAILED" : "");
 			break;
-		if ( strchr(buf,0x1A) || strchr(buf,0x04) )
-			break;			// EOF from ascii-xfr
+		}
+		std_printf("\n%08X ",(unsigned)ihex_dec_addr(&dec));
 	}
 }
 